@@ -0,0 +1,182 @@
+/******************************************************************************
+   Copyright 2017-2019 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+
+/*************
+
+Arena is a bump allocator for data that all dies at the same time, like the
+bookkeeping of a single View. Allocations are carved out of a short list of
+large chunks, which are released together when the Arena is destroyed.
+Individual allocations are never freed.
+
+Chunks start small so that views that never write anything stay cheap, and
+double in size up to 'max_chunk_size'. Freed chunks go back to a process-wide
+ArenaChunkPool rather than to malloc, so short transactions reuse memory
+that's already mapped instead of faulting in fresh pages every time.
+
+*************/
+
+class ArenaChunkPool {
+public:
+    //the most memory we'll hold onto for reuse
+    enum { max_pooled_bytes = 64 * 1024 * 1024 };
+
+    static ArenaChunkPool& singleton() {
+        static ArenaChunkPool* pool = new ArenaChunkPool();
+        return *pool;
+    }
+
+    void* acquire(size_t bytes) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            auto it = m_chunks.find(bytes);
+            if (it != m_chunks.end() && it->second.size()) {
+                void* res = it->second.back();
+                it->second.pop_back();
+                m_pooled_bytes -= bytes;
+                return res;
+            }
+        }
+
+        void* chunk = malloc(bytes);
+        if (!chunk) {
+            throw std::bad_alloc();
+        }
+
+        return chunk;
+    }
+
+    void release(void* chunk, size_t bytes) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (m_pooled_bytes + bytes <= max_pooled_bytes) {
+                m_chunks[bytes].push_back(chunk);
+                m_pooled_bytes += bytes;
+                return;
+            }
+        }
+
+        free(chunk);
+    }
+
+private:
+    ArenaChunkPool() : m_pooled_bytes(0)
+    {
+    }
+
+    std::mutex m_mutex;
+
+    //free chunks, by size
+    std::map<size_t, std::vector<void*> > m_chunks;
+
+    size_t m_pooled_bytes;
+};
+
+class Arena {
+public:
+    enum { initial_chunk_size = 16 * 1024 };
+    enum { max_chunk_size = 4 * 1024 * 1024 };
+
+    Arena() :
+            m_cur(nullptr),
+            m_remaining(0),
+            m_next_chunk_size(initial_chunk_size),
+            m_bytes_allocated(0)
+    {
+    }
+
+    ~Arena() {
+        for (auto& chunkAndSize: m_chunks) {
+            ArenaChunkPool::singleton().release(chunkAndSize.first, chunkAndSize.second);
+        }
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        size_t padding = (alignment - ((uintptr_t)m_cur % alignment)) % alignment;
+
+        if (!m_cur || padding + bytes > m_remaining) {
+            newChunk(bytes + alignment);
+            padding = (alignment - ((uintptr_t)m_cur % alignment)) % alignment;
+        }
+
+        uint8_t* res = m_cur + padding;
+
+        m_cur += padding + bytes;
+        m_remaining -= padding + bytes;
+
+        return res;
+    }
+
+    template<class T>
+    T* allocateArray(size_t count) {
+        return (T*)allocate(sizeof(T) * count, alignof(T));
+    }
+
+    //total bytes in our chunks
+    size_t bytesAllocated() const {
+        return m_bytes_allocated;
+    }
+
+    size_t chunkCount() const {
+        return m_chunks.size();
+    }
+
+private:
+    void newChunk(size_t minBytes) {
+        size_t chunkSize = m_next_chunk_size;
+
+        while (chunkSize < minBytes) {
+            chunkSize *= 2;
+        }
+
+        if (m_next_chunk_size < max_chunk_size) {
+            m_next_chunk_size *= 2;
+        }
+
+        void* chunk = ArenaChunkPool::singleton().acquire(chunkSize);
+
+        m_chunks.push_back(std::make_pair(chunk, chunkSize));
+        m_bytes_allocated += chunkSize;
+
+        m_cur = (uint8_t*)chunk;
+        m_remaining = chunkSize;
+    }
+
+    //each chunk, and its size
+    std::vector<std::pair<void*, size_t> > m_chunks;
+
+    uint8_t* m_cur;
+
+    size_t m_remaining;
+
+    size_t m_next_chunk_size;
+
+    size_t m_bytes_allocated;
+};
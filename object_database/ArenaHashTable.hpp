@@ -0,0 +1,419 @@
+/******************************************************************************
+   Copyright 2017-2019 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "Arena.hpp"
+
+/*************
+
+ArenaHashMap is an open-addressing (linear probing) hash table whose slots
+live in an Arena. It supports the subset of std::unordered_map that View
+uses. When the table grows we leave the old slot array in the arena, so the
+total space used is at most about twice the final table size, and tearing
+the table down is a single walk over the slots.
+
+We scramble the result of 'Hash' before using it, so weak hashes (like
+xor'ing the two halves of a pair) don't cluster.
+
+Iterators and pointers to values are invalidated by inserts.
+
+*************/
+
+template<class K, class V, class Hash = std::hash<K> >
+class ArenaHashMap {
+    enum { slot_empty = 0, slot_full = 1, slot_tombstone = 2 };
+
+public:
+    typedef std::pair<K, V> value_type;
+
+    template<bool is_const>
+    class iterator_base {
+        typedef typename std::conditional<is_const, const ArenaHashMap*, ArenaHashMap*>::type table_ptr;
+        typedef typename std::conditional<is_const, const value_type, value_type>::type ref_type;
+
+    public:
+        iterator_base(table_ptr table, size_t slot) :
+                m_table(table),
+                m_slot(slot)
+        {
+            skipToFull();
+        }
+
+        //allow conversion from iterator to const_iterator
+        iterator_base(const iterator_base<false>& other) :
+                m_table(other.table()),
+                m_slot(other.slot())
+        {
+        }
+
+        ref_type& operator*() const {
+            return m_table->m_slots[m_slot];
+        }
+
+        ref_type* operator->() const {
+            return &m_table->m_slots[m_slot];
+        }
+
+        iterator_base& operator++() {
+            m_slot++;
+            skipToFull();
+            return *this;
+        }
+
+        bool operator==(const iterator_base& other) const {
+            return m_slot == other.m_slot;
+        }
+
+        bool operator!=(const iterator_base& other) const {
+            return m_slot != other.m_slot;
+        }
+
+        table_ptr table() const {
+            return m_table;
+        }
+
+        size_t slot() const {
+            return m_slot;
+        }
+
+    private:
+        void skipToFull() {
+            while (m_slot < m_table->m_capacity && m_table->m_states[m_slot] != slot_full) {
+                m_slot++;
+            }
+        }
+
+        table_ptr m_table;
+        size_t m_slot;
+    };
+
+    typedef iterator_base<false> iterator;
+    typedef iterator_base<true> const_iterator;
+
+    ArenaHashMap(Arena& arena) :
+            m_arena(&arena),
+            m_slots(nullptr),
+            m_states(nullptr),
+            m_capacity(0),
+            m_shift(64),
+            m_size(0),
+            m_tombstones(0)
+    {
+    }
+
+    ~ArenaHashMap() {
+        for (size_t k = 0; k < m_capacity; k++) {
+            if (m_states[k] == slot_full) {
+                m_slots[k].~value_type();
+            }
+        }
+    }
+
+    ArenaHashMap(const ArenaHashMap&) = delete;
+    ArenaHashMap& operator=(const ArenaHashMap&) = delete;
+
+    size_t size() const {
+        return m_size;
+    }
+
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    iterator begin() {
+        return iterator(this, 0);
+    }
+
+    iterator end() {
+        return iterator(this, m_capacity);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, m_capacity);
+    }
+
+    iterator find(const K& key) {
+        return iterator(this, findSlot(key));
+    }
+
+    const_iterator find(const K& key) const {
+        return const_iterator(this, findSlot(key));
+    }
+
+    size_t count(const K& key) const {
+        return findSlot(key) == m_capacity ? 0 : 1;
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) {
+        size_t slot = findSlot(value.first);
+
+        if (slot != m_capacity) {
+            return std::make_pair(iterator(this, slot), false);
+        }
+
+        slot = insertNew(value.first, value.second);
+
+        return std::make_pair(iterator(this, slot), true);
+    }
+
+    V& operator[](const K& key) {
+        size_t slot = findSlot(key);
+
+        if (slot == m_capacity) {
+            slot = insertNew(K(key), V());
+        }
+
+        return m_slots[slot].second;
+    }
+
+    size_t erase(const K& key) {
+        size_t slot = findSlot(key);
+
+        if (slot == m_capacity) {
+            return 0;
+        }
+
+        eraseSlot(slot);
+
+        return 1;
+    }
+
+    void erase(iterator it) {
+        eraseSlot(it.slot());
+    }
+
+private:
+    size_t slotFor(const K& key) const {
+        return (size_t)(((uint64_t)Hash()(key) * 0x9E3779B97F4A7C15ULL) >> m_shift);
+    }
+
+    //the slot holding 'key', or m_capacity if it's not present
+    size_t findSlot(const K& key) const {
+        if (!m_size) {
+            return m_capacity;
+        }
+
+        size_t mask = m_capacity - 1;
+
+        for (size_t slot = slotFor(key); ; slot = (slot + 1) & mask) {
+            if (m_states[slot] == slot_empty) {
+                return m_capacity;
+            }
+            if (m_states[slot] == slot_full && m_slots[slot].first == key) {
+                return slot;
+            }
+        }
+    }
+
+    //insert a key we know isn't present and return its slot
+    size_t insertNew(const K& key, const V& value) {
+        size_t slot = claimSlot(key);
+
+        new (&m_slots[slot]) value_type(key, value);
+        markFull(slot);
+
+        return slot;
+    }
+
+    //the same, but moving the key and value in. rehash uses this so that it
+    //doesn't deep-copy every value it relocates.
+    size_t insertNew(K&& key, V&& value) {
+        size_t slot = claimSlot(key);
+
+        new (&m_slots[slot]) value_type(std::move(key), std::move(value));
+        markFull(slot);
+
+        return slot;
+    }
+
+    //find a free slot for a key we know isn't present, growing if we need to.
+    //The caller constructs the value in it and then calls markFull.
+    size_t claimSlot(const K& key) {
+        if ((m_size + m_tombstones + 1) * 4 > m_capacity * 3) {
+            rehash();
+        }
+
+        size_t mask = m_capacity - 1;
+        size_t slot = slotFor(key);
+
+        while (m_states[slot] == slot_full) {
+            slot = (slot + 1) & mask;
+        }
+
+        return slot;
+    }
+
+    void markFull(size_t slot) {
+        if (m_states[slot] == slot_tombstone) {
+            m_tombstones--;
+        }
+
+        m_states[slot] = slot_full;
+        m_size++;
+    }
+
+    void eraseSlot(size_t slot) {
+        m_slots[slot].~value_type();
+        m_states[slot] = slot_tombstone;
+        m_tombstones++;
+        m_size--;
+    }
+
+    //move everything into a fresh slot array. We grow if we're more than half
+    //full of live values, otherwise we're just clearing out tombstones.
+    void rehash() {
+        size_t newCapacity = m_capacity ? m_capacity : 16;
+        while ((m_size + 1) * 2 > newCapacity) {
+            newCapacity *= 2;
+        }
+
+        value_type* oldSlots = m_slots;
+        uint8_t* oldStates = m_states;
+        size_t oldCapacity = m_capacity;
+
+        m_slots = m_arena->allocateArray<value_type>(newCapacity);
+        m_states = m_arena->allocateArray<uint8_t>(newCapacity);
+        std::fill(m_states, m_states + newCapacity, (uint8_t)slot_empty);
+
+        m_capacity = newCapacity;
+        m_shift = 64;
+        for (size_t c = newCapacity; c > 1; c /= 2) {
+            m_shift--;
+        }
+
+        m_size = 0;
+        m_tombstones = 0;
+
+        for (size_t k = 0; k < oldCapacity; k++) {
+            if (oldStates[k] == slot_full) {
+                insertNew(std::move(oldSlots[k].first), std::move(oldSlots[k].second));
+                oldSlots[k].~value_type();
+            }
+        }
+    }
+
+    Arena* m_arena;
+
+    value_type* m_slots;
+
+    uint8_t* m_states;
+
+    size_t m_capacity;
+
+    //64 - log2(m_capacity)
+    size_t m_shift;
+
+    size_t m_size;
+
+    size_t m_tombstones;
+};
+
+/*************
+
+ArenaHashSet is an ArenaHashMap with no values.
+
+*************/
+
+template<class K, class Hash = std::hash<K> >
+class ArenaHashSet {
+    class Empty {};
+
+    typedef ArenaHashMap<K, Empty, Hash> map_type;
+
+public:
+    class const_iterator {
+    public:
+        const_iterator(typename map_type::const_iterator it) : m_it(it)
+        {
+        }
+
+        const K& operator*() const {
+            return m_it->first;
+        }
+
+        const K* operator->() const {
+            return &m_it->first;
+        }
+
+        const_iterator& operator++() {
+            ++m_it;
+            return *this;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return m_it == other.m_it;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return m_it != other.m_it;
+        }
+
+    private:
+        typename map_type::const_iterator m_it;
+    };
+
+    typedef const_iterator iterator;
+
+    ArenaHashSet(Arena& arena) : m_map(arena)
+    {
+    }
+
+    size_t size() const {
+        return m_map.size();
+    }
+
+    bool empty() const {
+        return m_map.empty();
+    }
+
+    const_iterator begin() const {
+        return const_iterator(m_map.begin());
+    }
+
+    const_iterator end() const {
+        return const_iterator(m_map.end());
+    }
+
+    const_iterator find(const K& key) const {
+        return const_iterator(m_map.find(key));
+    }
+
+    size_t count(const K& key) const {
+        return m_map.count(key);
+    }
+
+    bool insert(const K& key) {
+        return m_map.insert(std::make_pair(key, Empty())).second;
+    }
+
+    size_t erase(const K& key) {
+        return m_map.erase(key);
+    }
+
+private:
+    map_type m_map;
+};
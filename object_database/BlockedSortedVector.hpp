@@ -0,0 +1,375 @@
+/******************************************************************************
+   Copyright 2017-2019 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+/*************
+
+BlockedSortedVector stores a sorted set of trivially copyable values in a
+sequence of contiguous blocks, each holding at most 'max_block_size' values.
+
+Compared to a std::set, each value costs its own size (plus a little slack
+in partially filled blocks) instead of a tree node, and walking the set in
+order touches memory sequentially. Compared to a single sorted std::vector,
+inserting or removing a value only moves the values in one block.
+
+Each block may carry a 'Summary' of its contents, which lets clients skip
+whole blocks during a scan. A Summary must be default constructible and
+provide
+
+    static Summary compute(const T* begin, const T* end, const T* next);
+
+where 'next' points at the first value of the following block, or is
+nullptr for the last block. Every write recomputes the summaries of the
+blocks it touched and of their predecessors, which look at their first
+values. So reading a summary never modifies the vector, and any number of
+threads can read it at once, as long as nobody writes to it meanwhile.
+
+*************/
+
+template<class T>
+class NoBlockSummary {
+public:
+    static NoBlockSummary compute(const T* begin, const T* end, const T* next) {
+        return NoBlockSummary();
+    }
+};
+
+template<class T, class Less = std::less<T>, class Summary = NoBlockSummary<T> >
+class BlockedSortedVector {
+public:
+    enum { max_block_size = 512 };
+
+    class iterator {
+    public:
+        iterator() : m_vec(nullptr), m_block(0), m_offset(0)
+        {
+        }
+
+        iterator(const BlockedSortedVector* vec, size_t block, size_t offset) :
+                m_vec(vec),
+                m_block(block),
+                m_offset(offset)
+        {
+        }
+
+        const T& operator*() const {
+            return m_vec->m_blocks[m_block][m_offset];
+        }
+
+        const T* operator->() const {
+            return &m_vec->m_blocks[m_block][m_offset];
+        }
+
+        iterator& operator++() {
+            m_offset++;
+            if (m_offset >= m_vec->m_blocks[m_block].size()) {
+                m_block++;
+                m_offset = 0;
+            }
+            return *this;
+        }
+
+        iterator& operator--() {
+            if (m_offset == 0) {
+                m_block--;
+                m_offset = m_vec->m_blocks[m_block].size() - 1;
+            } else {
+                m_offset--;
+            }
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const {
+            return m_block == other.m_block && m_offset == other.m_offset;
+        }
+
+        bool operator!=(const iterator& other) const {
+            return !(*this == other);
+        }
+
+        size_t block() const {
+            return m_block;
+        }
+
+        size_t offset() const {
+            return m_offset;
+        }
+
+    private:
+        const BlockedSortedVector* m_vec;
+        size_t m_block;
+        size_t m_offset;
+    };
+
+    BlockedSortedVector() : m_size(0)
+    {
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    iterator begin() const {
+        return iterator(this, 0, 0);
+    }
+
+    iterator end() const {
+        return iterator(this, m_blocks.size(), 0);
+    }
+
+    size_t blockCount() const {
+        return m_blocks.size();
+    }
+
+    // an iterator pointing at the first value in 'block'
+    iterator blockBegin(size_t block) const {
+        return iterator(this, block, 0);
+    }
+
+    size_t blockSize(size_t block) const {
+        return m_blocks[block].size();
+    }
+
+    // the values in 'block', contiguous and in order
+    const T* blockData(size_t block) const {
+        return &m_blocks[block][0];
+    }
+
+    const Summary& blockSummary(size_t block) const {
+        return m_summaries[block];
+    }
+
+    // the first value that's not less than 'value'
+    iterator lower_bound(const T& value) const {
+        size_t block = blockFor(value);
+
+        if (block == m_blocks.size()) {
+            return end();
+        }
+
+        const std::vector<T>& b = m_blocks[block];
+
+        return iterator(this, block, std::lower_bound(b.begin(), b.end(), value, m_less) - b.begin());
+    }
+
+    // the first value that's strictly greater than 'value'
+    iterator upper_bound(const T& value) const {
+        iterator it = lower_bound(value);
+
+        if (it != end() && !m_less(value, *it)) {
+            ++it;
+        }
+
+        return it;
+    }
+
+    iterator find(const T& value) const {
+        iterator it = lower_bound(value);
+
+        if (it != end() && !m_less(value, *it)) {
+            return it;
+        }
+
+        return end();
+    }
+
+    bool contains(const T& value) const {
+        return find(value) != end();
+    }
+
+    // insert 'value', returning false if an equivalent value was already present.
+    bool insert(const T& value) {
+        if (m_blocks.size() == 0) {
+            m_blocks.push_back(std::vector<T>());
+            m_blocks.back().push_back(value);
+            m_summaries.push_back(Summary());
+            m_size++;
+            updateSummaries(0);
+            return true;
+        }
+
+        size_t block = blockFor(value);
+
+        // values bigger than everything we have go into the last block
+        if (block == m_blocks.size()) {
+            block--;
+        }
+
+        std::vector<T>& b = m_blocks[block];
+
+        auto it = std::lower_bound(b.begin(), b.end(), value, m_less);
+
+        if (it != b.end() && !m_less(value, *it)) {
+            return false;
+        }
+
+        b.insert(it, value);
+        m_size++;
+
+        if (b.size() > max_block_size) {
+            splitBlock(block);
+        }
+
+        updateSummaries(block);
+
+        return true;
+    }
+
+    // replace an existing value with an equivalent one (one that compares
+    // equal under 'Less'). Returns false if no such value exists.
+    bool replace(const T& value) {
+        iterator it = find(value);
+
+        if (it == end()) {
+            return false;
+        }
+
+        m_blocks[it.block()][it.offset()] = value;
+
+        updateSummaries(it.block());
+
+        return true;
+    }
+
+    bool erase(const T& value) {
+        iterator it = find(value);
+
+        if (it == end()) {
+            return false;
+        }
+
+        erase(it);
+
+        return true;
+    }
+
+    void erase(iterator it) {
+        std::vector<T>& b = m_blocks[it.block()];
+
+        b.erase(b.begin() + it.offset());
+        m_size--;
+
+        if (b.size() == 0) {
+            m_blocks.erase(m_blocks.begin() + it.block());
+            m_summaries.erase(m_summaries.begin() + it.block());
+        } else if (b.size() < max_block_size / 4) {
+            mergeWithNeighbor(it.block());
+        }
+
+        updateSummaries(it.block());
+    }
+
+    void clear() {
+        m_blocks.clear();
+        m_summaries.clear();
+        m_size = 0;
+    }
+
+    // total bytes we've allocated, for diagnostics.
+    size_t bytesAllocated() const {
+        size_t res = m_blocks.capacity() * sizeof(std::vector<T>) + m_summaries.capacity() * sizeof(Summary);
+
+        for (auto& b: m_blocks) {
+            res += b.capacity() * sizeof(T);
+        }
+
+        return res;
+    }
+
+private:
+    // the index of the first block whose largest value is not less than 'value',
+    // or m_blocks.size() if there is none.
+    size_t blockFor(const T& value) const {
+        size_t lo = 0;
+        size_t hi = m_blocks.size();
+
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+
+            if (m_less(m_blocks[mid].back(), value)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        return lo;
+    }
+
+    void splitBlock(size_t block) {
+        std::vector<T>& b = m_blocks[block];
+
+        std::vector<T> upperHalf(b.begin() + b.size() / 2, b.end());
+        b.erase(b.begin() + b.size() / 2, b.end());
+        b.shrink_to_fit();
+
+        m_blocks.insert(m_blocks.begin() + block + 1, std::move(upperHalf));
+        m_summaries.insert(m_summaries.begin() + block + 1, Summary());
+    }
+
+    void mergeWithNeighbor(size_t block) {
+        if (m_blocks.size() < 2) {
+            return;
+        }
+
+        // always fold the later block into the earlier one
+        size_t lower = block + 1 < m_blocks.size() ? block : block - 1;
+
+        if (m_blocks[lower].size() + m_blocks[lower + 1].size() > max_block_size) {
+            return;
+        }
+
+        m_blocks[lower].insert(m_blocks[lower].end(), m_blocks[lower + 1].begin(), m_blocks[lower + 1].end());
+        m_blocks.erase(m_blocks.begin() + lower + 1);
+        m_summaries.erase(m_summaries.begin() + lower + 1);
+    }
+
+    // recompute the summaries a write to 'block' could have changed. That's its own,
+    // its predecessor's, which looks at its first value, and, since the write may have
+    // split 'block' or merged or removed it, whatever block now follows it.
+    void updateSummaries(size_t block) {
+        size_t lo = block > 0 ? block - 1 : 0;
+        size_t hi = std::min(block + 2, m_blocks.size());
+
+        for (size_t b = lo; b < hi; b++) {
+            const std::vector<T>& values = m_blocks[b];
+
+            m_summaries[b] = Summary::compute(
+                &values[0],
+                &values[0] + values.size(),
+                b + 1 < m_blocks.size() ? &m_blocks[b + 1][0] : nullptr
+            );
+        }
+    }
+
+    std::vector<std::vector<T> > m_blocks;
+
+    // one per block, kept up to date by every write
+    std::vector<Summary> m_summaries;
+
+    size_t m_size;
+
+    Less m_less;
+};
@@ -0,0 +1,293 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "Common.hpp"
+#include "IndexId.hpp"
+#include "ObjectFieldId.hpp"
+#include "direct_types/all.hpp"
+
+/*************
+
+ChangeLog remembers which (field, object) pairs and which index memberships
+each recent transaction changed, so that a consumer who has processed
+everything up to some transaction can ask for just what happened since.
+
+It's bounded: we hold at most 'capacity' changes (a write, or one object
+joining or leaving one index value), dropping the oldest transactions whole
+to make room. Once we've dropped a transaction we can't answer questions
+about anything before it, and say so, so the consumer knows to rescan.
+
+*************/
+
+class ChangeLog {
+public:
+    class Changes {
+    public:
+        // every change after the transaction we were asked about is here
+        bool complete;
+
+        // the last transaction we know of. Ask about this one next time.
+        transaction_id latestTid;
+
+        // the objects with writes to the fields we were asked about, sorted
+        std::vector<object_id> oids;
+
+        // for each index value, the objects that joined or left it, each sorted.
+        // An object that joined and then left again (or the reverse) is in neither.
+        std::map<IndexKey, std::pair<std::vector<object_id>, std::vector<object_id> > > indexChanges;
+    };
+
+    ChangeLog() :
+        mCapacity(0),
+        mSize(0),
+        mCompleteSince(NO_TRANSACTION),
+        mLatestTid(NO_TRANSACTION)
+    {
+    }
+
+    // hold at most 'capacity' changes. Zero turns us off and forgets everything.
+    // We can only answer for transactions after 'currentTid'.
+    void setCapacity(size_t capacity, transaction_id currentTid) {
+        if (!mCapacity) {
+            mCompleteSince = currentTid;
+            mLatestTid = currentTid;
+        }
+
+        mCapacity = capacity;
+
+        if (!mCapacity) {
+            mTransactions.clear();
+            mSize = 0;
+            return;
+        }
+
+        dropOldestUntilWithinCapacity();
+    }
+
+    bool enabled() const {
+        return mCapacity > 0;
+    }
+
+    size_t size() const {
+        return mSize;
+    }
+
+    // transactions have to arrive in order. Anything before our latest is ignored.
+    void record(
+            transaction_id tid,
+            const ConstDict<ObjectFieldId, OneOf<None, Bytes> >& writes,
+            const ConstDict<IndexId, TupleOf<object_id> >& setAdds,
+            const ConstDict<IndexId, TupleOf<object_id> >& setRemoves
+            ) {
+        if (!mCapacity || tid <= mLatestTid) {
+            return;
+        }
+
+        mLatestTid = tid;
+
+        mTransactions.push_back(Transaction());
+        Transaction& transaction = mTransactions.back();
+        transaction.tid = tid;
+
+        for (const auto& keyAndValue: writes) {
+            transaction.writes.push_back(std::make_pair(keyAndValue.first.fieldId(), keyAndValue.first.objId()));
+        }
+
+        mSize += transaction.writes.size();
+
+        auto indexChangesFor = [&](const IndexId& index) -> IndexChanges& {
+            IndexKey key(index.fieldId(), index.indexValue());
+
+            for (auto& changes: transaction.indexChanges) {
+                if (changes.index == key) {
+                    return changes;
+                }
+            }
+
+            transaction.indexChanges.push_back(IndexChanges(key));
+            return transaction.indexChanges.back();
+        };
+
+        for (const auto& indexAndOids: setAdds) {
+            IndexChanges& changes = indexChangesFor(indexAndOids.first);
+
+            for (object_id oid: indexAndOids.second) {
+                changes.adds.push_back(oid);
+            }
+
+            mSize += indexAndOids.second.size();
+        }
+
+        for (const auto& indexAndOids: setRemoves) {
+            IndexChanges& changes = indexChangesFor(indexAndOids.first);
+
+            for (object_id oid: indexAndOids.second) {
+                changes.removes.push_back(oid);
+            }
+
+            mSize += indexAndOids.second.size();
+        }
+
+        dropOldestUntilWithinCapacity();
+    }
+
+    /*****
+    what changed after 'tid'. If 'fields' isn't null, we only report writes to those
+    fields and changes to indices on them.
+    *****/
+    Changes changesSince(transaction_id tid, const std::set<field_id>* fields) const {
+        Changes res;
+        res.complete = mCapacity && tid >= mCompleteSince;
+        res.latestTid = mLatestTid;
+
+        auto wanted = [&](field_id field) {
+            return !fields || fields->count(field);
+        };
+
+        std::set<object_id> oids;
+
+        // for each (index value, object), whether the first and last changes we saw added it
+        std::map<IndexKey, std::map<object_id, std::pair<bool, bool> > > memberships;
+
+        auto note = [&](std::map<object_id, std::pair<bool, bool> >& objects, object_id oid, bool added) {
+            auto it = objects.find(oid);
+
+            if (it == objects.end()) {
+                objects[oid] = std::make_pair(added, added);
+            } else {
+                it->second.second = added;
+            }
+        };
+
+        auto it = std::upper_bound(mTransactions.begin(), mTransactions.end(), tid, TransactionLess());
+
+        for (; it != mTransactions.end(); ++it) {
+            for (const auto& fieldAndOid: it->writes) {
+                if (wanted(fieldAndOid.first)) {
+                    oids.insert(fieldAndOid.second);
+                }
+            }
+
+            for (const auto& changes: it->indexChanges) {
+                if (!wanted(changes.index.fieldId())) {
+                    continue;
+                }
+
+                auto& objects = memberships[changes.index];
+
+                for (object_id oid: changes.adds) {
+                    note(objects, oid, true);
+                }
+
+                for (object_id oid: changes.removes) {
+                    note(objects, oid, false);
+                }
+            }
+        }
+
+        res.oids.assign(oids.begin(), oids.end());
+
+        for (const auto& indexAndObjects: memberships) {
+            std::vector<object_id> joined;
+            std::vector<object_id> left;
+
+            for (const auto& oidAndFirstLast: indexAndObjects.second) {
+                // an object's changes to one index value alternate, so if the first and
+                // last disagree it ended up where it started
+                if (oidAndFirstLast.second.first != oidAndFirstLast.second.second) {
+                    continue;
+                }
+
+                (oidAndFirstLast.second.first ? joined : left).push_back(oidAndFirstLast.first);
+            }
+
+            if (joined.size() || left.size()) {
+                res.indexChanges[indexAndObjects.first] = std::make_pair(joined, left);
+            }
+        }
+
+        return res;
+    }
+
+private:
+    class IndexChanges {
+    public:
+        IndexChanges(const IndexKey& inIndex) : index(inIndex)
+        {
+        }
+
+        IndexKey index;
+
+        std::vector<object_id> adds;
+
+        std::vector<object_id> removes;
+    };
+
+    class Transaction {
+    public:
+        size_t changeCount() const {
+            size_t res = writes.size();
+
+            for (const auto& changes: indexChanges) {
+                res += changes.adds.size() + changes.removes.size();
+            }
+
+            return res;
+        }
+
+        transaction_id tid;
+
+        std::vector<std::pair<field_id, object_id> > writes;
+
+        std::vector<IndexChanges> indexChanges;
+    };
+
+    class TransactionLess {
+    public:
+        bool operator()(transaction_id tid, const Transaction& transaction) const {
+            return tid < transaction.tid;
+        }
+    };
+
+    void dropOldestUntilWithinCapacity() {
+        while (mSize > mCapacity && mTransactions.size()) {
+            mSize -= mTransactions.front().changeCount();
+            mCompleteSince = mTransactions.front().tid;
+            mTransactions.pop_front();
+        }
+    }
+
+    size_t mCapacity;
+
+    // the number of changes in mTransactions
+    size_t mSize;
+
+    // we know about every change after this transaction
+    transaction_id mCompleteSince;
+
+    transaction_id mLatestTid;
+
+    // in increasing transaction order
+    std::deque<Transaction> mTransactions;
+};
@@ -0,0 +1,130 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#include "FrameCompression.hpp"
+
+/***********
+CoalescingWriteBuffer holds the framed messages (a 4 byte length followed by
+the message) waiting to go out on a socket, packed together into chunks of
+about one TLS record each, so that a burst of small messages becomes a few
+large writes instead of two tiny writes per message.
+
+Messages bigger than a chunk aren't copied: their length goes at the end of
+the current chunk and the message itself becomes a chunk of its own.
+
+SSL_write requires that after it asks us to retry, we retry with exactly the
+same buffer. So once someone has looked at the front chunk we never append
+to it again.
+***********/
+
+class CoalescingWriteBuffer {
+public:
+    // the largest TLS record. We try to fill each one.
+    enum { target_chunk_size = 16 * 1024 };
+
+    CoalescingWriteBuffer() :
+        mFrontSent(0),
+        mFrontIsLocked(false),
+        mBytesPending(0)
+    {
+    }
+
+    // if 'isCompressed', 'msg' is the body of a compressed frame (see FrameCompression)
+    void appendMessage(std::string&& msg, bool isCompressed = false) {
+        uint32_t bytecount = msg.size() | (isCompressed ? FrameCompression::compressed_flag : 0);
+        const char* header = (const char*)&bytecount;
+
+        mBytesPending += msg.size() + sizeof(bytecount);
+
+        if (msg.size() + sizeof(bytecount) > target_chunk_size) {
+            appendToChunk(header, sizeof(bytecount));
+            mChunks.push_back(std::move(msg));
+        } else {
+            std::string& chunk = chunkWithRoomFor(msg.size() + sizeof(bytecount));
+            chunk.append(header, sizeof(bytecount));
+            chunk.append(msg);
+        }
+    }
+
+    bool empty() const {
+        return mChunks.empty();
+    }
+
+    size_t chunkCount() const {
+        return mChunks.size();
+    }
+
+    size_t bytesPending() const {
+        return mBytesPending;
+    }
+
+    // the unsent part of the front chunk. The buffer can't be empty.
+    // This chunk won't change until it has been completely consumed.
+    const char* frontData() {
+        mFrontIsLocked = true;
+        return &mChunks.front()[mFrontSent];
+    }
+
+    size_t frontSize() const {
+        return mChunks.front().size() - mFrontSent;
+    }
+
+    // 'bytes' of the front chunk made it onto the socket
+    void consumed(size_t bytes) {
+        mFrontSent += bytes;
+        mBytesPending -= bytes;
+
+        if (mFrontSent == mChunks.front().size()) {
+            mChunks.pop_front();
+            mFrontSent = 0;
+            mFrontIsLocked = false;
+        }
+    }
+
+private:
+    bool canAppendToBack() const {
+        return mChunks.size() && (mChunks.size() > 1 || !mFrontIsLocked);
+    }
+
+    std::string& chunkWithRoomFor(size_t bytes) {
+        if (!canAppendToBack() || mChunks.back().size() + bytes > target_chunk_size) {
+            mChunks.push_back(std::string());
+            mChunks.back().reserve(target_chunk_size);
+        }
+
+        return mChunks.back();
+    }
+
+    void appendToChunk(const char* data, size_t bytes) {
+        chunkWithRoomFor(bytes).append(data, bytes);
+    }
+
+    std::deque<std::string> mChunks;
+
+    // how much of the front chunk has been written
+    size_t mFrontSent;
+
+    // whether we've handed out the front chunk, in which case it can't change
+    bool mFrontIsLocked;
+
+    size_t mBytesPending;
+};
@@ -70,7 +70,7 @@ public:
   }
 
   size_t hash() const {
-    return m_fieldId ^ m_hash_val;
+    return hashCombine(m_fieldId, m_hash_val);
   }
 
 private:
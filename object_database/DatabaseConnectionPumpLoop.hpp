@@ -17,7 +17,11 @@
 #pragma once
 
 #include <Python.h>
+#include <atomic>
+#include <cerrno>
+#include <climits>
 #include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <vector>
@@ -27,8 +31,15 @@
 #include <fcntl.h>
 #include <openssl/ssl.h>
 
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
 #include "typed_python/Format.hpp"
-#include "DatabaseConnectionPumpLoop.hpp"
+#include "CoalescingWriteBuffer.hpp"
+#include "FrameCompression.hpp"
+#include "FrameReadBuffer.hpp"
+#include "SpscQueue.hpp"
 
 
 /***********
@@ -37,6 +48,20 @@ Two threads - one for handling serialization and message processing
 the other for handling interacting with python objects, with the point being
 that the GIL can get blocked for a long time, and we don't want that to preclude
 us heartbeating.
+
+The first of these can either be a dedicated thread running 'writeLoop', or
+one of the shared threads of a PumpLoopEngine, which calls 'pump' whenever
+our socket is ready or someone wakes us up.
+
+Messages pass between the python thread and the socket thread through a
+lock-free SpscQueue in each direction. Each side only wakes the other if it
+might be asleep, so a burst of messages costs one wakeup rather than a lock
+and a syscall apiece. 'write' and 'setHeartbeatMessage' must not be called
+concurrently, which the GIL ensures for our python callers.
+
+We track every message from 'write' until its last byte is on the wire, both
+for 'pumpStats' and so that 'write' can block while more than the high water
+mark is queued, rather than letting a slow peer grow our queue forever.
 ***********/
 
 // declaration of the PySSL socket datastructure which is contained
@@ -77,28 +102,79 @@ typedef struct {
 
 // extern PyTypeObject PySSLSocket_Type;
 
+// something that can process our incoming messages in C++ before they go to python.
+class NativeMessageHandler {
+public:
+    virtual ~NativeMessageHandler() {}
+
+    // called on the read loop with the GIL held. Returns a new reference to what
+    // the python callback should receive in place of the raw bytes, or nullptr
+    // if we dealt with the message and python doesn't need to see it.
+    virtual PyObject* handle(const char* data, size_t size) = 0;
+};
+
 class DatabaseConnectionPumpLoop {
 public:
     DatabaseConnectionPumpLoop(PySSLSocket* pySslSocket) :
         mSocket((PySSLSocket*)incref((PyObject*)pySslSocket)),
         mSSL(mSocket->ssl),
         mIsClosed(false),
+        mPumpsWithNoUpdate(0),
+        mReadLoopIsWaiting(false),
+        mHasConsumer(false),
+        mReadyFDArmed(false),
+        mReadyReadFD(-1),
+        mReadyWriteFD(-1),
+        mSocketThreadWakePending(false),
+        mNextHeartbeat(0),
         mHeartbeatInterval(0),
-        mMessagesInWriteBufferFrontPartSent(0),
-        mHasReadSizeOfFrontMessage(false)
+        mWakeReadFD(-1),
+        mWakeWriteFD(-1),
+        mMessagesWritten(0),
+        mSslWrites(0),
+        mRecordsWritten(0),
+        mBytesWritten(0),
+        mCompressionThreshold(0),
+        mShouldSendCompressionHello(false),
+        mPeerAcceptsCompression(false),
+        mMessagesCompressed(0),
+        mBytesBeforeCompression(0),
+        mBytesAfterCompression(0),
+        mMessagesDecompressed(0),
+        mBytesBeforeDecompression(0),
+        mBytesAfterDecompression(0),
+        mHighWaterMark(0),
+        mWritersWaiting(0),
+        mMessagesQueued(0),
+        mBytesQueued(0),
+        mOldestUnsentEnqueuedAt(0),
+        mNanosInSelect(0),
+        mNanosInSslRead(0),
+        mNanosInSslWrite(0),
+        mNanosBlockedOnHighWaterMark(0),
+        mTimesBlockedOnHighWaterMark(0)
     {
+        for (auto& bucket: mWireLatencyHistogram) {
+            bucket = 0;
+        }
+
         mSSLSocketFD = SSL_get_fd(mSSL);
 
         if (fcntl(mSSLSocketFD, F_SETFL, fcntl(mSSLSocketFD, F_GETFL, 0) | O_NONBLOCK) == -1) {
             throw std::runtime_error("Failed to mark our socket nonblocking.");
         }
-
-        if (pipe(mWakePipe) == -1) {
-            throw std::runtime_error("Failed to allocate the wake pipe.");
-        }
     }
 
     ~DatabaseConnectionPumpLoop() {
+        // we keep the ready fd until now, rather than closing it with the socket,
+        // so an event loop that hasn't yet unregistered it never sees the number reused
+        if (mReadyReadFD != -1) {
+            ::close(mReadyReadFD);
+        }
+        if (mReadyWriteFD != -1 && mReadyWriteFD != mReadyReadFD) {
+            ::close(mReadyWriteFD);
+        }
+
         PyEnsureGilAcquired getTheGil;
         decref((PyObject*)mSocket);
     }
@@ -109,51 +185,38 @@ public:
         return ts.tv_sec + ts.tv_nsec / 1000000000.0;
     }
 
+    // a clock for measuring intervals, which never goes backwards
+    static int64_t curNanos() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
     void setHeartbeatMessage(std::string msg, float frequency) {
-        std::unique_lock<std::mutex> lock(mMutex);
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
 
-        mHeartbeatMessage = msg;
-        mNextHeartbeat = curClock() + frequency;
-        mHeartbeatInterval = frequency;
-        mMessagesToSend.push_back(msg);
+            mHeartbeatMessage = msg;
+            mNextHeartbeat = curClock() + frequency;
+            mHeartbeatInterval = frequency;
+        }
+
+        enqueue(std::move(msg));
 
-        //wake up the reader
-        ::write(mWakePipe[1], (void*)" ", 1);
+        wakeSocketThread();
     }
 
     // really, this is the 'select loop'
     void writeLoop() {
         PyEnsureGilReleased releaseTheGil;
 
-        size_t selectsWithNoUpdate = 0;
+        openWakeFD();
 
         try {
             while (true) {
-                // lock the lock and pull any messages off we need to send;
-                {
-                    std::unique_lock<std::mutex> lock(mMutex);
-
-                    if (mIsClosed) {
-                        ensureSslSocketClosed();
-                        return;
-                    }
-
-                    if (curClock() > mNextHeartbeat && mHeartbeatMessage.size() && mHeartbeatInterval > 0.0) {
-                        mMessagesToSend.push_back(mHeartbeatMessage);
-                        mNextHeartbeat = curClock() + mHeartbeatInterval;
-                    }
-
-                    while (mMessagesToSend.size()) {
-                        std::string msg = mMessagesToSend.front();
-                        mMessagesToSend.pop_front();
-
-                        uint32_t bytesToSend = msg.size();
-
-                        mMessagesInWriteBuffer.push_back(
-                            std::string((char*)&bytesToSend, (char*)&bytesToSend + sizeof(uint32_t))
-                        );
-                        mMessagesInWriteBuffer.push_back(msg);
-                    }
+                if (!stageOutgoingMessages()) {
+                    ensureSslSocketClosed();
+                    return;
                 }
 
                 if (SSL_get_shutdown(mSSL)) {
@@ -171,25 +234,23 @@ public:
                 FD_ZERO(&writeFds);
 
                 FD_SET(mSSLSocketFD, &readFds);
-                FD_SET(mWakePipe[0], &readFds);
+                FD_SET(mWakeReadFD, &readFds);
 
-                bool wantedToWrite = false;
-                if ((mMessagesInWriteBuffer.size() && !(SSL_want_read(mSSL) && selectsWithNoUpdate > 2)) || SSL_want_write(mSSL)) {
+                bool wantedToWrite = wantsToWrite();
+                if (wantedToWrite) {
                     FD_SET(mSSLSocketFD, &writeFds);
-                    wantedToWrite = true;
                 }
 
                 timeval toSleep;
                 toSleep.tv_sec = 0;
                 toSleep.tv_usec = 0;
 
-                bool wantsToWakeUp = false;
                 double t0 = curClock();
-                double sleepSeconds = mNextHeartbeat - t0;
+                int64_t selectStart = curNanos();
+                double sleepSeconds = secondsUntilHeartbeat();
 
-                if (mHeartbeatMessage.size() && mHeartbeatInterval > 0.0) {
-                    wantsToWakeUp = true;
-                    if (sleepSeconds < 0) {
+                if (sleepSeconds >= 0) {
+                    if (sleepSeconds == 0) {
                         sleepSeconds = 0.00001;
                     }
 
@@ -198,17 +259,19 @@ public:
                 }
 
                 int selectRes = select(
-                    std::max(mWakePipe[0], mSSLSocketFD) + 1,
+                    std::max(mWakeReadFD, mSSLSocketFD) + 1,
                     &readFds,
                     &writeFds,
                     NULL,
-                    wantsToWakeUp ? &toSleep : NULL
+                    sleepSeconds >= 0 ? &toSleep : NULL
                 );
 
+                mNanosInSelect += curNanos() - selectStart;
+
                 // if we blocked for a while, reset our counter, we're not in a
                 // spin loop.
                 if (curClock() - t0 > 0.01) {
-                    selectsWithNoUpdate = 0;
+                    mPumpsWithNoUpdate = 0;
                 }
 
                 if (curClock() - t0 > 1.0 && wantedToWrite) {
@@ -219,44 +282,13 @@ public:
                     throw std::runtime_error("Warning: SELECT failed.");
                 }
 
-                bool sslSocketWriteable = FD_ISSET(mSSLSocketFD, &writeFds);
-                bool sslSocketReadable = FD_ISSET(mSSLSocketFD, &readFds);
-                bool wakePipeReadable = FD_ISSET(mWakePipe[0], &readFds);
-
-                if (wakePipeReadable) {
-                    // just read whatever data off here we can. we
-                    // don't care about it because we just use the pipe
-                    // to wake ourselves up.
-                    char buffer[1024];
-                    ::read(mWakePipe[0], buffer, 1024);
+                if (FD_ISSET(mWakeReadFD, &readFds)) {
+                    drainWakeFD();
                 }
 
                 // always try to read/write on the socket. ssl will push back if
                 // its a problem
-                bool wroteAny = readAnyPendingDataOnSocket();
-
-                if (writeAnyPendingDataToSocket()) {
-                    wroteAny = true;
-                }
-
-                if (wroteAny) {
-                    selectsWithNoUpdate = 0;
-                } else {
-                    selectsWithNoUpdate++;
-                }
-
-                if (selectsWithNoUpdate && selectsWithNoUpdate % 1000 == 0) {
-                    std::cerr << "DatabaseConnectionPumpLoop had "
-                        << selectsWithNoUpdate << " updates with no progress. "
-                        << mMessagesInWriteBuffer.size() << " messages.  "
-                        << "SSL_want_write(mSSL) = " << (SSL_want_write(mSSL) ? "true":"false") << ", "
-                        << "SSL_want_read(mSSL) = " << (SSL_want_read(mSSL) ? "true":"false") << ", "
-                        << "sslSocketWriteable: " << (sslSocketWriteable? "true":"false") << ". "
-                        << "sslSocketReadable: " << (sslSocketReadable? "true":"false") << ". "
-                        << "wakePipeReadable: " << (wakePipeReadable? "true":"false") << ". "
-                        << "\n"
-                    ;
-                }
+                pump();
             }
         } catch(...) {
             ensureSslSocketClosed();
@@ -264,15 +296,220 @@ public:
         }
     }
 
+    /*****
+    Do whatever we can without blocking: queue any heartbeat that's due, read
+    whatever's on the socket, and write whatever the socket will take. This is
+    the body of 'writeLoop', and what a PumpLoopEngine calls when our socket is
+    ready. Returns true if we made progress.
+    *****/
+    bool pump() {
+        if (!stageOutgoingMessages()) {
+            return false;
+        }
+
+        if (SSL_get_shutdown(mSSL)) {
+            close("Socket shut down");
+            return false;
+        }
+
+        bool madeProgress = readAnyPendingDataOnSocket();
+
+        if (writeAnyPendingDataToSocket()) {
+            madeProgress = true;
+        }
+
+        if (madeProgress) {
+            mPumpsWithNoUpdate = 0;
+        } else {
+            mPumpsWithNoUpdate++;
+        }
+
+        if (mPumpsWithNoUpdate && mPumpsWithNoUpdate % 1000 == 0) {
+            std::cerr << "DatabaseConnectionPumpLoop had "
+                << mPumpsWithNoUpdate << " updates with no progress. "
+                << mWriteBuffer.bytesPending() << " bytes pending.  "
+                << "SSL_want_write(mSSL) = " << (SSL_want_write(mSSL) ? "true":"false") << ", "
+                << "SSL_want_read(mSSL) = " << (SSL_want_read(mSSL) ? "true":"false") << ". "
+                << "\n"
+            ;
+        }
+
+        return madeProgress;
+    }
+
+    // should we wait for the socket to become writeable? Once we've had a few pumps
+    // with no progress where SSL is waiting on a read, we stop asking, since the
+    // socket will happily report writeable forever and we'd spin.
+    bool wantsToWrite() {
+        return (!mWriteBuffer.empty() && !(SSL_want_read(mSSL) && mPumpsWithNoUpdate > 2)) || SSL_want_write(mSSL);
+    }
+
+    // if SSL has already decrypted data we haven't read, the socket won't tell us about it.
+    bool hasBufferedReadData() {
+        return SSL_pending(mSSL) > 0;
+    }
+
+    // how long until we need to send a heartbeat (0 if it's overdue), or -1 if we don't send them.
+    double secondsUntilHeartbeat() {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        if (!mHeartbeatMessage.size() || mHeartbeatInterval <= 0.0) {
+            return -1;
+        }
+
+        return std::max(0.0, mNextHeartbeat - curClock());
+    }
+
+    // from now on a PumpLoopEngine pumps us, and 'onWake' tells it when we have
+    // new messages to send. We can't also run 'writeLoop'.
+    void attachToEngine(std::function<void ()> onWake) {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        if (mWakeCallback || mWakeReadFD != -1) {
+            throw std::runtime_error("This DatabaseConnectionPumpLoop is already being pumped.");
+        }
+
+        mWakeCallback = onWake;
+    }
+
+    int socketFD() const {
+        return mSSLSocketFD;
+    }
+
+    // how well we're batching writes. We count an 'SSL_write' that makes progress
+    // as one write, and assume it went out in as few full-sized records as possible.
+    class WriteStats {
+    public:
+        int64_t messages;
+        int64_t sslWrites;
+        int64_t records;
+        int64_t bytes;
+    };
+
+    WriteStats writeStats() const {
+        WriteStats res;
+        res.messages = mMessagesWritten;
+        res.sslWrites = mSslWrites;
+        res.records = mRecordsWritten;
+        res.bytes = mBytesWritten;
+        return res;
+    }
+
+    /*****
+    Compress outgoing messages of at least 'threshold' bytes, once the other
+    side says it can read them. We tell it we can read them too. Compression
+    happens on the socket thread, so it never holds up python.
+    *****/
+    void enableCompression(size_t threshold) {
+        if (!threshold) {
+            throw std::runtime_error("Compression threshold must be positive.");
+        }
+
+        mCompressionThreshold = threshold;
+        mShouldSendCompressionHello = true;
+
+        wakeSocketThread();
+    }
+
+    // how much compression is saving us, in each direction
+    class CompressionStats {
+    public:
+        int64_t messagesCompressed;
+        int64_t bytesBeforeCompression;
+        int64_t bytesAfterCompression;
+        int64_t messagesDecompressed;
+        int64_t bytesBeforeDecompression;
+        int64_t bytesAfterDecompression;
+    };
+
+    CompressionStats compressionStats() const {
+        CompressionStats res;
+        res.messagesCompressed = mMessagesCompressed;
+        res.bytesBeforeCompression = mBytesBeforeCompression;
+        res.bytesAfterCompression = mBytesAfterCompression;
+        res.messagesDecompressed = mMessagesDecompressed;
+        res.bytesBeforeDecompression = mBytesBeforeDecompression;
+        res.bytesAfterDecompression = mBytesAfterDecompression;
+        return res;
+    }
+
+    /*****
+    What the socket thread is doing, and how far behind it is. Messages count
+    as queued from when 'write' accepts them until their last byte is written.
+    *****/
+    enum { latency_buckets = 32 };
+
+    class PumpStats {
+    public:
+        int64_t messagesQueued;
+        int64_t bytesQueued;
+
+        // how long the oldest message the socket thread has picked up has been waiting
+        // to go out, or 0 if it has nothing unsent.
+        double oldestUnsentMessageAge;
+
+        // 'select' only counts time in 'writeLoop'. A PumpLoopEngine waits for all
+        // of its sockets at once.
+        double secondsInSelect;
+        double secondsInSslRead;
+        double secondsInSslWrite;
+
+        int64_t timesBlockedOnHighWaterMark;
+        double secondsBlockedOnHighWaterMark;
+
+        // bucket 0 counts messages that took under a microsecond to go from 'write'
+        // to the wire, and bucket k counts those that took [2^(k-1), 2^k) microseconds.
+        int64_t wireLatencyHistogram[latency_buckets];
+    };
+
+    PumpStats pumpStats() const {
+        PumpStats res;
+        res.messagesQueued = mMessagesQueued;
+        res.bytesQueued = mBytesQueued;
+
+        int64_t oldest = mOldestUnsentEnqueuedAt;
+        res.oldestUnsentMessageAge = oldest ? (curNanos() - oldest) / 1000000000.0 : 0.0;
+
+        res.secondsInSelect = mNanosInSelect / 1000000000.0;
+        res.secondsInSslRead = mNanosInSslRead / 1000000000.0;
+        res.secondsInSslWrite = mNanosInSslWrite / 1000000000.0;
+        res.timesBlockedOnHighWaterMark = mTimesBlockedOnHighWaterMark;
+        res.secondsBlockedOnHighWaterMark = mNanosBlockedOnHighWaterMark / 1000000000.0;
+
+        for (size_t k = 0; k < latency_buckets; k++) {
+            res.wireLatencyHistogram[k] = mWireLatencyHistogram[k];
+        }
+
+        return res;
+    }
+
+    // make 'write' block while at least 'bytes' of messages are queued. 0 means never block.
+    void setHighWaterMark(size_t bytes) {
+        mHighWaterMark = bytes;
+
+        // let anyone waiting on the old mark re-check
+        std::unique_lock<std::mutex> lock(mMutex);
+        mQueueHasDrained.notify_all();
+    }
+
     bool readAnyPendingDataOnSocket() {
-        const int BUFSIZE = 1024 * 128;
-        char buffer[BUFSIZE];
+        // read straight into the buffer our messages will live in
+        std::pair<char*, size_t> region = mReadBuffer.writableRegion();
 
-        // read some data
-        int res = SSL_read(mSSL, buffer, BUFSIZE);
+        int64_t readStart = curNanos();
+        int res = SSL_read(mSSL, region.first, std::min<size_t>(region.second, INT_MAX));
+        mNanosInSslRead += curNanos() - readStart;
 
         if (res > 0) {
-            consumeReadBytes(buffer, res);
+            mReadBuffer.commit(res, mFramesJustRead);
+
+            decompressFrames(mFramesJustRead);
+
+            if (mFramesJustRead.size()) {
+                messagesReceived(mFramesJustRead);
+                mFramesJustRead.clear();
+            }
+
             return true;
         }
 
@@ -319,122 +556,68 @@ public:
         return false;
     }
 
-    void consumeReadBytes(char* bytes, size_t bytecount) {
-        while (bytecount ||
-            (mHasReadSizeOfFrontMessage && mPartiallyReadFrontMessageSize == mPartiallyReadFrontMessage.size())
-        ) {
-            if (mHasReadSizeOfFrontMessage) {
-                if (mPartiallyReadFrontMessageSize == mPartiallyReadFrontMessage.size()) {
-                    // consume the message
-                    messageReceived(
-                        std::string(
-                            mPartiallyReadFrontMessage.begin(),
-                            mPartiallyReadFrontMessage.end()
-                        )
-                    );
-
-                    mPartiallyReadFrontMessage.resize(0);
-                    mHasReadSizeOfFrontMessage = false;
-                } else {
-                    // copy into the main buffer
-                    size_t toConsume = std::min(
-                        mPartiallyReadFrontMessageSize - mPartiallyReadFrontMessage.size(),
-                        bytecount
-                    );
-
-                    copyFromBuffer(bytes, bytecount, toConsume);
-                }
-            } else {
-                if (mPartiallyReadFrontMessage.size() == sizeof(uint32_t)) {
-                    // we have the 4 bytes. copy the size out and clear the buffer
-                    mHasReadSizeOfFrontMessage = true;
-                    mPartiallyReadFrontMessageSize = *(uint32_t*)&mPartiallyReadFrontMessage[0];
-                    mPartiallyReadFrontMessage.resize(0);
-                } else {
-                    // we don't have the 4 bytes yet. grab them.
-                    uint32_t toConsume = std::min(
-                        sizeof(uint32_t) - mPartiallyReadFrontMessage.size(),
-                        bytecount
-                    );
-
-                    copyFromBuffer(bytes, bytecount, toConsume);
-                }
-            }
-        }
-    }
-
-    void copyFromBuffer(char* &bytes, size_t& bytecount, size_t toConsume) {
-        size_t oldSize = mPartiallyReadFrontMessage.size();
+    bool writeAnyPendingDataToSocket() {
+        bool wroteSome = false;
 
-        // make size on the buffer
-        mPartiallyReadFrontMessage.resize(mPartiallyReadFrontMessage.size() + toConsume);
+        while (!mWriteBuffer.empty()) {
+            // if a previous write asked us to retry, this is the same buffer it failed on.
+            int64_t writeStart = curNanos();
+            int bytesWritten = SSL_write(
+                mSSL,
+                mWriteBuffer.frontData(),
+                mWriteBuffer.frontSize()
+            );
+            mNanosInSslWrite += curNanos() - writeStart;
 
-        // copy from our stack buffer into this one
-        memcpy(&mPartiallyReadFrontMessage[oldSize], bytes, toConsume);
+            if (bytesWritten > 0) {
+                mWriteBuffer.consumed(bytesWritten);
 
-        // update the stack buffer.
-        bytes += toConsume;
-        bytecount -= toConsume;
-    }
+                mSslWrites++;
+                mBytesWritten += bytesWritten;
+                mRecordsWritten += (bytesWritten + CoalescingWriteBuffer::target_chunk_size - 1)
+                    / CoalescingWriteBuffer::target_chunk_size;
 
-    bool writeAnyPendingDataToSocket() {
-        bool wroteSome = false;
+                messagesReachedTheWire();
 
-        while (mMessagesInWriteBuffer.size()) {
-            if (mMessagesInWriteBufferFrontPartSent >= mMessagesInWriteBuffer.front().size()) {
-                mMessagesInWriteBufferFrontPartSent = 0;
-                mMessagesInWriteBuffer.pop_front();
+                wroteSome = true;
             } else {
-                // we still have some data
-                int bytesWritten = SSL_write(
-                    mSSL,
-                    &mMessagesInWriteBuffer.front()[mMessagesInWriteBufferFrontPartSent],
-                    mMessagesInWriteBuffer.front().size() - mMessagesInWriteBufferFrontPartSent
-                );
+                if (bytesWritten == 0) {
+                    close("graceful shutdown during write");
+                    return false;
+                }
 
-                if (bytesWritten > 0) {
-                    mMessagesInWriteBufferFrontPartSent += bytesWritten;
+                //something bad happened
+                int err = SSL_get_error(mSSL, bytesWritten);
 
-                    wroteSome = true;
+                if (err == SSL_ERROR_ZERO_RETURN) {
+                    close("graceful shutdown during write");
+                    return false;
+                }
+                else if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) {
+                    return wroteSome;
+                }
+                else if (err == SSL_ERROR_WANT_CONNECT) {
+                    close("write error: ssl want connect");
+                    throw std::runtime_error("Unexpected SSL_ERROR_WANT_CONNECT in 'writeBytes'");
+                }
+                else if (err == SSL_ERROR_WANT_ACCEPT) {
+                    close("write error: ssl want accept");
+                    throw std::runtime_error("Unexpected SSL_ERROR_WANT_ACCEPT in 'writeBytes'");
+                }
+                else if (err == SSL_ERROR_WANT_X509_LOOKUP) {
+                    close("write error: ssl want x509 lookup");
+                    throw std::runtime_error("Unexpected SSL_ERROR_WANT_X509_LOOKUP in 'writeBytes'");
+                }
+                else if (err == SSL_ERROR_SYSCALL) {
+                    close("write error: ssl bad syscall");
+                    throw std::runtime_error("Unexpected SSL_ERROR_SYSCALL in 'writeBytes'");
+                }
+                else if (err == SSL_ERROR_SSL) {
+                    close("write error: ssl error ssl");
+                    throw std::runtime_error("Unexpected SSL_ERROR_SSL in 'writeBytes'");
                 } else {
-                    if (bytesWritten == 0) {
-                        close("graceful shutdown during write");
-                        return false;
-                    }
-
-                    //something bad happened
-                    int err = SSL_get_error(mSSL, bytesWritten);
-
-                    if (err == SSL_ERROR_ZERO_RETURN) {
-                        close("graceful shutdown during write");
-                        return false;
-                    }
-                    else if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) {
-                        return wroteSome;
-                    }
-                    else if (err == SSL_ERROR_WANT_CONNECT) {
-                        close("write error: ssl want connect");
-                        throw std::runtime_error("Unexpected SSL_ERROR_WANT_CONNECT in 'writeBytes'");
-                    }
-                    else if (err == SSL_ERROR_WANT_ACCEPT) {
-                        close("write error: ssl want accept");
-                        throw std::runtime_error("Unexpected SSL_ERROR_WANT_ACCEPT in 'writeBytes'");
-                    }
-                    else if (err == SSL_ERROR_WANT_X509_LOOKUP) {
-                        close("write error: ssl want x509 lookup");
-                        throw std::runtime_error("Unexpected SSL_ERROR_WANT_X509_LOOKUP in 'writeBytes'");
-                    }
-                    else if (err == SSL_ERROR_SYSCALL) {
-                        close("write error: ssl bad syscall");
-                        throw std::runtime_error("Unexpected SSL_ERROR_SYSCALL in 'writeBytes'");
-                    }
-                    else if (err == SSL_ERROR_SSL) {
-                        close("write error: ssl error ssl");
-                        throw std::runtime_error("Unexpected SSL_ERROR_SSL in 'writeBytes'");
-                    } else {
-                        close("unknown write error");
-                        throw std::runtime_error("Unexpected unknown error in 'writeBytes'");
-                    }
+                    close("unknown write error");
+                    throw std::runtime_error("Unexpected unknown error in 'writeBytes'");
                 }
             }
         }
@@ -447,54 +630,172 @@ public:
             SSL_shutdown(mSSL);
         }
 
-        ::close(mWakePipe[0]);
-        ::close(mWakePipe[1]);
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        if (mWakeReadFD != -1) {
+            ::close(mWakeReadFD);
+        }
+        if (mWakeWriteFD != -1 && mWakeWriteFD != mWakeReadFD) {
+            ::close(mWakeWriteFD);
+        }
+
+        mWakeReadFD = -1;
+        mWakeWriteFD = -1;
     }
 
-    void messageReceived(const std::string& msg) {
-        std::unique_lock<std::mutex> lock(mMutex);
+    // hand 'frames' to the read loop. Only the socket thread calls this.
+    void messagesReceived(std::vector<FrameReadBuffer::Frame>& frames) {
+        for (auto& frame: frames) {
+            mMessagesReceived.push(std::move(frame));
+        }
 
-        mMessagesReceived.push_back(msg);
+        // pairs with the fence in 'takeReceivedMessages'. Either we see that it's
+        // waiting, or it sees what we just pushed.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
 
-        mHasReceivedMessages.notify_all();
+        if (mReadLoopIsWaiting.load(std::memory_order_relaxed)) {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mHasReceivedMessages.notify_all();
+        }
+
+        // pairs with the fence in 'drainReadyMessages'. We only signal the ready fd
+        // once per drain, however many batches arrive in between.
+        if (mReadyFDArmed.load(std::memory_order_relaxed) && mReadyFDArmed.exchange(false)) {
+            signalReadyFD();
+        }
     }
 
     // really, this is the 'event loop'
     void readLoop(PyObject* callback) {
-        PyEnsureGilReleased releaseTheGil;
+        if (mHasConsumer.exchange(true)) {
+            throw std::runtime_error("This DatabaseConnectionPumpLoop already has a reader.");
+        }
 
-        while (true) {
-            std::vector<std::string> toFire;
+        PyEnsureGilReleased releaseTheGil;
 
-            {
-                std::unique_lock<std::mutex> lock(mMutex);
+        std::vector<FrameReadBuffer::Frame> toFire;
 
-                if (mIsClosed) {
-                    return;
-                }
+        while (takeReceivedMessages(toFire)) {
+            callOnMessage(toFire, callback);
+            toFire.clear();
+        }
+    }
 
-                if (mMessagesReceived.size() == 0) {
-                    mHasReceivedMessages.wait(lock);
-                }
+    // wait until we've received some messages and move them into 'out'.
+    // Returns false once we're closed. Only the read loop calls this.
+    bool takeReceivedMessages(std::vector<FrameReadBuffer::Frame>& out) {
+        while (true) {
+            if (mIsClosed) {
+                return false;
+            }
 
-                std::swap(toFire, mMessagesReceived);
+            FrameReadBuffer::Frame frame;
+            while (mMessagesReceived.pop(frame)) {
+                out.push_back(std::move(frame));
             }
 
-            if (toFire.size()) {
-                callOnMessage(toFire, callback);
+            if (out.size()) {
+                return true;
             }
+
+            std::unique_lock<std::mutex> lock(mMutex);
+
+            mReadLoopIsWaiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            mHasReceivedMessages.wait(lock, [&]() { return mIsClosed || !mMessagesReceived.empty(); });
+
+            mReadLoopIsWaiting.store(false, std::memory_order_relaxed);
         }
     }
 
-    void callOnMessage(const std::vector<std::string>& messages, PyObject* callback) {
+    /*****
+    instead of running 'readLoop' on a thread of its own, let the caller's event loop
+    wait on a file descriptor that becomes readable whenever messages are ready, and
+    call 'drainReadyMessages' from that loop. Returns the fd, which stays open until
+    we're destroyed. Requires the GIL.
+    *****/
+    int openReadyFD() {
+        if (mHasConsumer.exchange(true)) {
+            throw std::runtime_error("This DatabaseConnectionPumpLoop already has a reader.");
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+
+#ifdef __linux__
+        mReadyReadFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (mReadyReadFD == -1) {
+            throw std::runtime_error("Failed to allocate the ready eventfd.");
+        }
+        mReadyWriteFD = mReadyReadFD;
+#else
+        int readyPipe[2];
+        if (pipe(readyPipe) == -1) {
+            throw std::runtime_error("Failed to allocate the ready pipe.");
+        }
+        fcntl(readyPipe[0], F_SETFL, fcntl(readyPipe[0], F_GETFL, 0) | O_NONBLOCK);
+        fcntl(readyPipe[1], F_SETFL, fcntl(readyPipe[1], F_GETFL, 0) | O_NONBLOCK);
+
+        mReadyReadFD = readyPipe[0];
+        mReadyWriteFD = readyPipe[1];
+#endif
+
+        mReadyFDArmed = true;
+
+        // anything that's already arrived has to show up as readable too. A close
+        // can't sneak in, since it signals under mMutex once it sees the fd.
+        if ((mIsClosed || !mMessagesReceived.empty()) && mReadyFDArmed.exchange(false)) {
+            signalReadyFD();
+        }
+
+        return mReadyReadFD;
+    }
+
+    // move whatever messages are ready into 'out' without waiting, and clear the
+    // ready fd. Returns false once we're closed. Only the ready fd's owner calls this.
+    bool drainReadyMessages(std::vector<FrameReadBuffer::Frame>& out) {
+        if (mReadyReadFD == -1) {
+            throw std::runtime_error("Call openReadyFD before draining a DatabaseConnectionPumpLoop.");
+        }
+
+        char buffer[1024];
+        if (::read(mReadyReadFD, buffer, mReadyReadFD == mReadyWriteFD ? sizeof(uint64_t) : sizeof(buffer)) < 0
+                && errno != EAGAIN) {
+            std::cerr << "Warning: failed to read from the ready fd" << std::endl;
+        }
+
+        FrameReadBuffer::Frame frame;
+        while (mMessagesReceived.pop(frame)) {
+            out.push_back(std::move(frame));
+        }
+
+        // re-arm, then look again: either the socket thread sees us armed, or we see
+        // what it pushed after our last pop and leave the fd signalled for next time.
+        mReadyFDArmed.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (!mMessagesReceived.empty() && mReadyFDArmed.exchange(false)) {
+            signalReadyFD();
+        }
+
+        if (mIsClosed) {
+            // keep the fd readable, so the caller comes back and sees that we're closed
+            signalReadyFD();
+            return out.size() > 0;
+        }
+
+        return true;
+    }
+
+    void callOnMessage(const std::vector<FrameReadBuffer::Frame>& messages, PyObject* callback) {
         PyEnsureGilAcquired getTheGil;
 
         for (const auto& msg: messages) {
-            if (!msg.size()) {
-                throw std::runtime_error("Improperly formed message in DatabaseConnectionPumpLoop");
-            }
+            PyObject* bytes = messageToPython(msg);
 
-            PyObject* bytes = PyBytes_FromStringAndSize(&msg[0], msg.size());
+            if (!bytes) {
+                continue;
+            }
 
             PyObject* res = PyObject_CallFunctionObjArgs(
                 callback,
@@ -512,19 +813,59 @@ public:
         }
     }
 
+    // a new reference to what python should see for 'msg', or nullptr if our native
+    // message handler dealt with it. Requires the GIL.
+    PyObject* messageToPython(const FrameReadBuffer::Frame& msg) {
+        if (!msg.size) {
+            throw std::runtime_error("Improperly formed message in DatabaseConnectionPumpLoop");
+        }
+
+        // copy it, since python may replace it while we're using it
+        std::shared_ptr<NativeMessageHandler> handler = mNativeMessageHandler;
+
+        if (handler) {
+            return handler->handle(msg.data, msg.size);
+        }
+
+        PyObject* bytes = PyBytes_FromStringAndSize(msg.data, msg.size);
+
+        if (!bytes) {
+            throw PythonExceptionSet();
+        }
+
+        return bytes;
+    }
+
+    // give 'handler' the first look at every message the read loop receives
+    // from here on. Pass nullptr to send everything to python again. Requires the GIL.
+    void setNativeMessageHandler(std::shared_ptr<NativeMessageHandler> handler) {
+        mNativeMessageHandler = handler;
+    }
+
+    // queue a message. If we're over the high water mark, this waits (without
+    // the GIL) until the socket thread catches up. Returns false if we're closed.
     bool write(const char* data, size_t bytes) {
-        std::unique_lock<std::mutex> lock(mMutex);
+        return write(std::string(data, data + bytes));
+    }
 
+    // the same, for a message we already have as a string
+    bool write(std::string&& message) {
         if (mIsClosed) {
             return false;
         }
 
-        mMessagesToSend.push_back(std::string(data, data + bytes));
+        if (mHighWaterMark && mBytesQueued >= (int64_t)mHighWaterMark) {
+            waitForQueueToDrain();
 
-        if (::write(mWakePipe[1], (void*)" ", 1) != 1) {
-            std::cerr << "Warning: failed to write to the wake-pipe" << std::endl;
+            if (mIsClosed) {
+                return false;
+            }
         }
 
+        enqueue(std::move(message));
+
+        wakeSocketThread();
+
         return true;
     }
 
@@ -536,57 +877,357 @@ public:
         if (!mIsClosed) {
             mIsClosed = true;
 
-            // place a byte on the wake pipe. it should
+            // wake the socket thread. it should
             // wake up and check the mIsClosed flag
-            ::write(mWakePipe[1], (void*)" ", 1);
+            wakeLocked();
 
-            // also wake the read thread.
+            // also wake the read thread, and anyone waiting to write.
             mHasReceivedMessages.notify_all();
+            mQueueHasDrained.notify_all();
+
+            if (mReadyWriteFD != -1) {
+                signalReadyFD();
+            }
         }
     }
 
     bool isClosed() {
-        std::unique_lock<std::mutex> lock(mMutex);
-
         return mIsClosed;
     }
 
 private:
+    // a message 'write' made, and when (in 'curNanos')
+    class OutgoingMessage {
+    public:
+        OutgoingMessage() : enqueuedAt(0)
+        {
+        }
+
+        OutgoingMessage(std::string&& inData, int64_t inEnqueuedAt) :
+            data(std::move(inData)),
+            enqueuedAt(inEnqueuedAt)
+        {
+        }
+
+        std::string data;
+        int64_t enqueuedAt;
+    };
+
+    // a message in mWriteBuffer, which is completely written once 'mBytesWritten'
+    // reaches 'endOffset'.
+    class UnsentMessage {
+    public:
+        int64_t endOffset;
+        int64_t enqueuedAt;
+        size_t size;
+    };
+
+    // only the python thread calls this
+    void enqueue(std::string&& msg) {
+        mMessagesQueued++;
+        mBytesQueued += msg.size();
+
+        mMessagesToSend.push(OutgoingMessage(std::move(msg), curNanos()));
+    }
+
+    // block until we're below the high water mark or closed. Requires the GIL, which we release.
+    void waitForQueueToDrain() {
+        PyEnsureGilReleased releaseTheGil;
+
+        int64_t t0 = curNanos();
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+
+            // pairs with the fence in 'messagesReachedTheWire'. Either we see
+            // the queue drain, or it sees that we're waiting.
+            mWritersWaiting++;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            mQueueHasDrained.wait(lock, [&]() {
+                return mIsClosed || !mHighWaterMark || mBytesQueued < (int64_t)mHighWaterMark;
+            });
+
+            mWritersWaiting--;
+        }
+
+        mTimesBlockedOnHighWaterMark++;
+        mNanosBlockedOnHighWaterMark += curNanos() - t0;
+    }
+
+    // we wrote some bytes. Retire every message they finished, and
+    // wake anyone waiting for the queue to drain.
+    void messagesReachedTheWire() {
+        if (mUnsentMessages.empty() || mUnsentMessages.front().endOffset > mBytesWritten) {
+            return;
+        }
+
+        int64_t now = curNanos();
+
+        while (mUnsentMessages.size() && mUnsentMessages.front().endOffset <= mBytesWritten) {
+            const UnsentMessage& msg = mUnsentMessages.front();
+
+            mWireLatencyHistogram[latencyBucket(now - msg.enqueuedAt)]++;
+            mMessagesQueued--;
+            mBytesQueued -= msg.size;
+
+            mUnsentMessages.pop_front();
+        }
+
+        mOldestUnsentEnqueuedAt = mUnsentMessages.size() ? mUnsentMessages.front().enqueuedAt : 0;
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (mWritersWaiting.load(std::memory_order_relaxed)) {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mQueueHasDrained.notify_all();
+        }
+    }
+
+    static size_t latencyBucket(int64_t nanos) {
+        int64_t micros = nanos / 1000;
+        size_t bucket = 0;
+
+        while (micros && bucket + 1 < latency_buckets) {
+            micros >>= 1;
+            bucket++;
+        }
+
+        return bucket;
+    }
+
+    // move any messages we've been asked to send (and a heartbeat, if one is due)
+    // into the write buffer. Returns false if we're closed.
+    bool stageOutgoingMessages() {
+        if (mIsClosed) {
+            return false;
+        }
+
+        // anything pushed after this point wakes us again. Pairs with the
+        // fence in 'wakeSocketThread'.
+        mSocketThreadWakePending.store(false, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+
+            if (curClock() > mNextHeartbeat && mHeartbeatMessage.size() && mHeartbeatInterval > 0.0) {
+                mWriteBuffer.appendMessage(std::string(mHeartbeatMessage));
+                mMessagesWritten++;
+                mNextHeartbeat = curClock() + mHeartbeatInterval;
+            }
+        }
+
+        if (mShouldSendCompressionHello && mShouldSendCompressionHello.exchange(false)) {
+            mWriteBuffer.appendMessage(std::string(), true);
+        }
+
+        size_t compressionThreshold = mPeerAcceptsCompression ? (size_t)mCompressionThreshold : 0;
+
+        OutgoingMessage msg;
+        while (mMessagesToSend.pop(msg)) {
+            std::string compressed;
+            size_t size = msg.data.size();
+
+            if (compressionThreshold && size >= compressionThreshold
+                    && FrameCompression::compress(msg.data, compressed)) {
+                mMessagesCompressed++;
+                mBytesBeforeCompression += size;
+                mBytesAfterCompression += compressed.size();
+
+                mWriteBuffer.appendMessage(std::move(compressed), true);
+            } else {
+                mWriteBuffer.appendMessage(std::move(msg.data));
+            }
+
+            UnsentMessage unsent;
+            unsent.endOffset = mBytesWritten + mWriteBuffer.bytesPending();
+            unsent.enqueuedAt = msg.enqueuedAt;
+            unsent.size = size;
+
+            if (mUnsentMessages.empty()) {
+                mOldestUnsentEnqueuedAt = unsent.enqueuedAt;
+            }
+
+            mUnsentMessages.push_back(unsent);
+
+            mMessagesWritten++;
+        }
+
+        return true;
+    }
+
+    // replace compressed frames with their contents, and drop any 'hello's,
+    // noting that the other side can read compressed frames.
+    void decompressFrames(std::vector<FrameReadBuffer::Frame>& frames) {
+        size_t kept = 0;
+
+        for (size_t k = 0; k < frames.size(); k++) {
+            FrameReadBuffer::Frame& frame = frames[k];
+
+            if (frame.isCompressed) {
+                if (!frame.size) {
+                    mPeerAcceptsCompression = true;
+                    continue;
+                }
+
+                size_t size;
+                std::shared_ptr<char> block = FrameCompression::decompress(frame.data, frame.size, size);
+
+                mMessagesDecompressed++;
+                mBytesBeforeDecompression += frame.size;
+                mBytesAfterDecompression += size;
+
+                frame = FrameReadBuffer::Frame(block, block.get(), size);
+            }
+
+            if (kept != k) {
+                frames[kept] = std::move(frame);
+            }
+            kept++;
+        }
+
+        frames.resize(kept);
+    }
+
+    // make the fd 'writeLoop' sleeps on. On linux this is an eventfd,
+    // which is one fd instead of two and never fills up.
+    void openWakeFD() {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        if (mWakeCallback || mWakeReadFD != -1) {
+            throw std::runtime_error("This DatabaseConnectionPumpLoop is already being pumped.");
+        }
+
+#ifdef __linux__
+        mWakeReadFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (mWakeReadFD == -1) {
+            throw std::runtime_error("Failed to allocate the wake eventfd.");
+        }
+        mWakeWriteFD = mWakeReadFD;
+#else
+        int wakePipe[2];
+        if (pipe(wakePipe) == -1) {
+            throw std::runtime_error("Failed to allocate the wake pipe.");
+        }
+        fcntl(wakePipe[0], F_SETFL, fcntl(wakePipe[0], F_GETFL, 0) | O_NONBLOCK);
+        fcntl(wakePipe[1], F_SETFL, fcntl(wakePipe[1], F_GETFL, 0) | O_NONBLOCK);
+
+        mWakeReadFD = wakePipe[0];
+        mWakeWriteFD = wakePipe[1];
+#endif
+    }
+
+    void drainWakeFD() {
+        // just read whatever data off here we can. we
+        // don't care about it because we just use it
+        // to wake ourselves up.
+        char buffer[1024];
+        if (::read(mWakeReadFD, buffer, mWakeReadFD == mWakeWriteFD ? sizeof(uint64_t) : sizeof(buffer)) < 0
+                && errno != EAGAIN) {
+            std::cerr << "Warning: failed to read from the wake fd" << std::endl;
+        }
+    }
+
+    // we just pushed onto mMessagesToSend. Wake the socket thread, unless
+    // it's already been woken and hasn't yet picked up what's queued.
+    void wakeSocketThread() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (mSocketThreadWakePending.load(std::memory_order_relaxed)
+                || mSocketThreadWakePending.exchange(true)) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        wakeLocked();
+    }
+
+    // wake up whoever is pumping our socket. Requires mMutex.
+    void wakeLocked() {
+        if (mWakeCallback) {
+            mWakeCallback();
+            return;
+        }
+
+        // if nobody's listening yet, 'writeLoop' will pick up
+        // whatever we queued when it starts.
+        if (mWakeWriteFD == -1) {
+            return;
+        }
+
+        uint64_t one = 1;
+        size_t toWrite = mWakeReadFD == mWakeWriteFD ? sizeof(one) : 1;
+
+        if (::write(mWakeWriteFD, (void*)&one, toWrite) != (ssize_t)toWrite && errno != EAGAIN) {
+            std::cerr << "Warning: failed to write to the wake fd" << std::endl;
+        }
+    }
+
+    // make the ready fd readable. It's fine to do this more than once.
+    void signalReadyFD() {
+        uint64_t one = 1;
+        size_t toWrite = mReadyReadFD == mReadyWriteFD ? sizeof(one) : 1;
+
+        if (::write(mReadyWriteFD, (void*)&one, toWrite) != (ssize_t)toWrite && errno != EAGAIN) {
+            std::cerr << "Warning: failed to write to the ready fd" << std::endl;
+        }
+    }
+
     PySSLSocket* mSocket;
     SSL* mSSL;
 
-    bool mIsClosed;
+    std::atomic<bool> mIsClosed;
+
+    // how many pumps in a row have done nothing. If this gets large we're spinning.
+    size_t mPumpsWithNoUpdate;
 
     // all messages, in order, that we have received but
-    // not fired on the 'read' loop.
-    std::vector<std::string> mMessagesReceived;
+    // not fired on the 'read' loop. These point into mReadBuffer's blocks.
+    // The socket thread pushes and the read loop pops.
+    SpscQueue<FrameReadBuffer::Frame> mMessagesReceived;
 
-    // condition variable the 'read' loop waits on
+    // condition variable the 'read' loop waits on, with mMutex
     std::condition_variable mHasReceivedMessages;
 
-    // messages we want to send. There will be exactly 1 for
-    // each byte placed on the 'wake pipe'. These have not
-    // been picked up by the socket thread yet.
-    std::deque<std::string> mMessagesToSend;
-
-    // a little state machine that contains the actual packets
-    // we want to send. mMessagesInWriteBuffer contains alternating
-    // 4 byte messages (encoding size) and then the actual message.
-    // mMessagesInWriteBufferFrontPartSent is the number of bytes
-    // in mMessagesInWriteBuffer.front() that have been flushed to
-    // the socket.
-    size_t mMessagesInWriteBufferFrontPartSent;
-    std::deque<std::string> mMessagesInWriteBuffer;
-
-    // a little statemachine for the front message we're reading.
-    // if we are reading the 4 bytes containing the message size,
-    // then mHasReadSizeOfFrontMessage is false, otherwise true.
-    // if we have read the size then mPartiallyReadFrontMessageSize is
-    // the size we're expecting.
-    // mPartiallyReadFrontMessage contains the actual bytes we've read
-    bool mHasReadSizeOfFrontMessage;
-    size_t mPartiallyReadFrontMessageSize;
-    std::vector<char> mPartiallyReadFrontMessage;
+    // true while the read loop might be waiting on mHasReceivedMessages
+    std::atomic<bool> mReadLoopIsWaiting;
+
+    // set once 'readLoop' or 'openReadyFD' has claimed mMessagesReceived,
+    // since only one of them can pop from it
+    std::atomic<bool> mHasConsumer;
+
+    // true if the socket thread should signal the ready fd when it next pushes
+    // messages. Whoever clears it is the one who signals.
+    std::atomic<bool> mReadyFDArmed;
+
+    // what an event loop waits on in place of 'readLoop'. These are the same fd
+    // if it's an eventfd, and -1 until 'openReadyFD'.
+    int mReadyReadFD;
+    int mReadyWriteFD;
+
+    // messages we want to send, which have not been picked up by the
+    // socket thread yet. The python thread pushes and the socket thread pops.
+    SpscQueue<OutgoingMessage> mMessagesToSend;
+
+    // true if we've woken the socket thread and it hasn't yet looked at
+    // mMessagesToSend, in which case there's no need to wake it again.
+    std::atomic<bool> mSocketThreadWakePending;
+
+    // the framed messages we've picked up and not yet flushed to the socket.
+    // only the socket thread touches this.
+    CoalescingWriteBuffer mWriteBuffer;
+
+    // the messages in mWriteBuffer, oldest first. Only the socket thread touches this.
+    std::deque<UnsentMessage> mUnsentMessages;
+
+    // if set, sees each message before python does. Protected by the GIL.
+    std::shared_ptr<NativeMessageHandler> mNativeMessageHandler;
+
+    // what we read off the socket, split into messages.
+    // only the socket thread touches these.
+    FrameReadBuffer mReadBuffer;
+    std::vector<FrameReadBuffer::Frame> mFramesJustRead;
 
     std::mutex mMutex;
 
@@ -594,7 +1235,54 @@ private:
     double mNextHeartbeat;
     double mHeartbeatInterval;
 
-    int mWakePipe[2];
+    // what 'writeLoop' sleeps on. These are the same fd if it's an eventfd.
+    int mWakeReadFD;
+    int mWakeWriteFD;
+
+    // if set, we're being pumped by a PumpLoopEngine, and this wakes it up.
+    std::function<void ()> mWakeCallback;
+
+    // counters for 'writeStats'. The socket thread updates these and anyone can read them.
+    std::atomic<int64_t> mMessagesWritten;
+    std::atomic<int64_t> mSslWrites;
+    std::atomic<int64_t> mRecordsWritten;
+    std::atomic<int64_t> mBytesWritten;
+
+    // compress outgoing messages at least this big, or 0 to never compress.
+    std::atomic<size_t> mCompressionThreshold;
+
+    // set when we need to tell the other side we can read compressed frames
+    std::atomic<bool> mShouldSendCompressionHello;
+
+    // whether the other side has told us it can read compressed frames.
+    // only the socket thread touches this.
+    bool mPeerAcceptsCompression;
+
+    // counters for 'compressionStats'. The socket thread updates these and anyone can read them.
+    std::atomic<int64_t> mMessagesCompressed;
+    std::atomic<int64_t> mBytesBeforeCompression;
+    std::atomic<int64_t> mBytesAfterCompression;
+    std::atomic<int64_t> mMessagesDecompressed;
+    std::atomic<int64_t> mBytesBeforeDecompression;
+    std::atomic<int64_t> mBytesAfterDecompression;
+
+    // if nonzero, 'write' blocks while at least this many bytes are queued
+    std::atomic<size_t> mHighWaterMark;
+
+    // how many threads are blocked in 'write', waiting on mQueueHasDrained with mMutex
+    std::atomic<int64_t> mWritersWaiting;
+    std::condition_variable mQueueHasDrained;
+
+    // counters for 'pumpStats'. Anyone can read them.
+    std::atomic<int64_t> mMessagesQueued;
+    std::atomic<int64_t> mBytesQueued;
+    std::atomic<int64_t> mOldestUnsentEnqueuedAt;
+    std::atomic<int64_t> mNanosInSelect;
+    std::atomic<int64_t> mNanosInSslRead;
+    std::atomic<int64_t> mNanosInSslWrite;
+    std::atomic<int64_t> mNanosBlockedOnHighWaterMark;
+    std::atomic<int64_t> mTimesBlockedOnHighWaterMark;
+    std::atomic<int64_t> mWireLatencyHistogram[latency_buckets];
 
     int mSSLSocketFD;
 };
@@ -15,14 +15,28 @@
 ******************************************************************************/
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
 
 #include <typed_python/SerializationContext.hpp>
 #include <typed_python/DeserializationBuffer.hpp>
 #include "VersionedObjects.hpp"
+#include "ChangeLog.hpp"
 #include "ObjectFieldId.hpp"
 #include "IndexId.hpp"
+#include "SpillFile.hpp"
+#include "StateFile.hpp"
+#include "SubscribedObjectRanges.hpp"
+#include "ViewTrace.hpp"
 #include "direct_types/all.hpp"
 
 /*************
@@ -30,14 +44,66 @@ DatabaseConnectionState stores a set of versioned objects for a single database
 connection. It provides methods for tracking which object versions have refcounts,
 cleaning up the connection state, serializing/deserializing values from transactions,
 etc.
+
+Everything here is protected by the GIL, except that while any SnapshotViews
+exist, threads without the GIL may be reading the VersionedObjects. So while
+there are snapshots, anything that changes them holds 'm_snapshot_mutex'
+exclusively (see SnapshotWriteGuard), and snapshot readers hold it shared.
 *************/
 
 class DatabaseConnectionState {
 public:
+   //by default, how much garbage collection we do each time a transaction
+   //arrives or a view goes away. See VersionedObjects::collectGarbage.
+   enum { default_gc_step_work = 10000 };
+   enum { default_gc_step_microseconds = 1000 };
+
+   //transactions with fewer writes and index changes than this get applied on
+   //the calling thread. See setParallelApply.
+   enum { default_parallel_apply_threshold = 100000 };
+
+   /*****
+   holds m_snapshot_mutex exclusively for as long as it lives, if there are any
+   snapshots. Call with the GIL. Snapshot readers don't hold the GIL, so we give it
+   up while we wait for them rather than stall everybody else.
+   *****/
+   class SnapshotWriteGuard {
+   public:
+      SnapshotWriteGuard(DatabaseConnectionState& state) :
+            m_mutex(state.m_snapshot_count ? &state.m_snapshot_mutex : nullptr)
+      {
+         if (m_mutex && !m_mutex->try_lock()) {
+            PyEnsureGilReleased releaseTheGil;
+            m_mutex->lock();
+         }
+      }
+
+      ~SnapshotWriteGuard() {
+         if (m_mutex) {
+            m_mutex->unlock();
+         }
+      }
+
+      SnapshotWriteGuard(const SnapshotWriteGuard&) = delete;
+      SnapshotWriteGuard& operator=(const SnapshotWriteGuard&) = delete;
+
+   private:
+      std::shared_timed_mutex* m_mutex;
+   };
+
    DatabaseConnectionState() :
          m_next_identity(-1),
          m_cur_transaction_id(-1),
-         m_min_transaction_id(-1)
+         m_min_transaction_id(-1),
+         m_gc_step_work(default_gc_step_work),
+         m_gc_step_microseconds(default_gc_step_microseconds),
+         m_parallel_apply_threads(defaultParallelApplyThreads()),
+         m_parallel_apply_threshold(default_parallel_apply_threshold),
+         m_spill_min_bytes(0),
+         m_spill_interval_microseconds(0),
+         m_last_spill(std::chrono::steady_clock::now()),
+         m_type_subscription_generation(0),
+         m_snapshot_count(0)
    {
       m_objects.reset(new VersionedObjects());
    }
@@ -46,6 +112,12 @@ public:
       m_trigger_lazy_load = PyObjectHolder(o);
    }
 
+   //called as 'o(schemaName, typeName, oids)' to start loading several lazy objects
+   //of one type at once, without waiting for them.
+   void setTriggerLazyPrefetch(PyObject* o) {
+      m_trigger_lazy_prefetch = PyObjectHolder(o);
+   }
+
    void setIdentityRoot(transaction_id id) {
       m_next_identity = id;
    }
@@ -54,40 +126,97 @@ public:
       return m_next_identity++;
    }
 
+   // reserve 'count' consecutive identities, and return the first
+   transaction_id allocateIdentities(int64_t count) {
+      transaction_id first = m_next_identity;
+      m_next_identity += count;
+      return first;
+   }
+
+   // the Bytes in 'writes' are refcounted, and VersionedObjects holds on to the
+   // large ones rather than copying them.
    void incomingTransaction(
          transaction_id tid,
-         ConstDict<ObjectFieldId, OneOf<None, Bytes> > writes,
-         ConstDict<IndexId, TupleOf<object_id> > setAdds,
-         ConstDict<IndexId, TupleOf<object_id> > setRemoves
+         const ConstDict<ObjectFieldId, OneOf<None, Bytes> >& writes,
+         const ConstDict<IndexId, TupleOf<object_id> >& setAdds,
+         const ConstDict<IndexId, TupleOf<object_id> >& setRemoves
          ) {
-      for (auto keyValuePair: writes) {
-         None n;
-
-         if (keyValuePair.second.getValue(n)) {
-            m_objects->markObjectVersionDeleted(keyValuePair.first.fieldId(), keyValuePair.first.objId(), tid);
-         } else {
-            Bytes serializedVal;
-            if (!keyValuePair.second.getValue(serializedVal)) {
-               throw std::runtime_error("Corrupt 'OneOf'");
-            }
+      applyTransaction(tid, writes, setAdds, setRemoves);
 
-            m_objects->addObjectVersion(keyValuePair.first.fieldId(), keyValuePair.first.objId(), tid, serializedVal);
-         }
+      m_change_log.record(tid, writes, setAdds, setRemoves);
+
+      cleanup(tid);
+   }
+
+   /*****
+   remember the last 'capacity' writes and index changes, so 'changesSince' can say
+   what happened after a given transaction. Zero turns it off.
+   *****/
+   void setChangeLogCapacity(size_t capacity) {
+      m_change_log.setCapacity(capacity, m_cur_transaction_id);
+   }
+
+   // see ChangeLog::changesSince
+   ChangeLog::Changes changesSince(transaction_id tid, const std::set<field_id>* fields) const {
+      return m_change_log.changesSince(tid, fields);
+   }
+
+   // snapshots register themselves here, with the GIL
+   void snapshotCreated() {
+      m_snapshot_count++;
+   }
+
+   void snapshotDestroyed() {
+      m_snapshot_count--;
+   }
+
+   std::shared_timed_mutex& getSnapshotMutex() {
+      return m_snapshot_mutex;
+   }
+
+   void applyTransaction(
+         transaction_id tid,
+         const ConstDict<ObjectFieldId, OneOf<None, Bytes> >& writes,
+         const ConstDict<IndexId, TupleOf<object_id> >& setAdds,
+         const ConstDict<IndexId, TupleOf<object_id> >& setRemoves
+         ) {
+      SnapshotWriteGuard guard(*this);
+
+      size_t operations = writes.size();
+
+      for (const auto& indexAndOids: setAdds) {
+         operations += indexAndOids.second.size();
       }
 
-      for (auto indexAndOids: setAdds) {
+      for (const auto& indexAndOids: setRemoves) {
+         operations += indexAndOids.second.size();
+      }
+
+      if (m_parallel_apply_threads > 1 && operations >= m_parallel_apply_threshold) {
+         applyTransactionInParallel(tid, writes, setAdds, setRemoves);
+         return;
+      }
+
+      for (const auto& keyValuePair: writes) {
+         applyWrite(
+            m_objects->fieldForWrite(keyValuePair.first.fieldId(), tid),
+            keyValuePair.first.objId(),
+            tid,
+            keyValuePair.second
+         );
+      }
+
+      for (const auto& indexAndOids: setAdds) {
          for (auto o: indexAndOids.second) {
             m_objects->indexAdd(indexAndOids.first.fieldId(), indexAndOids.first.indexValue(), tid, o);
          }
       }
 
-      for (auto indexAndOids: setRemoves) {
+      for (const auto& indexAndOids: setRemoves) {
          for (auto o: indexAndOids.second) {
             m_objects->indexRemove(indexAndOids.first.fieldId(), indexAndOids.first.indexValue(), tid, o);
          }
       }
-
-      cleanup(tid);
    }
 
    void setContext(std::shared_ptr<SerializationContext> inContext) {
@@ -140,6 +269,8 @@ public:
    }
 
    void checkMinId() {
+      int64_t traceStart = ViewTrace::startSpan();
+
       transaction_id minId = m_cur_transaction_id;
 
       if (m_version_refcounts.size()) {
@@ -149,8 +280,93 @@ public:
       if (minId > m_min_transaction_id) {
          m_min_transaction_id = minId;
 
-         m_objects->moveGuaranteedLowestIdForward(m_min_transaction_id);
+         m_objects->setGarbageCollectionTarget(m_min_transaction_id);
       }
+
+      SnapshotWriteGuard guard(*this);
+
+      // we only do a bounded amount of garbage collection here, so that a long-lived
+      // view going away doesn't stall everyone while we drain everything it was holding.
+      // whatever's left gets picked up by the next call, or by 'collectGarbage'.
+      m_objects->collectGarbage(m_gc_step_work, m_gc_step_microseconds);
+
+      if (m_spill_file && std::chrono::steady_clock::now() - m_last_spill >= std::chrono::microseconds(m_spill_interval_microseconds)) {
+         spillColdValuesWhileHoldingGuard();
+      }
+
+      ViewTrace::finishSpan(ViewTrace::span_garbage_collection, traceStart);
+   }
+
+   /*****
+   spill serialized values of at least 'minBytes' that nobody has read for
+   'coldMicroseconds' (or up to twice that) to a file in 'directory', which we
+   map back in when they're read. We check whenever we collect garbage. An empty
+   'directory' turns it off; values we already spilled stay where they are.
+   *****/
+   void setSpillPolicy(const std::string& directory, size_t minBytes, int64_t coldMicroseconds) {
+      SnapshotWriteGuard guard(*this);
+
+      if (directory.empty()) {
+         m_spill_file.reset();
+         return;
+      }
+
+      // the new file only has to outlive the values we put in it, and they keep it alive
+      m_spill_file.reset(new SpillFile(directory));
+      m_spill_min_bytes = minBytes;
+      m_spill_interval_microseconds = coldMicroseconds;
+      m_last_spill = std::chrono::steady_clock::now();
+   }
+
+   // sweep for cold values now, whether or not it's time to. Returns the bytes we spilled.
+   size_t spillColdValues() {
+      SnapshotWriteGuard guard(*this);
+
+      if (!m_spill_file) {
+         return 0;
+      }
+
+      return spillColdValuesWhileHoldingGuard();
+   }
+
+   // bytes of spilled values that are still live, and how big the spill file has grown
+   std::pair<int64_t, int64_t> spillStats() const {
+      if (!m_spill_file) {
+         return std::make_pair(0, 0);
+      }
+
+      return std::make_pair(m_spill_file->liveBytes(), m_spill_file->fileSize());
+   }
+
+   // collect garbage below the current minimum transaction id. 'maxWork' and
+   // 'maxMicroseconds' bound the work done, as in VersionedObjects::collectGarbage.
+   size_t collectGarbage(size_t maxWork, int64_t maxMicroseconds) {
+      SnapshotWriteGuard guard(*this);
+
+      return m_objects->collectGarbage(maxWork, maxMicroseconds);
+   }
+
+   size_t garbageCollectionBacklog() const {
+      return m_objects->garbageCollectionBacklog();
+   }
+
+   /*****
+   apply transactions with at least 'minOperations' writes and index changes on
+   'threads' threads, counting the calling thread. One thread means we never do.
+   *****/
+   void setParallelApply(size_t threads, size_t minOperations) {
+      m_parallel_apply_threads = std::max<size_t>(1, threads);
+      m_parallel_apply_threshold = minOperations;
+   }
+
+   static size_t defaultParallelApplyThreads() {
+      return std::max<size_t>(1, std::min<size_t>(8, std::thread::hardware_concurrency()));
+   }
+
+   // set the limits on how much garbage collection we do automatically
+   void setGarbageCollectionStep(size_t maxWork, int64_t maxMicroseconds) {
+      m_gc_step_work = maxWork;
+      m_gc_step_microseconds = maxMicroseconds;
    }
 
    field_id getFieldId(SchemaAndTypeName type, std::string fieldName) {
@@ -183,19 +399,20 @@ public:
    }
 
    transaction_id objectSubscriptionLowestTransaction(object_id i) {
-      auto it = m_subscribed_objects.find(i);
+      return m_subscribed_objects.lookup(i);
+   }
 
-      if (it == m_subscribed_objects.end()) {
-         return NO_TRANSACTION;
-      }
+   // does our subscription to all of type 't' cover transaction 'tid'? If so, every
+   // object of the type is visible to it, and nobody needs to look at the object.
+   bool typeIsVisible(SchemaAndTypeName t, transaction_id tid) {
+      transaction_id tidForType = typeSubscriptionLowestTransaction(t);
 
-      return it->second;
+      return tidForType != NO_TRANSACTION && tid >= tidForType;
    }
 
    // is an object visible to transaction 'tid'?
    bool objectIsVisible(SchemaAndTypeName t, object_id i, transaction_id tid) {
-      transaction_id tidForType = typeSubscriptionLowestTransaction(t);
-      if (tidForType != NO_TRANSACTION && tid >= tidForType) {
+      if (typeIsVisible(t, tid)) {
          return true;
       }
 
@@ -211,6 +428,8 @@ public:
    void markTypeSubscribed(SchemaAndTypeName t, transaction_id tid) {
       auto it = m_subscribed_types.find(t);
 
+      m_type_subscription_generation++;
+
       if (it == m_subscribed_types.end()) {
          m_subscribed_types[t] = tid;
          return;
@@ -219,15 +438,14 @@ public:
       it->second = std::max(it->second, tid);
    }
 
-   void markObjectSubscribed(object_id i, transaction_id tid) {
-      auto it = m_subscribed_objects.find(i);
-
-      if (it == m_subscribed_objects.end()) {
-         m_subscribed_objects[i] = tid;
-         return;
-      }
+   // changes whenever a type subscription does, so a View can remember that a type is
+   // visible to it and know when to stop believing that.
+   size_t typeSubscriptionGeneration() const {
+      return m_type_subscription_generation;
+   }
 
-      it->second = std::max(it->second, tid);
+   void markObjectSubscribed(object_id i, transaction_id tid) {
+      m_subscribed_objects.mark(i, tid);
    }
 
    void markObjectSubscribed(SchemaAndTypeName t, object_id oid, transaction_id tid) {
@@ -257,6 +475,8 @@ public:
          throw std::runtime_error("No lazy object loader was defined.");
       }
 
+      int64_t traceStart = ViewTrace::startSpan();
+
       PyObject* res = PyObject_CallFunction(
          m_trigger_lazy_load,
          "lss",
@@ -270,13 +490,482 @@ public:
       }
 
       decref(res);
+
+      ViewTrace::finishSpan(ViewTrace::span_lazy_load, traceStart);
+   }
+
+   /*****
+   start loading whichever of 'oids' are lazy, with one request per type, and
+   return without waiting for them. A later loadLazyObjectIfNeeded on any of them
+   waits for that request rather than making its own.
+   *****/
+   void prefetchLazyObjects(const TupleOf<object_id>& oids) {
+      std::unordered_map<SchemaAndTypeName, std::vector<object_id> > oidsByType;
+
+      for (object_id oid: oids) {
+         auto it = m_lazy_objects.find(oid);
+
+         if (it != m_lazy_objects.end()) {
+            oidsByType[it->second].push_back(oid);
+         }
+      }
+
+      if (!oidsByType.size()) {
+         return;
+      }
+
+      if (!m_trigger_lazy_prefetch) {
+         throw std::runtime_error("No lazy object prefetcher was defined.");
+      }
+
+      for (auto& typeAndOids: oidsByType) {
+         PyObjectStealer pyOids(TupleOf<object_id>(typeAndOids.second).toPython());
+
+         PyObject* res = PyObject_CallFunction(
+            m_trigger_lazy_prefetch,
+            "ssO",
+            typeAndOids.first.schemaName().c_str(),
+            typeAndOids.first.typeName().c_str(),
+            (PyObject*)pyOids
+         );
+
+         if (!res) {
+            throw PythonExceptionSet();
+         }
+
+         decref(res);
+      }
    }
 
    PyObject* getLazyLoadTrigger() {
       return m_trigger_lazy_load;
    }
 
+   /*****
+   write what we can see at the current transaction of every type we're subscribed
+   to as a whole, other than 'excludedTypes', to 'path', so that a later connection
+   can 'restoreState' from it rather than downloading it all again. 'epoch' names
+   the server process the transaction ids came from.
+
+   The file holds the field ids of those types, the value of each of their fields
+   on each object, and which objects are in each of their index values. See
+   StateFileReader.
+   *****/
+   void saveState(const std::string& path, const std::string& epoch, const std::set<SchemaAndTypeName>& excludedTypes) {
+      transaction_id tid = m_cur_transaction_id;
+
+      std::vector<SchemaAndTypeName> savedTypes;
+      std::set<field_id> savedFields;
+
+      for (auto& typeAndTid: m_subscribed_types) {
+         if (excludedTypes.find(typeAndTid.first) == excludedTypes.end() && typeAndTid.second <= tid) {
+            savedTypes.push_back(typeAndTid.first);
+
+            for (auto& nameAndId: m_field_ids[typeAndTid.first]) {
+               savedFields.insert(nameAndId.second);
+            }
+         }
+      }
+
+      StateFileWriter writer(path);
+
+      writer.write(stateFileMagic(), state_file_magic_size);
+      writer.writeInt(tid);
+      writer.writeString(epoch);
+
+      writer.writeInt(savedFields.size());
+
+      for (auto& type: savedTypes) {
+         for (auto& nameAndId: m_field_ids[type]) {
+            writer.writeString(type.schemaName());
+            writer.writeString(type.typeName());
+            writer.writeString(nameAndId.first);
+            writer.writeInt(nameAndId.second);
+         }
+      }
+
+      writer.writeInt(savedTypes.size());
+
+      for (auto& type: savedTypes) {
+         writer.writeString(type.schemaName());
+         writer.writeString(type.typeName());
+      }
+
+      for (field_id fieldId: savedFields) {
+         VersionedObjectsOfMultiType* objects = m_objects->findVersionedObjectsForFieldId(fieldId);
+
+         std::vector<object_id> oids;
+
+         if (objects) {
+            objects->visitObjectIds([&](object_id oid) { oids.push_back(oid); });
+         }
+
+         std::sort(oids.begin(), oids.end());
+
+         std::vector<std::pair<object_id, std::pair<const uint8_t*, size_t> > > values;
+
+         for (object_id oid: oids) {
+            const uint8_t* data;
+            size_t size;
+
+            if (objects->bestPayload(oid, tid, data, size)) {
+               values.push_back(std::make_pair(oid, std::make_pair(data, size)));
+            }
+         }
+
+         writer.writeInt(fieldId);
+         writer.writeInt(values.size());
+
+         for (auto& oidAndPayload: values) {
+            writer.writeInt(oidAndPayload.first);
+            writer.writeBytes(oidAndPayload.second.first, oidAndPayload.second.second);
+         }
+      }
+
+      std::vector<std::pair<IndexKey, std::vector<object_id> > > indexValues;
+
+      m_objects->visitIndexIdSets([&](field_id fid, const index_value& value, const VersionedIdSet& ids) {
+         if (savedFields.find(fid) == savedFields.end()) {
+            return;
+         }
+
+         std::vector<object_id> oids;
+
+         ids.lookupAll(tid, [&](object_id oid) { oids.push_back(oid); return true; });
+
+         if (oids.size()) {
+            indexValues.push_back(std::make_pair(IndexKey(fid, value), oids));
+         }
+      });
+
+      writer.writeInt(indexValues.size());
+
+      for (auto& keyAndOids: indexValues) {
+         writer.writeInt(keyAndOids.first.fieldId());
+         writer.writeBytes(&keyAndOids.first.indexValue()[0], keyAndOids.first.indexValue().size());
+         writer.writeInt(keyAndOids.second.size());
+         writer.write(&keyAndOids.second[0], keyAndOids.second.size() * sizeof(object_id));
+      }
+
+      writer.finish();
+   }
+
+   /*****
+   load a file written by 'saveState' into this state, which must be empty, and
+   return the transaction id it was saved at. Values stay in the mapped file
+   rather than being copied out of it. If we've already collected garbage past
+   that transaction, we load them at the oldest one we haven't: nothing in them
+   could have changed in between without our hearing about it.
+
+   Objects we load can't be read until python resubscribes to their type, and says so
+   with 'finishRestoredType', or gives up on it with 'forgetRestoredType'. Until
+   then, 'restoredIndexValue' says which value of each index an object had.
+   *****/
+   transaction_id restoreState(const std::string& path, std::string& outEpoch) {
+      if (m_objects->objectCount() || m_subscribed_types.size() || !m_subscribed_objects.empty()) {
+         throw std::runtime_error("Can only restore state into an empty DatabaseConnectionState.");
+      }
+
+      StateFileReader reader(path);
+
+      if (memcmp(reader.read(state_file_magic_size), stateFileMagic(), state_file_magic_size) != 0) {
+         throw std::runtime_error(path + " isn't a saved DatabaseConnectionState.");
+      }
+
+      transaction_id savedTid = reader.readInt();
+      transaction_id tid = std::max(savedTid, m_min_transaction_id);
+      outEpoch = reader.readString();
+
+      int64_t fieldCount = reader.readInt();
+
+      for (int64_t k = 0; k < fieldCount; k++) {
+         std::string schemaName = reader.readString();
+         std::string typeName = reader.readString();
+         std::string fieldName = reader.readString();
+         field_id fieldId = reader.readInt();
+
+         setFieldId(SchemaAndTypeName(schemaName, typeName), fieldName, fieldId);
+      }
+
+      int64_t typeCount = reader.readInt();
+
+      for (int64_t k = 0; k < typeCount; k++) {
+         std::string schemaName = reader.readString();
+         std::string typeName = reader.readString();
+
+         m_restored_types.insert(SchemaAndTypeName(schemaName, typeName));
+      }
+
+      // if the file turns out to be bad, leave us as empty as we were
+      try {
+         for (int64_t k = 0; k < fieldCount; k++) {
+            field_id fieldId = reader.readInt();
+            int64_t valueCount = reader.readInt();
+
+            for (int64_t v = 0; v < valueCount; v++) {
+               object_id oid = reader.readInt();
+
+               size_t size;
+               const uint8_t* data = reader.readBytes(size);
+
+               m_objects->addSharedObjectVersion(fieldId, oid, tid, reader.owner(), data, size);
+            }
+         }
+
+         int64_t indexCount = reader.readInt();
+
+         for (int64_t k = 0; k < indexCount; k++) {
+            field_id fieldId = reader.readInt();
+
+            size_t size;
+            const uint8_t* data = reader.readBytes(size);
+            index_value value((const char*)data, size);
+
+            int64_t oidCount = reader.readInt();
+
+            if (oidCount < 0 || oidCount > std::numeric_limits<int64_t>::max() / (int64_t)sizeof(object_id)) {
+               throw reader.corrupt();
+            }
+
+            const uint8_t* oids = reader.read(oidCount * sizeof(object_id));
+
+            VersionedIdSet& ids = m_objects->indexIdSetForWrite(fieldId, value, tid);
+
+            for (int64_t o = 0; o < oidCount; o++) {
+               object_id oid;
+               memcpy(&oid, oids + o * sizeof(object_id), sizeof(oid));
+
+               ids.add(tid, oid);
+               m_restored_index_values[std::make_pair(fieldId, oid)] = value;
+            }
+         }
+
+         if (!reader.atEnd()) {
+            throw reader.corrupt();
+         }
+      } catch(...) {
+         std::set<SchemaAndTypeName> restored = m_restored_types;
+
+         for (auto& type: restored) {
+            forgetRestoredType(type);
+         }
+
+         throw;
+      }
+
+      return savedTid;
+   }
+
+   const std::set<SchemaAndTypeName>& restoredTypes() const {
+      return m_restored_types;
+   }
+
+   //which value of index 'fieldId' object 'oid' had when we saved the state we
+   //restored from, or nullptr if it wasn't in any of them.
+   const index_value* restoredIndexValue(field_id fieldId, object_id oid) const {
+      auto it = m_restored_index_values.find(std::make_pair(fieldId, oid));
+
+      if (it == m_restored_index_values.end()) {
+         return nullptr;
+      }
+
+      return &it->second;
+   }
+
+   //we've resubscribed to restored type 't', so it's up to date
+   void finishRestoredType(SchemaAndTypeName t) {
+      m_restored_types.erase(t);
+
+      if (!m_restored_types.size()) {
+         m_restored_index_values.clear();
+      }
+   }
+
+   //throw away everything we restored for type 't'. It's too old to bring up to date.
+   void forgetRestoredType(SchemaAndTypeName t) {
+      if (m_restored_types.find(t) == m_restored_types.end()) {
+         return;
+      }
+
+      SnapshotWriteGuard guard(*this);
+
+      for (auto& nameAndId: m_field_ids[t]) {
+         m_objects->forgetField(nameAndId.second);
+      }
+
+      finishRestoredType(t);
+   }
+
 private:
+   // the caller holds a SnapshotWriteGuard and has checked we have a spill file
+   size_t spillColdValuesWhileHoldingGuard() {
+      m_last_spill = std::chrono::steady_clock::now();
+
+      return m_objects->spillColdPayloads(*m_spill_file, m_spill_min_bytes);
+   }
+
+   //the first bytes of every file 'saveState' writes
+   enum { state_file_magic_size = 8 };
+
+   static const char* stateFileMagic() {
+      return "ODBSTATE";
+   }
+
+   static void applyWrite(VersionedObjectsOfMultiType* objects, object_id oid, transaction_id tid, const OneOf<None, Bytes>& value) {
+      None n;
+
+      if (value.getValue(n)) {
+         objects->markDeleted(oid, tid);
+      } else {
+         Bytes serializedVal;
+         if (!value.getValue(serializedVal)) {
+            throw std::runtime_error("Corrupt 'OneOf'");
+         }
+
+         objects->add(oid, tid, serializedVal);
+      }
+   }
+
+   /*****
+   apply a large transaction on several threads. Writes to different fields touch
+   different VersionedObjectsOfMultiType, and changes to different index values
+   touch different VersionedIdSets, so once we've done the bookkeeping they share
+   (see VersionedObjects::fieldForWrite) each field or index value is a unit of
+   work that one thread does start to finish.
+
+   The workers never touch python. We keep the GIL while they run, so that views
+   can't see the transaction half-applied.
+   *****/
+   void applyTransactionInParallel(
+         transaction_id tid,
+         const ConstDict<ObjectFieldId, OneOf<None, Bytes> >& writes,
+         const ConstDict<IndexId, TupleOf<object_id> >& setAdds,
+         const ConstDict<IndexId, TupleOf<object_id> >& setRemoves
+         ) {
+      // the writes to one field, in the order they appear in the transaction
+      class FieldWrites {
+      public:
+         VersionedObjectsOfMultiType* objects;
+         std::vector<std::pair<object_id, const OneOf<None, Bytes>*> > writes;
+      };
+
+      // the changes to one index value. Adds happen before removes, as they do in
+      // 'applyTransaction'.
+      class IndexWrites {
+      public:
+         VersionedIdSet* ids;
+         const TupleOf<object_id>* adds;
+         const TupleOf<object_id>* removes;
+      };
+
+      std::vector<FieldWrites> fieldWrites;
+      std::unordered_map<field_id, size_t> fieldSlots;
+
+      for (const auto& keyValuePair: writes) {
+         field_id fieldId = keyValuePair.first.fieldId();
+
+         auto it = fieldSlots.find(fieldId);
+
+         if (it == fieldSlots.end()) {
+            it = fieldSlots.insert(std::make_pair(fieldId, fieldWrites.size())).first;
+            fieldWrites.push_back(FieldWrites());
+            fieldWrites.back().objects = m_objects->fieldForWrite(fieldId, tid);
+         }
+
+         fieldWrites[it->second].writes.push_back(
+            std::make_pair(keyValuePair.first.objId(), &keyValuePair.second)
+         );
+      }
+
+      std::vector<IndexWrites> indexWrites;
+      std::unordered_map<IndexKey, size_t> indexSlots;
+
+      auto indexSlotFor = [&](const IndexId& index) -> IndexWrites& {
+         IndexKey key(index.fieldId(), index.indexValue());
+
+         auto it = indexSlots.find(key);
+
+         if (it == indexSlots.end()) {
+            it = indexSlots.insert(std::make_pair(key, indexWrites.size())).first;
+            indexWrites.push_back(IndexWrites());
+            indexWrites.back().ids = &m_objects->indexIdSetForWrite(index.fieldId(), index.indexValue(), tid);
+            indexWrites.back().adds = nullptr;
+            indexWrites.back().removes = nullptr;
+         }
+
+         return indexWrites[it->second];
+      };
+
+      for (const auto& indexAndOids: setAdds) {
+         indexSlotFor(indexAndOids.first).adds = &indexAndOids.second;
+      }
+
+      for (const auto& indexAndOids: setRemoves) {
+         indexSlotFor(indexAndOids.first).removes = &indexAndOids.second;
+      }
+
+      size_t units = fieldWrites.size() + indexWrites.size();
+
+      std::atomic<size_t> nextUnit(0);
+      std::mutex errorMutex;
+      std::exception_ptr error;
+
+      auto work = [&]() {
+         while (true) {
+            size_t unit = nextUnit++;
+
+            if (unit >= units) {
+               return;
+            }
+
+            try {
+               if (unit < fieldWrites.size()) {
+                  FieldWrites& field = fieldWrites[unit];
+
+                  for (auto& oidAndValue: field.writes) {
+                     applyWrite(field.objects, oidAndValue.first, tid, *oidAndValue.second);
+                  }
+               } else {
+                  IndexWrites& index = indexWrites[unit - fieldWrites.size()];
+
+                  if (index.adds) {
+                     for (auto o: *index.adds) {
+                        index.ids->add(tid, o);
+                     }
+                  }
+
+                  if (index.removes) {
+                     for (auto o: *index.removes) {
+                        index.ids->remove(tid, o);
+                     }
+                  }
+               }
+            } catch(...) {
+               std::lock_guard<std::mutex> lock(errorMutex);
+               if (!error) {
+                  error = std::current_exception();
+               }
+            }
+         }
+      };
+
+      std::vector<std::thread> threads;
+
+      for (size_t k = 1; k < std::min(m_parallel_apply_threads, units); k++) {
+         threads.push_back(std::thread(work));
+      }
+
+      work();
+
+      for (auto& thread: threads) {
+         thread.join();
+      }
+
+      if (error) {
+         std::rethrow_exception(error);
+      }
+   }
+
    //the next guid we will create.
    transaction_id m_next_identity;
 
@@ -290,6 +979,28 @@ private:
    //the minimum transaction we're keeping
    transaction_id m_min_transaction_id;
 
+   //how much garbage collection 'checkMinId' does at a time
+   size_t m_gc_step_work;
+
+   int64_t m_gc_step_microseconds;
+
+   //see setParallelApply
+   size_t m_parallel_apply_threads;
+
+   size_t m_parallel_apply_threshold;
+
+   //see setChangeLogCapacity
+   ChangeLog m_change_log;
+
+   //see setSpillPolicy. m_spill_file is null unless we're spilling.
+   std::unique_ptr<SpillFile> m_spill_file;
+
+   size_t m_spill_min_bytes;
+
+   int64_t m_spill_interval_microseconds;
+
+   std::chrono::steady_clock::time_point m_last_spill;
+
    //for each version number, how many views are outstanding on it?
    //we have to be careful not to delete behind these.
    std::map<transaction_id, int> m_version_refcounts;
@@ -304,9 +1015,24 @@ private:
 
    //for each object where we're explicitly subscribed (because of an index or
    //object-level subscription), the transaction id where that became effective.
-   std::unordered_map<object_id, transaction_id> m_subscribed_objects;
+   SubscribedObjectRanges m_subscribed_objects;
+
+   size_t m_type_subscription_generation;
 
    PyObjectHolder m_trigger_lazy_load;
 
+   PyObjectHolder m_trigger_lazy_prefetch;
+
+   //how many SnapshotViews are alive. Only changes with the GIL.
+   int64_t m_snapshot_count;
+
+   //see SnapshotWriteGuard
+   std::shared_timed_mutex m_snapshot_mutex;
+
    std::unordered_map<object_id, SchemaAndTypeName> m_lazy_objects;
+
+   //see restoreState
+   std::set<SchemaAndTypeName> m_restored_types;
+
+   std::unordered_map<std::pair<field_id, object_id>, index_value> m_restored_index_values;
 };
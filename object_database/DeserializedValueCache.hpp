@@ -0,0 +1,330 @@
+/******************************************************************************
+   Copyright 2017-2019 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <deque>
+#include <limits>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+#include <typed_python/Type.hpp>
+#include <typed_python/Instance.hpp>
+#include <typed_python/SerializationContext.hpp>
+#include "Common.hpp"
+#include "HashFunctions.hpp"
+#include "direct_types/FlatHashMap.hpp"
+
+/*************
+
+DeserializedValueCache holds the deserialized form of object versions we've
+read, for every field in a VersionedObjects, under a single memory budget.
+
+Values of simple types (e.g. int) are shared by every SerializationContext.
+Values of other types can deserialize differently depending on the context,
+so they're cached per context.
+
+When we're over budget we evict using CLOCK: entries sit in a ring in
+insertion order, a hit sets the entry's 'referenced' bit, and the hand
+gives each referenced entry a second chance (clearing the bit) before
+evicting the first unreferenced one it finds.
+
+A pointer returned by 'lookup' or 'insert' stays valid until the version is
+dropped or some later 'insert' evicts it, so callers should use it before
+reading anything else.
+
+*************/
+
+class DeserializedValueCache {
+public:
+    typedef std::pair<object_id, transaction_id> key_type;
+
+    class Entry {
+    public:
+        Entry(const Instance& inValue, size_t inBytes, uint64_t inClockId) :
+                value(inValue),
+                bytes(inBytes),
+                referenced(false),
+                clockId(inClockId)
+        {
+        }
+
+        Instance value;
+
+        //our estimate of the memory this entry holds
+        size_t bytes;
+
+        bool referenced;
+
+        //identifies this entry's slot in the clock ring
+        uint64_t clockId;
+    };
+
+    typedef FlatHashMap<key_type, Entry> table_type;
+
+    //the cached values for a single field
+    class FieldTables {
+    public:
+        std::unordered_map<Type*, table_type> simple;
+
+        std::unordered_map<Type*, std::map<std::shared_ptr<SerializationContext>, table_type> > nonsimple;
+    };
+
+    //a rough per-entry cost of the hash table node and clock slot
+    enum { entry_overhead_bytes = 96 };
+
+    DeserializedValueCache() :
+            m_budget(std::numeric_limits<size_t>::max()),
+            m_bytes(0),
+            m_entry_count(0),
+            m_next_clock_id(0),
+            m_hits(0),
+            m_misses(0),
+            m_evictions(0),
+            m_drops(0)
+    {
+    }
+
+    DeserializedValueCache(const DeserializedValueCache&) = delete;
+    DeserializedValueCache& operator=(const DeserializedValueCache&) = delete;
+
+    //the tables for 'fieldId'. The reference stays valid for the life of the cache.
+    FieldTables& tablesForField(field_id fieldId) {
+        return m_fields[fieldId];
+    }
+
+    instance_ptr lookup(FieldTables& tables, Type* t, const std::shared_ptr<SerializationContext>& ctx, object_id oid, transaction_id tid) {
+        table_type& table = tableFor(tables, t, ctx);
+
+        auto it = table.find(key_type(oid, tid));
+
+        if (it == table.end()) {
+            m_misses++;
+            return nullptr;
+        }
+
+        m_hits++;
+        it->second.referenced = true;
+
+        return it->second.value.data();
+    }
+
+    //add a freshly deserialized value, evicting other values if we're over budget.
+    //'serializedBytes' is the size of the value's serialized form, which we use to
+    //estimate the size of anything it holds outside of its own layout.
+    instance_ptr insert(
+                FieldTables& tables,
+                Type* t,
+                const std::shared_ptr<SerializationContext>& ctx,
+                object_id oid,
+                transaction_id tid,
+                const Instance& value,
+                size_t serializedBytes
+                ) {
+        table_type& table = tableFor(tables, t, ctx);
+
+        key_type key(oid, tid);
+
+        auto it = table.find(key);
+
+        if (it != table.end()) {
+            //somebody else filled this in while we were deserializing
+            return it->second.value.data();
+        }
+
+        size_t bytes = t->bytecount() + serializedBytes + entry_overhead_bytes;
+        uint64_t clockId = m_next_clock_id++;
+
+        it = table.insert(std::make_pair(key, Entry(value, bytes, clockId))).first;
+
+        m_clock.push_back(ClockSlot(&table, key, clockId));
+        m_bytes += bytes;
+        m_entry_count++;
+
+        evictToBudget(clockId);
+
+        return it->second.value.data();
+    }
+
+    //forget any cached values for this version of an object
+    void dropVersion(FieldTables& tables, object_id oid, transaction_id tid) {
+        key_type key(oid, tid);
+
+        for (auto& typeAndTable: tables.simple) {
+            dropFromTable(typeAndTable.second, key);
+        }
+
+        for (auto& typeAndTables: tables.nonsimple) {
+            for (auto& contextAndTable: typeAndTables.second) {
+                dropFromTable(contextAndTable.second, key);
+            }
+        }
+
+        //dropped entries leave stale slots in the ring. Clear them out once they
+        //outnumber the live ones.
+        if (m_clock.size() > 1024 && m_clock.size() > m_entry_count * 2) {
+            removeStaleClockSlots();
+        }
+    }
+
+    void setBudget(size_t bytes) {
+        m_budget = bytes;
+        evictToBudget(m_next_clock_id);
+    }
+
+    size_t getBudget() const {
+        return m_budget;
+    }
+
+    bool hasBudget() const {
+        return m_budget != std::numeric_limits<size_t>::max();
+    }
+
+    size_t bytes() const {
+        return m_bytes;
+    }
+
+    size_t entryCount() const {
+        return m_entry_count;
+    }
+
+    size_t hits() const {
+        return m_hits;
+    }
+
+    size_t misses() const {
+        return m_misses;
+    }
+
+    size_t evictions() const {
+        return m_evictions;
+    }
+
+    //how many entries we've ever dropped, for any reason. A pointer we handed out
+    //can only have been invalidated if this has changed since.
+    size_t drops() const {
+        return m_drops;
+    }
+
+private:
+    class ClockSlot {
+    public:
+        ClockSlot(table_type* inTable, key_type inKey, uint64_t inClockId) :
+                table(inTable),
+                key(inKey),
+                clockId(inClockId)
+        {
+        }
+
+        table_type* table;
+        key_type key;
+        uint64_t clockId;
+    };
+
+    table_type& tableFor(FieldTables& tables, Type* t, const std::shared_ptr<SerializationContext>& ctx) {
+        if (t->isSimple()) {
+            return tables.simple[t];
+        }
+
+        return tables.nonsimple[t][ctx];
+    }
+
+    void dropFromTable(table_type& table, const key_type& key) {
+        auto it = table.find(key);
+
+        if (it == table.end()) {
+            return;
+        }
+
+        m_bytes -= it->second.bytes;
+        m_entry_count--;
+        m_drops++;
+        table.erase(it);
+    }
+
+    //the entry this slot refers to, or nullptr if it has been dropped
+    Entry* entryFor(const ClockSlot& slot) {
+        auto it = slot.table->find(slot.key);
+
+        if (it == slot.table->end() || it->second.clockId != slot.clockId) {
+            return nullptr;
+        }
+
+        return &it->second;
+    }
+
+    //evict until we're within budget, but never evict the entry with clock id 'keep'
+    void evictToBudget(uint64_t keep) {
+        while (m_bytes > m_budget && m_clock.size()) {
+            ClockSlot slot = m_clock.front();
+            m_clock.pop_front();
+
+            Entry* entry = entryFor(slot);
+
+            if (!entry) {
+                continue;
+            }
+
+            if (entry->referenced || slot.clockId == keep) {
+                entry->referenced = false;
+                m_clock.push_back(slot);
+
+                if (m_entry_count == 1 && slot.clockId == keep) {
+                    return;
+                }
+
+                continue;
+            }
+
+            dropFromTable(*slot.table, slot.key);
+            m_evictions++;
+        }
+    }
+
+    void removeStaleClockSlots() {
+        std::deque<ClockSlot> live;
+
+        for (auto& slot: m_clock) {
+            if (entryFor(slot)) {
+                live.push_back(slot);
+            }
+        }
+
+        m_clock.swap(live);
+    }
+
+    std::unordered_map<field_id, FieldTables> m_fields;
+
+    //every live entry, oldest first, plus some slots for entries that have been dropped
+    std::deque<ClockSlot> m_clock;
+
+    size_t m_budget;
+
+    size_t m_bytes;
+
+    size_t m_entry_count;
+
+    uint64_t m_next_clock_id;
+
+    size_t m_hits;
+
+    size_t m_misses;
+
+    size_t m_evictions;
+
+    size_t m_drops;
+};
@@ -0,0 +1,117 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <zlib.h>
+
+/***********
+FrameCompression describes how we compress individual framed messages.
+
+A frame is a 4 byte length followed by the message. If the top bit of the
+length is set, the frame is compressed, and its body is the 4 byte length of
+the original message followed by a zlib stream of it.
+
+A compressed frame with no body is a 'hello': it tells the other side that
+we can read compressed frames. Nobody sends compressed frames until they've
+received one, so peers that never send it never see one. This matches
+'MessageBuffer' in message_bus.py.
+***********/
+
+class FrameCompression {
+public:
+    enum : uint32_t { compressed_flag = 0x80000000 };
+
+    // the largest message a frame's length can describe
+    enum : uint32_t { max_frame_size = ~compressed_flag };
+
+    // deflate can't shrink anything by more than this, so a compressed body of 'n'
+    // bytes can't hold more than 'n * max_compression_ratio' bytes of message.
+    enum : uint32_t { max_compression_ratio = 1032 };
+
+    // compress 'msg' into the body of a compressed frame. Returns false, and
+    // leaves 'out' alone, if that wouldn't make it any smaller.
+    static bool compress(const std::string& msg, std::string& out) {
+        uLongf bound = compressBound(msg.size());
+
+        std::string res;
+        res.resize(sizeof(uint32_t) + bound);
+
+        uint32_t originalSize = msg.size();
+        memcpy(&res[0], &originalSize, sizeof(originalSize));
+
+        if (::compress2(
+                (Bytef*)&res[sizeof(uint32_t)],
+                &bound,
+                (const Bytef*)msg.data(),
+                msg.size(),
+                Z_DEFAULT_COMPRESSION
+                ) != Z_OK) {
+            return false;
+        }
+
+        if (sizeof(uint32_t) + bound >= msg.size()) {
+            return false;
+        }
+
+        res.resize(sizeof(uint32_t) + bound);
+        out = std::move(res);
+
+        return true;
+    }
+
+    // decompress the body of a compressed frame into a new block of exactly the right size.
+    // Throws before allocating anything if the frame claims a size no frame could have,
+    // so a corrupt or hostile header can't make us allocate gigabytes.
+    static std::shared_ptr<char> decompress(const char* data, size_t size, size_t& outSize) {
+        if (size < sizeof(uint32_t)) {
+            throw std::runtime_error("Compressed frame is too short.");
+        }
+
+        uint32_t originalSize;
+        memcpy(&originalSize, data, sizeof(originalSize));
+
+        if (originalSize > max_frame_size) {
+            throw std::runtime_error("Compressed frame claims to be larger than the largest frame.");
+        }
+
+        if (originalSize > (uint64_t)(size - sizeof(uint32_t)) * max_compression_ratio) {
+            throw std::runtime_error("Compressed frame claims to be larger than its body could hold.");
+        }
+
+        std::shared_ptr<char> block(new char[originalSize], std::default_delete<char[]>());
+
+        uLongf written = originalSize;
+
+        if (::uncompress(
+                (Bytef*)block.get(),
+                &written,
+                (const Bytef*)data + sizeof(uint32_t),
+                size - sizeof(uint32_t)
+                ) != Z_OK || written != originalSize) {
+            throw std::runtime_error("Corrupt compressed frame.");
+        }
+
+        outSize = originalSize;
+
+        return block;
+    }
+};
@@ -0,0 +1,196 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "FrameCompression.hpp"
+
+/***********
+FrameReadBuffer splits a stream of framed messages (a 4 byte length followed
+by the message) into individual messages without copying them.
+
+Callers read from the socket straight into 'writableRegion' and then
+'commit' what they read. Each complete message comes back as a Frame that
+points into the block it was read into and holds a reference to it, so the
+block lives until the last of its frames is gone.
+
+Small messages share blocks of 'block_size'. When a block fills up, we move
+the partial message at its end into a fresh block, or back to the start of
+the same one if no frames refer to it any more. A message too big for a block
+gets a block of exactly its own size, which we read the rest of it into
+directly.
+
+Frames with FrameCompression::compressed_flag set in their length come back
+marked 'isCompressed', still compressed. Decompressing them is up to the caller.
+***********/
+
+class FrameReadBuffer {
+public:
+    enum { block_size = 64 * 1024 };
+
+    // don't bother reading into less space than this. It's one TLS record.
+    enum { min_read_size = 16 * 1024 };
+
+    class Frame {
+    public:
+        Frame() : data(nullptr), size(0), isCompressed(false)
+        {
+        }
+
+        Frame(std::shared_ptr<char> inBlock, const char* inData, size_t inSize, bool inIsCompressed = false) :
+            block(inBlock),
+            data(inData),
+            size(inSize),
+            isCompressed(inIsCompressed)
+        {
+        }
+
+        std::shared_ptr<char> block;
+        const char* data;
+        size_t size;
+        bool isCompressed;
+    };
+
+    FrameReadBuffer() :
+        mCapacity(0),
+        mParsePos(0),
+        mReadPos(0),
+        mIsDedicated(false),
+        mDedicatedIsCompressed(false)
+    {
+    }
+
+    // where the next read should go, and how much it may read
+    std::pair<char*, size_t> writableRegion() {
+        if (!mBlock) {
+            newBlock(block_size, 0);
+        }
+
+        if (!mIsDedicated && mCapacity - mReadPos < min_read_size && mParsePos > 0) {
+            moveTailToNewBlock();
+        }
+
+        return std::make_pair(mBlock.get() + mReadPos, mCapacity - mReadPos);
+    }
+
+    // 'bytes' bytes were read into 'writableRegion'. Append any messages they complete to 'out'.
+    void commit(size_t bytes, std::vector<Frame>& out) {
+        mReadPos += bytes;
+
+        if (mIsDedicated) {
+            if (mReadPos == mCapacity) {
+                out.push_back(Frame(mBlock, mBlock.get(), mCapacity, mDedicatedIsCompressed));
+                mBlock.reset();
+                mIsDedicated = false;
+            }
+            return;
+        }
+
+        while (mReadPos - mParsePos >= sizeof(uint32_t)) {
+            uint32_t header;
+            memcpy(&header, mBlock.get() + mParsePos, sizeof(header));
+
+            bool isCompressed = header & FrameCompression::compressed_flag;
+            uint32_t size = header & ~FrameCompression::compressed_flag;
+
+            size_t available = mReadPos - mParsePos - sizeof(uint32_t);
+
+            if (available >= size) {
+                out.push_back(Frame(mBlock, mBlock.get() + mParsePos + sizeof(uint32_t), size, isCompressed));
+                mParsePos += sizeof(uint32_t) + size;
+            } else {
+                if (size + sizeof(uint32_t) > block_size) {
+                    // this message gets a block of its own
+                    // 'old' keeps 'partial' alive until we've copied it
+                    const char* partial = mBlock.get() + mParsePos + sizeof(uint32_t);
+                    std::shared_ptr<char> old = mBlock;
+
+                    newBlock(size, available);
+                    memcpy(mBlock.get(), partial, available);
+                    mIsDedicated = true;
+                    mDedicatedIsCompressed = isCompressed;
+                }
+                return;
+            }
+        }
+
+        if (mParsePos == mReadPos && blockIsOurs()) {
+            // we consumed everything and nobody is looking at it. Start over.
+            mParsePos = mReadPos = 0;
+        }
+    }
+
+private:
+    // true if no Frames refer to mBlock any more, so we can write over it.
+    bool blockIsOurs() const {
+        if (mBlock.use_count() != 1) {
+            return false;
+        }
+
+        // frames can be released on other threads after they've been read.
+        // make sure those reads happen before we overwrite anything.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+
+    void newBlock(size_t capacity, size_t alreadyRead) {
+        mBlock = std::shared_ptr<char>(new char[capacity], std::default_delete<char[]>());
+        mCapacity = capacity;
+        mParsePos = 0;
+        mReadPos = alreadyRead;
+    }
+
+    // move the partial message at the end of the block to the start of a block
+    void moveTailToNewBlock() {
+        size_t tail = mReadPos - mParsePos;
+
+        if (blockIsOurs()) {
+            memmove(mBlock.get(), mBlock.get() + mParsePos, tail);
+            mParsePos = 0;
+            mReadPos = tail;
+            return;
+        }
+
+        std::shared_ptr<char> old = mBlock;
+        size_t oldParsePos = mParsePos;
+
+        newBlock(block_size, tail);
+        memcpy(mBlock.get(), old.get() + oldParsePos, tail);
+    }
+
+    std::shared_ptr<char> mBlock;
+
+    size_t mCapacity;
+
+    // the start of the first message we haven't completed
+    size_t mParsePos;
+
+    // where the next read goes
+    size_t mReadPos;
+
+    // if true, mBlock holds only the body of one large message
+    bool mIsDedicated;
+
+    // whether that message is compressed
+    bool mDedicatedIsCompressed;
+};
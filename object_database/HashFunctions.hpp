@@ -17,6 +17,7 @@
 #pragma once
 
 #include <string>
+#include "direct_types/Hashing.hpp"
 
 /*******
 Overrides of std::hash so we can use unordered containers.
@@ -31,7 +32,7 @@ namespace std {
         typedef std::size_t result_type;
 
         result_type operator()(argument_type const& s) const noexcept {
-            return std::hash<std::string>()(s.first) ^ (size_t)s.second;
+            return hashCombine(std::hash<std::string>()(s.first), (size_t)s.second);
         }
     };
 
@@ -51,7 +52,7 @@ namespace std {
         typedef std::size_t result_type;
 
         result_type operator()(argument_type const& s) const noexcept {
-            return s.first ^ s.second;
+            return hashCombine(s.first, s.second);
         }
     };
 
@@ -61,7 +62,7 @@ namespace std {
         typedef std::size_t result_type;
 
         result_type operator()(argument_type const& s) const noexcept {
-            return std::hash<std::string>()(s.first) ^ std::hash<std::string>()(s.second);
+            return hashCombine(std::hash<std::string>()(s.first), std::hash<std::string>()(s.second));
         }
     };
 }
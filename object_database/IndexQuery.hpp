@@ -0,0 +1,148 @@
+/******************************************************************************
+   Copyright 2017-2019 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "Common.hpp"
+#include "VersionedIdSet.hpp"
+#include "OrderedIndex.hpp"
+
+/*************
+
+IndexLookupTerm is one clause of an index lookup: either "index 'fieldId'
+has value 'value'", or "index 'fieldId' has a value in 'range'". A lookup
+with several terms finds the objects matching all of them.
+
+*************/
+
+class IndexLookupTerm {
+public:
+    static IndexLookupTerm exact(field_id fieldId, index_value value) {
+        IndexLookupTerm res;
+        res.fieldId = fieldId;
+        res.value = value;
+        return res;
+    }
+
+    static IndexLookupTerm inRange(field_id fieldId, Type* indexType, const IndexValueRange& range) {
+        IndexLookupTerm res;
+        res.fieldId = fieldId;
+        res.isRange = true;
+        res.indexType = indexType;
+        res.range = range;
+        return res;
+    }
+
+    IndexLookupTerm() :
+            fieldId(NO_FIELD),
+            isRange(false),
+            indexType(nullptr)
+    {
+    }
+
+    field_id fieldId;
+
+    index_value value;
+
+    bool isRange;
+
+    Type* indexType;
+
+    IndexValueRange range;
+};
+
+/*************
+
+IndexCursor walks the objects matching a single IndexLookupTerm in a view,
+in increasing order. It's either backed directly by the committed
+VersionedIdSet plus the view's own adds and removes, or (for range terms)
+by a precomputed sorted list of object ids.
+
+*************/
+
+class IndexCursor {
+public:
+    IndexCursor(
+                transaction_id tid,
+                const VersionedIdSet* committed,
+                const std::set<object_id>* adds,
+                const std::set<object_id>* removes
+                ) :
+            m_tid(tid),
+            m_committed(committed),
+            m_adds(adds),
+            m_removes(removes),
+            m_is_materialized(false)
+    {
+    }
+
+    IndexCursor(std::vector<object_id> sortedIds) :
+            m_tid(NO_TRANSACTION),
+            m_committed(nullptr),
+            m_adds(nullptr),
+            m_removes(nullptr),
+            m_is_materialized(true),
+            m_ids(std::move(sortedIds))
+    {
+    }
+
+    //the first object >= 'o' matching this term, or NO_OBJECT
+    object_id seek(object_id o) const {
+        if (m_is_materialized) {
+            auto it = std::lower_bound(m_ids.begin(), m_ids.end(), o);
+            return it == m_ids.end() ? (object_id)NO_OBJECT : *it;
+        }
+
+        object_id committed = m_committed ? m_committed->lookupNext(m_tid, o - 1) : (object_id)NO_OBJECT;
+
+        while (committed != NO_OBJECT && m_removes && m_removes->find(committed) != m_removes->end()) {
+            committed = m_committed->lookupNext(m_tid, committed);
+        }
+
+        object_id added = NO_OBJECT;
+        if (m_adds) {
+            auto it = m_adds->lower_bound(o);
+            if (it != m_adds->end()) {
+                added = *it;
+            }
+        }
+
+        if (committed == NO_OBJECT) {
+            return added;
+        }
+        if (added == NO_OBJECT) {
+            return committed;
+        }
+        return std::min(committed, added);
+    }
+
+private:
+    transaction_id m_tid;
+
+    const VersionedIdSet* m_committed;
+
+    const std::set<object_id>* m_adds;
+
+    const std::set<object_id>* m_removes;
+
+    bool m_is_materialized;
+
+    std::vector<object_id> m_ids;
+};
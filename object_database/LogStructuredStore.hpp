@@ -0,0 +1,1028 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*************
+
+LogStructuredStore is an embedded key-value store for the server's
+persistence layer. It holds the same two kinds of keys as Redis does for us:
+keys with a value, and keys with a set of members, all of them bytes.
+
+Everything lives in one file, which is a log of batches. Each batch is the
+writes of one 'commit', checksummed, so a torn write at the end of the file
+(from a crash mid-commit) is noticed when we open it, and dropped.
+
+We keep an index of the whole store in memory. Values we read from the file
+when we opened it (or last compacted it) stay in the file: we map it and
+point into the mapping, so a large database opens without copying its values
+and they're paged in as they're read. Values written since are held in RAM
+until the next compaction.
+
+Commits are grouped: a commit queues its writes and waits until they're on
+disk. Whoever gets to the file first writes (and syncs) everything queued so
+far, so concurrent committers share one fsync, and then applies those
+commits to the index, in order. A commit nobody could write never reaches
+the index, and its caller gets the error.
+
+Once the log is more than twice the size of what's live in it, a background
+thread compacts it: it copies what's live, writes that out to a new file
+while commits carry on against the old one, then briefly stops commits to
+copy over whatever they wrote in the meantime, swap the new file in, and
+point at it.
+
+*************/
+
+class LogStructuredStore {
+public:
+    class Batch {
+    public:
+        // value keys to set
+        std::vector<std::pair<std::string, std::string> > values;
+
+        // value keys to delete
+        std::vector<std::string> deletes;
+
+        // members to add to, then members to remove from, set keys
+        std::vector<std::pair<std::string, std::vector<std::string> > > adds;
+        std::vector<std::pair<std::string, std::vector<std::string> > > removes;
+    };
+
+    LogStructuredStore(const std::string& path, bool sync, int64_t compactionMinBytes = 64 * 1024 * 1024) :
+        mPath(path),
+        mSync(sync),
+        mCompactionMinBytes(compactionMinBytes),
+        mFd(-1),
+        mFileSize(0),
+        mLiveBytes(0),
+        mValueVersion(0),
+        mCompacting(false),
+        mWritesToFail(0)
+    {
+        mFd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+
+        if (mFd < 0) {
+            throw std::runtime_error("Couldn't open " + path + ": " + strerror(errno));
+        }
+
+        try {
+            load();
+        } catch(...) {
+            ::close(mFd);
+            throw;
+        }
+    }
+
+    ~LogStructuredStore() {
+        if (mCompactionThread.joinable()) {
+            mCompactionThread.join();
+        }
+
+        ::close(mFd);
+    }
+
+    LogStructuredStore(const LogStructuredStore&) = delete;
+    LogStructuredStore& operator=(const LogStructuredStore&) = delete;
+
+    bool get(const std::string& key, std::string& outValue) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto it = mValues.find(key);
+
+        if (it == mValues.end()) {
+            return false;
+        }
+
+        outValue.assign(it->second.data(), it->second.size);
+
+        return true;
+    }
+
+    std::vector<std::string> getSetMembers(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto it = mSets.find(key);
+
+        if (it == mSets.end()) {
+            return std::vector<std::string>();
+        }
+
+        return std::vector<std::string>(it->second.begin(), it->second.end());
+    }
+
+    bool exists(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        return mValues.count(key) || mSets.count(key);
+    }
+
+    /*****
+    apply 'batch' and return once it's durable (or at least written, if we're not
+    syncing). Fills out the set keys that went from empty to non-empty, and the
+    reverse. If we can't write it, we throw, and it's as if we were never called.
+    *****/
+    void commit(const Batch& batch, std::vector<std::string>& newSets, std::vector<std::string>& droppedSets) {
+        QueuedCommit queued(batch, newSets, droppedSets);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            for (const auto& keyAndMembers: batch.adds) {
+                if (mValues.count(keyAndMembers.first) || mQueuedValueKeys.count(keyAndMembers.first)) {
+                    throw std::runtime_error("Can't add set members to a key holding a value.");
+                }
+            }
+
+            std::string record;
+
+            for (const auto& keyAndValue: batch.values) {
+                encodeValue(record, OP_SET, keyAndValue.first, &keyAndValue.second);
+            }
+
+            for (const auto& key: batch.deletes) {
+                encodeValue(record, OP_DELETE, key, nullptr);
+            }
+
+            for (const auto& keyAndMembers: batch.adds) {
+                if (!keyAndMembers.second.empty()) {
+                    encodeMembers(record, OP_ADD, keyAndMembers.first, keyAndMembers.second);
+                }
+            }
+
+            for (const auto& keyAndMembers: batch.removes) {
+                if (!keyAndMembers.second.empty()) {
+                    encodeMembers(record, OP_REMOVE, keyAndMembers.first, keyAndMembers.second);
+                }
+            }
+
+            if (record.empty()) {
+                return;
+            }
+
+            for (const auto& keyAndValue: batch.values) {
+                mQueuedValueKeys[keyAndValue.first]++;
+            }
+
+            appendRecord(mPending, record.data(), record.size());
+            mQueue.push_back(&queued);
+        }
+
+        flushThrough(queued);
+    }
+
+    /*****
+    rewrite the file with just what's live in it. Commits carry on while we write,
+    and only wait while we copy over what they wrote in the meantime and swap the
+    new file in.
+    *****/
+    void compact() {
+        std::lock_guard<std::mutex> compactionLock(mCompactionMutex);
+
+        // what's live, as of 'snapshotSize' bytes into the file. Values can point
+        // into 'snapshotMapping', which we keep alive until we're done with them.
+        std::unordered_map<std::string, StoredValue> values;
+        std::unordered_map<std::string, std::unordered_set<std::string> > sets;
+        std::shared_ptr<Mapping> snapshotMapping;
+        int64_t snapshotSize;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            values = mValues;
+            sets = mSets;
+            snapshotMapping = mMapping;
+            snapshotSize = mFileSize;
+        }
+
+        std::string tempPath = mPath + ".compacting";
+
+        int fd = ::open(tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+        if (fd < 0) {
+            throw std::runtime_error("Couldn't open " + tempPath + ": " + strerror(errno));
+        }
+
+        // where each value will be in the new file, by key and version
+        std::vector<std::pair<const std::string*, std::pair<uint64_t, size_t> > > offsets;
+
+        // how much of the new file is the snapshot, and how much we've written
+        int64_t compactedSize;
+        int64_t written;
+
+        // how far into the old file we've copied
+        int64_t copiedThrough = snapshotSize;
+
+        try {
+            compactedSize = writeSnapshot(fd, values, sets, offsets);
+            written = compactedSize;
+
+            // catch up with the commits made while we wrote the snapshot. Nobody
+            // changes the part of the old file that's already written.
+            int64_t fileSize;
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                fileSize = mFileSize;
+            }
+
+            copyLogTail(fd, copiedThrough, fileSize, written);
+
+            syncCompactedFile(fd, tempPath);
+        } catch(...) {
+            ::close(fd);
+            unlink(tempPath.c_str());
+            throw;
+        }
+
+        std::lock_guard<std::mutex> writeLock(mWriteMutex);
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        try {
+            if (copyLogTail(fd, copiedThrough, mFileSize, written)) {
+                syncCompactedFile(fd, tempPath);
+            }
+
+            if (rename(tempPath.c_str(), mPath.c_str()) != 0) {
+                throw std::runtime_error("Couldn't replace " + mPath + ": " + strerror(errno));
+            }
+        } catch(...) {
+            ::close(fd);
+            unlink(tempPath.c_str());
+            throw;
+        }
+
+        // the old mapping stays good after we close its file, so our values do too
+        ::close(mFd);
+        mFd = fd;
+        mFileSize = written;
+
+        syncDirectory();
+
+        std::shared_ptr<Mapping> mapping(new Mapping(mFd, compactedSize));
+
+        // values written since the snapshot are in RAM, so they don't need moving
+        for (const auto& keyAndOffset: offsets) {
+            auto it = mValues.find(*keyAndOffset.first);
+
+            if (it != mValues.end() && it->second.version == keyAndOffset.second.first) {
+                it->second.mapped = mapping->data + keyAndOffset.second.second;
+                std::string().swap(it->second.owned);
+            }
+        }
+
+        mMapping = mapping;
+    }
+
+    // make the next 'count' writes of commits to the file fail, as if the disk had
+    void failWritesForTesting(int64_t count) {
+        mWritesToFail = count;
+    }
+
+    // how big the file is
+    int64_t logBytes() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mFileSize + mPending.size();
+    }
+
+    // roughly how many bytes of keys, values and set members are live
+    int64_t liveBytes() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mLiveBytes;
+    }
+
+    // how many value keys and set keys we hold
+    std::pair<size_t, size_t> keyCounts() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return std::make_pair(mValues.size(), mSets.size());
+    }
+
+private:
+    enum { OP_SET = 1, OP_DELETE = 2, OP_ADD = 3, OP_REMOVE = 4 };
+
+    // each record is a length, a checksum of what follows, and the ops
+    static const size_t RECORD_HEADER_BYTES = 12;
+
+    static const char* magic() {
+        return "ODBLOG1\n";
+    }
+
+    static const size_t MAGIC_BYTES = 8;
+
+    // a value, either in the mapped file or in RAM
+    class StoredValue {
+    public:
+        StoredValue() : mapped(nullptr), size(0), version(0)
+        {
+        }
+
+        const char* data() const {
+            return mapped ? mapped : owned.data();
+        }
+
+        const char* mapped;
+        size_t size;
+        std::string owned;
+
+        // bumped each time the key is set, so compaction can tell whether it's changed
+        uint64_t version;
+    };
+
+    // a commit waiting for its writes to be on disk
+    class QueuedCommit {
+    public:
+        QueuedCommit(const Batch& inBatch, std::vector<std::string>& inNewSets, std::vector<std::string>& inDroppedSets) :
+            batch(inBatch),
+            newSets(inNewSets),
+            droppedSets(inDroppedSets),
+            done(false)
+        {
+        }
+
+        const Batch& batch;
+        std::vector<std::string>& newSets;
+        std::vector<std::string>& droppedSets;
+
+        // whether somebody wrote it (or failed to), and if they failed, why
+        bool done;
+        std::string error;
+    };
+
+    class Mapping {
+    public:
+        Mapping(int fd, size_t inSize) : data(nullptr), size(inSize) {
+            if (!size) {
+                return;
+            }
+
+            void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+
+            if (mapped == MAP_FAILED) {
+                throw std::runtime_error(std::string("Couldn't map the persistence log: ") + strerror(errno));
+            }
+
+            data = (const char*)mapped;
+        }
+
+        ~Mapping() {
+            if (data) {
+                munmap((void*)data, size);
+            }
+        }
+
+        const char* data;
+        size_t size;
+    };
+
+    static uint32_t checksum(const char* data, size_t size, uint32_t hash = 2166136261u) {
+        // FNV-1a. We only need to notice torn writes, not tampering.
+        for (size_t k = 0; k < size; k++) {
+            hash ^= (uint8_t)data[k];
+            hash *= 16777619u;
+        }
+
+        return hash;
+    }
+
+    static void appendInt(std::string& out, uint64_t value, size_t bytes) {
+        for (size_t k = 0; k < bytes; k++) {
+            out.push_back((char)((value >> (8 * k)) & 0xFF));
+        }
+    }
+
+    static uint64_t readInt(const char* data, size_t bytes) {
+        uint64_t res = 0;
+
+        for (size_t k = 0; k < bytes; k++) {
+            res |= ((uint64_t)(uint8_t)data[k]) << (8 * k);
+        }
+
+        return res;
+    }
+
+    static void appendBytes(std::string& out, const char* data, size_t size) {
+        appendInt(out, size, 8);
+        out.append(data, size);
+    }
+
+    static void appendRecord(std::string& out, const char* ops, size_t size) {
+        appendInt(out, size, 8);
+        appendInt(out, checksum(ops, size), 4);
+        out.append(ops, size);
+    }
+
+    static void encodeValue(std::string& out, int op, const std::string& key, const std::string* value) {
+        out.push_back((char)op);
+        appendBytes(out, key.data(), key.size());
+
+        if (value) {
+            appendBytes(out, value->data(), value->size());
+        }
+    }
+
+    static void encodeMembers(std::string& out, int op, const std::string& key, const std::vector<std::string>& members) {
+        out.push_back((char)op);
+        appendBytes(out, key.data(), key.size());
+        appendInt(out, members.size(), 8);
+
+        for (const auto& member: members) {
+            appendBytes(out, member.data(), member.size());
+        }
+    }
+
+    // set 'key' to a value, which is in the mapping if 'mapped' isn't null
+    void setValue(const std::string& key, const char* mapped, const char* data, size_t size) {
+        auto setIt = mSets.find(key);
+        if (setIt != mSets.end()) {
+            dropSet(setIt);
+        }
+
+        auto it = mValues.find(key);
+
+        if (it == mValues.end()) {
+            it = mValues.insert(std::make_pair(key, StoredValue())).first;
+            mLiveBytes += key.size();
+        } else {
+            mLiveBytes -= it->second.size;
+        }
+
+        StoredValue& stored = it->second;
+
+        stored.size = size;
+        stored.mapped = mapped;
+        stored.version = ++mValueVersion;
+
+        if (mapped) {
+            std::string().swap(stored.owned);
+        } else {
+            stored.owned.assign(data, size);
+        }
+
+        mLiveBytes += size;
+    }
+
+    // like Redis's DEL, this drops a set held in 'key' too
+    void deleteValue(const std::string& key) {
+        auto it = mValues.find(key);
+
+        if (it != mValues.end()) {
+            mLiveBytes -= key.size() + it->second.size;
+            mValues.erase(it);
+        }
+
+        auto setIt = mSets.find(key);
+        if (setIt != mSets.end()) {
+            dropSet(setIt);
+        }
+    }
+
+    void dropSet(std::unordered_map<std::string, std::unordered_set<std::string> >::iterator it) {
+        mLiveBytes -= it->first.size();
+
+        for (const auto& member: it->second) {
+            mLiveBytes -= member.size();
+        }
+
+        mSets.erase(it);
+    }
+
+    // returns whether the set was empty before
+    template<class members_type>
+    bool addMembers(const std::string& key, const members_type& members) {
+        auto it = mSets.find(key);
+        bool wasEmpty = it == mSets.end();
+
+        if (wasEmpty) {
+            it = mSets.insert(std::make_pair(key, std::unordered_set<std::string>())).first;
+            mLiveBytes += key.size();
+        }
+
+        for (const auto& member: members) {
+            if (it->second.insert(member).second) {
+                mLiveBytes += member.size();
+            }
+        }
+
+        return wasEmpty;
+    }
+
+    // returns whether the set is now empty
+    template<class members_type>
+    bool removeMembers(const std::string& key, const members_type& members) {
+        auto it = mSets.find(key);
+
+        if (it == mSets.end()) {
+            return false;
+        }
+
+        for (const auto& member: members) {
+            if (it->second.erase(member)) {
+                mLiveBytes -= member.size();
+            }
+        }
+
+        if (it->second.empty()) {
+            dropSet(it);
+            return true;
+        }
+
+        return false;
+    }
+
+    /*****
+    read the file into our index, pointing at values in the mapping. Drops a torn
+    record at the end, if there is one.
+    *****/
+    void load() {
+        struct stat st;
+        if (fstat(mFd, &st) != 0) {
+            throw std::runtime_error("Couldn't stat " + mPath + ": " + strerror(errno));
+        }
+
+        if (st.st_size == 0) {
+            writeAt(mFd, magic(), MAGIC_BYTES, 0);
+            syncFile();
+            syncDirectory();
+            mFileSize = MAGIC_BYTES;
+            mMapping.reset(new Mapping(mFd, 0));
+            return;
+        }
+
+        mMapping.reset(new Mapping(mFd, st.st_size));
+
+        const char* data = mMapping->data;
+        size_t size = mMapping->size;
+
+        if (size < MAGIC_BYTES || memcmp(data, magic(), MAGIC_BYTES) != 0) {
+            throw std::runtime_error(mPath + " isn't an object_database persistence log.");
+        }
+
+        size_t pos = MAGIC_BYTES;
+
+        while (pos + RECORD_HEADER_BYTES <= size) {
+            uint64_t length = readInt(data + pos, 8);
+            uint32_t sum = readInt(data + pos + 8, 4);
+
+            if (length > size - pos - RECORD_HEADER_BYTES) {
+                break;
+            }
+
+            const char* ops = data + pos + RECORD_HEADER_BYTES;
+
+            if (checksum(ops, length) != sum) {
+                break;
+            }
+
+            replay(ops, length);
+
+            pos += RECORD_HEADER_BYTES + length;
+        }
+
+        if (pos < size) {
+            // a commit that didn't make it to disk whole. It was never acknowledged.
+            if (ftruncate(mFd, pos) != 0) {
+                throw std::runtime_error("Couldn't truncate " + mPath + ": " + strerror(errno));
+            }
+
+            syncFile();
+        }
+
+        mFileSize = pos;
+    }
+
+    void replay(const char* ops, size_t size) {
+        size_t pos = 0;
+
+        auto readBytes = [&](const char*& outData, size_t& outSize) {
+            if (size - pos < 8) {
+                throw std::runtime_error("Corrupt record in " + mPath);
+            }
+
+            outSize = readInt(ops + pos, 8);
+            pos += 8;
+
+            if (size - pos < outSize) {
+                throw std::runtime_error("Corrupt record in " + mPath);
+            }
+
+            outData = ops + pos;
+            pos += outSize;
+        };
+
+        while (pos < size) {
+            int op = ops[pos++];
+
+            const char* keyData;
+            size_t keySize;
+            readBytes(keyData, keySize);
+
+            std::string key(keyData, keySize);
+
+            if (op == OP_SET) {
+                const char* valueData;
+                size_t valueSize;
+                readBytes(valueData, valueSize);
+
+                setValue(key, valueData, valueData, valueSize);
+            } else if (op == OP_DELETE) {
+                deleteValue(key);
+            } else if (op == OP_ADD || op == OP_REMOVE) {
+                if (size - pos < 8) {
+                    throw std::runtime_error("Corrupt record in " + mPath);
+                }
+
+                uint64_t count = readInt(ops + pos, 8);
+                pos += 8;
+
+                std::vector<std::string> members;
+
+                for (uint64_t k = 0; k < count; k++) {
+                    const char* memberData;
+                    size_t memberSize;
+                    readBytes(memberData, memberSize);
+
+                    members.push_back(std::string(memberData, memberSize));
+                }
+
+                if (op == OP_ADD) {
+                    addMembers(key, members);
+                } else {
+                    removeMembers(key, members);
+                }
+            } else {
+                throw std::runtime_error("Corrupt record in " + mPath);
+            }
+        }
+    }
+
+    // apply one commit's writes to the index, in the order 'commit' encoded them
+    void applyWhileLocked(QueuedCommit& queued) {
+        const Batch& batch = queued.batch;
+
+        for (const auto& keyAndValue: batch.values) {
+            setValue(keyAndValue.first, nullptr, keyAndValue.second.data(), keyAndValue.second.size());
+        }
+
+        for (const auto& key: batch.deletes) {
+            deleteValue(key);
+        }
+
+        for (const auto& keyAndMembers: batch.adds) {
+            if (!keyAndMembers.second.empty() && addMembers(keyAndMembers.first, keyAndMembers.second)) {
+                queued.newSets.push_back(keyAndMembers.first);
+            }
+        }
+
+        for (const auto& keyAndMembers: batch.removes) {
+            if (!keyAndMembers.second.empty() && removeMembers(keyAndMembers.first, keyAndMembers.second)) {
+                queued.droppedSets.push_back(keyAndMembers.first);
+            }
+        }
+    }
+
+    // 'queued' has been written or has failed, so its values are no longer on their way
+    void forgetQueuedValuesWhileLocked(const QueuedCommit& queued) {
+        for (const auto& keyAndValue: queued.batch.values) {
+            auto it = mQueuedValueKeys.find(keyAndValue.first);
+
+            if (!--it->second) {
+                mQueuedValueKeys.erase(it);
+            }
+        }
+    }
+
+    // write out everything queued, which includes 'mine' unless somebody else already did
+    void flushThrough(QueuedCommit& mine) {
+        // while somebody else is writing, we queue up here, and usually find that
+        // they wrote our commit too
+        std::lock_guard<std::mutex> writeLock(mWriteMutex);
+
+        std::string toWrite;
+        std::vector<QueuedCommit*> commits;
+        off_t offset;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            if (mine.done) {
+                if (mine.error.size()) {
+                    throw std::runtime_error(mine.error);
+                }
+
+                return;
+            }
+
+            toWrite.swap(mPending);
+            commits.swap(mQueue);
+            offset = mFileSize;
+        }
+
+        try {
+            writeAt(toWrite.data(), toWrite.size(), offset);
+            syncFile();
+        } catch(std::exception& e) {
+            // none of these commits happened. Cut off whatever part of them we wrote,
+            // so that a restart doesn't find a whole one there. The next commit writes
+            // over it anyway.
+            if (ftruncate(mFd, offset) != 0) {
+                std::cerr << "Warning: failed to truncate " << mPath << " after a failed commit" << std::endl;
+            }
+
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            for (QueuedCommit* queued: commits) {
+                forgetQueuedValuesWhileLocked(*queued);
+                queued->done = true;
+                queued->error = e.what();
+            }
+
+            throw;
+        }
+
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        mFileSize += toWrite.size();
+
+        for (QueuedCommit* queued: commits) {
+            applyWhileLocked(*queued);
+            forgetQueuedValuesWhileLocked(*queued);
+            queued->done = true;
+        }
+
+        if (!mCompacting && mFileSize > mCompactionMinBytes && mFileSize > 2 * mLiveBytes) {
+            startCompactionWhileLocked();
+        }
+    }
+
+    /*****
+    compact on a thread of our own, so no commit waits for it. If it fails (say
+    the disk is full) the log is still good, and we try again after a later commit.
+    *****/
+    void startCompactionWhileLocked() {
+        // the last compaction clears 'mCompacting' as the last thing it does, so
+        // this doesn't wait on anything
+        if (mCompactionThread.joinable()) {
+            mCompactionThread.join();
+        }
+
+        mCompacting = true;
+
+        mCompactionThread = std::thread([this]() {
+            try {
+                compact();
+            } catch(std::exception& e) {
+                std::cerr << "Warning: failed to compact " << mPath << ": " << e.what() << std::endl;
+            }
+
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCompacting = false;
+        });
+    }
+
+    // write 'values' and 'sets' to 'fd' as a new log, and return how big it is
+    int64_t writeSnapshot(
+            int fd,
+            const std::unordered_map<std::string, StoredValue>& values,
+            const std::unordered_map<std::string, std::unordered_set<std::string> >& sets,
+            std::vector<std::pair<const std::string*, std::pair<uint64_t, size_t> > >& outOffsets
+            ) {
+        std::string buffer(magic(), MAGIC_BYTES);
+
+        // leave room for the record header, which we fill in at the end
+        buffer.append(RECORD_HEADER_BYTES, '\0');
+
+        off_t written = 0;
+        uint32_t sum = checksum(nullptr, 0);
+        uint64_t opBytes = 0;
+
+        auto flush = [&]() {
+            if (written == 0) {
+                // the part after the magic and header is checksummed
+                sum = checksum(buffer.data() + MAGIC_BYTES + RECORD_HEADER_BYTES, buffer.size() - MAGIC_BYTES - RECORD_HEADER_BYTES, sum);
+                opBytes += buffer.size() - MAGIC_BYTES - RECORD_HEADER_BYTES;
+            } else {
+                sum = checksum(buffer.data(), buffer.size(), sum);
+                opBytes += buffer.size();
+            }
+
+            writeAt(fd, buffer.data(), buffer.size(), written);
+            written += buffer.size();
+            buffer.clear();
+        };
+
+        for (const auto& keyAndValue: values) {
+            buffer.push_back((char)OP_SET);
+            appendBytes(buffer, keyAndValue.first.data(), keyAndValue.first.size());
+            appendInt(buffer, keyAndValue.second.size, 8);
+
+            outOffsets.push_back(
+                std::make_pair(&keyAndValue.first, std::make_pair(keyAndValue.second.version, written + buffer.size()))
+            );
+
+            buffer.append(keyAndValue.second.data(), keyAndValue.second.size);
+
+            if (buffer.size() > (1 << 20)) {
+                flush();
+            }
+        }
+
+        for (const auto& keyAndMembers: sets) {
+            buffer.push_back((char)OP_ADD);
+            appendBytes(buffer, keyAndMembers.first.data(), keyAndMembers.first.size());
+            appendInt(buffer, keyAndMembers.second.size(), 8);
+
+            for (const auto& member: keyAndMembers.second) {
+                appendBytes(buffer, member.data(), member.size());
+            }
+
+            if (buffer.size() > (1 << 20)) {
+                flush();
+            }
+        }
+
+        flush();
+
+        std::string header;
+        appendInt(header, opBytes, 8);
+        appendInt(header, sum, 4);
+        writeAt(fd, header.data(), header.size(), MAGIC_BYTES);
+
+        return written;
+    }
+
+    /*****
+    copy the records in '[ioFrom, to)' of our file to 'ioWritten' in 'fd', and move
+    both along. Returns whether there was anything to copy.
+    *****/
+    bool copyLogTail(int fd, int64_t& ioFrom, int64_t to, int64_t& ioWritten) {
+        if (ioFrom >= to) {
+            return false;
+        }
+
+        std::string buffer;
+
+        while (ioFrom < to) {
+            buffer.resize(std::min<int64_t>(to - ioFrom, 1 << 20));
+
+            ssize_t bytesRead = pread(mFd, &buffer[0], buffer.size(), ioFrom);
+
+            if (bytesRead < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                throw std::runtime_error("Couldn't read " + mPath + ": " + strerror(errno));
+            }
+
+            if (bytesRead == 0) {
+                throw std::runtime_error(mPath + " is shorter than we wrote it.");
+            }
+
+            writeAt(fd, buffer.data(), bytesRead, ioWritten);
+
+            ioFrom += bytesRead;
+            ioWritten += bytesRead;
+        }
+
+        return true;
+    }
+
+    void syncCompactedFile(int fd, const std::string& path) {
+        if (mSync && fdatasync(fd) != 0) {
+            throw std::runtime_error("Couldn't sync " + path + ": " + strerror(errno));
+        }
+    }
+
+    // write a batch of commits to our file
+    void writeAt(const char* data, size_t size, off_t offset) {
+        if (mWritesToFail > 0) {
+            mWritesToFail--;
+            throw std::runtime_error("Failed writing the persistence log: failure injected for testing");
+        }
+
+        writeAt(mFd, data, size, offset);
+    }
+
+    void writeAt(int fd, const char* data, size_t size, off_t offset) {
+        while (size) {
+            ssize_t written = pwrite(fd, data, size, offset);
+
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                throw std::runtime_error(std::string("Failed writing the persistence log: ") + strerror(errno));
+            }
+
+            data += written;
+            size -= written;
+            offset += written;
+        }
+    }
+
+    void syncFile() {
+        if (mSync && fdatasync(mFd) != 0) {
+            throw std::runtime_error("Couldn't sync " + mPath + ": " + strerror(errno));
+        }
+    }
+
+    // make a file we created or renamed durable
+    void syncDirectory() {
+        if (!mSync) {
+            return;
+        }
+
+        size_t slash = mPath.rfind('/');
+        std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : mPath.substr(0, slash);
+
+        int fd = ::open(directory.c_str(), O_RDONLY);
+
+        if (fd >= 0) {
+            fsync(fd);
+            ::close(fd);
+        }
+    }
+
+    std::string mPath;
+
+    bool mSync;
+
+    int64_t mCompactionMinBytes;
+
+    int mFd;
+
+    // what we've read from, or compacted, the file. Compaction holds on to it
+    // while it copies values out of it.
+    std::shared_ptr<Mapping> mMapping;
+
+    // how much of the file is good. We append here.
+    int64_t mFileSize;
+
+    int64_t mLiveBytes;
+
+    std::unordered_map<std::string, StoredValue> mValues;
+
+    std::unordered_map<std::string, std::unordered_set<std::string> > mSets;
+
+    // the last 'version' we gave a StoredValue
+    uint64_t mValueVersion;
+
+    // the records of the commits in 'mQueue', which aren't written or in the index yet
+    std::string mPending;
+
+    std::vector<QueuedCommit*> mQueue;
+
+    // how many queued or in-flight commits set each key, so 'commit' can refuse
+    // to add set members to a key that's about to hold a value
+    std::unordered_map<std::string, int64_t> mQueuedValueKeys;
+
+    // whether our compaction thread is running
+    bool mCompacting;
+
+    // guards everything above
+    std::mutex mMutex;
+
+    // held by whoever is writing commits to the file, and by compaction while it
+    // swaps in the new file
+    std::mutex mWriteMutex;
+
+    // held by whoever is compacting
+    std::mutex mCompactionMutex;
+
+    std::thread mCompactionThread;
+
+    std::atomic<int64_t> mWritesToFail;
+};
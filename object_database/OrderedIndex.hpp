@@ -0,0 +1,200 @@
+/******************************************************************************
+   Copyright 2017-2019 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <typed_python/Type.hpp>
+#include <typed_python/Instance.hpp>
+#include <typed_python/SerializationContext.hpp>
+#include <typed_python/DeserializationBuffer.hpp>
+#include "Common.hpp"
+
+/*************
+
+IndexValueRange describes a (possibly open-ended) interval of values of an
+index's type. Bounds are compared using the type's own ordering.
+
+*************/
+
+class IndexValueRange {
+public:
+    IndexValueRange() :
+            hasLo(false),
+            hasHi(false),
+            includeLo(true),
+            includeHi(false)
+    {
+    }
+
+    //is the value pointed to by 'data' (of type 't') above our lower bound?
+    bool aboveLo(Type* t, instance_ptr data) const {
+        if (!hasLo) {
+            return true;
+        }
+
+        return t->cmp(data, lo.data(), includeLo ? Py_GE : Py_GT, false);
+    }
+
+    //is the value pointed to by 'data' (of type 't') below our upper bound?
+    bool belowHi(Type* t, instance_ptr data) const {
+        if (!hasHi) {
+            return true;
+        }
+
+        return t->cmp(data, hi.data(), includeHi ? Py_LE : Py_LT, false);
+    }
+
+    bool contains(Type* t, instance_ptr data) const {
+        return aboveLo(t, data) && belowHi(t, data);
+    }
+
+    Instance lo;
+    Instance hi;
+    bool hasLo;
+    bool hasHi;
+    bool includeLo;
+    bool includeHi;
+};
+
+/*************
+
+OrderedIndex keeps the distinct values of one index field sorted by the
+index type's ordering, so we can find every index value in a range without
+looking at all of them.
+
+Index values are just serialized bytes, so we have to decode them to order
+them. We do that lazily, when someone asks for a range, rather than while
+we're applying incoming transactions.
+
+*************/
+
+class OrderedIndex {
+    class InstanceLess {
+    public:
+        InstanceLess(Type* t) : m_type(t)
+        {
+        }
+
+        bool operator()(const Instance& left, const Instance& right) const {
+            return m_type->cmp(left.data(), right.data(), Py_LT, false);
+        }
+
+    private:
+        Type* m_type;
+    };
+
+    typedef std::multimap<Instance, index_value, InstanceLess> sorted_type;
+
+public:
+    OrderedIndex(Type* indexType) :
+            m_index_type(indexType),
+            m_sorted(InstanceLess(indexType))
+    {
+    }
+
+    Type* getIndexType() const {
+        return m_index_type;
+    }
+
+    //a new value appeared in the index
+    void valueAdded(const index_value& value) {
+        if (m_decoded.find(value) == m_decoded.end()) {
+            m_pending.insert(value);
+        }
+    }
+
+    //a value is no longer present in the index
+    void valueRemoved(const index_value& value) {
+        m_pending.erase(value);
+
+        auto it = m_decoded.find(value);
+        if (it != m_decoded.end()) {
+            m_sorted.erase(it->second);
+            m_decoded.erase(it);
+        }
+    }
+
+    //decode an index value, which is the serialization of a single value of 'indexType'
+    static Instance decode(Type* indexType, const SerializationContext& ctx, const index_value& value) {
+        DeserializationBuffer buffer((uint8_t*)&value[0], value.size(), ctx);
+
+        return Instance(indexType, [&](instance_ptr dataPtr) {
+            auto fieldAndWireType = buffer.readFieldNumberAndWireType();
+
+            indexType->deserialize(dataPtr, buffer, fieldAndWireType.second);
+        });
+    }
+
+    //call 'visitor' with each index value in 'range', in order, until it returns false.
+    template<class visitor_type>
+    void visitRange(const SerializationContext& ctx, const IndexValueRange& range, const visitor_type& visitor) {
+        decodePending(ctx);
+
+        auto it = range.hasLo ? m_sorted.lower_bound(range.lo) : m_sorted.begin();
+
+        for (; it != m_sorted.end(); ++it) {
+            if (!range.aboveLo(m_index_type, it->first.data())) {
+                continue;
+            }
+
+            if (!range.belowHi(m_index_type, it->first.data())) {
+                return;
+            }
+
+            if (!visitor(it->second)) {
+                return;
+            }
+        }
+    }
+
+    size_t size() const {
+        return m_decoded.size() + m_pending.size();
+    }
+
+private:
+    void decodePending(const SerializationContext& ctx) {
+        if (!m_pending.size()) {
+            return;
+        }
+
+        std::vector<index_value> toDecode(m_pending.begin(), m_pending.end());
+        m_pending.clear();
+
+        for (auto& value: toDecode) {
+            m_decoded.insert(
+                std::make_pair(
+                    value,
+                    m_sorted.insert(std::make_pair(decode(m_index_type, ctx, value), value))
+                )
+            );
+        }
+    }
+
+    Type* m_index_type;
+
+    //the decoded values, in order
+    sorted_type m_sorted;
+
+    //for each decoded value, where it lives in m_sorted
+    std::map<index_value, sorted_type::iterator> m_decoded;
+
+    //values we haven't decoded yet
+    std::set<index_value> m_pending;
+};
@@ -0,0 +1,255 @@
+/******************************************************************************
+   Copyright 2017-2019 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/*************
+
+PayloadSlab holds many small byte strings packed into large chunks. Each
+string is identified by a 64 bit handle (its chunk, and its offset within
+the chunk). Strings are never moved, and each chunk keeps a count of the
+bytes in it that are still in use, so a chunk whose strings have all been
+released goes straight back to malloc. Large strings get a chunk of their
+own. Chunks start small and grow with the slab, so a field holding a few
+small values doesn't cost a full-sized chunk.
+
+Chunks that are only partly in use stay around until the owner rewrites
+the live strings into a fresh slab, which it should do when
+'garbageBytes()' gets large relative to 'liveBytes()'.
+
+A string that already lives in an immutable refcounted buffer can be
+'adopt'ed instead of copied. It gets a chunk of its own that points into the
+buffer and holds a reference to it until the string is released.
+
+*************/
+
+class PayloadSlab {
+    class Chunk {
+    public:
+        uint8_t* data;
+        size_t capacity;
+        size_t used;
+        size_t live;
+
+        //if set, 'data' belongs to this and we didn't allocate it
+        std::shared_ptr<const void> owner;
+    };
+
+public:
+    enum { min_chunk_size = 4 * 1024 };
+    enum { max_chunk_size = 256 * 1024 };
+
+    //strings at least this big get a chunk of their own
+    enum { dedicated_chunk_threshold = max_chunk_size / 4 };
+
+    PayloadSlab() :
+            m_current_chunk(-1),
+            m_live_bytes(0),
+            m_garbage_bytes(0),
+            m_adopted_bytes(0)
+    {
+    }
+
+    ~PayloadSlab() {
+        for (auto& chunk: m_chunks) {
+            if (!chunk.owner) {
+                free(chunk.data);
+            }
+        }
+    }
+
+    PayloadSlab(const PayloadSlab&) = delete;
+    PayloadSlab& operator=(const PayloadSlab&) = delete;
+
+    //copy 'bytes' into the slab and return a handle to them.
+    uint64_t append(const uint8_t* bytes, size_t count) {
+        if (!count) {
+            return 0;
+        }
+
+        size_t chunkIx;
+
+        if (count >= dedicated_chunk_threshold) {
+            chunkIx = newChunk(count);
+        } else {
+            if (m_current_chunk < 0 || m_chunks[m_current_chunk].used + count > m_chunks[m_current_chunk].capacity) {
+                size_t capacity = std::min<size_t>(max_chunk_size, std::max<size_t>(min_chunk_size, m_live_bytes));
+                m_current_chunk = newChunk(std::max(capacity, count));
+            }
+            chunkIx = m_current_chunk;
+        }
+
+        Chunk& chunk = m_chunks[chunkIx];
+
+        uint64_t handle = ((uint64_t)chunkIx << 32) + chunk.used;
+
+        memcpy(chunk.data + chunk.used, bytes, count);
+        chunk.used += count;
+        chunk.live += count;
+        m_live_bytes += count;
+
+        return handle;
+    }
+
+    //refer to the 'count' bytes at 'bytes' without copying them. They must not change
+    //as long as 'owner' is alive, and we keep it alive until they're released.
+    uint64_t adopt(std::shared_ptr<const void> owner, const uint8_t* bytes, size_t count) {
+        if (!count) {
+            return 0;
+        }
+
+        Chunk chunk;
+        chunk.data = const_cast<uint8_t*>(bytes);
+        chunk.capacity = count;
+        chunk.used = count;
+        chunk.live = count;
+        chunk.owner = std::move(owner);
+
+        m_adopted_bytes += count;
+
+        return (uint64_t)addChunk(std::move(chunk)) << 32;
+    }
+
+    //copy the 'count' bytes at 'handle' in 'other' into this slab. Adopted bytes
+    //stay adopted, so this never copies them.
+    uint64_t appendFrom(const PayloadSlab& other, uint64_t handle, size_t count) {
+        const Chunk& chunk = other.m_chunks[handle >> 32];
+
+        if (chunk.owner) {
+            return adopt(chunk.owner, other.data(handle), count);
+        }
+
+        return append(other.data(handle), count);
+    }
+
+    const uint8_t* data(uint64_t handle) const {
+        return m_chunks[handle >> 32].data + (handle & 0xFFFFFFFF);
+    }
+
+    //mark the 'count' bytes at 'handle' as no longer needed.
+    void release(uint64_t handle, size_t count) {
+        if (!count) {
+            return;
+        }
+
+        size_t chunkIx = handle >> 32;
+        Chunk& chunk = m_chunks[chunkIx];
+
+        chunk.live -= count;
+
+        if (chunk.owner) {
+            //adopted chunks only ever hold one string
+            m_adopted_bytes -= count;
+            chunk.owner.reset();
+        } else {
+            m_live_bytes -= count;
+
+            if (chunk.live) {
+                m_garbage_bytes += count;
+                return;
+            }
+
+            //nothing in this chunk is in use any more.
+            m_garbage_bytes -= chunk.used - count;
+
+            free(chunk.data);
+        }
+
+        chunk.data = nullptr;
+        chunk.capacity = 0;
+        chunk.used = 0;
+
+        if ((long)chunkIx == m_current_chunk) {
+            m_current_chunk = -1;
+        }
+
+        m_free_chunk_slots.push_back(chunkIx);
+    }
+
+    void swap(PayloadSlab& other) {
+        std::swap(m_chunks, other.m_chunks);
+        std::swap(m_free_chunk_slots, other.m_free_chunk_slots);
+        std::swap(m_current_chunk, other.m_current_chunk);
+        std::swap(m_live_bytes, other.m_live_bytes);
+        std::swap(m_garbage_bytes, other.m_garbage_bytes);
+        std::swap(m_adopted_bytes, other.m_adopted_bytes);
+    }
+
+    //bytes of live strings we copied into our own chunks
+    size_t liveBytes() const {
+        return m_live_bytes;
+    }
+
+    //bytes of live strings we adopted rather than copied
+    size_t adoptedBytes() const {
+        return m_adopted_bytes;
+    }
+
+    //bytes of released strings sitting in chunks that are still partly in use
+    size_t garbageBytes() const {
+        return m_garbage_bytes;
+    }
+
+private:
+    size_t newChunk(size_t capacity) {
+        Chunk chunk;
+        chunk.data = (uint8_t*)malloc(capacity);
+        chunk.capacity = capacity;
+        chunk.used = 0;
+        chunk.live = 0;
+
+        if (!chunk.data) {
+            throw std::bad_alloc();
+        }
+
+        return addChunk(std::move(chunk));
+    }
+
+    size_t addChunk(Chunk chunk) {
+        if (m_free_chunk_slots.size()) {
+            size_t res = m_free_chunk_slots.back();
+            m_free_chunk_slots.pop_back();
+            m_chunks[res] = std::move(chunk);
+            return res;
+        }
+
+        m_chunks.push_back(std::move(chunk));
+        return m_chunks.size() - 1;
+    }
+
+    std::vector<Chunk> m_chunks;
+
+    //indices in m_chunks whose chunk has been freed
+    std::vector<size_t> m_free_chunk_slots;
+
+    //the chunk we're appending small strings to, or -1
+    long m_current_chunk;
+
+    size_t m_live_bytes;
+
+    size_t m_garbage_bytes;
+
+    size_t m_adopted_bytes;
+};
@@ -0,0 +1,364 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "DatabaseConnectionPumpLoop.hpp"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+/***********
+PumpLoopEngine multiplexes the sockets of many DatabaseConnectionPumpLoops
+over a small, fixed pool of threads, instead of giving each connection its
+own 'writeLoop' thread blocked in 'select'.
+
+Each worker thread owns an epoll set and an eventfd. A pump loop is assigned
+to one worker for its whole life. We pump it whenever its socket is ready,
+when it wakes us because it has something to send, and when its heartbeat is
+due. Once a pump loop is closed, its worker drops it.
+
+This is only available on linux. Elsewhere 'isSupported' is false and
+callers should run 'writeLoop' on a thread of their own.
+***********/
+
+#ifdef __linux__
+
+class PumpLoopEngine {
+    class Worker {
+    public:
+        Worker() : mEpollFD(-1), mWakeFD(-1)
+        {
+            mEpollFD = epoll_create1(EPOLL_CLOEXEC);
+            if (mEpollFD == -1) {
+                throw std::runtime_error("Failed to create an epoll fd.");
+            }
+
+            mWakeFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (mWakeFD == -1) {
+                throw std::runtime_error("Failed to create an eventfd.");
+            }
+
+            epoll_event event;
+            event.events = EPOLLIN;
+            event.data.ptr = nullptr;
+
+            if (epoll_ctl(mEpollFD, EPOLL_CTL_ADD, mWakeFD, &event) == -1) {
+                throw std::runtime_error("Failed to add our eventfd to the epoll set.");
+            }
+
+            std::thread([this]() { run(); }).detach();
+        }
+
+        void attach(std::shared_ptr<DatabaseConnectionPumpLoop> loop) {
+            std::unique_lock<std::mutex> lock(mMutex);
+
+            mToAttach.push_back(loop);
+            wakeLocked();
+        }
+
+        // 'loop' has something for us to do. It might not be ours any more.
+        void wake(DatabaseConnectionPumpLoop* loop) {
+            std::unique_lock<std::mutex> lock(mMutex);
+
+            if (mToPump.insert(loop).second) {
+                wakeLocked();
+            }
+        }
+
+        // how many loops we have, including ones we haven't picked up yet
+        size_t loopCount() {
+            std::unique_lock<std::mutex> lock(mMutex);
+
+            return mLoopCount + mToAttach.size();
+        }
+
+    private:
+        class LoopState {
+        public:
+            std::shared_ptr<DatabaseConnectionPumpLoop> loop;
+
+            // the epoll events we're currently registered for
+            uint32_t events;
+        };
+
+        void wakeLocked() {
+            uint64_t one = 1;
+            if (::write(mWakeFD, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN) {
+                std::cerr << "Warning: failed to write to PumpLoopEngine's eventfd" << std::endl;
+            }
+        }
+
+        void run() {
+            const int maxEvents = 256;
+            epoll_event events[maxEvents];
+
+            std::vector<std::shared_ptr<DatabaseConnectionPumpLoop> > toAttach;
+            std::set<DatabaseConnectionPumpLoop*> toPump;
+
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(mMutex);
+
+                    std::swap(toAttach, mToAttach);
+                    std::swap(toPump, mToPump);
+                }
+
+                for (auto& loop: toAttach) {
+                    attachNow(loop);
+                }
+                toAttach.clear();
+
+                // pump anything that was waiting on a heartbeat or on data SSL already buffered
+                int timeoutMs = -1;
+
+                for (auto& loopAndState: mLoops) {
+                    DatabaseConnectionPumpLoop* loop = loopAndState.first;
+
+                    if (loop->hasBufferedReadData()) {
+                        toPump.insert(loop);
+                    }
+
+                    double untilHeartbeat = loop->secondsUntilHeartbeat();
+
+                    if (untilHeartbeat == 0) {
+                        toPump.insert(loop);
+                    } else if (untilHeartbeat > 0) {
+                        int ms = std::ceil(untilHeartbeat * 1000);
+                        timeoutMs = timeoutMs == -1 ? ms : std::min(timeoutMs, ms);
+                    }
+                }
+
+                for (auto loop: toPump) {
+                    pumpNow(loop);
+                }
+
+                if (toPump.size()) {
+                    // pumping may have queued more work. check for it without sleeping.
+                    timeoutMs = 0;
+                }
+                toPump.clear();
+
+                int eventCount = epoll_wait(mEpollFD, events, maxEvents, timeoutMs);
+
+                if (eventCount == -1) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+
+                    std::cerr << "PumpLoopEngine: epoll_wait failed with errno " << errno << std::endl;
+                    continue;
+                }
+
+                for (long k = 0; k < eventCount; k++) {
+                    if (!events[k].data.ptr) {
+                        uint64_t count;
+                        if (::read(mWakeFD, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                            std::cerr << "Warning: failed to read from the PumpLoopEngine wake fd" << std::endl;
+                        }
+                    } else {
+                        toPump.insert((DatabaseConnectionPumpLoop*)events[k].data.ptr);
+                    }
+                }
+
+                for (auto loop: toPump) {
+                    pumpNow(loop);
+                }
+                toPump.clear();
+            }
+        }
+
+        void attachNow(std::shared_ptr<DatabaseConnectionPumpLoop> loop) {
+            LoopState state;
+            state.loop = loop;
+            state.events = EPOLLIN;
+
+            epoll_event event;
+            event.events = state.events;
+            event.data.ptr = loop.get();
+
+            if (epoll_ctl(mEpollFD, EPOLL_CTL_ADD, loop->socketFD(), &event) == -1) {
+                std::cerr << "PumpLoopEngine: failed to add a socket to the epoll set." << std::endl;
+                loop->close("failed to register with the PumpLoopEngine");
+                loop->ensureSslSocketClosed();
+                return;
+            }
+
+            mLoops[loop.get()] = state;
+
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mLoopCount = mLoops.size();
+            }
+
+            // we'll pump it right away, in case it had messages queued before it was attached
+            pumpNow(loop.get());
+        }
+
+        void pumpNow(DatabaseConnectionPumpLoop* loop) {
+            auto it = mLoops.find(loop);
+
+            if (it == mLoops.end()) {
+                // we already dropped it
+                return;
+            }
+
+            try {
+                loop->pump();
+
+                if (loop->isClosed()) {
+                    detachNow(it);
+                    return;
+                }
+
+                uint32_t events = EPOLLIN | (loop->wantsToWrite() ? EPOLLOUT : 0);
+
+                if (events != it->second.events) {
+                    epoll_event event;
+                    event.events = events;
+                    event.data.ptr = loop;
+
+                    if (epoll_ctl(mEpollFD, EPOLL_CTL_MOD, loop->socketFD(), &event) == -1) {
+                        throw std::runtime_error("Failed to update our epoll registration.");
+                    }
+
+                    it->second.events = events;
+                }
+            } catch(std::exception& e) {
+                std::cerr << "PumpLoopEngine: pump loop threw " << e.what() << std::endl;
+                loop->close("exception in PumpLoopEngine");
+                detachNow(it);
+            } catch(...) {
+                std::cerr << "PumpLoopEngine: pump loop threw an unknown exception" << std::endl;
+                loop->close("exception in PumpLoopEngine");
+                detachNow(it);
+            }
+        }
+
+        void detachNow(std::unordered_map<DatabaseConnectionPumpLoop*, LoopState>::iterator it) {
+            std::shared_ptr<DatabaseConnectionPumpLoop> loop = it->second.loop;
+
+            // the socket may already be closed, in which case epoll already forgot about it
+            epoll_ctl(mEpollFD, EPOLL_CTL_DEL, loop->socketFD(), nullptr);
+
+            mLoops.erase(it);
+
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mLoopCount = mLoops.size();
+                mToPump.erase(loop.get());
+            }
+
+            loop->ensureSslSocketClosed();
+        }
+
+        int mEpollFD;
+
+        int mWakeFD;
+
+        // only touched by our thread
+        std::unordered_map<DatabaseConnectionPumpLoop*, LoopState> mLoops;
+
+        // everything below here is protected by mMutex
+        std::mutex mMutex;
+
+        std::vector<std::shared_ptr<DatabaseConnectionPumpLoop> > mToAttach;
+
+        std::set<DatabaseConnectionPumpLoop*> mToPump;
+
+        size_t mLoopCount = 0;
+    };
+
+public:
+    static bool isSupported() {
+        return true;
+    }
+
+    // the engine everyone shares. We never destroy it, since its threads
+    // can be running right up until the process exits.
+    static PumpLoopEngine& shared() {
+        static PumpLoopEngine* engine = new PumpLoopEngine(defaultThreadCount());
+
+        return *engine;
+    }
+
+    static size_t defaultThreadCount() {
+        return std::max<size_t>(1, std::min<size_t>(4, std::thread::hardware_concurrency() / 2));
+    }
+
+    // start pumping 'loop' on the worker with the fewest loops. From here
+    // on it doesn't need a 'writeLoop' thread.
+    void attach(std::shared_ptr<DatabaseConnectionPumpLoop> loop) {
+        Worker* best = mWorkers[0].get();
+
+        for (auto& worker: mWorkers) {
+            if (worker->loopCount() < best->loopCount()) {
+                best = worker.get();
+            }
+        }
+
+        DatabaseConnectionPumpLoop* loopPtr = loop.get();
+
+        loop->attachToEngine([best, loopPtr]() { best->wake(loopPtr); });
+
+        best->attach(loop);
+    }
+
+    size_t threadCount() const {
+        return mWorkers.size();
+    }
+
+private:
+    // our threads run forever, so we can't be destroyed. Use 'shared'.
+    explicit PumpLoopEngine(size_t threadCount) {
+        for (size_t k = 0; k < threadCount; k++) {
+            mWorkers.push_back(std::unique_ptr<Worker>(new Worker()));
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker> > mWorkers;
+};
+
+#else
+
+class PumpLoopEngine {
+public:
+    static bool isSupported() {
+        return false;
+    }
+
+    static PumpLoopEngine& shared() {
+        throw std::runtime_error("PumpLoopEngine requires epoll, which this platform doesn't have.");
+    }
+
+    void attach(std::shared_ptr<DatabaseConnectionPumpLoop> loop) {
+        throw std::runtime_error("PumpLoopEngine requires epoll, which this platform doesn't have.");
+    }
+};
+
+#endif
@@ -15,6 +15,9 @@
 ******************************************************************************/
 
 #include "PyDatabaseConnectionPumpLoop.hpp"
+#include "PumpLoopEngine.hpp"
+#include "PyDatabaseConnectionState.hpp"
+#include "PyView.hpp"
 #include "ObjectFieldId.hpp"
 #include "IndexId.hpp"
 #include "direct_types/all.hpp"
@@ -24,10 +27,21 @@
 PyMethodDef PyDatabaseConnectionPumpLoop_methods[] = {
     {"readLoop", (PyCFunction)PyDatabaseConnectionPumpLoop::readLoop, METH_VARARGS | METH_KEYWORDS, NULL},
     {"writeLoop", (PyCFunction)PyDatabaseConnectionPumpLoop::writeLoop, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"readyFD", (PyCFunction)PyDatabaseConnectionPumpLoop::readyFD, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"drain", (PyCFunction)PyDatabaseConnectionPumpLoop::drain, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"attachToEngine", (PyCFunction)PyDatabaseConnectionPumpLoop::attachToEngine, METH_VARARGS | METH_KEYWORDS, NULL},
     {"write", (PyCFunction)PyDatabaseConnectionPumpLoop::write, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"writeCommit", (PyCFunction)PyDatabaseConnectionPumpLoop::writeCommit, METH_VARARGS | METH_KEYWORDS, NULL},
     {"close", (PyCFunction)PyDatabaseConnectionPumpLoop::close, METH_VARARGS | METH_KEYWORDS, NULL},
     {"isClosed", (PyCFunction)PyDatabaseConnectionPumpLoop::isClosed, METH_VARARGS | METH_KEYWORDS, NULL},
     {"setHeartbeatMessage", (PyCFunction)PyDatabaseConnectionPumpLoop::setHeartbeatMessage, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"writeStats", (PyCFunction)PyDatabaseConnectionPumpLoop::writeStats, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"setTransactionHandler", (PyCFunction)PyDatabaseConnectionPumpLoop::setTransactionHandler, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"clearTransactionHandler", (PyCFunction)PyDatabaseConnectionPumpLoop::clearTransactionHandler, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"enableCompression", (PyCFunction)PyDatabaseConnectionPumpLoop::enableCompression, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"compressionStats", (PyCFunction)PyDatabaseConnectionPumpLoop::compressionStats, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"pumpStats", (PyCFunction)PyDatabaseConnectionPumpLoop::pumpStats, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"setHighWaterMark", (PyCFunction)PyDatabaseConnectionPumpLoop::setHighWaterMark, METH_VARARGS | METH_KEYWORDS, NULL},
     {NULL}  /* Sentinel */
 };
 
@@ -36,6 +50,7 @@ PyMethodDef PyDatabaseConnectionPumpLoop_methods[] = {
 void PyDatabaseConnectionPumpLoop::dealloc(PyDatabaseConnectionPumpLoop *self)
 {
     self->state.~shared_ptr();
+    self->transactionHandler.~shared_ptr();
 
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
@@ -49,6 +64,7 @@ PyObject* PyDatabaseConnectionPumpLoop::new_(PyTypeObject *type, PyObject *args,
 
     if (self != NULL) {
         new (&self->state) std::shared_ptr<DatabaseConnectionPumpLoop>();
+        new (&self->transactionHandler) std::shared_ptr<TransactionMessageHandler>();
     }
 
     return (PyObject*)self;
@@ -89,6 +105,74 @@ PyObject* PyDatabaseConnectionPumpLoop::writeLoop(PyDatabaseConnectionPumpLoop *
     });
 }
 
+/* static */
+PyObject* PyDatabaseConnectionPumpLoop::readyFD(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs) {
+    static const char *kwlist[] = {NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        return PyLong_FromLong(self->state->openReadyFD());
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionPumpLoop::drain(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs) {
+    static const char *kwlist[] = {NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        std::vector<FrameReadBuffer::Frame> frames;
+
+        if (!self->state->drainReadyMessages(frames)) {
+            return incref(Py_None);
+        }
+
+        PyObjectStealer res(PyList_New(0));
+
+        for (const auto& frame: frames) {
+            PyObject* message = self->state->messageToPython(frame);
+
+            if (!message) {
+                continue;
+            }
+
+            int failed = PyList_Append(res, message);
+            decref(message);
+
+            if (failed) {
+                throw PythonExceptionSet();
+            }
+        }
+
+        return incref(res);
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionPumpLoop::attachToEngine(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs) {
+    static const char *kwlist[] = {NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        if (!PumpLoopEngine::isSupported()) {
+            return incref(Py_False);
+        }
+
+        PumpLoopEngine::shared().attach(self->state);
+
+        return incref(Py_True);
+    });
+}
+
 /* static */
 PyObject* PyDatabaseConnectionPumpLoop::close(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs) {
     static const char *kwlist[] = {NULL};
@@ -148,6 +232,109 @@ PyObject* PyDatabaseConnectionPumpLoop::write(PyDatabaseConnectionPumpLoop *self
     });
 }
 
+/* static */
+PyObject* PyDatabaseConnectionPumpLoop::writeCommit(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs) {
+    static const char *kwlist[] = {"messageType", "view", "transactionGuid", "asOfVersion", NULL};
+
+    PyObject* messageType;
+    PyObject* view;
+    int64_t transactionGuid;
+    transaction_id asOfVersion;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOll", (char**)kwlist, &messageType, &view, &transactionGuid, &asOfVersion)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        if (!PyObject_TypeCheck(view, &PyType_View)) {
+            throw std::runtime_error("Expected 'view' to be a View.");
+        }
+
+        std::vector<std::string> messages = PyView::serializeCommitMessages(
+            (PyView*)view,
+            messageType,
+            transactionGuid,
+            asOfVersion
+        );
+
+        for (auto& message: messages) {
+            if (!self->state->write(std::move(message))) {
+                return incref(Py_False);
+            }
+        }
+
+        return incref(Py_True);
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionPumpLoop::setTransactionHandler(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs) {
+    static const char *kwlist[] = {"messageType", "connectionState", "lock", "onTransaction", NULL};
+
+    PyObject* messageType;
+    PyObject* connectionState;
+    PyObject* lock;
+    PyObject* onTransaction;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOO", (char**)kwlist, &messageType, &connectionState, &lock, &onTransaction)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        Type* t = PyInstance::unwrapTypeArgToTypePtr(messageType);
+
+        if (!t || t->getTypeCategory() != Type::TypeCategory::catAlternative) {
+            throw std::runtime_error("Expected 'messageType' to be an Alternative.");
+        }
+
+        if (!PyObject_TypeCheck(connectionState, &PyType_DatabaseConnectionState)) {
+            throw std::runtime_error("Expected 'connectionState' to be a DatabaseConnectionState.");
+        }
+
+        if (TransactionMessageHandler::transactionIndex((Alternative*)t) == -1) {
+            return incref(Py_False);
+        }
+
+        std::shared_ptr<TransactionMessageHandler> handler(
+            new TransactionMessageHandler(
+                (Alternative*)t,
+                ((PyDatabaseConnectionState*)connectionState)->state,
+                lock,
+                onTransaction
+            )
+        );
+
+        if (self->transactionHandler) {
+            self->transactionHandler->disable();
+        }
+
+        self->transactionHandler = handler;
+        self->state->setNativeMessageHandler(handler);
+
+        return incref(Py_True);
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionPumpLoop::clearTransactionHandler(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs) {
+    static const char *kwlist[] = {NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        if (self->transactionHandler) {
+            self->transactionHandler->disable();
+            self->transactionHandler.reset();
+        }
+
+        self->state->setNativeMessageHandler(nullptr);
+
+        return incref(Py_None);
+    });
+}
+
 /* static */
 PyObject* PyDatabaseConnectionPumpLoop::isClosed(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs) {
     static const char *kwlist[] = {NULL};
@@ -161,6 +348,161 @@ PyObject* PyDatabaseConnectionPumpLoop::isClosed(PyDatabaseConnectionPumpLoop *s
     });
 }
 
+/* static */
+PyObject* PyDatabaseConnectionPumpLoop::writeStats(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs) {
+    static const char *kwlist[] = {NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        DatabaseConnectionPumpLoop::WriteStats stats = self->state->writeStats();
+
+        double writes = std::max<int64_t>(stats.sslWrites, 1);
+
+        PyObject* res = PyDict_New();
+
+        auto setItem = [&](const char* name, PyObject* value) {
+            PyDict_SetItemString(res, name, value);
+            decref(value);
+        };
+
+        setItem("messages", PyLong_FromLongLong(stats.messages));
+        setItem("sslWrites", PyLong_FromLongLong(stats.sslWrites));
+        setItem("records", PyLong_FromLongLong(stats.records));
+        setItem("bytes", PyLong_FromLongLong(stats.bytes));
+        setItem("recordsPerWrite", PyFloat_FromDouble(stats.records / writes));
+        setItem("bytesPerWrite", PyFloat_FromDouble(stats.bytes / writes));
+
+        return res;
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionPumpLoop::enableCompression(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs) {
+    static const char *kwlist[] = {"threshold", NULL};
+
+    long threshold;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "l", (char**)kwlist, &threshold)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        if (threshold <= 0) {
+            throw std::runtime_error("Expected 'threshold' to be positive.");
+        }
+
+        self->state->enableCompression(threshold);
+
+        return incref(Py_None);
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionPumpLoop::compressionStats(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs) {
+    static const char *kwlist[] = {NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        DatabaseConnectionPumpLoop::CompressionStats stats = self->state->compressionStats();
+
+        PyObject* res = PyDict_New();
+
+        auto setItem = [&](const char* name, PyObject* value) {
+            PyDict_SetItemString(res, name, value);
+            decref(value);
+        };
+
+        setItem("messagesCompressed", PyLong_FromLongLong(stats.messagesCompressed));
+        setItem("bytesBeforeCompression", PyLong_FromLongLong(stats.bytesBeforeCompression));
+        setItem("bytesAfterCompression", PyLong_FromLongLong(stats.bytesAfterCompression));
+        setItem("messagesDecompressed", PyLong_FromLongLong(stats.messagesDecompressed));
+        setItem("bytesBeforeDecompression", PyLong_FromLongLong(stats.bytesBeforeDecompression));
+        setItem("bytesAfterDecompression", PyLong_FromLongLong(stats.bytesAfterDecompression));
+        setItem(
+            "sentCompressionRatio",
+            PyFloat_FromDouble(stats.bytesBeforeCompression / std::max<double>(stats.bytesAfterCompression, 1))
+        );
+        setItem(
+            "receivedCompressionRatio",
+            PyFloat_FromDouble(stats.bytesAfterDecompression / std::max<double>(stats.bytesBeforeDecompression, 1))
+        );
+
+        return res;
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionPumpLoop::pumpStats(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs) {
+    static const char *kwlist[] = {NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        DatabaseConnectionPumpLoop::PumpStats stats = self->state->pumpStats();
+
+        PyObject* res = PyDict_New();
+
+        auto setItem = [&](const char* name, PyObject* value) {
+            PyDict_SetItemString(res, name, value);
+            decref(value);
+        };
+
+        setItem("messagesQueued", PyLong_FromLongLong(stats.messagesQueued));
+        setItem("bytesQueued", PyLong_FromLongLong(stats.bytesQueued));
+        setItem("oldestUnsentMessageAge", PyFloat_FromDouble(stats.oldestUnsentMessageAge));
+        setItem("secondsInSelect", PyFloat_FromDouble(stats.secondsInSelect));
+        setItem("secondsInSslRead", PyFloat_FromDouble(stats.secondsInSslRead));
+        setItem("secondsInSslWrite", PyFloat_FromDouble(stats.secondsInSslWrite));
+        setItem("timesBlockedOnHighWaterMark", PyLong_FromLongLong(stats.timesBlockedOnHighWaterMark));
+        setItem("secondsBlockedOnHighWaterMark", PyFloat_FromDouble(stats.secondsBlockedOnHighWaterMark));
+
+        // a list of (upper bound in seconds, count) for each bucket with anything in it
+        PyObject* histogram = PyList_New(0);
+
+        for (size_t k = 0; k < DatabaseConnectionPumpLoop::latency_buckets; k++) {
+            if (stats.wireLatencyHistogram[k]) {
+                PyObjectStealer bucket(
+                    Py_BuildValue("(dL)", (1LL << k) / 1000000.0, (long long)stats.wireLatencyHistogram[k])
+                );
+                PyList_Append(histogram, bucket);
+            }
+        }
+
+        setItem("wireLatencyHistogram", histogram);
+
+        return res;
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionPumpLoop::setHighWaterMark(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs) {
+    static const char *kwlist[] = {"bytes", NULL};
+
+    long bytes;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "l", (char**)kwlist, &bytes)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        if (bytes < 0) {
+            throw std::runtime_error("Expected 'bytes' to be nonnegative.");
+        }
+
+        self->state->setHighWaterMark(bytes);
+
+        return incref(Py_None);
+    });
+}
+
 /* static */
 int PyDatabaseConnectionPumpLoop::init(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs)
 {
@@ -24,12 +24,16 @@
 #include <iostream>
 
 #include "DatabaseConnectionPumpLoop.hpp"
+#include "TransactionMessageHandler.hpp"
 
 class PyDatabaseConnectionPumpLoop {
 public:
     PyObject_HEAD;
     std::shared_ptr<DatabaseConnectionPumpLoop> state;
 
+    // the handler we installed with 'setTransactionHandler', if any
+    std::shared_ptr<TransactionMessageHandler> transactionHandler;
+
     static void dealloc(PyDatabaseConnectionPumpLoop *self);
 
     static PyObject *new_(PyTypeObject *type, PyObject *args, PyObject *kwargs);
@@ -42,11 +46,50 @@ public:
 
     static PyObject* write(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs);
 
+    // serialize the commit of a View as 'messageType' messages and queue them, without
+    // building the messages in python. Returns False if we're closed.
+    static PyObject* writeCommit(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs);
+
     static PyObject* readLoop(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs);
 
     static PyObject* writeLoop(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs);
 
+    // instead of 'readLoop', return a file descriptor that's readable whenever 'drain'
+    // has something for us, so an event loop can wait on it alongside everything else
+    static PyObject* readyFD(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs);
+
+    // a list of the messages that are ready, without waiting. Returns None once we're closed.
+    static PyObject* drain(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs);
+
+    // pump our socket on the shared PumpLoopEngine instead of a 'writeLoop' thread.
+    // Returns False if this platform doesn't support it.
+    static PyObject* attachToEngine(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs);
+
     static PyObject* setHeartbeatMessage(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs);
+
+    // a dict of counters describing how well we're batching writes onto the socket
+    static PyObject* writeStats(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs);
+
+    // apply incoming 'Transaction' messages to a DatabaseConnectionState in C++ rather
+    // than handing them to python. Returns False if the message type doesn't have the
+    // layout we expect.
+    static PyObject* setTransactionHandler(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs);
+
+    // go back to handing every message to python
+    static PyObject* clearTransactionHandler(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs);
+
+    // compress outgoing messages of at least 'threshold' bytes, once the server agrees
+    static PyObject* enableCompression(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs);
+
+    // a dict of counters describing how much compression is saving us
+    static PyObject* compressionStats(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs);
+
+    // a dict describing queued messages, where the socket thread spends its time, and
+    // how long messages take to get from 'write' onto the wire
+    static PyObject* pumpStats(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs);
+
+    // make 'write' block while this many bytes are queued. 0 means never block.
+    static PyObject* setHighWaterMark(PyDatabaseConnectionPumpLoop *self, PyObject *args, PyObject *kwargs);
 };
 
 extern PyTypeObject PyType_DatabaseConnectionPumpLoop;
@@ -37,6 +37,24 @@ PyMethodDef PyDatabaseConnectionState_methods[] = {
     {"typeSubscriptionLowestTransaction", (PyCFunction)PyDatabaseConnectionState::typeSubscriptionLowestTransaction, METH_VARARGS | METH_KEYWORDS, NULL},
     {"objectSubscriptionLowestTransaction", (PyCFunction)PyDatabaseConnectionState::objectSubscriptionLowestTransaction, METH_VARARGS | METH_KEYWORDS, NULL},
     {"setTriggerLazyLoad", (PyCFunction)PyDatabaseConnectionState::setTriggerLazyLoad, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"setTriggerLazyPrefetch", (PyCFunction)PyDatabaseConnectionState::setTriggerLazyPrefetch, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"setDeserializedValueCacheBudget", (PyCFunction)PyDatabaseConnectionState::setDeserializedValueCacheBudget, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"deserializedValueCacheStats", (PyCFunction)PyDatabaseConnectionState::deserializedValueCacheStats, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"collectGarbage", (PyCFunction)PyDatabaseConnectionState::collectGarbage, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"garbageCollectionBacklog", (PyCFunction)PyDatabaseConnectionState::garbageCollectionBacklog, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"setGarbageCollectionStep", (PyCFunction)PyDatabaseConnectionState::setGarbageCollectionStep, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"setParallelApply", (PyCFunction)PyDatabaseConnectionState::setParallelApply, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"setChangeLogCapacity", (PyCFunction)PyDatabaseConnectionState::setChangeLogCapacity, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"changesSince", (PyCFunction)PyDatabaseConnectionState::changesSince, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"setSpillPolicy", (PyCFunction)PyDatabaseConnectionState::setSpillPolicy, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"spillColdValues", (PyCFunction)PyDatabaseConnectionState::spillColdValues, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"spillStats", (PyCFunction)PyDatabaseConnectionState::spillStats, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"saveState", (PyCFunction)PyDatabaseConnectionState::saveState, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"restoreState", (PyCFunction)PyDatabaseConnectionState::restoreState, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"restoredTypes", (PyCFunction)PyDatabaseConnectionState::restoredTypes, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"restoredIndexValue", (PyCFunction)PyDatabaseConnectionState::restoredIndexValue, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"finishRestoredType", (PyCFunction)PyDatabaseConnectionState::finishRestoredType, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"forgetRestoredType", (PyCFunction)PyDatabaseConnectionState::forgetRestoredType, METH_VARARGS | METH_KEYWORDS, NULL},
     {NULL}  /* Sentinel */
 };
 
@@ -186,6 +204,491 @@ PyObject* PyDatabaseConnectionState::objectCount(PyDatabaseConnectionState* self
     });
 }
 
+/* static */
+PyObject* PyDatabaseConnectionState::setDeserializedValueCacheBudget(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {"budget", NULL};
+
+    PyObject* budget;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", (char**)kwlist, &budget)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        DeserializedValueCache& cache = self->state->getVersionedObjects()->getValueCache();
+
+        if (budget == Py_None) {
+            cache.setBudget(std::numeric_limits<size_t>::max());
+            return incref(Py_None);
+        }
+
+        if (!PyLong_Check(budget)) {
+            throw std::runtime_error("Deserialized value cache budget must be an int (bytes) or None (unlimited)");
+        }
+
+        long long bytes = PyLong_AsLongLong(budget);
+
+        if (bytes == -1 && PyErr_Occurred()) {
+            throw PythonExceptionSet();
+        }
+
+        if (bytes < 0) {
+            throw std::runtime_error("Deserialized value cache budget can't be negative");
+        }
+
+        cache.setBudget(bytes);
+
+        return incref(Py_None);
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::deserializedValueCacheStats(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        DeserializedValueCache& cache = self->state->getVersionedObjects()->getValueCache();
+
+        PyObject* res = PyDict_New();
+
+        auto setItem = [&](const char* name, PyObject* value) {
+            PyDict_SetItemString(res, name, value);
+            decref(value);
+        };
+
+        setItem("hits", PyLong_FromSize_t(cache.hits()));
+        setItem("misses", PyLong_FromSize_t(cache.misses()));
+        setItem("evictions", PyLong_FromSize_t(cache.evictions()));
+        setItem("entries", PyLong_FromSize_t(cache.entryCount()));
+        setItem("bytes", PyLong_FromSize_t(cache.bytes()));
+        setItem("budget", cache.hasBudget() ? PyLong_FromSize_t(cache.getBudget()) : incref(Py_None));
+
+        return res;
+    });
+}
+
+// parse a nonnegative int, or None (meaning no limit, which we return as -1)
+static int64_t parseOptionalLimit(PyObject* limit, const char* name) {
+    if (limit == Py_None) {
+        return -1;
+    }
+
+    if (!PyLong_Check(limit)) {
+        throw std::runtime_error(std::string(name) + " must be an int or None");
+    }
+
+    long long res = PyLong_AsLongLong(limit);
+
+    if (res == -1 && PyErr_Occurred()) {
+        throw PythonExceptionSet();
+    }
+
+    if (res < 0) {
+        throw std::runtime_error(std::string(name) + " can't be negative");
+    }
+
+    return res;
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::collectGarbage(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {"maxWork", "maxMicroseconds", NULL};
+
+    PyObject* maxWork = Py_None;
+    PyObject* maxMicroseconds = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OO", (char**)kwlist, &maxWork, &maxMicroseconds)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        int64_t work = parseOptionalLimit(maxWork, "maxWork");
+        int64_t microseconds = parseOptionalLimit(maxMicroseconds, "maxMicroseconds");
+
+        return PyLong_FromSize_t(
+            self->state->collectGarbage(
+                work < 0 ? std::numeric_limits<size_t>::max() : work,
+                microseconds
+            )
+        );
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::garbageCollectionBacklog(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        return PyLong_FromSize_t(self->state->garbageCollectionBacklog());
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::setGarbageCollectionStep(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {"maxWork", "maxMicroseconds", NULL};
+
+    PyObject* maxWork;
+    PyObject* maxMicroseconds;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO", (char**)kwlist, &maxWork, &maxMicroseconds)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        int64_t work = parseOptionalLimit(maxWork, "maxWork");
+        int64_t microseconds = parseOptionalLimit(maxMicroseconds, "maxMicroseconds");
+
+        self->state->setGarbageCollectionStep(
+            work < 0 ? std::numeric_limits<size_t>::max() : work,
+            microseconds
+        );
+
+        return incref(Py_None);
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::setParallelApply(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {"threads", "minOperations", NULL};
+
+    long threads;
+    long minOperations;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ll", (char**)kwlist, &threads, &minOperations)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        if (threads < 1) {
+            throw std::runtime_error("threads must be at least 1");
+        }
+
+        if (minOperations < 0) {
+            throw std::runtime_error("minOperations can't be negative");
+        }
+
+        self->state->setParallelApply(threads, minOperations);
+
+        return incref(Py_None);
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::setChangeLogCapacity(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {"capacity", NULL};
+
+    long capacity;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "l", (char**)kwlist, &capacity)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        if (capacity < 0) {
+            throw std::runtime_error("capacity can't be negative");
+        }
+
+        self->state->setChangeLogCapacity(capacity);
+
+        return incref(Py_None);
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::changesSince(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {"transaction_id", "fieldIds", NULL};
+
+    transaction_id tid;
+    PyObject* fieldIds = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "l|O", (char**)kwlist, &tid, &fieldIds)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        std::set<field_id> fields;
+
+        if (fieldIds != Py_None) {
+            for (field_id field: TupleOf<field_id>::fromPython(fieldIds)) {
+                fields.insert(field);
+            }
+        }
+
+        ChangeLog::Changes changes = self->state->changesSince(tid, fieldIds == Py_None ? nullptr : &fields);
+
+        PyObjectStealer indexChanges(PyDict_New());
+
+        for (const auto& indexAndChanges: changes.indexChanges) {
+            PyObjectStealer index(
+                IndexId(indexAndChanges.first.fieldId(), indexAndChanges.first.indexValue()).toPython()
+            );
+
+            const auto& joined = indexAndChanges.second.first;
+            const auto& left = indexAndChanges.second.second;
+
+            PyObjectStealer joinedAndLeft(PyTuple_Pack(
+                2,
+                (PyObject*)PyObjectStealer(TupleOf<object_id>::fromBuffer(joined.data(), joined.size()).toPython()),
+                (PyObject*)PyObjectStealer(TupleOf<object_id>::fromBuffer(left.data(), left.size()).toPython())
+            ));
+
+            PyDict_SetItem(indexChanges, index, joinedAndLeft);
+        }
+
+        PyObject* res = PyDict_New();
+
+        auto setItem = [&](const char* name, PyObject* value) {
+            PyDict_SetItemString(res, name, value);
+            decref(value);
+        };
+
+        setItem("complete", incref(changes.complete ? Py_True : Py_False));
+        setItem("latestTid", PyLong_FromLongLong(changes.latestTid));
+        setItem("oids", TupleOf<object_id>::fromBuffer(changes.oids.data(), changes.oids.size()).toPython());
+        setItem("indexChanges", incref(indexChanges));
+
+        return res;
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::setSpillPolicy(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {"directory", "minBytes", "coldSeconds", NULL};
+
+    PyObject* directory;
+    long minBytes;
+    double coldSeconds;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Old", (char**)kwlist, &directory, &minBytes, &coldSeconds)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        std::string path;
+
+        if (directory != Py_None) {
+            if (!PyUnicode_Check(directory)) {
+                throw std::runtime_error("directory must be a string or None");
+            }
+
+            path = PyUnicode_AsUTF8(directory);
+
+            if (path.empty()) {
+                throw std::runtime_error("directory can't be empty");
+            }
+        }
+
+        if (minBytes < 1) {
+            throw std::runtime_error("minBytes must be at least 1");
+        }
+
+        if (coldSeconds < 0) {
+            throw std::runtime_error("coldSeconds can't be negative");
+        }
+
+        self->state->setSpillPolicy(path, minBytes, coldSeconds * 1000000);
+
+        return incref(Py_None);
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::spillColdValues(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        return PyLong_FromSize_t(self->state->spillColdValues());
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::spillStats(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        std::pair<int64_t, int64_t> stats = self->state->spillStats();
+
+        PyObject* res = PyDict_New();
+
+        auto setItem = [&](const char* name, PyObject* value) {
+            PyDict_SetItemString(res, name, value);
+            decref(value);
+        };
+
+        setItem("spilledBytes", PyLong_FromLongLong(stats.first));
+        setItem("spillFileBytes", PyLong_FromLongLong(stats.second));
+
+        return res;
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::saveState(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {"path", "epoch", "excludedTypes", NULL};
+
+    const char* path;
+    const char* epoch;
+    PyObject* excludedTypes;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ssO", (char**)kwlist, &path, &epoch, &excludedTypes)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        std::set<SchemaAndTypeName> excluded;
+
+        iterate(excludedTypes, [&](PyObject* schemaAndTypename) {
+            const char* schemaName;
+            const char* typeName;
+
+            if (!PyArg_ParseTuple(schemaAndTypename, "ss", &schemaName, &typeName)) {
+                throw PythonExceptionSet();
+            }
+
+            excluded.insert(SchemaAndTypeName(schemaName, typeName));
+        });
+
+        self->state->saveState(path, epoch, excluded);
+
+        return incref(Py_None);
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::restoreState(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {"path", NULL};
+
+    const char* path;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s", (char**)kwlist, &path)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        std::string epoch;
+
+        transaction_id tid = self->state->restoreState(path, epoch);
+
+        return Py_BuildValue("(ls#)", tid, epoch.data(), (Py_ssize_t)epoch.size());
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::restoredTypes(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        PyObjectStealer res(PyList_New(0));
+
+        for (auto& type: self->state->restoredTypes()) {
+            PyObjectStealer schemaAndTypename(
+                Py_BuildValue("(ss)", type.schemaName().c_str(), type.typeName().c_str())
+            );
+
+            if (!schemaAndTypename || PyList_Append(res, schemaAndTypename) == -1) {
+                throw PythonExceptionSet();
+            }
+        }
+
+        return incref((PyObject*)res);
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::restoredIndexValue(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {"field_id", "object_id", NULL};
+
+    field_id fieldId;
+    object_id oid;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ll", (char**)kwlist, &fieldId, &oid)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        const index_value* value = self->state->restoredIndexValue(fieldId, oid);
+
+        if (!value) {
+            return incref(Py_None);
+        }
+
+        return PyBytes_FromStringAndSize((const char*)&(*value)[0], value->size());
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::finishRestoredType(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {"schema", "typename", NULL};
+
+    const char* schemaName;
+    const char* typeName;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ss", (char**)kwlist, &schemaName, &typeName)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        self->state->finishRestoredType(SchemaAndTypeName(schemaName, typeName));
+
+        return incref(Py_None);
+    });
+}
+
+/* static */
+PyObject* PyDatabaseConnectionState::forgetRestoredType(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {"schema", "typename", NULL};
+
+    const char* schemaName;
+    const char* typeName;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ss", (char**)kwlist, &schemaName, &typeName)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        self->state->forgetRestoredType(SchemaAndTypeName(schemaName, typeName));
+
+        return incref(Py_None);
+    });
+}
+
 /* static */
 PyObject* PyDatabaseConnectionState::allocateIdentity(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs)
 {
@@ -392,6 +895,26 @@ PyObject* PyDatabaseConnectionState::setTriggerLazyLoad(PyDatabaseConnectionStat
     });
 }
 
+PyObject* PyDatabaseConnectionState::setTriggerLazyPrefetch(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs) {
+    static const char *kwlist[] = {"callback", NULL};
+
+    PyObject* callback;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", (char**)kwlist, &callback)) {
+        return NULL;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        if (!self->state) {
+            throw std::runtime_error("Invalid PyDatabaseConnectionState (nullptr)");
+        }
+
+        self->state->setTriggerLazyPrefetch(callback);
+
+        return incref(Py_None);
+    });
+}
+
 PyTypeObject PyType_DatabaseConnectionState = {
     PyVarObject_HEAD_INIT(NULL, 0)
     .tp_name = "DatabaseConnectionState",
@@ -65,6 +65,42 @@ public:
     static PyObject* markObjectNotLazy(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
 
     static PyObject* setTriggerLazyLoad(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* setTriggerLazyPrefetch(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* setDeserializedValueCacheBudget(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* deserializedValueCacheStats(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* collectGarbage(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* garbageCollectionBacklog(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* setGarbageCollectionStep(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* setParallelApply(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* setChangeLogCapacity(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* changesSince(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* setSpillPolicy(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* spillColdValues(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* spillStats(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* saveState(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* restoreState(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* restoredTypes(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* restoredIndexValue(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* finishRestoredType(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* forgetRestoredType(PyDatabaseConnectionState* self, PyObject* args, PyObject* kwargs);
 };
 
 extern PyTypeObject PyType_DatabaseConnectionState;
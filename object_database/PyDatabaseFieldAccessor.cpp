@@ -0,0 +1,247 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#include <Python.h>
+#include <typed_python/util.hpp>
+#include <typed_python/PyInstance.hpp>
+
+#include "PyDatabaseFieldAccessor.hpp"
+
+void PyDatabaseFieldAccessor::dealloc(PyDatabaseFieldAccessor* self)
+{
+    Py_XDECREF((PyObject*)self->obType);
+    Py_XDECREF(self->internedName);
+
+    self->fieldName.~basic_string();
+
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+PyObject* PyDatabaseFieldAccessor::new_(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyDatabaseFieldAccessor *self;
+    self = (PyDatabaseFieldAccessor*)type->tp_alloc(type, 0);
+
+    if (self != NULL) {
+        self->obType = nullptr;
+        new (&self->fieldName) std::string();
+        self->internedName = nullptr;
+    }
+    return (PyObject*)self;
+}
+
+int PyDatabaseFieldAccessor::init(PyDatabaseFieldAccessor *self, PyObject *args, PyObject *kwargs)
+{
+    static const char* kwlist[] = { "databaseType", "fieldName", NULL };
+    PyObject* databaseType;
+    const char* fieldName;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Os", (char**)kwlist, &databaseType, &fieldName)) {
+        return -1;
+    }
+
+    return translateExceptionToPyObjectReturningInt([&]() {
+        PyDatabaseObjectType* obType = PyDatabaseObjectType::check(databaseType);
+        if (!obType) {
+            throw std::runtime_error("Expected first argument to be a database type.");
+        }
+
+        if (obType->m_fields.find(fieldName) == obType->m_fields.end()) {
+            throw std::runtime_error(
+                "No field named " + std::string(fieldName) + " defined on " + obType->m_schema_and_typename
+            );
+        }
+
+        PyObject* internedName = PyUnicode_InternFromString(fieldName);
+        if (!internedName) {
+            throw PythonExceptionSet();
+        }
+
+        Py_XDECREF((PyObject*)self->obType);
+        Py_XDECREF(self->internedName);
+        self->obType = (PyDatabaseObjectType*)incref(databaseType);
+        self->fieldName = fieldName;
+        self->internedName = internedName;
+
+        return 0;
+    });
+}
+
+PyDatabaseObjectType::AttributeSlot* PyDatabaseFieldAccessor::prepare(View* view, PyObject* o) {
+    if (!obType) {
+        throw std::runtime_error("DatabaseFieldAccessor was never initialized.");
+    }
+
+    if (o->ob_type != (PyTypeObject*)obType) {
+        throw std::runtime_error(
+            "Accessor for " + obType->m_schema_and_typename + "." + fieldName + " can't be used on an instance of " +
+                o->ob_type->tp_name
+        );
+    }
+
+    PyDatabaseObjectType::checkVisible(view, o);
+
+    PyDatabaseObjectType::AttributeSlot* slot = obType->attributeSlotFor(internedName);
+
+    //'exists', 'delete' and the like take precedence over fields in 'obj.field', so a
+    //field with one of those names has no slot of its own.
+    if (slot->kind != PyDatabaseObjectType::AttributeSlot::Kind::Field) {
+        throw std::runtime_error(
+            "Field " + obType->m_schema_and_typename + "." + fieldName + " is hidden by a builtin attribute."
+        );
+    }
+
+    return slot;
+}
+
+PyObject* PyDatabaseFieldAccessor::get(PyDatabaseFieldAccessor* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "obj", NULL };
+    PyObject* obj;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", (char**)kwlist, &obj)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        View* view = View::currentView();
+        if (!view) {
+            throw std::runtime_error("Database attributes cannot be read without an active view.");
+        }
+
+        PyDatabaseObjectType::AttributeSlot* slot = self->prepare(view, obj);
+
+        return PyDatabaseObjectType::lookupFieldValueById(
+            self->obType,
+            view,
+            PyDatabaseObjectType::getObjectId(obj),
+            self->obType->fieldIdForSlot(*slot, &view->getConnectionState()),
+            slot->fieldType
+        );
+    });
+}
+
+PyObject* PyDatabaseFieldAccessor::set(PyDatabaseFieldAccessor* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "obj", "value", NULL };
+    PyObject* obj;
+    PyObject* value;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO", (char**)kwlist, &obj, &value)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        View* view = View::currentView();
+        if (!view) {
+            throw std::runtime_error("Database attributes cannot be set without an active transaction.");
+        }
+
+        Type* fieldType = self->prepare(view, obj)->fieldType;
+
+        Instance i(fieldType, [&](instance_ptr tgt) {
+            PyInstance::copyConstructFromPythonInstance(fieldType, tgt, value, ConversionLevel::ImplicitContainers);
+        });
+
+        //converting 'value' can run python code, which could add a member to the type and
+        //clear its slots, so we look ours up again, with its current index list.
+        PyDatabaseObjectType::AttributeSlot* slot = self->prepare(view, obj);
+
+        PyDatabaseObjectType::setFieldValueById(
+            self->obType,
+            view,
+            PyDatabaseObjectType::getObjectId(obj),
+            self->obType->fieldIdForSlot(*slot, &view->getConnectionState()),
+            slot->indices,
+            fieldType,
+            i.data()
+        );
+
+        return incref(Py_None);
+    });
+}
+
+PyObject* PyDatabaseFieldAccessor::tp_repr(PyObject* o) {
+    PyDatabaseFieldAccessor* self = (PyDatabaseFieldAccessor*)o;
+
+    if (!self->obType) {
+        return PyUnicode_FromString("DatabaseFieldAccessor()");
+    }
+
+    return PyUnicode_FromString(
+        ("DatabaseFieldAccessor(" + self->obType->m_schema_and_typename + "." + self->fieldName + ")").c_str()
+    );
+}
+
+PyMethodDef PyDatabaseFieldAccessor_methods[] = {
+    {"get", (PyCFunction) PyDatabaseFieldAccessor::get, METH_VARARGS | METH_KEYWORDS},
+    {"set", (PyCFunction) PyDatabaseFieldAccessor::set, METH_VARARGS | METH_KEYWORDS},
+
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject PyType_DatabaseFieldAccessor = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "DatabaseFieldAccessor",
+    .tp_basicsize = sizeof(PyDatabaseFieldAccessor),
+    .tp_itemsize = 0,
+    .tp_dealloc = (destructor) PyDatabaseFieldAccessor::dealloc,
+    #if PY_MINOR_VERSION < 8
+    .tp_print = 0,
+    #else
+    .tp_vectorcall_offset = 0,                  // printfunc  (Changed to tp_vectorcall_offset in Python 3.8)
+    #endif
+    .tp_getattr = 0,
+    .tp_setattr = 0,
+    .tp_as_async = 0,
+    .tp_repr = PyDatabaseFieldAccessor::tp_repr,
+    .tp_as_number = 0,
+    .tp_as_sequence = 0,
+    .tp_as_mapping = 0,
+    .tp_hash = 0,
+    .tp_call = 0,
+    .tp_str = 0,
+    .tp_getattro = 0,
+    .tp_setattro = 0,
+    .tp_as_buffer = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = 0,
+    .tp_traverse = 0,
+    .tp_clear = 0,
+    .tp_richcompare = 0,
+    .tp_weaklistoffset = 0,
+    .tp_iter = 0,
+    .tp_iternext = 0,
+    .tp_methods = PyDatabaseFieldAccessor_methods,
+    .tp_members = 0,
+    .tp_getset = 0,
+    .tp_base = 0,
+    .tp_dict = 0,
+    .tp_descr_get = 0,
+    .tp_descr_set = 0,
+    .tp_dictoffset = 0,
+    .tp_init = (initproc) PyDatabaseFieldAccessor::init,
+    .tp_alloc = 0,
+    .tp_new = PyDatabaseFieldAccessor::new_,
+    .tp_free = 0,
+    .tp_is_gc = 0,
+    .tp_bases = 0,
+    .tp_mro = 0,
+    .tp_cache = 0,
+    .tp_subclasses = 0,
+    .tp_weaklist = 0,
+    .tp_del = 0,
+    .tp_version_tag = 0,
+    .tp_finalize = 0,
+};
@@ -0,0 +1,70 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <Python.h>
+#include <string>
+
+#include "PyDatabaseObjectType.hpp"
+
+extern PyTypeObject PyType_DatabaseFieldAccessor;
+
+/*************
+
+A DatabaseFieldAccessor reads and writes one field of one database type. It
+holds the field's interned name, so 'get' and 'set' find the type's
+AttributeSlot for it with one pointer lookup, the same way 'obj.field' does,
+and go straight to View::getField / setField. Since the slot is looked up on
+each call, the field type, field id and index list are always whatever the
+type currently has. Hot interpreted loops can hold on to one instead of
+using 'obj.field'.
+
+This is an interpreter-level accessor: code compiled with typed_python that
+calls it still goes through the interpreter to do so. We don't yet give the
+compiler a wrapper for database types that would lower field reads and
+writes to View::getField / setField.
+
+*************/
+
+class PyDatabaseFieldAccessor {
+public:
+    PyObject_HEAD;
+
+    // the type we belong to. We hold a reference to it.
+    PyDatabaseObjectType* obType;
+
+    std::string fieldName;
+
+    // 'fieldName' as an interned python string. We hold a reference to it.
+    PyObject* internedName;
+
+    static void dealloc(PyDatabaseFieldAccessor *self);
+
+    static PyObject *new_(PyTypeObject *type, PyObject *args, PyObject *kwds);
+
+    static int init(PyDatabaseFieldAccessor *self, PyObject *args, PyObject *kwds);
+
+    static PyObject* get(PyDatabaseFieldAccessor* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* set(PyDatabaseFieldAccessor* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* tp_repr(PyObject* o);
+
+    // check that 'o' is one of our objects and visible in 'view', and return our field's
+    // slot. The slot is only good until something adds a member to the type.
+    PyDatabaseObjectType::AttributeSlot* prepare(View* view, PyObject* o);
+};
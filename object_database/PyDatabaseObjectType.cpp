@@ -1,5 +1,7 @@
 #include "PyDatabaseObjectType.hpp"
+#include "PyDatabaseFieldAccessor.hpp"
 #include <typed_python/PyInstance.hpp>
+#include <numpy/arrayobject.h>
 
 std::unordered_set<PyDatabaseObjectType*> PyDatabaseObjectType::s_database_object_types;
 
@@ -67,10 +69,15 @@ PyTypeObject* PyDatabaseObjectType::createDatabaseObjectType(PyObject* schema, s
         Py_True
         );
 
-    PyMethodDef* methods = new PyMethodDef[15] {
+    PyMethodDef* methods = new PyMethodDef[20] {
         {"fromIdentity", (PyCFunction)PyDatabaseObjectType::fromIdentity, METH_VARARGS | METH_CLASS, NULL},
         {"lookupAny", (PyCFunction)PyDatabaseObjectType::pyLookupAny, METH_VARARGS | METH_KEYWORDS | METH_CLASS, NULL},
         {"lookupAll", (PyCFunction)PyDatabaseObjectType::pyLookupAll, METH_VARARGS | METH_KEYWORDS | METH_CLASS, NULL},
+        {"createMany", (PyCFunction)PyDatabaseObjectType::pyCreateMany, METH_VARARGS | METH_KEYWORDS | METH_CLASS, NULL},
+        {"setMany", (PyCFunction)PyDatabaseObjectType::pySetMany, METH_VARARGS | METH_KEYWORDS | METH_CLASS, NULL},
+        {"gather", (PyCFunction)PyDatabaseObjectType::pyGather, METH_VARARGS | METH_KEYWORDS | METH_CLASS, NULL},
+        {"gatherArray", (PyCFunction)PyDatabaseObjectType::pyGatherArray, METH_VARARGS | METH_KEYWORDS | METH_CLASS, NULL},
+        {"fieldAccessor", (PyCFunction)PyDatabaseObjectType::pyFieldAccessor, METH_VARARGS | METH_KEYWORDS | METH_CLASS, NULL},
         {"lookupOne", (PyCFunction)PyDatabaseObjectType::pyLookupOne, METH_VARARGS | METH_KEYWORDS | METH_CLASS, NULL},
         {"lookupUnique", (PyCFunction)PyDatabaseObjectType::pyLookupUnique, METH_VARARGS | METH_KEYWORDS | METH_CLASS, NULL},
         {"markLazyByDefault", (PyCFunction)PyDatabaseObjectType::pyMarkLazyByDefault, METH_VARARGS | METH_KEYWORDS | METH_CLASS, NULL},
@@ -186,6 +193,124 @@ void PyDatabaseObjectType::finalize() {
     m_is_finalized = true;
 }
 
+void PyDatabaseObjectType::clearAttributeSlots() {
+    for (auto& nameAndSlot: m_interned_attribute_slots) {
+        decref(nameAndSlot.first);
+    }
+
+    m_interned_attribute_slots.clear();
+    m_attribute_slots.clear();
+}
+
+PyDatabaseObjectType::AttributeSlot PyDatabaseObjectType::computeAttributeSlot(const std::string& name) {
+    AttributeSlot slot;
+    slot.name = name;
+
+    //these take precedence over anything defined on the type, in the
+    //order that tp_getattro has always checked them.
+    if (name == "_identity") {
+        slot.kind = AttributeSlot::Kind::Identity;
+        return slot;
+    }
+
+    if (name == "__class__") {
+        slot.kind = AttributeSlot::Kind::Class;
+        return slot;
+    }
+
+    if (name == "__schema__") {
+        slot.kind = AttributeSlot::Kind::Schema;
+        return slot;
+    }
+
+    if (name == "exists") {
+        slot.kind = AttributeSlot::Kind::Exists;
+        return slot;
+    }
+
+    if (name == "delete") {
+        slot.kind = AttributeSlot::Kind::Delete;
+        return slot;
+    }
+
+    auto fieldIt = m_fields.find(name);
+    if (fieldIt != m_fields.end()) {
+        slot.kind = AttributeSlot::Kind::Field;
+        slot.fieldType = fieldIt->second;
+
+        auto indexList = m_field_to_indices.find(name);
+        if (indexList != m_field_to_indices.end()) {
+            slot.indices = &indexList->second;
+        }
+
+        return slot;
+    }
+
+    auto staticMethodIt = m_static_methods.find(name);
+    if (staticMethodIt != m_static_methods.end()) {
+        slot.kind = AttributeSlot::Kind::StaticMethod;
+        slot.method = staticMethodIt->second;
+        return slot;
+    }
+
+    auto methodIt = m_methods.find(name);
+    if (methodIt != m_methods.end()) {
+        slot.kind = AttributeSlot::Kind::Method;
+        slot.method = methodIt->second;
+        return slot;
+    }
+
+    auto propIt = m_properties.find(name);
+    if (propIt != m_properties.end()) {
+        slot.kind = AttributeSlot::Kind::Property;
+        slot.getter = propIt->second.first;
+        slot.setter = propIt->second.second;
+        return slot;
+    }
+
+    return slot;
+}
+
+PyDatabaseObjectType::AttributeSlot* PyDatabaseObjectType::attributeSlotFor(PyObject* attrName) {
+    auto internedIt = m_interned_attribute_slots.find(attrName);
+    if (internedIt != m_interned_attribute_slots.end()) {
+        return internedIt->second;
+    }
+
+    std::string name(PyUnicode_AsUTF8(attrName));
+
+    auto slotIt = m_attribute_slots.find(name);
+
+    if (slotIt == m_attribute_slots.end()) {
+        AttributeSlot slot = computeAttributeSlot(name);
+
+        if (slot.kind == AttributeSlot::Kind::Missing) {
+            //nobody should hold onto this past the call that asked for it
+            static AttributeSlot missing;
+            missing = slot;
+            return &missing;
+        }
+
+        slotIt = m_attribute_slots.insert(std::make_pair(name, slot)).first;
+    }
+
+    //a string that isn't interned is probably a temporary, and we'd never see its address again.
+    if (PyUnicode_CHECK_INTERNED(attrName)) {
+        m_interned_attribute_slots[incref(attrName)] = &slotIt->second;
+    }
+
+    return &slotIt->second;
+}
+
+field_id PyDatabaseObjectType::fieldIdForSlot(AttributeSlot& slot, DatabaseConnectionState* state) {
+    if (slot.lastState != state) {
+        slot.lastFieldId = fieldIdForNameAndState(slot.name, state);
+        slot.lastState = state;
+    }
+
+    return slot.lastFieldId;
+}
+
 void PyDatabaseObjectType::assertNameDoesntExist(std::string name) {
     if (m_fields.find(name) != m_fields.end() ||
             m_static_methods.find(name) != m_static_methods.end() ||
@@ -206,6 +331,8 @@ void PyDatabaseObjectType::addMethod(std::string name, PyObject* method) {
     }
 
     m_methods[name] = incref(method);
+
+    clearAttributeSlots();
 }
 
 void PyDatabaseObjectType::addStaticMethod(std::string name, PyObject* method) {
@@ -214,15 +341,19 @@ void PyDatabaseObjectType::addStaticMethod(std::string name, PyObject* method) {
     PyDict_SetItemString(((PyTypeObject*)this)->tp_dict, name.c_str(), method);
 
     m_static_methods[name] = incref(method);
+
+    clearAttributeSlots();
 }
 
 void PyDatabaseObjectType::addField(std::string name, Type* fieldType) {
     assertNameDoesntExist(name);
 
     m_fields[name] = fieldType;
+
+    clearAttributeSlots();
 }
 
-void PyDatabaseObjectType::addIndex(std::string index_name, const std::vector<std::string>& field_names) {
+void PyDatabaseObjectType::addIndex(std::string index_name, const std::vector<std::string>& field_names, bool ordered) {
     if (m_indices.find(index_name) != m_indices.end()) {
         throw std::runtime_error("Index '" + index_name + "' already exists.");
     }
@@ -247,12 +378,20 @@ void PyDatabaseObjectType::addIndex(std::string index_name, const std::vector<st
     } else {
         m_indexTypes[index_name] = types[0];
     }
+
+    if (ordered) {
+        m_ordered_indices.insert(index_name);
+    }
+
+    clearAttributeSlots();
 }
 
 void PyDatabaseObjectType::addProperty(std::string name, PyObject* getter, PyObject* setter) {
     assertNameDoesntExist(name);
 
     m_properties[name] = std::make_pair(incref(getter), incref(setter));
+
+    clearAttributeSlots();
 }
 
 void PyDatabaseObjectType::ensureAllFieldsInitialized(View* view, object_id oid) {
@@ -447,34 +586,39 @@ int PyDatabaseObjectType::tp_setattro(PyObject *o, PyObject* attrName, PyObject*
             throw std::runtime_error("Database attributes cannot be set without an active transaction.");
         }
 
-        std::string attr(PyUnicode_AsUTF8(attrName));
-
         object_id oid = getObjectId(o);
 
         PyDatabaseObjectType* obType = (PyDatabaseObjectType*)o->ob_type;
 
         checkVisible(view, o);
 
-        auto fieldIt = obType->m_fields.find(attr);
-        if (fieldIt != obType->m_fields.end()) {
-            Type* fieldType = fieldIt->second;
+        AttributeSlot* slot = obType->attributeSlotFor(attrName);
+
+        if (slot->kind == AttributeSlot::Kind::Field) {
+            Type* fieldType = slot->fieldType;
 
             Instance i(fieldType, [&](instance_ptr tgt) {
                 PyInstance::copyConstructFromPythonInstance(fieldType, tgt, attrVal, ConversionLevel::ImplicitContainers);
             });
 
-            setFieldValue(obType, oid, attr, fieldType, i.data());
+            setFieldValueById(
+                obType,
+                view,
+                oid,
+                obType->fieldIdForSlot(*slot, &view->getConnectionState()),
+                slot->indices,
+                fieldType,
+                i.data()
+            );
             return 0;
         }
 
-        auto propIt = obType->m_properties.find(attr);
-
-        if (propIt != obType->m_properties.end()) {
-            if (propIt->second.second == Py_None) {
-                throw std::runtime_error("Attribute " + attr + " is not settable.");
+        if (slot->kind == AttributeSlot::Kind::Property) {
+            if (slot->setter == Py_None) {
+                throw std::runtime_error("Attribute " + slot->name + " is not settable.");
             }
 
-            PyObject* result = PyObject_CallFunctionObjArgs(propIt->second.second, o, attrVal, NULL);
+            PyObject* result = PyObject_CallFunctionObjArgs(slot->setter, o, attrVal, NULL);
 
             if (!result) {
                 throw PythonExceptionSet();
@@ -485,7 +629,7 @@ int PyDatabaseObjectType::tp_setattro(PyObject *o, PyObject* attrName, PyObject*
             return 0;
         }
 
-        throw std::runtime_error("Attribute " + attr + " is not settable.");
+        throw std::runtime_error("Attribute " + slot->name + " is not settable.");
     });
 }
 
@@ -512,10 +656,31 @@ void PyDatabaseObjectType::setFieldValue(PyDatabaseObjectType* obType, object_id
 
     field_id fieldId = obType->fieldIdForNameAndState(attr, &view->getConnectionState());
 
-    //pull each value out of the index if its already populated
     auto indexList = obType->m_field_to_indices.find(attr);
-    if (indexList != obType->m_field_to_indices.end()) {
-        for (auto index: indexList->second) {
+
+    setFieldValueById(
+        obType,
+        view,
+        oid,
+        fieldId,
+        indexList != obType->m_field_to_indices.end() ? &indexList->second : nullptr,
+        fieldType,
+        data
+    );
+}
+
+void PyDatabaseObjectType::setFieldValueById(
+        PyDatabaseObjectType* obType,
+        View* view,
+        object_id oid,
+        field_id fieldId,
+        const std::set<std::string>* indices,
+        Type* fieldType,
+        instance_ptr data
+        ) {
+    //pull each value out of the index if its already populated
+    if (indices) {
+        for (auto index: *indices) {
             field_id fieldIdForIndex = obType->fieldIdForNameAndState(index, &view->getConnectionState());
 
             OneOf<None, index_value> curIndexValue = obType->calcCurIndexValue(view, index, fieldIdForIndex, oid);
@@ -531,8 +696,8 @@ void PyDatabaseObjectType::setFieldValue(PyDatabaseObjectType* obType, object_id
     view->setField(fieldId, oid, fieldType, data);
 
     //now add each value back to the index if its not already populated
-    if (indexList != obType->m_field_to_indices.end()) {
-        for (auto index: indexList->second) {
+    if (indices) {
+        for (auto index: *indices) {
             field_id fieldIdForIndex = obType->fieldIdForNameAndState(index, &view->getConnectionState());
 
             OneOf<None, index_value> curIndexValue = obType->calcCurIndexValue(view, index, fieldIdForIndex, oid);
@@ -610,55 +775,58 @@ PyObject* PyDatabaseObjectType::tp_getattro(PyObject *o, PyObject* attrName) {
 
         PyDatabaseObjectType* obType = (PyDatabaseObjectType*)o->ob_type;
 
-        std::string attr(PyUnicode_AsUTF8(attrName));
+        AttributeSlot* slot = obType->attributeSlotFor(attrName);
 
         object_id oid = getObjectId(o);
 
-        if (attr == "_identity") {
-            return PyLong_FromLong(oid);
-        }
-
-        if (attr == "__class__") {
-            return incref((PyObject*)obType);
-        }
+        switch (slot->kind) {
+            case AttributeSlot::Kind::Identity:
+                return PyLong_FromLong(oid);
 
-        if (attr == "__schema__") {
-            return PyObject_GetAttr((PyObject*)obType, attrName);
-        }
+            case AttributeSlot::Kind::Class:
+                return incref((PyObject*)obType);
 
-        if (attr == "exists") {
-            static PyMethodDef exists = {"exists", (PyCFunction)PyDatabaseObjectType::pyExists, METH_VARARGS | METH_KEYWORDS, NULL};
-            return PyCFunction_New(&exists, o);
-        }
+            case AttributeSlot::Kind::Schema:
+                return PyObject_GetAttr((PyObject*)obType, attrName);
 
-        if (attr == "delete") {
-            static PyMethodDef deleteFun = {"delete", (PyCFunction)PyDatabaseObjectType::pyDelete, METH_VARARGS | METH_KEYWORDS, NULL};
-            return PyCFunction_New(&deleteFun, o);
-        }
+            case AttributeSlot::Kind::Exists: {
+                static PyMethodDef exists = {"exists", (PyCFunction)PyDatabaseObjectType::pyExists, METH_VARARGS | METH_KEYWORDS, NULL};
+                return PyCFunction_New(&exists, o);
+            }
 
-        auto fieldIt = obType->m_fields.find(attr);
-        if (fieldIt != obType->m_fields.end()) {
-            checkVisible(nullptr, o);
+            case AttributeSlot::Kind::Delete: {
+                static PyMethodDef deleteFun = {"delete", (PyCFunction)PyDatabaseObjectType::pyDelete, METH_VARARGS | METH_KEYWORDS, NULL};
+                return PyCFunction_New(&deleteFun, o);
+            }
 
-            return lookupFieldValue(obType, oid, attr, fieldIt->second);
-        }
+            case AttributeSlot::Kind::Field: {
+                View* view = View::currentView();
+                if (!view) {
+                    throw std::runtime_error("Database attributes cannot be read without an active transaction.");
+                }
 
-        auto staticMethodIt = obType->m_static_methods.find(attr);
+                checkVisible(view, o);
 
-        if (staticMethodIt != obType->m_static_methods.end()) {
-            return incref(staticMethodIt->second);
-        }
+                return lookupFieldValueById(
+                    obType,
+                    view,
+                    oid,
+                    obType->fieldIdForSlot(*slot, &view->getConnectionState()),
+                    slot->fieldType
+                );
+            }
 
-        auto methodIt = obType->m_methods.find(attr);
+            case AttributeSlot::Kind::StaticMethod:
+                return incref(slot->method);
 
-        if (methodIt != obType->m_methods.end()) {
-            return PyMethod_New(methodIt->second, o);
-        }
+            case AttributeSlot::Kind::Method:
+                return PyMethod_New(slot->method, o);
 
-        auto propIt = obType->m_properties.find(attr);
+            case AttributeSlot::Kind::Property:
+                return PyObject_CallFunctionObjArgs(slot->getter, o, NULL);
 
-        if (propIt != obType->m_properties.end()) {
-            return PyObject_CallFunctionObjArgs(propIt->second.first, o, NULL);
+            case AttributeSlot::Kind::Missing:
+                break;
         }
 
         PyErr_Format(
@@ -683,6 +851,16 @@ PyObject* PyDatabaseObjectType::lookupFieldValue(PyDatabaseObjectType* obType, o
 
     field_id fieldId = obType->fieldIdForNameAndState(attr, &view->getConnectionState());
 
+    return lookupFieldValueById(obType, view, oid, fieldId, fieldType);
+}
+
+PyObject* PyDatabaseObjectType::lookupFieldValueById(PyDatabaseObjectType* obType, View* view, object_id oid, field_id fieldId, Type* fieldType)
+{
+    ViewTrace::Scope* trace = view->getTrace();
+    if (trace) {
+        trace->counters.attributeReads++;
+    }
+
     instance_ptr data = view->getField(fieldId, oid, fieldType);
 
     if (!data) {
@@ -971,11 +1149,12 @@ PyObject* PyDatabaseObjectType::pyIsLazyByDefault(PyObject *databaseType, PyObje
 
 PyObject* PyDatabaseObjectType::pyAddIndex(PyObject *databaseType, PyObject* args, PyObject* kwargs)
 {
-    static const char *kwlist[] = {"field", "fieldList", NULL};
+    static const char *kwlist[] = {"field", "fieldList", "ordered", NULL};
     const char* field;
     PyObject* fieldList;
+    int ordered = 0;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO", (char**)kwlist, &field, &fieldList)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|p", (char**)kwlist, &field, &fieldList, &ordered)) {
         return nullptr;
     }
 
@@ -1002,7 +1181,7 @@ PyObject* PyDatabaseObjectType::pyAddIndex(PyObject *databaseType, PyObject* arg
     }
 
     return translateExceptionToPyObject([&] {
-        obType->addIndex(field, fieldnames);
+        obType->addIndex(field, fieldnames, ordered);
         return incref(Py_None);
     });
 }
@@ -1026,9 +1205,14 @@ PyObject* PyDatabaseObjectType::pyLookupOne(PyObject *databaseType, PyObject* ar
             );
         }
 
-        std::pair<field_id, index_value> lookup = obType->parseIndexLookupKwarg(view, kwargs);
+        std::vector<IndexLookupTerm> lookup = obType->parseIndexLookupKwargs(view, kwargs);
 
-        object_id oid = view->indexLookupFirst(lookup.first, lookup.second);
+        object_id oid = NO_OBJECT;
+
+        view->indexLookup(lookup, [&](object_id o) {
+            oid = o;
+            return false;
+        });
 
         if (oid == NO_OBJECT) {
             throw std::runtime_error(
@@ -1058,9 +1242,14 @@ PyObject* PyDatabaseObjectType::pyLookupAny(PyObject *databaseType, PyObject* ar
             );
         }
 
-        std::pair<field_id, index_value> lookup = obType->parseIndexLookupKwarg(view, kwargs);
+        std::vector<IndexLookupTerm> lookup = obType->parseIndexLookupKwargs(view, kwargs);
 
-        object_id oid = view->indexLookupFirst(lookup.first, lookup.second);
+        object_id oid = NO_OBJECT;
+
+        view->indexLookup(lookup, [&](object_id o) {
+            oid = o;
+            return false;
+        });
 
         if (oid == NO_OBJECT) {
             return incref(Py_None);
@@ -1088,24 +1277,32 @@ PyObject* PyDatabaseObjectType::pyLookupUnique(PyObject *databaseType, PyObject*
             );
         }
 
-        std::pair<field_id, index_value> lookup = obType->parseIndexLookupKwarg(view, kwargs);
+        std::vector<IndexLookupTerm> lookup = obType->parseIndexLookupKwargs(view, kwargs);
+
+        object_id oid = NO_OBJECT;
+        bool unique = true;
 
-        object_id oid = view->indexLookupFirst(lookup.first, lookup.second);
+        view->indexLookup(lookup, [&](object_id o) {
+            if (oid != NO_OBJECT) {
+                unique = false;
+                return false;
+            }
+            oid = o;
+            return true;
+        });
 
         if (oid == NO_OBJECT) {
             return incref(Py_None);
         }
-        PyObject* result = obType->fromIntegerIdentity(oid);
 
         // check uniqueness
-        oid = view->indexLookupNext(lookup.first, lookup.second, oid);
-        if (oid != NO_OBJECT) {
-            decref(result);
+        if (!unique) {
             throw std::runtime_error(
                 "" + obType->m_schema_and_typename + " not unique."
             );
         }
-        return result;
+
+        return obType->fromIntegerIdentity(oid);
     });
 }
 
@@ -1127,18 +1324,206 @@ PyObject* PyDatabaseObjectType::pyLookupAll(PyObject *databaseType, PyObject* ar
             );
         }
 
-        std::pair<field_id, index_value> lookup = obType->parseIndexLookupKwarg(view, kwargs);
+        std::vector<IndexLookupTerm> lookup = obType->parseIndexLookupKwargs(view, kwargs);
 
-        object_id oid = view->indexLookupFirst(lookup.first, lookup.second);
+        int64_t bound = view->indexLookupBound(lookup);
 
-        TupleOf<object_id> oids = TupleOf<object_id>::createUnbounded([&](object_id* tgt, int index) {
-            if (oid != NO_OBJECT) {
-                *tgt = oid;
-                oid = view->indexLookupNext(lookup.first, lookup.second, oid);
+        TupleOf<object_id> oids;
+
+        if (bound >= 0) {
+            // write the ids straight into the tuple we hand to python
+            oids = TupleOf<object_id>::fromFill(bound, [&](object_id* buffer) {
+                int64_t count = 0;
+
+                view->indexLookup(lookup, [&](object_id o) {
+                    if (count == bound) {
+                        throw std::runtime_error("lookupAll found more objects than its index can hold.");
+                    }
+                    buffer[count++] = o;
+                    return true;
+                });
+
+                return count;
+            });
+        } else {
+            // only range terms, which already materialize their matches, so we
+            // can't know how many there are until we've looked
+            std::vector<object_id> found;
+
+            view->indexLookup(lookup, [&](object_id o) {
+                found.push_back(o);
                 return true;
+            });
+
+            oids = TupleOf<object_id>::fromBuffer(found.data(), found.size());
+        }
+
+        return oids.toPython(
+            // element type override
+            PyInstance::unwrapTypeArgToTypePtr(databaseType)
+        );
+    });
+}
+
+/* static */
+PyObject* PyDatabaseObjectType::pyCreateMany(PyObject *databaseType, PyObject* args, PyObject* kwargs) {
+    return translateExceptionToPyObject([&] {
+        PyDatabaseObjectType* obType = PyDatabaseObjectType::check(databaseType);
+        if (!obType) {
+            throw std::runtime_error("Expected first argument to be a database type.");
+        }
+
+        View* view = View::currentView();
+        if (!view || !view->isWriteable()) {
+            throw std::runtime_error(
+                "Can't create instances of " + obType->m_schema_and_typename + " outside of a transaction."
+            );
+        }
+
+        if (obType->m_init_method) {
+            throw std::runtime_error(
+                "Can't use createMany on " + obType->m_schema_and_typename + " since it defines __init__."
+            );
+        }
+
+        if (PyTuple_Size(args) > 1) {
+            throw std::runtime_error("createMany takes at most one positional argument, the count.");
+        }
+
+        int64_t count = -1;
+
+        if (PyTuple_Size(args)) {
+            count = PyLong_AsLong(PyTuple_GetItem(args, 0));
+
+            if (count == -1 && PyErr_Occurred()) {
+                throw PythonExceptionSet();
             }
 
-            return false;
+            if (count < 0) {
+                throw std::runtime_error("Can't create a negative number of objects.");
+            }
+        }
+
+        std::vector<Column> columns = obType->parseColumnKwargs(kwargs, "createMany", count);
+
+        if (count < 0) {
+            throw std::runtime_error("createMany needs a count or at least one column of values.");
+        }
+
+        DatabaseConnectionState& state = view->getConnectionState();
+
+        bool exists = true;
+
+        //where each field's values come from: a column we were given, or one value for
+        //every object. Fields we weren't given get their default.
+        class FieldValues {
+        public:
+            field_id fieldId;
+
+            Type* fieldType;
+
+            const Column* column;
+
+            Instance value;
+
+            instance_ptr valueFor(int64_t k) const {
+                return column ? column->columnType->eltPtr(column->values.data(), k) : value.data();
+            }
+        };
+
+        std::map<std::string, FieldValues> fields;
+
+        for (const auto& column: columns) {
+            FieldValues& values = fields[column.name];
+            values.fieldType = column.fieldType;
+            values.column = &column;
+        }
+
+        for (const auto& nameAndType: obType->m_fields) {
+            if (fields.find(nameAndType.first) != fields.end()) {
+                continue;
+            }
+
+            Type* fieldType = nameAndType.second;
+
+            FieldValues& values = fields[nameAndType.first];
+            values.fieldType = fieldType;
+            values.column = nullptr;
+
+            if (nameAndType.first == " exists") {
+                values.value = Instance((instance_ptr)&exists, ::Bool::Make());
+                continue;
+            }
+
+            if (!fieldType->is_default_constructible()) {
+                throw std::runtime_error(
+                    "Can't construct instances of " + obType->m_schema_and_typename + "." +
+                        " without providing a value for " + nameAndType.first
+                );
+            }
+
+            values.value = Instance(fieldType, [&](instance_ptr tgt) { fieldType->constructor(tgt); });
+        }
+
+        for (auto& nameAndValues: fields) {
+            nameAndValues.second.fieldId = obType->fieldIdForNameAndState(nameAndValues.first, &state);
+        }
+
+        object_id firstOid = state.allocateIdentities(count);
+
+        for (int64_t k = 0; k < count; k++) {
+            view->newObject(obType->m_schema_and_typename, firstOid + k);
+        }
+
+        //the objects are all new, so we can write each field's column in one go
+        for (const auto& nameAndValues: fields) {
+            const FieldValues& values = nameAndValues.second;
+
+            view->setNewObjectsField(values.fieldId, firstOid, count, values.fieldType, [&](int64_t k) {
+                return values.valueFor(k);
+            });
+        }
+
+        //and there's nothing to pull out of the indices first. We serialize each index
+        //value the way calcCurIndexValue does, but straight from the columns.
+        for (const auto& indexAndFields: obType->m_indices) {
+            field_id indexFieldId = obType->fieldIdForNameAndState(indexAndFields.first, &state);
+
+            std::vector<const FieldValues*> indexFields;
+            for (const auto& fieldname: indexAndFields.second) {
+                indexFields.push_back(&fields[fieldname]);
+            }
+
+            bool compound = indexFields.size() != 1;
+
+            for (int64_t k = 0; k < count; k++) {
+                SerializationBuffer buffer(*view->getSerializationContext());
+
+                if (compound) {
+                    buffer.writeBeginCompound(0);
+                }
+
+                size_t fieldIndex = 0;
+                for (const FieldValues* values: indexFields) {
+                    values->fieldType->serialize(values->valueFor(k), buffer, fieldIndex++);
+                }
+
+                if (compound) {
+                    buffer.writeEndCompound();
+                }
+
+                buffer.finalize();
+
+                view->indexAdd(indexFieldId, Bytes((const char*)buffer.buffer(), buffer.size()), firstOid + k);
+            }
+        }
+
+        TupleOf<object_id> oids = TupleOf<object_id>::fromFill(count, [&](object_id* buffer) {
+            for (int64_t k = 0; k < count; k++) {
+                buffer[k] = firstOid + k;
+            }
+
+            return count;
         });
 
         return oids.toPython(
@@ -1148,43 +1533,469 @@ PyObject* PyDatabaseObjectType::pyLookupAll(PyObject *databaseType, PyObject* ar
     });
 }
 
-std::pair<field_id, index_value> PyDatabaseObjectType::parseIndexLookupKwarg(View* view, PyObject* kwargs) {
+/* static */
+PyObject* PyDatabaseObjectType::pySetMany(PyObject *databaseType, PyObject* args, PyObject* kwargs) {
+    return translateExceptionToPyObject([&] {
+        PyDatabaseObjectType* obType = PyDatabaseObjectType::check(databaseType);
+        if (!obType) {
+            throw std::runtime_error("Expected first argument to be a database type.");
+        }
+
+        View* view = View::currentView();
+        if (!view) {
+            throw std::runtime_error("Database attributes cannot be set without an active transaction.");
+        }
+
+        if (PyTuple_Size(args) != 1) {
+            throw std::runtime_error("setMany takes one positional argument, the objects to write to.");
+        }
+
+        PyObjectStealer objects(PySequence_Fast(PyTuple_GetItem(args, 0), "setMany expects a sequence of objects"));
+
+        if (!objects) {
+            throw PythonExceptionSet();
+        }
+
+        int64_t count = PySequence_Fast_GET_SIZE((PyObject*)objects);
+
+        std::vector<Column> columns = obType->parseColumnKwargs(kwargs, "setMany", count);
+
+        std::vector<object_id> oids;
+
+        for (int64_t k = 0; k < count; k++) {
+            PyObject* o = PySequence_Fast_GET_ITEM((PyObject*)objects, k);
+
+            if (o->ob_type != (PyTypeObject*)obType) {
+                throw std::runtime_error(
+                    "setMany on " + obType->m_schema_and_typename + " can't write to an instance of " +
+                        o->ob_type->tp_name
+                );
+            }
+
+            checkVisible(view, o);
+
+            oids.push_back(getObjectId(o));
+        }
+
+        DatabaseConnectionState& state = view->getConnectionState();
+
+        for (const auto& column: columns) {
+            field_id fieldId = obType->fieldIdForNameAndState(column.name, &state);
+
+            auto indexList = obType->m_field_to_indices.find(column.name);
+            const std::set<std::string>* indices =
+                indexList != obType->m_field_to_indices.end() ? &indexList->second : nullptr;
+
+            for (int64_t k = 0; k < count; k++) {
+                setFieldValueById(
+                    obType,
+                    view,
+                    oids[k],
+                    fieldId,
+                    indices,
+                    column.fieldType,
+                    column.columnType->eltPtr(column.values.data(), k)
+                );
+            }
+        }
+
+        return incref(Py_None);
+    });
+}
+
+std::vector<PyDatabaseObjectType::Column> PyDatabaseObjectType::parseColumnKwargs(
+        PyObject* kwargs,
+        const std::string& methodName,
+        int64_t& count
+        ) {
     if (kwargs && !PyDict_Check(kwargs)) {
         throw std::runtime_error("Kwargs was not a Dict");
     }
 
-    if (!kwargs || PyDict_Size(kwargs) == 0) {
-        //this is how we encode a single bool
-        return std::make_pair(
-            fieldIdForNameAndState(" exists", &view->getConnectionState()),
-            SerializationBuffer::serializeSingleBoolToBytes(true)
+    std::vector<Column> columns;
+
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+
+    while (kwargs && PyDict_Next(kwargs, &pos, &key, &value)) {
+        if (!PyUnicode_Check(key)) {
+            throw std::runtime_error("Invalid keyword argument: not a string");
+        }
+
+        std::string name = PyUnicode_AsUTF8(key);
+
+        auto fieldIt = m_fields.find(name);
+
+        if (fieldIt == m_fields.end()) {
+            throw std::runtime_error(
+                "Can't call " + methodName + " on " + m_schema_and_typename + " with an argument named " + name
+            );
+        }
+
+        Column column;
+        column.name = name;
+        column.fieldType = fieldIt->second;
+        column.columnType = TupleOfType::Make(column.fieldType);
+
+        try {
+            column.values = Instance(column.columnType, [&](instance_ptr tgt) {
+                PyInstance::copyConstructFromPythonInstance(column.columnType, tgt, value, ConversionLevel::ImplicitContainers);
+            });
+        } catch(std::exception& e) {
+            throw std::runtime_error(
+                "Failed to convert the values for " + m_schema_and_typename + "." + name + ": " + e.what()
+            );
+        }
+
+        int64_t columnCount = column.columnType->count(column.values.data());
+
+        if (count < 0) {
+            count = columnCount;
+        } else if (columnCount != count) {
+            throw std::runtime_error(
+                methodName + " got " + std::to_string(columnCount) + " values for " + name +
+                    " but expected " + std::to_string(count)
+            );
+        }
+
+        columns.push_back(column);
+    }
+
+    return columns;
+}
+
+/* static */
+PyObject* PyDatabaseObjectType::pyGather(PyObject *databaseType, PyObject* args, PyObject* kwargs) {
+    return translateExceptionToPyObject([&] {
+        PyDatabaseObjectType* obType = PyDatabaseObjectType::check(databaseType);
+        if (!obType) {
+            throw std::runtime_error("Expected first argument to be a database type.");
+        }
+
+        View* view = nullptr;
+        Type* fieldType = nullptr;
+        field_id fieldId;
+
+        std::vector<object_id> oids = obType->gatherTargets(args, kwargs, "gather", view, fieldType, fieldId);
+
+        ListOfType* listType = ListOfType::Make(fieldType);
+
+        Instance result(listType, [&](instance_ptr tgt) { listType->constructor(tgt); });
+
+        listType->reserve(result.data(), oids.size());
+
+        std::unique_ptr<Instance> defaultValue;
+
+        for (object_id oid: oids) {
+            listType->append(result.data(), obType->gatherValue(view, fieldId, fieldType, oid, defaultValue));
+        }
+
+        return PyInstance::extractPythonObject(result.data(), listType);
+    });
+}
+
+/* static */
+PyObject* PyDatabaseObjectType::pyGatherArray(PyObject *databaseType, PyObject* args, PyObject* kwargs) {
+    return translateExceptionToPyObject([&] {
+        PyDatabaseObjectType* obType = PyDatabaseObjectType::check(databaseType);
+        if (!obType) {
+            throw std::runtime_error("Expected first argument to be a database type.");
+        }
+
+        View* view = nullptr;
+        Type* fieldType = nullptr;
+        field_id fieldId;
+
+        std::vector<object_id> oids = obType->gatherTargets(args, kwargs, "gatherArray", view, fieldType, fieldId);
+
+        int numpyType = numpyTypeFor(fieldType);
+
+        if (numpyType < 0) {
+            throw std::runtime_error(
+                "Can't gather " + fieldType->name() + " into a numpy array. Use 'gather' instead."
+            );
+        }
+
+        npy_intp dims[1] = { (npy_intp)oids.size() };
+
+        PyObjectStealer array(PyArray_SimpleNew(1, dims, numpyType));
+
+        if (!array) {
+            throw PythonExceptionSet();
+        }
+
+        uint8_t* out = (uint8_t*)PyArray_DATA((PyArrayObject*)(PyObject*)array);
+        size_t bytecount = fieldType->bytecount();
+
+        std::unique_ptr<Instance> defaultValue;
+
+        for (size_t k = 0; k < oids.size(); k++) {
+            memcpy(out + k * bytecount, obType->gatherValue(view, fieldId, fieldType, oids[k], defaultValue), bytecount);
+        }
+
+        return incref((PyObject*)array);
+    });
+}
+
+/* static */
+int PyDatabaseObjectType::numpyTypeFor(Type* t) {
+    switch (t->getTypeCategory()) {
+        case Type::TypeCategory::catBool: return NPY_BOOL;
+        case Type::TypeCategory::catInt8: return NPY_INT8;
+        case Type::TypeCategory::catInt16: return NPY_INT16;
+        case Type::TypeCategory::catInt32: return NPY_INT32;
+        case Type::TypeCategory::catInt64: return NPY_INT64;
+        case Type::TypeCategory::catUInt8: return NPY_UINT8;
+        case Type::TypeCategory::catUInt16: return NPY_UINT16;
+        case Type::TypeCategory::catUInt32: return NPY_UINT32;
+        case Type::TypeCategory::catUInt64: return NPY_UINT64;
+        case Type::TypeCategory::catFloat32: return NPY_FLOAT32;
+        case Type::TypeCategory::catFloat64: return NPY_FLOAT64;
+        default: return -1;
+    }
+}
+
+std::vector<object_id> PyDatabaseObjectType::gatherTargets(
+        PyObject* args,
+        PyObject* kwargs,
+        const std::string& methodName,
+        View*& view,
+        Type*& fieldType,
+        field_id& fieldId
+        ) {
+    view = View::currentView();
+    if (!view) {
+        throw std::runtime_error(
+            "Can't " + methodName + " instances of " + m_schema_and_typename + " outside of a view."
         );
     }
 
-    if (PyDict_Size(kwargs) != 1) {
-        throw std::runtime_error("You may lookup from at most one index at a time.");
+    if (PyTuple_Size(args) < 1 || PyTuple_Size(args) > 2 || !PyUnicode_Check(PyTuple_GetItem(args, 0))) {
+        throw std::runtime_error(methodName + " expects a field name and, optionally, the objects to read.");
     }
 
-    PyObject *key, *value;
-    Py_ssize_t pos = 0;
+    std::string fieldName = PyUnicode_AsUTF8(PyTuple_GetItem(args, 0));
 
-    if (!PyDict_Next(kwargs, &pos, &key, &value)) {
-        throw std::runtime_error("Failed to iterate a dict even though it has items.");
+    auto fieldIt = m_fields.find(fieldName);
+    if (fieldIt == m_fields.end()) {
+        throw std::runtime_error("No field named " + fieldName + " defined on " + m_schema_and_typename);
     }
 
-    if (!PyUnicode_Check(key)) {
-        throw std::runtime_error("Invalid keyword argument: not a string");
+    fieldType = fieldIt->second;
+    fieldId = fieldIdForNameAndState(fieldName, &view->getConnectionState());
+
+    std::vector<object_id> oids;
+
+    PyObject* objects = PyTuple_Size(args) > 1 ? PyTuple_GetItem(args, 1) : Py_None;
+
+    if (objects == Py_None) {
+        std::vector<IndexLookupTerm> lookup = parseIndexLookupKwargs(view, kwargs);
+
+        view->indexLookup(lookup, [&](object_id o) {
+            oids.push_back(o);
+            return true;
+        });
+
+        view->prefetchLazyObjects(TupleOf<object_id>::fromBuffer(oids.data(), oids.size()));
+
+        return oids;
+    }
+
+    if (kwargs && PyDict_Size(kwargs)) {
+        throw std::runtime_error("Pass " + methodName + " either the objects to read or an index lookup, not both.");
+    }
+
+    Type* objectsType = PyInstance::extractTypeFrom((PyTypeObject*)objects->ob_type);
+
+    if (objectsType && (
+            objectsType->getTypeCategory() == Type::TypeCategory::catTupleOf
+            || objectsType->getTypeCategory() == Type::TypeCategory::catListOf)) {
+        TupleOrListOfType* containerType = (TupleOrListOfType*)objectsType;
+        Type* eltType = containerType->getEltType();
+
+        //a TupleOf our type (like lookupAll returns) is laid out as object_ids
+        if (eltType == PyInstance::unwrapTypeArgToTypePtr((PyObject*)this) || eltType == Int64::Make()) {
+            instance_ptr data = ((PyInstance*)objects)->dataPtr();
+            int64_t count = containerType->count(data);
+
+            for (int64_t k = 0; k < count; k++) {
+                oids.push_back(*(object_id*)containerType->eltPtr(data, k));
+            }
+        }
+    }
+
+    if (oids.empty()) {
+        iterate(objects, [&](PyObject* o) {
+            if (o->ob_type == (PyTypeObject*)this) {
+                oids.push_back(getObjectId(o));
+            } else if (PyLong_CheckExact(o)) {
+                oids.push_back(PyLong_AsLong(o));
+            } else {
+                throw std::runtime_error(
+                    methodName + " on " + m_schema_and_typename + " can't read from an instance of " +
+                        o->ob_type->tp_name
+                );
+            }
+        });
+    }
+
+    //bring in any lazily loaded objects in one go, rather than one at a time as we read them
+    view->prefetchLazyObjects(TupleOf<object_id>::fromBuffer(oids.data(), oids.size()));
+
+    for (object_id oid: oids) {
+        if (!view->objectIsVisible(m_schema_and_typename, oid)) {
+            PyErr_SetObject(getObjectDoesntExistException(), fromIntegerIdentity(oid));
+            throw PythonExceptionSet();
+        }
+    }
+
+    return oids;
+}
+
+instance_ptr PyDatabaseObjectType::gatherValue(
+        View* view,
+        field_id fieldId,
+        Type* fieldType,
+        object_id oid,
+        std::unique_ptr<Instance>& defaultValue
+        ) {
+    view->loadLazyObjectIfNeeded(oid);
+
+    instance_ptr data = view->getField(fieldId, oid, fieldType);
+
+    if (data) {
+        return data;
+    }
+
+    //as in lookupFieldValueById, an object that exists but never had the field set reads as the default
+    field_id existsFID = fieldIdForNameAndState(" exists", &view->getConnectionState());
+
+    if (!view->getField(existsFID, oid, ::Bool::Make())) {
+        PyErr_SetObject(getObjectDoesntExistException(), fromIntegerIdentity(oid));
+        throw PythonExceptionSet();
+    }
+
+    if (!defaultValue) {
+        defaultValue.reset(new Instance(fieldType, [&](instance_ptr tgt) {
+            fieldType->constructor(tgt);
+        }));
+    }
+
+    return defaultValue->data();
+}
+
+/* static */
+PyObject* PyDatabaseObjectType::pyFieldAccessor(PyObject *databaseType, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "fieldName", NULL };
+    PyObject* fieldName;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", (char**)kwlist, &fieldName)) {
+        return nullptr;
+    }
+
+    return PyObject_CallFunctionObjArgs((PyObject*)&PyType_DatabaseFieldAccessor, databaseType, fieldName, NULL);
+}
+
+std::vector<IndexLookupTerm> PyDatabaseObjectType::parseIndexLookupKwargs(View* view, PyObject* kwargs) {
+    if (kwargs && !PyDict_Check(kwargs)) {
+        throw std::runtime_error("Kwargs was not a Dict");
+    }
+
+    std::vector<IndexLookupTerm> terms;
+
+    if (!kwargs || PyDict_Size(kwargs) == 0) {
+        //this is how we encode a single bool
+        terms.push_back(
+            IndexLookupTerm::exact(
+                fieldIdForNameAndState(" exists", &view->getConnectionState()),
+                SerializationBuffer::serializeSingleBoolToBytes(true)
+            )
+        );
+        return terms;
     }
 
-    const char* argName = PyUnicode_AsUTF8(key);
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+
+    while (PyDict_Next(kwargs, &pos, &key, &value)) {
+        if (!PyUnicode_Check(key)) {
+            throw std::runtime_error("Invalid keyword argument: not a string");
+        }
+
+        const char* argName = PyUnicode_AsUTF8(key);
+
+        if (m_indexTypes.find(argName) == m_indexTypes.end()) {
+            throw std::runtime_error("No index named " + std::string(argName) + " defined on "
+                + m_schema_and_typename);
+        }
+
+        Type* indexValType = m_indexTypes[argName];
+
+        field_id indexFieldId = fieldIdForNameAndState(argName, &view->getConnectionState());
+
+        int isRange = PyObject_IsInstance(value, getIndexRangeType());
+        if (isRange == -1) {
+            throw PythonExceptionSet();
+        }
+
+        if (!isRange) {
+            terms.push_back(IndexLookupTerm::exact(indexFieldId, indexValueFor(view, indexValType, value)));
+            continue;
+        }
+
+        if (m_ordered_indices.find(argName) == m_ordered_indices.end()) {
+            throw std::runtime_error("Index " + std::string(argName) + " on " + m_schema_and_typename
+                + " is not ordered, so it doesn't support range lookups.");
+        }
+
+        //pull an attribute off 'value', which is an IndexRange
+        auto getRangeAttr = [&](const char* name) {
+            PyObject* res = PyObject_GetAttrString(value, name);
+            if (!res) {
+                throw PythonExceptionSet();
+            }
+            return res;
+        };
+
+        auto parseBound = [&](const char* name, bool& hasBound, Instance& bound) {
+            PyObject* boundVal = getRangeAttr(name);
+
+            if (boundVal != Py_None) {
+                bound = Instance(indexValType, [&](instance_ptr tgt) {
+                    PyInstance::copyConstructFromPythonInstance(indexValType, tgt, boundVal, ConversionLevel::ImplicitContainers);
+                });
+                hasBound = true;
+            }
+
+            decref(boundVal);
+        };
+
+        auto parseFlag = [&](const char* name, bool& flag) {
+            PyObject* flagVal = getRangeAttr(name);
+            int truth = PyObject_IsTrue(flagVal);
+            decref(flagVal);
+
+            if (truth == -1) {
+                throw PythonExceptionSet();
+            }
 
-    if (m_indexTypes.find(argName) == m_indexTypes.end()) {
-        throw std::runtime_error("No index named " + std::string(argName) + " defined on "
-            + m_schema_and_typename);
+            flag = truth;
+        };
+
+        IndexValueRange range;
+
+        parseBound("lo", range.hasLo, range.lo);
+        parseBound("hi", range.hasHi, range.hi);
+        parseFlag("includeLo", range.includeLo);
+        parseFlag("includeHi", range.includeHi);
+
+        terms.push_back(IndexLookupTerm::inRange(indexFieldId, indexValType, range));
     }
 
-    Type* indexValType = m_indexTypes[argName];
+    return terms;
+}
 
+index_value PyDatabaseObjectType::indexValueFor(View* view, Type* indexValType, PyObject* value) {
     Instance indexVal(indexValType, [&](instance_ptr tgt) {
         PyInstance::copyConstructFromPythonInstance(indexValType, tgt, value, ConversionLevel::ImplicitContainers);
     });
@@ -1196,10 +2007,33 @@ std::pair<field_id, index_value> PyDatabaseObjectType::parseIndexLookupKwarg(Vie
     buffer.finalize();
 
     //right now, index_value is just the serialization of the value.
-    return std::make_pair(
-        fieldIdForNameAndState(argName, &view->getConnectionState()),
-        Bytes((const char*)buffer.buffer(), buffer.size())
-    );
+    return Bytes((const char*)buffer.buffer(), buffer.size());
+}
+
+PyObject* PyDatabaseObjectType::getIndexRangeType() {
+    // we only remember the type once we've found it, so a failed import gets
+    // retried next time rather than failing forever.
+    static PyObject* indexRangeType = nullptr;
+
+    if (indexRangeType) {
+        return indexRangeType;
+    }
+
+    PyObjectStealer objectModule(PyImport_ImportModule("object_database.object"));
+
+    if (!objectModule) {
+        throw PythonExceptionSet();
+    }
+
+    PyObject* found = PyObject_GetAttrString(objectModule, "IndexRange");
+
+    if (!found) {
+        throw PythonExceptionSet();
+    }
+
+    indexRangeType = found;
+
+    return indexRangeType;
 }
 
 /* static */
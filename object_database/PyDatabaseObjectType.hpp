@@ -25,6 +25,50 @@
 //these are always subclasses of NamedTuple with '_identity', so that
 //serialization can happen
 struct PyDatabaseObjectType {
+  /*******
+  Everything tp_getattro and tp_setattro need to know about one attribute name,
+  worked out the first time we see it. We also keep these by the address of the
+  python string, which for 'obj.field' is an interned name from the code object,
+  so the common case costs a pointer lookup rather than string operations.
+  *******/
+  class AttributeSlot {
+  public:
+    enum class Kind { Missing, Identity, Class, Schema, Exists, Delete, Field, StaticMethod, Method, Property };
+
+    AttributeSlot() :
+        kind(Kind::Missing),
+        fieldType(nullptr),
+        method(nullptr),
+        getter(nullptr),
+        setter(nullptr),
+        indices(nullptr),
+        lastState(nullptr),
+        lastFieldId(0)
+    {
+    }
+
+    Kind kind;
+
+    std::string name;
+
+    //for fields
+    Type* fieldType;
+
+    //for methods and static methods. Borrowed from m_methods or m_static_methods.
+    PyObject* method;
+
+    //for properties. Borrowed from m_properties.
+    PyObject* getter;
+    PyObject* setter;
+
+    //for fields, the indices the field is in, or nullptr if there are none
+    const std::set<std::string>* indices;
+
+    //the field id in the connection state we looked it up in most recently
+    DatabaseConnectionState* lastState;
+    field_id lastFieldId;
+  };
+
   PyTypeObject typeObj;
 
   bool m_is_finalized;
@@ -51,6 +95,9 @@ struct PyDatabaseObjectType {
   //the type of each index value
   std::unordered_map<std::string, Type*> m_indexTypes;
 
+  //the indices that support range lookups
+  std::unordered_set<std::string> m_ordered_indices;
+
   //for each of our fields, which indices is it in?
   std::unordered_map<std::string, std::set<std::string> > m_field_to_indices;
 
@@ -62,6 +109,25 @@ struct PyDatabaseObjectType {
 
   static std::unordered_set<PyDatabaseObjectType*> s_database_object_types;
 
+  //the slot for each attribute name we've looked up. We don't keep slots for names
+  //that don't exist, so looking up arbitrary names doesn't grow this.
+  std::unordered_map<std::string, AttributeSlot> m_attribute_slots;
+
+  //the same slots, keyed by interned python string. We hold a reference to each key.
+  std::unordered_map<PyObject*, AttributeSlot*> m_interned_attribute_slots;
+
+  //find the slot for 'attrName', which must be a string.
+  AttributeSlot* attributeSlotFor(PyObject* attrName);
+
+  //work out what 'name' refers to on this type.
+  AttributeSlot computeAttributeSlot(const std::string& name);
+
+  //forget all our slots. Adding a member to the type calls this.
+  void clearAttributeSlots();
+
+  //the field id for a field's slot in 'state'
+  field_id fieldIdForSlot(AttributeSlot& slot, DatabaseConnectionState* state);
+
 
   /*******
     ensure that all fields for value 'oid' have valid populated values in the given transaction.
@@ -111,7 +177,7 @@ struct PyDatabaseObjectType {
 
   void addField(std::string name, Type* fieldType);
 
-  void addIndex(std::string name, const std::vector<std::string>& names);
+  void addIndex(std::string name, const std::vector<std::string>& names, bool ordered = false);
 
   void addMethod(std::string name, PyObject* method);
 
@@ -139,8 +205,22 @@ struct PyDatabaseObjectType {
 
   static PyObject* lookupFieldValue(PyDatabaseObjectType* obType, object_id oid, std::string attributeName, Type* fieldType);
 
+  //read field 'fieldId' of 'oid' in 'view'.
+  static PyObject* lookupFieldValueById(PyDatabaseObjectType* obType, View* view, object_id oid, field_id fieldId, Type* fieldType);
+
   static void setFieldValue(PyDatabaseObjectType* obType, object_id oid, std::string attr, Type* fieldType, instance_ptr data);
 
+  //write field 'fieldId' of 'oid' in 'view', keeping 'indices' (the field's indices, or nullptr) up to date.
+  static void setFieldValueById(
+    PyDatabaseObjectType* obType,
+    View* view,
+    object_id oid,
+    field_id fieldId,
+    const std::set<std::string>* indices,
+    Type* fieldType,
+    instance_ptr data
+  );
+
   static PyObject* pySetModule(PyObject *none, PyObject* args, PyObject* kwargs);
 
   static PyObject* pyAddField(PyObject *none, PyObject* args, PyObject* kwargs);
@@ -167,7 +247,63 @@ struct PyDatabaseObjectType {
 
   static PyObject* pyLookupAll(PyObject *none, PyObject* args, PyObject* kwargs);
 
-  std::pair<field_id, index_value> parseIndexLookupKwarg(View* view, PyObject* kwargs);
+  static PyObject* pyCreateMany(PyObject *none, PyObject* args, PyObject* kwargs);
+
+  static PyObject* pySetMany(PyObject *none, PyObject* args, PyObject* kwargs);
+
+  //one field's values for 'createMany' or 'setMany', converted to a TupleOf the field's type
+  class Column {
+  public:
+    std::string name;
+
+    Type* fieldType;
+
+    TupleOfType* columnType;
+
+    Instance values;
+  };
+
+  //convert each keyword argument to a Column. 'count' is the length they all have to
+  //share, or -1 to take it from the first one.
+  std::vector<Column> parseColumnKwargs(PyObject* kwargs, const std::string& methodName, int64_t& count);
+
+  static PyObject* pyGather(PyObject *none, PyObject* args, PyObject* kwargs);
+
+  static PyObject* pyGatherArray(PyObject *none, PyObject* args, PyObject* kwargs);
+
+  //a DatabaseFieldAccessor for one of our fields
+  static PyObject* pyFieldAccessor(PyObject *none, PyObject* args, PyObject* kwargs);
+
+  //the numpy type number with the same layout as 't', or -1 if there isn't one
+  static int numpyTypeFor(Type* t);
+
+  /*****
+  parse the (field, objects=None, **lookup) arguments of 'gather' and 'gatherArray'.
+  Returns the ids of the objects to read, which are either 'objects' or the result
+  of the index lookup, all of them visible in the current view.
+  *****/
+  std::vector<object_id> gatherTargets(
+    PyObject* args,
+    PyObject* kwargs,
+    const std::string& methodName,
+    View*& view,
+    Type*& fieldType,
+    field_id& fieldId
+  );
+
+  //the value of 'fieldId' for 'oid', or 'defaultValue' (which we construct the first
+  //time we need it) if the object exists but has never had it set
+  instance_ptr gatherValue(View* view, field_id fieldId, Type* fieldType, object_id oid, std::unique_ptr<Instance>& defaultValue);
+
+  //parse the keyword arguments of a lookup into one term per index. Each argument
+  //is either a value of the index's type, or (for ordered indices) an IndexRange.
+  std::vector<IndexLookupTerm> parseIndexLookupKwargs(View* view, PyObject* kwargs);
+
+  //serialize 'value' as an index value of type 'indexValType'
+  static index_value indexValueFor(View* view, Type* indexValType, PyObject* value);
+
+  //lookup the object_database.object.IndexRange python class
+  static PyObject* getIndexRangeType();
 
   //check if an object is visible (via subscriptions) in the current view.
   //sets a python exception and throws PythonExceptionSet if not.
@@ -0,0 +1,379 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#include <Python.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <typed_python/util.hpp>
+
+#include "PyLogStructuredStore.hpp"
+
+void PyLogStructuredStore::dealloc(PyLogStructuredStore* self)
+{
+    {
+        // closing the file can block
+        PyEnsureGilReleased releaseTheGil;
+        self->store.~shared_ptr();
+    }
+
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+PyObject* PyLogStructuredStore::new_(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyLogStructuredStore *self;
+    self = (PyLogStructuredStore*)type->tp_alloc(type, 0);
+
+    if (self != NULL) {
+        new (&self->store) std::shared_ptr<LogStructuredStore>();
+    }
+    return (PyObject*)self;
+}
+
+int PyLogStructuredStore::init(PyLogStructuredStore *self, PyObject *args, PyObject *kwargs)
+{
+    static const char* kwlist[] = { "path", "sync", "compactionMinBytes", NULL };
+    const char* path;
+    int sync = 1;
+    int64_t compactionMinBytes = 64 * 1024 * 1024;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|pl", (char**)kwlist, &path, &sync, &compactionMinBytes)) {
+        return -1;
+    }
+
+    return translateExceptionToPyObjectReturningInt([&]() {
+        std::string pathStr(path);
+
+        // reading the log of a large database takes a while
+        std::shared_ptr<LogStructuredStore> store;
+
+        {
+            PyEnsureGilReleased releaseTheGil;
+            store.reset(new LogStructuredStore(pathStr, sync, compactionMinBytes));
+        }
+
+        self->store = store;
+
+        return 0;
+    });
+}
+
+LogStructuredStore& PyLogStructuredStore::getStore() {
+    if (!store) {
+        throw std::runtime_error("LogStructuredStore was never initialized.");
+    }
+
+    return *store;
+}
+
+static std::string bytesArg(PyObject* o, const char* what) {
+    if (!PyBytes_Check(o)) {
+        throw std::runtime_error(std::string("Expected bytes for ") + what + ", not " + o->ob_type->tp_name);
+    }
+
+    return std::string(PyBytes_AS_STRING(o), PyBytes_GET_SIZE(o));
+}
+
+PyObject* PyLogStructuredStore::get(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "key", NULL };
+    PyObject* key;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", (char**)kwlist, &key)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        std::string value;
+
+        if (!self->getStore().get(bytesArg(key, "a key"), value)) {
+            return incref(Py_None);
+        }
+
+        return PyBytes_FromStringAndSize(value.data(), value.size());
+    });
+}
+
+PyObject* PyLogStructuredStore::getSeveral(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "keys", NULL };
+    PyObject* keys;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", (char**)kwlist, &keys)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        LogStructuredStore& store = self->getStore();
+
+        PyObjectStealer res(PyList_New(0));
+
+        std::string value;
+
+        iterate(keys, [&](PyObject* key) {
+            PyObjectStealer item(
+                store.get(bytesArg(key, "a key"), value) ?
+                    PyBytes_FromStringAndSize(value.data(), value.size())
+                :   incref(Py_None)
+            );
+
+            if (!item || PyList_Append(res, item) != 0) {
+                throw PythonExceptionSet();
+            }
+        });
+
+        return incref((PyObject*)res);
+    });
+}
+
+PyObject* PyLogStructuredStore::getSetMembers(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "key", NULL };
+    PyObject* key;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", (char**)kwlist, &key)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        std::vector<std::string> members = self->getStore().getSetMembers(bytesArg(key, "a key"));
+
+        PyObjectStealer res(PyList_New(0));
+
+        for (const auto& member: members) {
+            PyObjectStealer item(PyBytes_FromStringAndSize(member.data(), member.size()));
+
+            if (!item || PyList_Append(res, item) != 0) {
+                throw PythonExceptionSet();
+            }
+        }
+
+        return incref((PyObject*)res);
+    });
+}
+
+PyObject* PyLogStructuredStore::exists(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "key", NULL };
+    PyObject* key;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", (char**)kwlist, &key)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        return incref(self->getStore().exists(bytesArg(key, "a key")) ? Py_True : Py_False);
+    });
+}
+
+PyObject* PyLogStructuredStore::setSeveral(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "values", "adds", "removes", NULL };
+    PyObject* values;
+    PyObject* adds;
+    PyObject* removes;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO", (char**)kwlist, &values, &adds, &removes)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        if (!PyDict_Check(values) || !PyDict_Check(adds) || !PyDict_Check(removes)) {
+            throw std::runtime_error("setSeveral expects three dicts.");
+        }
+
+        LogStructuredStore::Batch batch;
+
+        PyObject *key, *value;
+        Py_ssize_t pos = 0;
+
+        while (PyDict_Next(values, &pos, &key, &value)) {
+            if (value == Py_None) {
+                batch.deletes.push_back(bytesArg(key, "a key"));
+            } else {
+                batch.values.push_back(std::make_pair(bytesArg(key, "a key"), bytesArg(value, "a value")));
+            }
+        }
+
+        auto readMembers = [&](PyObject* dict, std::vector<std::pair<std::string, std::vector<std::string> > >& out) {
+            PyObject *setKey, *members;
+            Py_ssize_t setPos = 0;
+
+            while (PyDict_Next(dict, &setPos, &setKey, &members)) {
+                out.push_back(std::make_pair(bytesArg(setKey, "a key"), std::vector<std::string>()));
+
+                iterate(members, [&](PyObject* member) {
+                    out.back().second.push_back(bytesArg(member, "a set member"));
+                });
+            }
+        };
+
+        readMembers(adds, batch.adds);
+        readMembers(removes, batch.removes);
+
+        std::vector<std::string> newSets;
+        std::vector<std::string> droppedSets;
+
+        {
+            PyEnsureGilReleased releaseTheGil;
+
+            self->getStore().commit(batch, newSets, droppedSets);
+        }
+
+        auto toList = [&](const std::vector<std::string>& keys) {
+            PyObject* res = PyList_New(0);
+
+            for (const auto& k: keys) {
+                PyObjectStealer item(PyBytes_FromStringAndSize(k.data(), k.size()));
+                PyList_Append(res, item);
+            }
+
+            return res;
+        };
+
+        PyObjectStealer newSetList(toList(newSets));
+        PyObjectStealer droppedSetList(toList(droppedSets));
+
+        return PyTuple_Pack(2, (PyObject*)newSetList, (PyObject*)droppedSetList);
+    });
+}
+
+PyObject* PyLogStructuredStore::compact(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { NULL };
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        LogStructuredStore& store = self->getStore();
+
+        {
+            PyEnsureGilReleased releaseTheGil;
+            store.compact();
+        }
+
+        return incref(Py_None);
+    });
+}
+
+PyObject* PyLogStructuredStore::failWritesForTesting(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "count", NULL };
+    int64_t count;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "l", (char**)kwlist, &count)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        self->getStore().failWritesForTesting(count);
+
+        return incref(Py_None);
+    });
+}
+
+PyObject* PyLogStructuredStore::stats(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { NULL };
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        LogStructuredStore& store = self->getStore();
+
+        std::pair<size_t, size_t> keyCounts = store.keyCounts();
+
+        PyObject* res = PyDict_New();
+
+        auto setItem = [&](const char* name, int64_t value) {
+            PyObject* pyValue = PyLong_FromLong(value);
+            PyDict_SetItemString(res, name, pyValue);
+            decref(pyValue);
+        };
+
+        setItem("logBytes", store.logBytes());
+        setItem("liveBytes", store.liveBytes());
+        setItem("valueKeys", keyCounts.first);
+        setItem("setKeys", keyCounts.second);
+
+        return res;
+    });
+}
+
+PyMethodDef PyLogStructuredStore_methods[] = {
+    {"get", (PyCFunction) PyLogStructuredStore::get, METH_VARARGS | METH_KEYWORDS},
+    {"getSeveral", (PyCFunction) PyLogStructuredStore::getSeveral, METH_VARARGS | METH_KEYWORDS},
+    {"getSetMembers", (PyCFunction) PyLogStructuredStore::getSetMembers, METH_VARARGS | METH_KEYWORDS},
+    {"exists", (PyCFunction) PyLogStructuredStore::exists, METH_VARARGS | METH_KEYWORDS},
+    {"setSeveral", (PyCFunction) PyLogStructuredStore::setSeveral, METH_VARARGS | METH_KEYWORDS},
+    {"compact", (PyCFunction) PyLogStructuredStore::compact, METH_VARARGS | METH_KEYWORDS},
+    {"stats", (PyCFunction) PyLogStructuredStore::stats, METH_VARARGS | METH_KEYWORDS},
+    {"failWritesForTesting", (PyCFunction) PyLogStructuredStore::failWritesForTesting, METH_VARARGS | METH_KEYWORDS},
+
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject PyType_LogStructuredStore = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "LogStructuredStore",
+    .tp_basicsize = sizeof(PyLogStructuredStore),
+    .tp_itemsize = 0,
+    .tp_dealloc = (destructor) PyLogStructuredStore::dealloc,
+    #if PY_MINOR_VERSION < 8
+    .tp_print = 0,
+    #else
+    .tp_vectorcall_offset = 0,                  // printfunc  (Changed to tp_vectorcall_offset in Python 3.8)
+    #endif
+    .tp_getattr = 0,
+    .tp_setattr = 0,
+    .tp_as_async = 0,
+    .tp_repr = 0,
+    .tp_as_number = 0,
+    .tp_as_sequence = 0,
+    .tp_as_mapping = 0,
+    .tp_hash = 0,
+    .tp_call = 0,
+    .tp_str = 0,
+    .tp_getattro = 0,
+    .tp_setattro = 0,
+    .tp_as_buffer = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = 0,
+    .tp_traverse = 0,
+    .tp_clear = 0,
+    .tp_richcompare = 0,
+    .tp_weaklistoffset = 0,
+    .tp_iter = 0,
+    .tp_iternext = 0,
+    .tp_methods = PyLogStructuredStore_methods,
+    .tp_members = 0,
+    .tp_getset = 0,
+    .tp_base = 0,
+    .tp_dict = 0,
+    .tp_descr_get = 0,
+    .tp_descr_set = 0,
+    .tp_dictoffset = 0,
+    .tp_init = (initproc) PyLogStructuredStore::init,
+    .tp_alloc = 0,
+    .tp_new = PyLogStructuredStore::new_,
+    .tp_free = 0,
+    .tp_is_gc = 0,
+    .tp_bases = 0,
+    .tp_mro = 0,
+    .tp_cache = 0,
+    .tp_subclasses = 0,
+    .tp_weaklist = 0,
+    .tp_del = 0,
+    .tp_version_tag = 0,
+    .tp_finalize = 0,
+};
@@ -0,0 +1,58 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <Python.h>
+#include "LogStructuredStore.hpp"
+#include <memory>
+
+extern PyTypeObject PyType_LogStructuredStore;
+
+// the native half of persistence.LogStructuredPersistence. Keys, values and set
+// members are all bytes here.
+class PyLogStructuredStore {
+public:
+    PyObject_HEAD;
+    std::shared_ptr<LogStructuredStore> store;
+
+    static void dealloc(PyLogStructuredStore *self);
+
+    static PyObject *new_(PyTypeObject *type, PyObject *args, PyObject *kwds);
+
+    static PyObject* get(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* getSeveral(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* getSetMembers(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* exists(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs);
+
+    // returns (newSets, droppedSets). See LogStructuredStore::commit.
+    static PyObject* setSeveral(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* compact(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* stats(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs);
+
+    // make the next 'count' commits fail to write. See LogStructuredStore::failWritesForTesting.
+    static PyObject* failWritesForTesting(PyLogStructuredStore* self, PyObject* args, PyObject* kwargs);
+
+    static int init(PyLogStructuredStore *self, PyObject *args, PyObject *kwds);
+
+    // the store, or throw if we were never initialized
+    LogStructuredStore& getStore();
+};
@@ -0,0 +1,427 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#include <Python.h>
+#include <map>
+#include <memory>
+#include <vector>
+#include <typed_python/util.hpp>
+
+#include "PyServerTransactionRouter.hpp"
+#include "ServerTransactionRouter.hpp"
+#include "IndexId.hpp"
+#include "ObjectFieldId.hpp"
+
+typedef ConstDict<ObjectFieldId, OneOf<None, Bytes> > writes_type;
+typedef ConstDict<IndexId, TupleOf<object_id> > index_changes_type;
+
+void PyServerTransactionRouter::dealloc(PyServerTransactionRouter* self)
+{
+    self->router.~shared_ptr();
+
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+PyObject* PyServerTransactionRouter::new_(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyServerTransactionRouter *self;
+    self = (PyServerTransactionRouter*)type->tp_alloc(type, 0);
+
+    if (self != NULL) {
+        new (&self->router) std::shared_ptr<ServerTransactionRouter>();
+    }
+    return (PyObject*)self;
+}
+
+int PyServerTransactionRouter::init(PyServerTransactionRouter *self, PyObject *args, PyObject *kwds)
+{
+    self->router.reset(new ServerTransactionRouter());
+
+    return 0;
+}
+
+PyObject* PyServerTransactionRouter::subscribeToField(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "channel", "field_id", "isLazy", NULL };
+    int64_t channel;
+    int64_t field;
+    int isLazy;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "llp", (char**)kwlist, &channel, &field, &isLazy)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        self->router->subscribeToField(channel, field, isLazy);
+
+        return incref(Py_None);
+    });
+}
+
+PyObject* PyServerTransactionRouter::subscribeToIndex(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "channel", "index", "isLazy", NULL };
+    int64_t channel;
+    PyObject* index;
+    int isLazy;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "lOp", (char**)kwlist, &channel, &index, &isLazy)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        IndexId indexId = IndexId::fromPython(index);
+
+        self->router->subscribeToIndex(channel, IndexKey(indexId.fieldId(), indexId.indexValue()), isLazy);
+
+        return incref(Py_None);
+    });
+}
+
+PyObject* PyServerTransactionRouter::subscribeToIds(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "channel", "object_ids", NULL };
+    int64_t channel;
+    PyObject* oids;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "lO", (char**)kwlist, &channel, &oids)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        TupleOf<object_id> ids = TupleOf<object_id>::fromPython(oids);
+
+        std::vector<object_id> newIds = self->router->subscribeToIds(
+            channel,
+            ids.size() ? &ids[0] : nullptr,
+            ids.size()
+        );
+
+        return TupleOf<object_id>::fromBuffer(newIds.data(), newIds.size()).toPython();
+    });
+}
+
+PyObject* PyServerTransactionRouter::isSubscribedToField(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "channel", "field_id", NULL };
+    int64_t channel;
+    int64_t field;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ll", (char**)kwlist, &channel, &field)) {
+        return nullptr;
+    }
+
+    return incref(self->router->isSubscribedToField(channel, field) ? Py_True : Py_False);
+}
+
+PyObject* PyServerTransactionRouter::dropChannel(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "channel", NULL };
+    int64_t channel;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "l", (char**)kwlist, &channel)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        self->router->dropChannel(channel);
+
+        return incref(Py_None);
+    });
+}
+
+PyObject* PyServerTransactionRouter::channelCount(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { NULL };
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+        return nullptr;
+    }
+
+    return PyLong_FromLong(self->router->channelCount());
+}
+
+PyObject* PyServerTransactionRouter::route(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "field_ids", "object_ids", "set_adds", NULL };
+    PyObject* fieldIds;
+    PyObject* oids;
+    PyObject* setAdds;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO", (char**)kwlist, &fieldIds, &oids, &setAdds)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        TupleOf<field_id> fieldTuple = TupleOf<field_id>::fromPython(fieldIds);
+        TupleOf<object_id> oidTuple = TupleOf<object_id>::fromPython(oids);
+        auto cd_set_adds = ConstDict<IndexId, TupleOf<object_id> >::fromPython(setAdds);
+
+        std::vector<field_id> fields;
+        std::vector<object_id> mentioned;
+
+        for (field_id field: fieldTuple) {
+            fields.push_back(field);
+        }
+
+        for (object_id oid: oidTuple) {
+            mentioned.push_back(oid);
+        }
+
+        std::vector<std::pair<IndexKey, TupleOf<object_id> > > adds;
+
+        for (const auto& indexAndOids: cd_set_adds) {
+            adds.push_back(std::make_pair(
+                IndexKey(indexAndOids.first.fieldId(), indexAndOids.first.indexValue()),
+                indexAndOids.second
+            ));
+        }
+
+        ServerTransactionRouter::Route route = self->router->route(fields, mentioned, adds);
+
+        PyObjectStealer increases(PyList_New(0));
+
+        for (const auto& increase: route.increases) {
+            PyObjectStealer index(IndexId(increase.index.fieldId(), increase.index.indexValue()).toPython());
+            PyObjectStealer newIds(
+                TupleOf<object_id>::fromBuffer(increase.newIds.data(), increase.newIds.size()).toPython()
+            );
+
+            if (!index || !newIds) {
+                throw PythonExceptionSet();
+            }
+
+            PyObjectStealer entry(Py_BuildValue("(OlO)", (PyObject*)index, increase.channel, (PyObject*)newIds));
+
+            if (!entry || PyList_Append(increases, entry) != 0) {
+                throw PythonExceptionSet();
+            }
+        }
+
+        PyObjectStealer channels(
+            TupleOf<int64_t>::fromBuffer(route.channels.data(), route.channels.size()).toPython()
+        );
+        PyObjectStealer priorChannels(
+            TupleOf<int64_t>::fromBuffer(route.priorChannels.data(), route.priorChannels.size()).toPython()
+        );
+
+        if (!channels || !priorChannels) {
+            throw PythonExceptionSet();
+        }
+
+        return Py_BuildValue("(OOO)", (PyObject*)increases, (PyObject*)channels, (PyObject*)priorChannels);
+    });
+}
+
+// the members of each index change that 'filter' lets through. We leave out changes
+// that end up empty, and clear 'everything' if we left anything out.
+static index_changes_type filterIndexChanges(
+            const ServerTransactionRouter::Filter& filter,
+            const index_changes_type& changes,
+            bool& everything
+            ) {
+    std::vector<std::pair<IndexId, TupleOf<object_id> > > kept;
+    std::vector<object_id> oids;
+
+    for (const auto& indexAndOids: changes) {
+        oids.clear();
+
+        for (object_id oid: indexAndOids.second) {
+            if (filter.sees(indexAndOids.first.fieldId(), oid)) {
+                oids.push_back(oid);
+            }
+        }
+
+        if (oids.size() != indexAndOids.second.size()) {
+            everything = false;
+        }
+
+        if (oids.size()) {
+            kept.push_back(std::make_pair(
+                indexAndOids.first,
+                TupleOf<object_id>::fromBuffer(oids.data(), oids.size())
+            ));
+        }
+    }
+
+    return index_changes_type(kept);
+}
+
+PyObject* PyServerTransactionRouter::filterTransaction(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "channels", "writes", "set_adds", "set_removes", NULL };
+    PyObject* channels;
+    PyObject* writes;
+    PyObject* setAdds;
+    PyObject* setRemoves;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOO", (char**)kwlist, &channels, &writes, &setAdds, &setRemoves)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        TupleOf<int64_t> channelTuple = TupleOf<int64_t>::fromPython(channels);
+        writes_type cdWrites = writes_type::fromPython(writes);
+        index_changes_type cdSetAdds = index_changes_type::fromPython(setAdds);
+        index_changes_type cdSetRemoves = index_changes_type::fromPython(setRemoves);
+
+        PyObjectStealer res(PyList_New(0));
+
+        for (int64_t channel: channelTuple) {
+            ServerTransactionRouter::Filter filter = self->router->filterFor(channel);
+
+            bool everything = true;
+
+            std::vector<std::pair<ObjectFieldId, OneOf<None, Bytes> > > keptWrites;
+
+            for (const auto& keyAndValue: cdWrites) {
+                if (filter.sees(keyAndValue.first.fieldId(), keyAndValue.first.objId())) {
+                    keptWrites.push_back(std::make_pair(keyAndValue.first, keyAndValue.second));
+                } else {
+                    everything = false;
+                }
+            }
+
+            index_changes_type keptAdds = filterIndexChanges(filter, cdSetAdds, everything);
+            index_changes_type keptRemoves = filterIndexChanges(filter, cdSetRemoves, everything);
+
+            if (everything) {
+                if (PyList_Append(res, Py_None) != 0) {
+                    throw PythonExceptionSet();
+                }
+                continue;
+            }
+
+            PyObjectStealer pyWrites(writes_type(keptWrites).toPython());
+            PyObjectStealer pyAdds(keptAdds.toPython());
+            PyObjectStealer pyRemoves(keptRemoves.toPython());
+
+            if (!pyWrites || !pyAdds || !pyRemoves) {
+                throw PythonExceptionSet();
+            }
+
+            PyObjectStealer entry(PyTuple_Pack(3, (PyObject*)pyWrites, (PyObject*)pyAdds, (PyObject*)pyRemoves));
+
+            if (!entry || PyList_Append(res, entry) != 0) {
+                throw PythonExceptionSet();
+            }
+        }
+
+        return incref(res);
+    });
+}
+
+PyObject* PyServerTransactionRouter::indexReverseLookupKvs(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "set_adds", "set_removes", NULL };
+    PyObject* setAdds;
+    PyObject* setRemoves;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO", (char**)kwlist, &setAdds, &setRemoves)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        index_changes_type cdSetAdds = index_changes_type::fromPython(setAdds);
+        index_changes_type cdSetRemoves = index_changes_type::fromPython(setRemoves);
+
+        // removes first, so an object that moves between values ends up with the new one
+        std::map<std::pair<field_id, object_id>, OneOf<None, Bytes> > values;
+
+        for (const auto& indexAndOids: cdSetRemoves) {
+            for (object_id oid: indexAndOids.second) {
+                values[std::make_pair(indexAndOids.first.fieldId(), oid)] = None();
+            }
+        }
+
+        for (const auto& indexAndOids: cdSetAdds) {
+            for (object_id oid: indexAndOids.second) {
+                values[std::make_pair(indexAndOids.first.fieldId(), oid)] = indexAndOids.first.indexValue();
+            }
+        }
+
+        std::vector<std::pair<ObjectFieldId, OneOf<None, Bytes> > > kvs;
+
+        for (const auto& keyAndValue: values) {
+            kvs.push_back(std::make_pair(
+                ObjectFieldId(keyAndValue.first.second, keyAndValue.first.first, true),
+                keyAndValue.second
+            ));
+        }
+
+        return writes_type(kvs).toPython();
+    });
+}
+
+PyMethodDef PyServerTransactionRouter_methods[] = {
+    {"subscribeToField", (PyCFunction) PyServerTransactionRouter::subscribeToField, METH_VARARGS | METH_KEYWORDS},
+    {"subscribeToIndex", (PyCFunction) PyServerTransactionRouter::subscribeToIndex, METH_VARARGS | METH_KEYWORDS},
+    {"subscribeToIds", (PyCFunction) PyServerTransactionRouter::subscribeToIds, METH_VARARGS | METH_KEYWORDS},
+    {"isSubscribedToField", (PyCFunction) PyServerTransactionRouter::isSubscribedToField, METH_VARARGS | METH_KEYWORDS},
+    {"dropChannel", (PyCFunction) PyServerTransactionRouter::dropChannel, METH_VARARGS | METH_KEYWORDS},
+    {"channelCount", (PyCFunction) PyServerTransactionRouter::channelCount, METH_VARARGS | METH_KEYWORDS},
+    {"route", (PyCFunction) PyServerTransactionRouter::route, METH_VARARGS | METH_KEYWORDS},
+    {"filterTransaction", (PyCFunction) PyServerTransactionRouter::filterTransaction, METH_VARARGS | METH_KEYWORDS},
+    {"indexReverseLookupKvs", (PyCFunction) PyServerTransactionRouter::indexReverseLookupKvs, METH_VARARGS | METH_KEYWORDS},
+
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject PyType_ServerTransactionRouter = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "ServerTransactionRouter",
+    .tp_basicsize = sizeof(PyServerTransactionRouter),
+    .tp_itemsize = 0,
+    .tp_dealloc = (destructor) PyServerTransactionRouter::dealloc,
+    #if PY_MINOR_VERSION < 8
+    .tp_print = 0,
+    #else
+    .tp_vectorcall_offset = 0,                  // printfunc  (Changed to tp_vectorcall_offset in Python 3.8)
+    #endif
+    .tp_getattr = 0,
+    .tp_setattr = 0,
+    .tp_as_async = 0,
+    .tp_repr = 0,
+    .tp_as_number = 0,
+    .tp_as_sequence = 0,
+    .tp_as_mapping = 0,
+    .tp_hash = 0,
+    .tp_call = 0,
+    .tp_str = 0,
+    .tp_getattro = 0,
+    .tp_setattro = 0,
+    .tp_as_buffer = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = 0,
+    .tp_traverse = 0,
+    .tp_clear = 0,
+    .tp_richcompare = 0,
+    .tp_weaklistoffset = 0,
+    .tp_iter = 0,
+    .tp_iternext = 0,
+    .tp_methods = PyServerTransactionRouter_methods,
+    .tp_members = 0,
+    .tp_getset = 0,
+    .tp_base = 0,
+    .tp_dict = 0,
+    .tp_descr_get = 0,
+    .tp_descr_set = 0,
+    .tp_dictoffset = 0,
+    .tp_init = (initproc) PyServerTransactionRouter::init,
+    .tp_alloc = 0,
+    .tp_new = PyServerTransactionRouter::new_,
+    .tp_free = 0,
+    .tp_is_gc = 0,
+    .tp_bases = 0,
+    .tp_mro = 0,
+    .tp_cache = 0,
+    .tp_subclasses = 0,
+    .tp_weaklist = 0,
+    .tp_del = 0,
+    .tp_version_tag = 0,
+    .tp_finalize = 0,
+};
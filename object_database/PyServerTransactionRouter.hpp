@@ -0,0 +1,59 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <Python.h>
+#include "ServerTransactionRouter.hpp"
+#include <memory>
+
+extern PyTypeObject PyType_ServerTransactionRouter;
+
+class PyServerTransactionRouter {
+public:
+    PyObject_HEAD;
+    std::shared_ptr<ServerTransactionRouter> router;
+
+    static void dealloc(PyServerTransactionRouter *self);
+
+    static PyObject *new_(PyTypeObject *type, PyObject *args, PyObject *kwds);
+
+    static PyObject* subscribeToField(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* subscribeToIndex(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs);
+
+    // returns the ids the channel wasn't already subscribed to
+    static PyObject* subscribeToIds(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* isSubscribedToField(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* dropChannel(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* channelCount(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs);
+
+    // returns (increases, channels, priorChannels). See ServerTransactionRouter::route.
+    static PyObject* route(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs);
+
+    // for each of 'channels', None if it needs all of a transaction's writes, set_adds
+    // and set_removes, or else the (writes, set_adds, set_removes) it does need.
+    static PyObject* filterTransaction(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs);
+
+    // the ObjectFieldId(isIndexValue=True) entries recording each object's new value
+    // of each index 'set_adds' and 'set_removes' change, or None if it left the index.
+    static PyObject* indexReverseLookupKvs(PyServerTransactionRouter* self, PyObject* args, PyObject* kwargs);
+
+    static int init(PyServerTransactionRouter *self, PyObject *args, PyObject *kwds);
+};
@@ -0,0 +1,178 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <Python.h>
+#include <memory>
+
+#include "SnapshotView.hpp"
+#include "PyDatabaseConnectionState.hpp"
+
+/*******
+Python access to a SnapshotView. Every read gives up the GIL while it looks at
+the snapshot, so python threads can read from the same snapshot in parallel.
+*******/
+
+class PySnapshotView {
+public:
+    PyObject_HEAD;
+    std::shared_ptr<SnapshotView> state;
+
+    static void dealloc(PySnapshotView *self)
+    {
+        self->state.~shared_ptr();
+        Py_TYPE(self)->tp_free((PyObject*)self);
+    }
+
+    static PyObject *new_(PyTypeObject* type, PyObject* args, PyObject* kwargs)
+    {
+        PySnapshotView* self;
+
+        self = (PySnapshotView*) type->tp_alloc(type, 0);
+
+        if (self != NULL) {
+            new (&self->state) std::shared_ptr<SnapshotView>();
+        }
+
+        return (PyObject*)self;
+    }
+
+    static int init(PySnapshotView* self, PyObject* args, PyObject* kwargs)
+    {
+        static const char *kwlist[] = {"databaseConnectionState", "transaction_id", NULL};
+
+        PyObject* databaseConnectionState;
+        transaction_id tid;
+
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Ol", (char**)kwlist, &databaseConnectionState, &tid)) {
+            return -1;
+        }
+
+        if (databaseConnectionState->ob_type != &PyType_DatabaseConnectionState) {
+            PyErr_Format(PyExc_TypeError, "Expected a DatabaseConnectionState, got %S", databaseConnectionState->ob_type);
+            return -1;
+        }
+
+        self->state.reset(new SnapshotView(
+            ((PyDatabaseConnectionState*)databaseConnectionState)->state,
+            tid
+        ));
+
+        return 0;
+    }
+
+    // the value of 'fieldId' on 'oid' as type 'type', or None if it has none.
+    static PyObject* getField(PySnapshotView* self, PyObject* args, PyObject* kwargs) {
+        static const char *kwlist[] = {"fieldId", "oid", "type", NULL};
+
+        field_id fieldId;
+        object_id oid;
+        PyObject* typeArg;
+
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "llO", (char**)kwlist, &fieldId, &oid, &typeArg)) {
+            return NULL;
+        }
+
+        return translateExceptionToPyObject([&]() {
+            Type* t = PyInstance::unwrapTypeArgToTypePtr(typeArg);
+            if (!t) {
+                throw PythonExceptionSet();
+            }
+
+            instance_ptr data;
+
+            {
+                PyEnsureGilReleased releaseTheGil;
+
+                SnapshotView::Reader reader(*self->state);
+                data = reader.getField(fieldId, oid, t);
+            }
+
+            if (!data) {
+                return incref(Py_None);
+            }
+
+            return PyInstance::extractPythonObject(data, t);
+        });
+    }
+
+    static PyObject* fieldExists(PySnapshotView* self, PyObject* args, PyObject* kwargs) {
+        static const char *kwlist[] = {"fieldId", "oid", NULL};
+
+        field_id fieldId;
+        object_id oid;
+
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ll", (char**)kwlist, &fieldId, &oid)) {
+            return NULL;
+        }
+
+        return translateExceptionToPyObject([&]() {
+            bool exists;
+
+            {
+                PyEnsureGilReleased releaseTheGil;
+
+                SnapshotView::Reader reader(*self->state);
+                exists = reader.fieldExists(fieldId, oid);
+            }
+
+            return incref(exists ? Py_True : Py_False);
+        });
+    }
+
+    // the objects with value 'indexValue' in index 'fieldId', in order
+    static PyObject* indexLookupAll(PySnapshotView* self, PyObject* args, PyObject* kwargs) {
+        static const char *kwlist[] = {"fieldId", "indexValue", NULL};
+
+        field_id fieldId;
+        const char* indexValue;
+        Py_ssize_t indexValueSize;
+
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ly#", (char**)kwlist, &fieldId, &indexValue, &indexValueSize)) {
+            return NULL;
+        }
+
+        return translateExceptionToPyObject([&]() {
+            ListOf<object_id> out;
+            Bytes value(indexValue, indexValueSize);
+
+            {
+                PyEnsureGilReleased releaseTheGil;
+
+                SnapshotView::Reader reader(*self->state);
+                reader.indexLookupAll(fieldId, value, [&](object_id o) {
+                    out.append(o);
+                    return true;
+                });
+            }
+
+            return out.toPython();
+        });
+    }
+
+    static PyObject* getTransactionId(PySnapshotView* self, PyObject* args, PyObject* kwargs) {
+        static const char *kwlist[] = {NULL};
+
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+            return NULL;
+        }
+
+        return PyLong_FromLong(self->state->getTransactionId());
+    }
+};
+
+extern PyTypeObject PyType_SnapshotView;
@@ -120,6 +120,44 @@ PyObject* PyVersionedIdSet::lookupNext(PyVersionedIdSet* self, PyObject* args, P
     });
 }
 
+PyObject* PyVersionedIdSet::lookupAll(PyVersionedIdSet* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "transaction_id", NULL };
+    int64_t transaction;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "l", (char**)kwlist, &transaction)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        // no more ids can be active at any transaction than the set has entries
+        int64_t bound = self->idSet->totalEntryCount();
+
+        return TupleOf<object_id>::fromFill(bound, [&](object_id* buffer) {
+            int64_t count = 0;
+
+            self->idSet->lookupAll(transaction, [&](object_id o) {
+                buffer[count++] = o;
+                return count < bound;
+            });
+
+            return count;
+        }).toPython();
+    });
+}
+
+PyObject* PyVersionedIdSet::lookupAllSteps(PyVersionedIdSet* self, PyObject* args, PyObject* kwargs) {
+    static const char* kwlist[] = { "transaction_id", NULL };
+    int64_t transaction;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "l", (char**)kwlist, &transaction)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&]() {
+        return PyLong_FromLong(self->idSet->lookupAllSteps(transaction));
+    });
+}
+
 PyObject* PyVersionedIdSet::add(PyVersionedIdSet* self, PyObject* args, PyObject* kwargs) {
     static const char* kwlist[] = { "transaction_id", "object_id", NULL };
     int64_t transaction;
@@ -235,6 +273,8 @@ PyMethodDef PyVersionedIdSet_methods[] = {
     {"addTransaction", (PyCFunction) PyVersionedIdSet::addTransaction, METH_VARARGS | METH_KEYWORDS},
     {"lookupFirst", (PyCFunction) PyVersionedIdSet::lookupFirst, METH_VARARGS | METH_KEYWORDS},
     {"lookupNext", (PyCFunction) PyVersionedIdSet::lookupNext, METH_VARARGS | METH_KEYWORDS},
+    {"lookupAll", (PyCFunction) PyVersionedIdSet::lookupAll, METH_VARARGS | METH_KEYWORDS},
+    {"lookupAllSteps", (PyCFunction) PyVersionedIdSet::lookupAllSteps, METH_VARARGS | METH_KEYWORDS},
     {"add", (PyCFunction) PyVersionedIdSet::add, METH_VARARGS | METH_KEYWORDS},
     {"remove", (PyCFunction) PyVersionedIdSet::remove, METH_VARARGS | METH_KEYWORDS},
     {"transactionCount", (PyCFunction) PyVersionedIdSet::transactionCount, METH_VARARGS | METH_KEYWORDS},
@@ -39,6 +39,10 @@ public:
 
     static PyObject* lookupNext(PyVersionedIdSet* self, PyObject* args, PyObject* kwargs);
 
+    static PyObject* lookupAll(PyVersionedIdSet* self, PyObject* args, PyObject* kwargs);
+
+    static PyObject* lookupAllSteps(PyVersionedIdSet* self, PyObject* args, PyObject* kwargs);
+
     static PyObject* add(PyVersionedIdSet* self, PyObject* args, PyObject* kwargs);
 
     static PyObject* addTransaction(PyVersionedIdSet* self, PyObject* args, PyObject* kwargs);
@@ -20,11 +20,19 @@ PyMethodDef PyView_methods[] = {
     {"enter", (PyCFunction)PyView::enter, METH_VARARGS | METH_KEYWORDS, NULL},
     {"exit", (PyCFunction)PyView::exit, METH_VARARGS | METH_KEYWORDS, NULL},
     {"setSerializationContext", (PyCFunction)PyView::setSerializationContext, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"prefetchLazyObjects", (PyCFunction)PyView::prefetchLazyObjects, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"setReadTracking", (PyCFunction)PyView::setReadTracking, METH_VARARGS | METH_KEYWORDS, NULL},
     {"extractReads", (PyCFunction)PyView::extractReads, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"extractReadRanges", (PyCFunction)PyView::extractReadRanges, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"extractReadFields", (PyCFunction)PyView::extractReadFields, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"extractIndexRangeReads", (PyCFunction)PyView::extractIndexRangeReads, METH_VARARGS | METH_KEYWORDS, NULL},
     {"extractWrites", (PyCFunction)PyView::extractWrites, METH_VARARGS | METH_KEYWORDS, NULL},
     {"extractIndexReads", (PyCFunction)PyView::extractIndexReads, METH_VARARGS | METH_KEYWORDS, NULL},
     {"extractSetAdds", (PyCFunction)PyView::extractSetAdds, METH_VARARGS | METH_KEYWORDS, NULL},
     {"extractSetRemoves", (PyCFunction)PyView::extractSetRemoves, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"pendingWriteCounts", (PyCFunction)PyView::pendingWriteCounts, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"serializeCommit", (PyCFunction)PyView::serializeCommit, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"traceSummary", (PyCFunction)PyView::traceSummary, METH_VARARGS | METH_KEYWORDS, NULL},
     {NULL}  /* Sentinel */
 };
 
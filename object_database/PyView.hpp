@@ -27,6 +27,8 @@
 #include "PyDatabaseConnectionState.hpp"
 #include "ObjectFieldId.hpp"
 #include "IndexId.hpp"
+#include "TransactionCommitSerializer.hpp"
+#include <typed_python/PyInstance.hpp>
 #include <typed_python/SerializationBuffer.hpp>
 #include <typed_python/SerializationContext.hpp>
 #include <typed_python/PythonSerializationContext.hpp>
@@ -121,6 +123,104 @@ public:
         return out.toPython();
     }
 
+    // start loading any lazy objects among 'oids', all at once. See DatabaseConnectionState::prefetchLazyObjects.
+    static PyObject* prefetchLazyObjects(PyView* self, PyObject* args, PyObject* kwargs) {
+        static const char *kwlist[] = {"oids", NULL};
+
+        PyObject* oids;
+
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", (char**)kwlist, &oids)) {
+            return NULL;
+        }
+
+        return translateExceptionToPyObject([&]() {
+            self->state->prefetchLazyObjects(TupleOf<object_id>::fromPython(oids));
+
+            return incref(Py_None);
+        });
+    }
+
+    // 'tracking' is one of 'keys', 'ranges' or 'fields'. See View::ReadTracking.
+    static PyObject* setReadTracking(PyView* self, PyObject* args, PyObject* kwargs) {
+        static const char *kwlist[] = {"tracking", NULL};
+
+        const char* tracking;
+
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s", (char**)kwlist, &tracking)) {
+            return NULL;
+        }
+
+        return translateExceptionToPyObject([&]() {
+            std::string name(tracking);
+
+            if (name == "keys") {
+                self->state->setReadTracking(View::track_keys);
+            } else if (name == "ranges") {
+                self->state->setReadTracking(View::track_key_ranges);
+            } else if (name == "fields") {
+                self->state->setReadTracking(View::track_fields);
+            } else {
+                throw std::runtime_error("Unknown read tracking '" + name + "'. Expected 'keys', 'ranges' or 'fields'.");
+            }
+
+            return incref(Py_None);
+        });
+    }
+
+    // the reads recorded under 'ranges', as a dict from field id to a flat tuple of
+    // [start, stop) ranges of object ids.
+    static PyObject* extractReadRanges(PyView* self, PyObject* args, PyObject* kwargs) {
+        static const char *kwlist[] = {NULL};
+
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+            return NULL;
+        }
+
+        return translateExceptionToPyObject([&]() {
+            Dict<int64_t, TupleOf<object_id> > out;
+
+            self->state->visitReadKeyRanges([&](field_id field, const std::vector<object_id>& ranges) {
+                out[field] = TupleOf<object_id>(ranges);
+            });
+
+            return out.toPython();
+        });
+    }
+
+    // the fields read under 'fields'
+    static PyObject* extractReadFields(PyView* self, PyObject* args, PyObject* kwargs) {
+        static const char *kwlist[] = {NULL};
+
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+            return NULL;
+        }
+
+        ListOf<int64_t> out;
+
+        for (auto field: self->state->getReadFields()) {
+            out.append(field);
+        }
+
+        return out.toPython();
+    }
+
+    // the indices we looked up a range of values of
+    static PyObject* extractIndexRangeReads(PyView* self, PyObject* args, PyObject* kwargs) {
+        static const char *kwlist[] = {NULL};
+
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+            return NULL;
+        }
+
+        ListOf<int64_t> out;
+
+        for (auto field: self->state->getIndexRangeReads()) {
+            out.append(field);
+        }
+
+        return out.toPython();
+    }
+
     static PyObject* extractWrites(PyView* self, PyObject* args, PyObject* kwargs) {
         static const char *kwlist[] = {NULL};
 
@@ -136,7 +236,7 @@ public:
 
                 auto context = self->state->getSerializationContext();
 
-                for (auto keyAndCache: self->state->getWriteCache()) {
+                for (const auto& keyAndCache: self->state->getWriteCache()) {
                     SerializationBuffer b(*context);
 
                     keyAndCache.second.type()->serialize(keyAndCache.second.data(), b, 0);
@@ -164,7 +264,7 @@ public:
 
         ListOf<IndexId> out;
 
-        for (auto indexKey: self->state->getSetReads()) {
+        for (const auto& indexKey: self->state->getSetReads()) {
             out.append(IndexId(indexKey.fieldId(), indexKey.indexValue()));
         }
 
@@ -180,7 +280,7 @@ public:
 
         Dict<IndexId, ListOf<object_id> > out;
 
-        for (auto indexKeyToOids: self->state->getSetAdds()) {
+        for (const auto& indexKeyToOids: self->state->getSetAdds()) {
             ListOf<object_id> oids = out[IndexId(indexKeyToOids.first.fieldId(), indexKeyToOids.first.indexValue())];
             for (auto oid: indexKeyToOids.second) {
                 oids.append(oid);
@@ -199,7 +299,7 @@ public:
 
         Dict<IndexId, ListOf<object_id> > out;
 
-        for (auto indexKeyToOids: self->state->getSetRemoves()) {
+        for (const auto& indexKeyToOids: self->state->getSetRemoves()) {
             ListOf<object_id> oids = out[IndexId(indexKeyToOids.first.fieldId(), indexKeyToOids.first.indexValue())];
             for (auto oid: indexKeyToOids.second) {
                 oids.append(oid);
@@ -209,6 +309,120 @@ public:
         return out.toPython();
     }
 
+    // (writes, setChanges): how many fields we've written or deleted, and how many
+    // index values we've added objects to or removed them from.
+    static PyObject* pendingWriteCounts(PyView* self, PyObject* args, PyObject* kwargs) {
+        static const char *kwlist[] = {NULL};
+
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+            return NULL;
+        }
+
+        return Py_BuildValue(
+            "(nn)",
+            (Py_ssize_t)(self->state->getWriteCache().size() + self->state->getDeleteCache().size()),
+            (Py_ssize_t)(self->state->getSetAdds().size() + self->state->getSetRemoves().size())
+        );
+    }
+
+    // a dict of what ViewTrace counted while we were entered, or None if it was off.
+    // 'seconds' is how long we were entered, or have been so far.
+    static PyObject* traceSummary(PyView* self, PyObject* args, PyObject* kwargs) {
+        static const char *kwlist[] = {NULL};
+
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "", (char**)kwlist)) {
+            return NULL;
+        }
+
+        return translateExceptionToPyObject([&]() {
+            const ViewTrace::Scope* trace = self->state->getTrace();
+
+            if (!trace) {
+                return incref(Py_None);
+            }
+
+            const ViewTrace::Counters& c = trace->counters;
+
+            int64_t exitedAt = trace->exitedAt ? trace->exitedAt : ViewTrace::nanos();
+
+            PyObject* res = PyDict_New();
+
+            auto setItem = [&](const char* name, PyObject* value) {
+                PyDict_SetItemString(res, name, value);
+                decref(value);
+            };
+
+            setItem("sampled", incref(trace->sampled ? Py_True : Py_False));
+            setItem("seconds", PyFloat_FromDouble((exitedAt - trace->enteredAt) / 1000000000.0));
+            setItem("attributeReads", PyLong_FromLongLong(c.attributeReads));
+            setItem("fieldReads", PyLong_FromLongLong(c.fieldReads));
+            setItem("readCacheHits", PyLong_FromLongLong(c.readCacheHits));
+            setItem("valueCacheHits", PyLong_FromLongLong(c.valueCacheHits));
+            setItem("deserializations", PyLong_FromLongLong(c.deserializations));
+            setItem("fieldWrites", PyLong_FromLongLong(c.fieldWrites));
+            setItem("indexLookups", PyLong_FromLongLong(c.indexLookups));
+            setItem("indexLookupSteps", PyLong_FromLongLong(c.indexLookupSteps));
+            setItem("lazyLoads", PyLong_FromLongLong(c.lazyLoads));
+            setItem("lazyLoadSeconds", PyFloat_FromDouble(c.lazyLoadNanos / 1000000000.0));
+            setItem("gcPasses", PyLong_FromLongLong(c.gcPasses));
+            setItem("gcSeconds", PyFloat_FromDouble(c.gcNanos / 1000000000.0));
+
+            return res;
+        });
+    }
+
+    // the serialized 'messageType' messages that commit this view as 'transactionGuid',
+    // as a list of bytes. See TransactionCommitSerializer.
+    static PyObject* serializeCommit(PyView* self, PyObject* args, PyObject* kwargs) {
+        static const char *kwlist[] = {"messageType", "transactionGuid", "asOfVersion", NULL};
+
+        PyObject* messageType;
+        int64_t transactionGuid;
+        transaction_id asOfVersion;
+
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oll", (char**)kwlist, &messageType, &transactionGuid, &asOfVersion)) {
+            return NULL;
+        }
+
+        return translateExceptionToPyObject([&]() {
+            std::vector<std::string> messages = serializeCommitMessages(self, messageType, transactionGuid, asOfVersion);
+
+            PyObjectStealer out(PyList_New(0));
+
+            for (const auto& message: messages) {
+                PyObjectStealer bytes(PyBytes_FromStringAndSize(message.data(), message.size()));
+
+                if (!bytes || PyList_Append(out, bytes) != 0) {
+                    throw PythonExceptionSet();
+                }
+            }
+
+            return incref(out);
+        });
+    }
+
+    // build the commit messages. Call with the GIL, which serializing values needs.
+    static std::vector<std::string> serializeCommitMessages(
+                PyView* self,
+                PyObject* messageType,
+                int64_t transactionGuid,
+                transaction_id asOfVersion
+                ) {
+        if (!self->state) {
+            throw std::runtime_error("Invalid PyView (nullptr)");
+        }
+
+        Type* t = PyInstance::unwrapTypeArgToTypePtr(messageType);
+
+        if (!t || t->getTypeCategory() != Type::TypeCategory::catAlternative) {
+            throw std::runtime_error("Expected 'messageType' to be an Alternative.");
+        }
+
+        TransactionCommitSerializer serializer((Alternative*)t);
+
+        return serializer.serialize(*self->state, transactionGuid, asOfVersion);
+    }
+
     static PyObject* setSerializationContext(PyView* self, PyObject* args, PyObject* kwargs)
     {
         static const char *kwlist[] = {"serializationContext", NULL};
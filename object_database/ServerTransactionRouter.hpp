@@ -0,0 +1,283 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Common.hpp"
+#include "HashFunctions.hpp"
+#include "direct_types/FlatHashMap.hpp"
+
+/*************
+
+ServerTransactionRouter holds the server's view of what each connected
+channel is subscribed to - whole fields (from type subscriptions), index
+values, and individual objects - and decides which channels each new
+transaction has to go to.
+
+Channels are small integers the server hands out. A subscription can be
+lazy, in which case the channel also needs the prior values of whatever a
+transaction overwrites.
+
+'route' also grows index subscriptions: a channel subscribed to an index
+value gets subscribed to any object the transaction adds to it. It reports
+those as Increases, since the server has to tell the channel about them
+and load the new objects' values into the transaction.
+
+'filterFor' then says which parts of the transaction each of those channels
+needs, so we only send each one what it's subscribed to.
+
+*************/
+
+class ServerTransactionRouter {
+public:
+    typedef int64_t channel_id;
+
+    // 'channel' gained 'newIds' because it's subscribed to 'index'
+    class Increase {
+    public:
+        Increase(const IndexKey& inIndex, channel_id inChannel, std::vector<object_id>&& inNewIds) :
+            index(inIndex),
+            channel(inChannel),
+            newIds(std::move(inNewIds))
+        {
+        }
+
+        IndexKey index;
+        channel_id channel;
+        std::vector<object_id> newIds;
+    };
+
+    class Route {
+    public:
+        std::vector<Increase> increases;
+
+        // the channels that get the transaction, sorted
+        std::vector<channel_id> channels;
+
+        // the channels that need LazyTransactionPriors first, sorted
+        std::vector<channel_id> priorChannels;
+    };
+
+    /*****
+    says whether one channel needs a write to 'field' of 'oid', or 'oid' joining
+    or leaving a value of index 'field'. It does if it's subscribed to the field or
+    to the object. An index has the same id as a field of the same name, and
+    type subscriptions subscribe to their type's indices as well as its fields.
+    *****/
+    class Filter {
+    public:
+        Filter(const std::set<field_id>* fields, const std::unordered_set<object_id>* ids) :
+            mFields(fields),
+            mIds(ids)
+        {
+        }
+
+        bool sees(field_id field, object_id oid) const {
+            return (mFields && mFields->count(field)) || (mIds && mIds->count(oid));
+        }
+
+    private:
+        const std::set<field_id>* mFields;
+
+        const std::unordered_set<object_id>* mIds;
+    };
+
+    void subscribeToField(channel_id channel, field_id field, bool isLazy) {
+        mFieldSubscribers[field][channel] = isLazy;
+        mChannels[channel].fields.insert(field);
+    }
+
+    void subscribeToIndex(channel_id channel, const IndexKey& index, bool isLazy) {
+        mIndexSubscribers[index][channel] = isLazy;
+        mChannels[channel].indices.insert(index);
+    }
+
+    // subscribe 'channel' to each of 'oids'. Returns the ones it wasn't already subscribed to.
+    std::vector<object_id> subscribeToIds(channel_id channel, const object_id* oids, size_t count) {
+        std::vector<object_id> newIds;
+
+        Channel& subscriptions = mChannels[channel];
+
+        for (size_t k = 0; k < count; k++) {
+            if (subscriptions.ids.insert(oids[k]).second) {
+                mIdSubscribers[oids[k]].push_back(channel);
+                newIds.push_back(oids[k]);
+            }
+        }
+
+        return newIds;
+    }
+
+    bool isSubscribedToField(channel_id channel, field_id field) const {
+        auto it = mChannels.find(channel);
+
+        return it != mChannels.end() && it->second.fields.count(field);
+    }
+
+    void dropChannel(channel_id channel) {
+        auto it = mChannels.find(channel);
+
+        if (it == mChannels.end()) {
+            return;
+        }
+
+        for (field_id field: it->second.fields) {
+            auto subscribers = mFieldSubscribers.find(field);
+            subscribers->second.erase(channel);
+
+            if (subscribers->second.empty()) {
+                mFieldSubscribers.erase(subscribers);
+            }
+        }
+
+        for (const auto& index: it->second.indices) {
+            auto subscribers = mIndexSubscribers.find(index);
+            subscribers->second.erase(channel);
+
+            if (subscribers->second.empty()) {
+                mIndexSubscribers.erase(subscribers);
+            }
+        }
+
+        for (object_id oid: it->second.ids) {
+            auto subscribers = mIdSubscribers.find(oid);
+            std::vector<channel_id>& channels = subscribers->second;
+
+            channels.erase(std::find(channels.begin(), channels.end(), channel));
+
+            if (channels.empty()) {
+                mIdSubscribers.erase(subscribers);
+            }
+        }
+
+        mChannels.erase(it);
+    }
+
+    size_t channelCount() const {
+        return mChannels.size();
+    }
+
+    // what 'channel' needs of a transaction. Only valid until its subscriptions change.
+    Filter filterFor(channel_id channel) const {
+        auto it = mChannels.find(channel);
+
+        if (it == mChannels.end()) {
+            return Filter(nullptr, nullptr);
+        }
+
+        return Filter(&it->second.fields, &it->second.ids);
+    }
+
+    /*****
+    work out who gets a transaction that writes to 'fields', mentions 'oids' (as
+    keys or as members of index changes), and adds the objects in 'setAdds' to
+    those index values. Subscribes channels to any new members of indices they're
+    subscribed to.
+
+    'set_adds_type' iterates as pairs of (IndexKey, something iterating object_ids).
+    *****/
+    template<class set_adds_type>
+    Route route(const std::vector<field_id>& fields, const std::vector<object_id>& oids, const set_adds_type& setAdds) {
+        Route route;
+
+        std::set<channel_id> channels;
+        std::set<channel_id> priorChannels;
+
+        for (const auto& indexAndOids: setAdds) {
+            auto subscribers = mIndexSubscribers.find(indexAndOids.first);
+
+            if (subscribers == mIndexSubscribers.end()) {
+                continue;
+            }
+
+            std::vector<object_id> added;
+
+            for (object_id oid: indexAndOids.second) {
+                added.push_back(oid);
+            }
+
+            for (const auto& channelAndIsLazy: subscribers->second) {
+                if (channelAndIsLazy.second) {
+                    priorChannels.insert(channelAndIsLazy.first);
+                }
+
+                route.increases.push_back(Increase(
+                    indexAndOids.first,
+                    channelAndIsLazy.first,
+                    subscribeToIds(channelAndIsLazy.first, added.data(), added.size())
+                ));
+            }
+        }
+
+        for (field_id field: fields) {
+            auto subscribers = mFieldSubscribers.find(field);
+
+            if (subscribers == mFieldSubscribers.end()) {
+                continue;
+            }
+
+            for (const auto& channelAndIsLazy: subscribers->second) {
+                if (channelAndIsLazy.second) {
+                    priorChannels.insert(channelAndIsLazy.first);
+                }
+
+                channels.insert(channelAndIsLazy.first);
+            }
+        }
+
+        for (object_id oid: oids) {
+            auto subscribers = mIdSubscribers.find(oid);
+
+            if (subscribers != mIdSubscribers.end()) {
+                channels.insert(subscribers->second.begin(), subscribers->second.end());
+            }
+        }
+
+        route.channels.assign(channels.begin(), channels.end());
+        route.priorChannels.assign(priorChannels.begin(), priorChannels.end());
+
+        return route;
+    }
+
+private:
+    // everything one channel is subscribed to, so we can unwind it in 'dropChannel'
+    class Channel {
+    public:
+        std::set<field_id> fields;
+
+        std::set<IndexKey> indices;
+
+        std::unordered_set<object_id> ids;
+    };
+
+    // for each field, its subscribers and whether they're lazy
+    FlatHashMap<field_id, std::map<channel_id, bool> > mFieldSubscribers;
+
+    // for each index value, its subscribers and whether they're lazy
+    std::unordered_map<IndexKey, std::map<channel_id, bool> > mIndexSubscribers;
+
+    // for each individually subscribed object, the channels subscribed to it
+    FlatHashMap<object_id, std::vector<channel_id> > mIdSubscribers;
+
+    std::map<channel_id, Channel> mChannels;
+};
@@ -0,0 +1,122 @@
+#   Copyright 2017-2020 object_database Authors
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+
+from object_database.schema import IndexId, ObjectFieldId
+from object_database._types import ServerTransactionRouter
+
+import unittest
+
+
+class ServerTransactionRouterTest(unittest.TestCase):
+    def test_routes_by_field_index_and_object(self):
+        router = ServerTransactionRouter()
+
+        index = IndexId(fieldId=20, indexValue=b"a")
+
+        router.subscribeToField(1, 10, False)
+        router.subscribeToField(2, 10, True)
+        router.subscribeToIndex(3, index, False)
+
+        self.assertEqual(router.subscribeToIds(4, [5, 6]), (5, 6))
+        self.assertEqual(router.subscribeToIds(4, [6, 7]), (7,))
+
+        self.assertTrue(router.isSubscribedToField(2, 10))
+        self.assertFalse(router.isSubscribedToField(3, 10))
+
+        increases, channels, priorChannels = router.route([10], [5, 8, 9], {index: {8, 9}})
+
+        self.assertEqual(len(increases), 1)
+        self.assertEqual(increases[0][0], index)
+        self.assertEqual(increases[0][1], 3)
+        self.assertEqual(sorted(increases[0][2]), [8, 9])
+
+        self.assertEqual(channels, (1, 2, 3, 4))
+        self.assertEqual(priorChannels, (2,))
+
+        # channel 3 is now subscribed to the objects it gained
+        _, channels, _ = router.route([], [9], {})
+        self.assertEqual(channels, (3,))
+
+    def test_drop_channel(self):
+        router = ServerTransactionRouter()
+
+        index = IndexId(fieldId=20, indexValue=b"a")
+
+        router.subscribeToField(1, 10, False)
+        router.subscribeToIndex(1, index, True)
+        router.subscribeToIds(1, [5])
+        router.subscribeToIds(2, [5])
+
+        self.assertEqual(router.channelCount(), 2)
+
+        router.dropChannel(1)
+
+        self.assertEqual(router.channelCount(), 1)
+        self.assertEqual(router.route([10], [5], {index: [6]}), ([], (2,), ()))
+
+        router.dropChannel(2)
+
+        self.assertEqual(router.route([10], [5], {index: [6]}), ([], (), ()))
+
+    def test_filter_transaction(self):
+        router = ServerTransactionRouter()
+
+        aIndex = IndexId(fieldId=10, indexValue=b"a")
+        bIndex = IndexId(fieldId=10, indexValue=b"b")
+
+        router.subscribeToField(1, 10, False)
+        router.subscribeToField(1, 11, False)
+        router.subscribeToIds(2, [5])
+
+        writes = {
+            ObjectFieldId(fieldId=11, objId=5, isIndexValue=False): b"x",
+            ObjectFieldId(fieldId=11, objId=6, isIndexValue=False): None,
+        }
+        setAdds = {aIndex: (5, 6)}
+        setRemoves = {bIndex: (6,)}
+
+        everything, forTwo, forThree = router.filterTransaction(
+            [1, 2, 3], writes, setAdds, setRemoves
+        )
+
+        # channel 1 is subscribed to the whole type
+        self.assertIsNone(everything)
+
+        # channel 2 only knows about object 5
+        writesTwo, addsTwo, removesTwo = forTwo
+        self.assertEqual(
+            dict(writesTwo), {ObjectFieldId(fieldId=11, objId=5, isIndexValue=False): b"x"}
+        )
+        self.assertEqual(dict(addsTwo), {aIndex: (5,)})
+        self.assertEqual(dict(removesTwo), {})
+
+        # channel 3 isn't subscribed to anything
+        self.assertEqual([len(part) for part in forThree], [0, 0, 0])
+
+    def test_index_reverse_lookup_kvs(self):
+        router = ServerTransactionRouter()
+
+        aIndex = IndexId(fieldId=10, indexValue=b"a")
+        bIndex = IndexId(fieldId=10, indexValue=b"b")
+
+        # object 5 moves from 'b' to 'a', and object 6 leaves 'b'
+        kvs = router.indexReverseLookupKvs({aIndex: (5,)}, {bIndex: (5, 6)})
+
+        self.assertEqual(
+            dict(kvs),
+            {
+                ObjectFieldId(fieldId=10, objId=5, isIndexValue=True): b"a",
+                ObjectFieldId(fieldId=10, objId=6, isIndexValue=True): None,
+            },
+        )
@@ -0,0 +1,187 @@
+/******************************************************************************
+   Copyright 2017-2019 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+/*************
+
+SmallVector is a vector of trivially copyable values that stores up to
+'inline_count' of them inside the object itself, and only goes to the heap
+when it grows past that.
+
+*************/
+
+template<class T, size_t inline_count>
+class SmallVector {
+public:
+    SmallVector() :
+            m_data(m_inline),
+            m_size(0),
+            m_capacity(inline_count)
+    {
+    }
+
+    SmallVector(const SmallVector& other) :
+            m_data(m_inline),
+            m_size(0),
+            m_capacity(inline_count)
+    {
+        *this = other;
+    }
+
+    //takes the other's heap array if it has one, so it's cheap to move these
+    //around inside hash tables
+    SmallVector(SmallVector&& other) :
+            m_data(m_inline),
+            m_size(other.m_size),
+            m_capacity(inline_count)
+    {
+        if (other.m_data != other.m_inline) {
+            m_data = other.m_data;
+            m_capacity = other.m_capacity;
+            other.m_data = other.m_inline;
+            other.m_capacity = inline_count;
+        } else {
+            memcpy(m_inline, other.m_inline, sizeof(T) * m_size);
+        }
+
+        other.m_size = 0;
+    }
+
+    ~SmallVector() {
+        if (m_data != m_inline) {
+            free(m_data);
+        }
+    }
+
+    SmallVector& operator=(const SmallVector& other) {
+        if (this == &other) {
+            return *this;
+        }
+
+        reserve(other.m_size);
+        memcpy(m_data, other.m_data, sizeof(T) * other.m_size);
+        m_size = other.m_size;
+
+        return *this;
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    T* begin() {
+        return m_data;
+    }
+
+    T* end() {
+        return m_data + m_size;
+    }
+
+    const T* begin() const {
+        return m_data;
+    }
+
+    const T* end() const {
+        return m_data + m_size;
+    }
+
+    T& operator[](size_t index) {
+        return m_data[index];
+    }
+
+    const T& operator[](size_t index) const {
+        return m_data[index];
+    }
+
+    T& front() {
+        return m_data[0];
+    }
+
+    T& back() {
+        return m_data[m_size - 1];
+    }
+
+    const T& front() const {
+        return m_data[0];
+    }
+
+    const T& back() const {
+        return m_data[m_size - 1];
+    }
+
+    void push_back(const T& value) {
+        insert(m_size, value);
+    }
+
+    void insert(size_t index, const T& value) {
+        if (m_size == m_capacity) {
+            reserve(m_capacity * 2);
+        }
+
+        memmove(m_data + index + 1, m_data + index, sizeof(T) * (m_size - index));
+        m_data[index] = value;
+        m_size++;
+    }
+
+    void erase(size_t index) {
+        memmove(m_data + index, m_data + index + 1, sizeof(T) * (m_size - index - 1));
+        m_size--;
+    }
+
+    void reserve(size_t count) {
+        if (count <= m_capacity) {
+            return;
+        }
+
+        T* newData = (T*)malloc(sizeof(T) * count);
+        if (!newData) {
+            throw std::bad_alloc();
+        }
+
+        memcpy(newData, m_data, sizeof(T) * m_size);
+
+        if (m_data != m_inline) {
+            free(m_data);
+        }
+
+        m_data = newData;
+        m_capacity = count;
+    }
+
+    //bytes we've allocated outside of the object itself
+    size_t heapBytes() const {
+        return m_data == m_inline ? 0 : sizeof(T) * m_capacity;
+    }
+
+private:
+    T* m_data;
+
+    uint32_t m_size;
+
+    uint32_t m_capacity;
+
+    T m_inline[inline_count];
+};
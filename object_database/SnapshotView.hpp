@@ -0,0 +1,182 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include <typed_python/Instance.hpp>
+#include <typed_python/DeserializationBuffer.hpp>
+#include <typed_python/SerializationContext.hpp>
+
+#include "DatabaseConnectionState.hpp"
+#include "HashFunctions.hpp"
+
+/**********
+A SnapshotView is a read-only view of a DatabaseConnectionState pinned at a
+single transaction id, which any number of threads can read from at once
+without the GIL.
+
+Readers hold the connection's snapshot mutex shared, through a Reader, while
+everything that changes the VersionedObjects (incoming transactions and
+garbage collection) holds it exclusively. Take a Reader for a batch of reads
+rather than for each one, but don't hold it for long: transactions can't be
+applied while it's held.
+
+We never touch the connection's DeserializedValueCache, since GIL-holding
+views change it as they read. Instead each snapshot deserializes into its own
+cache, split into shards so readers rarely contend, and the pointers we hand
+out stay valid until the snapshot goes away.
+
+Only 'simple' types can be read, since the others need python to deserialize.
+Lazy objects that haven't been loaded look like they don't exist, so load them
+(see View::prefetchLazyObjects) before taking the snapshot.
+
+Create and destroy snapshots with the GIL.
+**********/
+
+class SnapshotView {
+public:
+   enum { value_shards = 16 };
+
+   SnapshotView(std::shared_ptr<DatabaseConnectionState> connection, transaction_id tid) :
+      m_tid(tid),
+      m_connection_state(connection),
+      m_versioned_objects(*connection->getVersionedObjects())
+   {
+      m_connection_state->increfVersion(m_tid);
+      m_connection_state->snapshotCreated();
+   }
+
+   ~SnapshotView() {
+      m_connection_state->decrefVersion(m_tid);
+      m_connection_state->snapshotDestroyed();
+   }
+
+   SnapshotView(const SnapshotView&) = delete;
+   SnapshotView& operator=(const SnapshotView&) = delete;
+
+   transaction_id getTransactionId() const {
+      return m_tid;
+   }
+
+   /******
+   holds off writers for as long as it lives, so it can read from the snapshot.
+   Doesn't need the GIL, and mustn't take it.
+   ******/
+   class Reader {
+   public:
+      Reader(SnapshotView& view) :
+         m_view(view),
+         m_lock(view.m_connection_state->getSnapshotMutex())
+      {
+      }
+
+      // the value of 'field' on 'oid', or nullptr if it doesn't have one. The pointer
+      // stays valid as long as the SnapshotView.
+      instance_ptr getField(field_id field, object_id oid, Type* t) {
+         return m_view.getFieldLocked(field, oid, t);
+      }
+
+      bool fieldExists(field_id field, object_id oid) {
+         VersionedObjectsOfMultiType* objects = m_view.m_versioned_objects.findVersionedObjectsForFieldId(field);
+
+         return objects && objects->existsAtTransaction(nullptr, oid, m_view.m_tid);
+      }
+
+      // call 'visitor' with each object in the index, in order, until it returns false.
+      template<class visitor_type>
+      void indexLookupAll(field_id fid, index_value i, const visitor_type& visitor) {
+         m_view.m_versioned_objects.indexLookupAll(fid, i, m_view.m_tid, visitor);
+      }
+
+   private:
+      SnapshotView& m_view;
+
+      std::shared_lock<std::shared_timed_mutex> m_lock;
+   };
+
+private:
+   class ValueShard {
+   public:
+      std::mutex mutex;
+
+      std::unordered_map<std::pair<field_id, object_id>, Instance> values;
+   };
+
+   ValueShard& shardFor(field_id field, object_id oid) {
+      return m_shards[hashCombine(field, oid) % value_shards];
+   }
+
+   // requires a Reader
+   instance_ptr getFieldLocked(field_id field, object_id oid, Type* t) {
+      if (!t->isSimple()) {
+         throw std::runtime_error("SnapshotView can only read simple types.");
+      }
+
+      auto key = std::make_pair(field, oid);
+      ValueShard& shard = shardFor(field, oid);
+
+      {
+         std::lock_guard<std::mutex> lock(shard.mutex);
+
+         auto it = shard.values.find(key);
+         if (it != shard.values.end()) {
+            if (it->second.type() != t) {
+               throw std::runtime_error("SnapshotView can only read a field as one type.");
+            }
+            return it->second.data();
+         }
+      }
+
+      VersionedObjectsOfMultiType* objects = m_versioned_objects.findVersionedObjectsForFieldId(field);
+
+      const uint8_t* data;
+      size_t size;
+
+      if (!objects || !objects->bestPayload(oid, m_tid, data, size)) {
+         return nullptr;
+      }
+
+      // deserialize outside of the shard's lock. Writers can't move the payload
+      // while our Reader holds them off.
+      NullSerializationContext context;
+      DeserializationBuffer buffer((uint8_t*)data, size, context);
+
+      Instance instance(t, [&](instance_ptr dataPtr) {
+         auto fieldAndWireType = buffer.readFieldNumberAndWireType();
+         t->deserialize(dataPtr, buffer, fieldAndWireType.second);
+      });
+
+      std::lock_guard<std::mutex> lock(shard.mutex);
+
+      // if another thread got here first, use its copy, since someone may have it already
+      auto it = shard.values.insert(std::make_pair(key, instance)).first;
+
+      return it->second.data();
+   }
+
+   transaction_id m_tid;
+
+   std::shared_ptr<DatabaseConnectionState> m_connection_state;
+
+   VersionedObjects& m_versioned_objects;
+
+   ValueShard m_shards[value_shards];
+};
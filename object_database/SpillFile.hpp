@@ -0,0 +1,177 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/***********
+SpillFile holds serialized values we'd rather not keep in RAM. We append
+them to an anonymous file (we unlink it as soon as we've created it) in
+batches, and map each batch read-only, so a value is paged back in by the
+kernel whenever somebody reads it, and dropped again under memory pressure
+since the pages are clean.
+
+Each batch is kept mapped by the 'owner' that 'write' returns, which is
+meant to be handed to PayloadSlab::adopt for every value in the batch. Once
+the last of them is released we unmap the batch and, where the filesystem
+supports it, give its space in the file back.
+***********/
+
+class SpillFile {
+    // closes the file once the SpillFile and every batch mapping are gone
+    class Descriptor {
+    public:
+        Descriptor(int inFd) : fd(inFd), liveBytes(0)
+        {
+        }
+
+        ~Descriptor() {
+            close(fd);
+        }
+
+        int fd;
+
+        // bytes of values in batches that are still mapped
+        std::atomic<int64_t> liveBytes;
+    };
+
+public:
+    class Batch {
+    public:
+        // keeps 'data' mapped
+        std::shared_ptr<const void> owner;
+
+        // the values we wrote, back to back
+        const uint8_t* data;
+    };
+
+    SpillFile(const std::string& directory) :
+        mPageSize(sysconf(_SC_PAGESIZE)),
+        mFileSize(0)
+    {
+        std::string pattern = directory + "/odb-spill-XXXXXX";
+        std::vector<char> path(pattern.begin(), pattern.end());
+        path.push_back(0);
+
+        int fd = mkstemp(path.data());
+
+        if (fd < 0) {
+            throw std::runtime_error("Couldn't create a spill file in " + directory + ".");
+        }
+
+        unlink(path.data());
+
+        mDescriptor.reset(new Descriptor(fd));
+    }
+
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    // append 'values' to the file as one batch and map it
+    Batch write(const std::vector<std::pair<const uint8_t*, size_t> >& values) {
+        size_t total = 0;
+
+        for (const auto& value: values) {
+            total += value.second;
+        }
+
+        if (!total) {
+            throw std::runtime_error("Can't spill an empty batch.");
+        }
+
+        // batches start on page boundaries, so we can map each one on its own
+        off_t offset = mFileSize;
+        size_t mappedSize = (total + mPageSize - 1) / mPageSize * mPageSize;
+
+        off_t pos = offset;
+        for (const auto& value: values) {
+            writeAt(value.first, value.second, pos);
+            pos += value.second;
+        }
+
+        void* mapped = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, mDescriptor->fd, offset);
+
+        if (mapped == MAP_FAILED) {
+            throw std::runtime_error("Couldn't map the spill file.");
+        }
+
+        mFileSize += mappedSize;
+        mDescriptor->liveBytes += total;
+
+        std::shared_ptr<Descriptor> descriptor = mDescriptor;
+
+        Batch batch;
+        batch.data = (const uint8_t*)mapped;
+        batch.owner = std::shared_ptr<const void>(mapped, [descriptor, mappedSize, offset, total](const void* p) {
+            munmap((void*)p, mappedSize);
+
+            #ifdef FALLOC_FL_PUNCH_HOLE
+            fallocate(descriptor->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, mappedSize);
+            #endif
+
+            descriptor->liveBytes -= total;
+        });
+
+        return batch;
+    }
+
+    // bytes of values sitting in the file that somebody still refers to
+    int64_t liveBytes() const {
+        return mDescriptor->liveBytes;
+    }
+
+    // how far the file extends. Released batches may not take up space on disk.
+    int64_t fileSize() const {
+        return mFileSize;
+    }
+
+private:
+    void writeAt(const uint8_t* data, size_t size, off_t offset) {
+        while (size) {
+            ssize_t written = pwrite(mDescriptor->fd, data, size, offset);
+
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                throw std::runtime_error("Failed writing to the spill file.");
+            }
+
+            data += written;
+            size -= written;
+            offset += written;
+        }
+    }
+
+    size_t mPageSize;
+
+    off_t mFileSize;
+
+    std::shared_ptr<Descriptor> mDescriptor;
+};
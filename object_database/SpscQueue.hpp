@@ -0,0 +1,151 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/***********
+SpscQueue is an unbounded queue between exactly one producer thread and
+exactly one consumer thread, with no locks: 'push' and 'pop' are each a
+handful of ordinary memory operations plus one atomic load and one atomic
+store.
+
+Items live in fixed-size segments chained into a list. The producer fills
+the last segment and links on a new one when it's full; the consumer frees
+each segment once it has moved past it. The producer never looks at a
+segment again after linking the next one, so the two threads never touch
+the same item at the same time.
+
+This doesn't do any waking up. Callers that want to sleep when the queue is
+empty need to arrange that themselves.
+***********/
+
+template<class T>
+class SpscQueue {
+    enum { segment_size = 256 };
+
+    class Segment {
+    public:
+        Segment() : published(0), next(nullptr)
+        {
+        }
+
+        T* item(size_t ix) {
+            return reinterpret_cast<T*>(&items[ix]);
+        }
+
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type items[segment_size];
+
+        // how many items the producer has finished writing into this segment
+        std::atomic<size_t> published;
+
+        // the next segment, once we're full
+        std::atomic<Segment*> next;
+    };
+
+public:
+    SpscQueue() :
+        mHead(new Segment()),
+        mHeadIndex(0)
+    {
+        mTail = mHead;
+        mTailIndex = 0;
+    }
+
+    ~SpscQueue() {
+        while (advanceHead()) {
+            mHead->item(mHeadIndex)->~T();
+            mHeadIndex++;
+        }
+
+        delete mHead;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // only the producer may call this
+    void push(T&& value) {
+        if (mTailIndex == segment_size) {
+            Segment* segment = new Segment();
+            mTail->next.store(segment, std::memory_order_release);
+            mTail = segment;
+            mTailIndex = 0;
+        }
+
+        new (mTail->item(mTailIndex)) T(std::move(value));
+        mTailIndex++;
+
+        mTail->published.store(mTailIndex, std::memory_order_release);
+    }
+
+    void push(const T& value) {
+        push(T(value));
+    }
+
+    // only the consumer may call this. Returns false if the queue is empty.
+    bool pop(T& out) {
+        if (!advanceHead()) {
+            return false;
+        }
+
+        T* item = mHead->item(mHeadIndex);
+        out = std::move(*item);
+        item->~T();
+        mHeadIndex++;
+
+        return true;
+    }
+
+    // only the consumer may call this.
+    bool empty() {
+        return !advanceHead();
+    }
+
+private:
+    // make sure mHead/mHeadIndex point at the next item, if there is one.
+    bool advanceHead() {
+        if (mHeadIndex == segment_size) {
+            Segment* next = mHead->next.load(std::memory_order_acquire);
+
+            if (!next) {
+                return false;
+            }
+
+            delete mHead;
+            mHead = next;
+            mHeadIndex = 0;
+        }
+
+        return mHeadIndex < mHead->published.load(std::memory_order_acquire);
+    }
+
+    // the consumer's end
+    Segment* mHead;
+    size_t mHeadIndex;
+
+    // keep the two ends on separate cache lines so the threads don't fight over them
+    char mPadding[64];
+
+    // the producer's end
+    Segment* mTail;
+    size_t mTailIndex;
+};
@@ -0,0 +1,213 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/***********
+StateFileWriter and StateFileReader read and write the files that
+DatabaseConnectionState::saveState produces: a flat sequence of native-endian
+integers, and byte strings prefixed by their length.
+
+The writer writes to 'path.tmp' and renames it over 'path' when it's done, so
+a reader never sees half a file. The reader maps the whole file, and hands out
+pointers into the mapping along with the 'owner' that keeps it mapped, so the
+values in the file don't have to be copied to be used.
+***********/
+
+class StateFileWriter {
+public:
+    StateFileWriter(const std::string& path) :
+        mPath(path),
+        mTmpPath(path + ".tmp"),
+        mFile(fopen(mTmpPath.c_str(), "wb"))
+    {
+        if (!mFile) {
+            throw std::runtime_error("Couldn't open " + mTmpPath + " for writing.");
+        }
+    }
+
+    ~StateFileWriter() {
+        if (mFile) {
+            fclose(mFile);
+            unlink(mTmpPath.c_str());
+        }
+    }
+
+    StateFileWriter(const StateFileWriter&) = delete;
+    StateFileWriter& operator=(const StateFileWriter&) = delete;
+
+    void writeInt(int64_t i) {
+        write(&i, sizeof(i));
+    }
+
+    void writeBytes(const void* data, size_t size) {
+        writeInt(size);
+        write(data, size);
+    }
+
+    void writeString(const std::string& s) {
+        writeBytes(s.data(), s.size());
+    }
+
+    void write(const void* data, size_t size) {
+        if (size && fwrite(data, 1, size, mFile) != size) {
+            throw std::runtime_error("Failed writing to " + mTmpPath + ".");
+        }
+    }
+
+    // flush everything and move the file into place
+    void finish() {
+        FILE* file = mFile;
+        mFile = nullptr;
+
+        if (fflush(file) != 0 || fsync(fileno(file)) != 0) {
+            fclose(file);
+            unlink(mTmpPath.c_str());
+            throw std::runtime_error("Failed writing to " + mTmpPath + ".");
+        }
+
+        fclose(file);
+
+        if (rename(mTmpPath.c_str(), mPath.c_str()) != 0) {
+            unlink(mTmpPath.c_str());
+            throw std::runtime_error("Couldn't move " + mTmpPath + " to " + mPath + ".");
+        }
+    }
+
+private:
+    std::string mPath;
+
+    std::string mTmpPath;
+
+    FILE* mFile;
+};
+
+class StateFileReader {
+public:
+    StateFileReader(const std::string& path) :
+        mPath(path),
+        mData(nullptr),
+        mSize(0),
+        mPos(0)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+
+        if (fd < 0) {
+            throw std::runtime_error("Couldn't open " + path + ".");
+        }
+
+        struct stat st;
+
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("Couldn't stat " + path + ".");
+        }
+
+        mSize = st.st_size;
+
+        if (mSize) {
+            void* mapped = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (mapped == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Couldn't map " + path + ".");
+            }
+
+            size_t size = mSize;
+            mOwner = std::shared_ptr<const void>(mapped, [size](const void* p) {
+                munmap((void*)p, size);
+            });
+
+            mData = (const uint8_t*)mapped;
+        }
+
+        // the mapping stays valid without the descriptor
+        close(fd);
+    }
+
+    // keeps the mapping alive. Anything pointing into the file should hold one.
+    const std::shared_ptr<const void>& owner() const {
+        return mOwner;
+    }
+
+    int64_t readInt() {
+        int64_t i;
+        memcpy(&i, read(sizeof(i)), sizeof(i));
+        return i;
+    }
+
+    // the next byte string, as a pointer into the file
+    const uint8_t* readBytes(size_t& outSize) {
+        int64_t size = readInt();
+
+        if (size < 0) {
+            throw corrupt();
+        }
+
+        outSize = size;
+
+        return read(size);
+    }
+
+    std::string readString() {
+        size_t size;
+        const uint8_t* data = readBytes(size);
+
+        return std::string((const char*)data, size);
+    }
+
+    const uint8_t* read(size_t size) {
+        if (size > mSize - mPos) {
+            throw corrupt();
+        }
+
+        const uint8_t* res = mData + mPos;
+        mPos += size;
+
+        return res;
+    }
+
+    bool atEnd() const {
+        return mPos == mSize;
+    }
+
+    std::runtime_error corrupt() const {
+        return std::runtime_error("State file " + mPath + " is truncated or corrupt.");
+    }
+
+private:
+    std::string mPath;
+
+    std::shared_ptr<const void> mOwner;
+
+    const uint8_t* mData;
+
+    size_t mSize;
+
+    size_t mPos;
+};
@@ -0,0 +1,153 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include "Common.hpp"
+#include "BlockedSortedVector.hpp"
+
+/*************
+
+SubscribedObjectRanges maps object ids to the transaction id at which we
+became subscribed to them, as a sorted set of runs of consecutive ids that
+share a transaction id.
+
+Ids handed out from one identity root are dense, and index subscriptions
+mark whole batches of them at the same transaction, so a subscription to
+hundreds of thousands of objects usually collapses to a handful of runs.
+A lookup is a binary search over those.
+
+*************/
+
+class SubscribedObjectRanges {
+public:
+    enum { NO_TRANSACTION = -1 };
+
+    //the transaction at which we subscribed to 'oid', or NO_TRANSACTION
+    transaction_id lookup(object_id oid) const {
+        auto it = runContaining(oid);
+
+        if (it == m_runs.end()) {
+            return NO_TRANSACTION;
+        }
+
+        return it->tid;
+    }
+
+    //we're subscribed to 'oid' as of 'tid', unless we already were as of a later one
+    void mark(object_id oid, transaction_id tid) {
+        auto it = runContaining(oid);
+
+        if (it != m_runs.end()) {
+            Run run = *it;
+
+            if (run.tid >= tid) {
+                return;
+            }
+
+            m_runs.erase(it);
+
+            if (run.start < oid) {
+                m_runs.insert(Run(run.start, oid, run.tid));
+            }
+
+            if (oid + 1 < run.stop) {
+                m_runs.insert(Run(oid + 1, run.stop, run.tid));
+            }
+        }
+
+        insertAndMerge(Run(oid, oid + 1, tid));
+    }
+
+    size_t runCount() const {
+        return m_runs.size();
+    }
+
+    bool empty() const {
+        return m_runs.empty();
+    }
+
+private:
+    //the objects in [start, stop) became visible at 'tid'
+    class Run {
+    public:
+        Run() : start(0), stop(0), tid(NO_TRANSACTION)
+        {
+        }
+
+        Run(object_id inStart, object_id inStop, transaction_id inTid) :
+            start(inStart),
+            stop(inStop),
+            tid(inTid)
+        {
+        }
+
+        object_id start;
+        object_id stop;
+        transaction_id tid;
+    };
+
+    class RunLess {
+    public:
+        bool operator()(const Run& l, const Run& r) const {
+            return l.start < r.start;
+        }
+    };
+
+    typedef BlockedSortedVector<Run, RunLess> runs_type;
+
+    runs_type::iterator runContaining(object_id oid) const {
+        auto it = m_runs.upper_bound(Run(oid, oid, NO_TRANSACTION));
+
+        if (it == m_runs.begin()) {
+            return m_runs.end();
+        }
+
+        --it;
+
+        if (oid < it->stop) {
+            return it;
+        }
+
+        return m_runs.end();
+    }
+
+    //insert 'run', which doesn't overlap anything, joining it to its neighbors if
+    //they touch it and have the same tid
+    void insertAndMerge(Run run) {
+        auto after = m_runs.lower_bound(run);
+
+        if (after != m_runs.end() && after->start == run.stop && after->tid == run.tid) {
+            run.stop = after->stop;
+            m_runs.erase(after);
+        }
+
+        auto before = m_runs.lower_bound(run);
+
+        if (before != m_runs.begin()) {
+            --before;
+
+            if (before->stop == run.start && before->tid == run.tid) {
+                run.start = before->start;
+                m_runs.erase(before);
+            }
+        }
+
+        m_runs.insert(run);
+    }
+
+    runs_type m_runs;
+};
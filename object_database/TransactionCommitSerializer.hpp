@@ -0,0 +1,379 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <Python.h>
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <typed_python/Type.hpp>
+#include <typed_python/Instance.hpp>
+#include <typed_python/SerializationBuffer.hpp>
+#include <typed_python/SerializationContext.hpp>
+
+#include "View.hpp"
+#include "ObjectFieldId.hpp"
+#include "IndexId.hpp"
+#include "direct_types/all.hpp"
+
+/***********
+TransactionCommitSerializer turns the writes and reads a View has recorded
+into the ClientToServer messages that commit them, serialized the way
+'serialize(ClientToServer, msg)' would, without building any python
+objects along the way.
+
+We produce the same messages as DatabaseConnection._createTransaction:
+TransactionData messages, chunked so that none of them gets too big, the
+TransactionReads for reads recorded as ranges or fields, and a final
+CompleteTransaction. We don't interleave Heartbeats. Python needed those
+because building the chunks could take long enough for the server to give
+up on it, and the pump loop heartbeats on its own.
+***********/
+
+class TransactionCommitSerializer {
+public:
+    typedef ConstDict<ObjectFieldId, OneOf<None, Bytes> > writes_type;
+    typedef ConstDict<IndexId, TupleOf<object_id> > index_changes_type;
+    typedef ConstDict<int64_t, TupleOf<object_id> > key_ranges_type;
+
+    // the limits _createTransaction uses for each chunk
+    enum { max_entries_per_message = 10000, max_oids_per_message = 100000, max_range_ints_per_message = 20000 };
+
+    // throws if 'messageType' doesn't have the messages we produce, laid out the way we expect.
+    TransactionCommitSerializer(Alternative* messageType) :
+        mMessageType(messageType),
+        mTransactionDataIndex(subtypeIndex(
+            messageType,
+            "TransactionData",
+            {"writes", "set_adds", "set_removes", "key_versions", "index_versions", "transaction_guid"},
+            {
+                writes_type::getType(),
+                index_changes_type::getType(),
+                index_changes_type::getType(),
+                TupleOf<ObjectFieldId>::getType(),
+                TupleOf<IndexId>::getType(),
+                TypeDetails<int64_t>::getType()
+            }
+        )),
+        mTransactionReadsIndex(subtypeIndex(
+            messageType,
+            "TransactionReads",
+            {"key_ranges", "field_versions", "index_field_versions", "transaction_guid"},
+            {
+                key_ranges_type::getType(),
+                TupleOf<int64_t>::getType(),
+                TupleOf<int64_t>::getType(),
+                TypeDetails<int64_t>::getType()
+            }
+        )),
+        mCompleteTransactionIndex(subtypeIndex(
+            messageType,
+            "CompleteTransaction",
+            {"as_of_version", "transaction_guid"},
+            {TypeDetails<int64_t>::getType(), TypeDetails<int64_t>::getType()}
+        ))
+    {
+    }
+
+    // the serialized messages that commit 'view' as transaction 'transactionGuid',
+    // in the order they have to be sent. The caller must hold the GIL: values go
+    // through the view's SerializationContext, and serializing anything but the
+    // simplest types can call into python.
+    std::vector<std::string> serialize(View& view, int64_t transactionGuid, transaction_id asOfVersion) {
+        if (!PyGILState_Check()) {
+            throw std::runtime_error("TransactionCommitSerializer::serialize needs the GIL.");
+        }
+
+        std::vector<std::string> messages;
+
+        ChunkBuilder chunk(*this, messages, transactionGuid);
+
+        auto context = view.getSerializationContext();
+
+        for (const auto& keyAndValue: view.getWriteCache()) {
+            SerializationBuffer b(*context);
+
+            keyAndValue.second.type()->serialize(keyAndValue.second.data(), b, 0);
+
+            b.finalize();
+
+            chunk.addWrite(
+                ObjectFieldId(keyAndValue.first.second, keyAndValue.first.first, false),
+                Bytes((const char*)b.buffer(), b.size())
+            );
+        }
+
+        for (const auto& key: view.getDeleteCache()) {
+            chunk.addWrite(ObjectFieldId(key.second, key.first, false), None());
+        }
+
+        for (const auto& indexAndOids: view.getSetAdds()) {
+            chunk.addIndexChange(chunk.setAdds, chunk.setAddCount, indexAndOids.first, indexAndOids.second);
+        }
+
+        for (const auto& indexAndOids: view.getSetRemoves()) {
+            chunk.addIndexChange(chunk.setRemoves, chunk.setRemoveCount, indexAndOids.first, indexAndOids.second);
+        }
+
+        for (const auto& key: view.getReadValues()) {
+            chunk.addKeyVersion(ObjectFieldId(key.second, key.first, false));
+        }
+
+        for (const auto& indexKey: view.getSetReads()) {
+            chunk.addIndexVersion(IndexId(indexKey.fieldId(), indexKey.indexValue()));
+        }
+
+        view.visitReadKeyRanges([&](field_id field, const std::vector<object_id>& ranges) {
+            for (size_t start = 0; start < ranges.size(); start += max_range_ints_per_message) {
+                size_t count = std::min<size_t>(max_range_ints_per_message, ranges.size() - start);
+
+                std::vector<std::pair<int64_t, TupleOf<object_id> > > keyRanges;
+
+                keyRanges.push_back(std::make_pair(
+                    (int64_t)field,
+                    TupleOf<object_id>::fromBuffer(&ranges[start], count)
+                ));
+
+                messages.push_back(transactionReads(
+                    key_ranges_type(keyRanges),
+                    TupleOf<int64_t>(),
+                    TupleOf<int64_t>(),
+                    transactionGuid
+                ));
+            }
+        });
+
+        if (view.getReadFields().size() || view.getIndexRangeReads().size()) {
+            std::vector<int64_t> fields;
+            std::vector<int64_t> indices;
+
+            for (field_id field: view.getReadFields()) {
+                fields.push_back(field);
+            }
+
+            for (field_id index: view.getIndexRangeReads()) {
+                indices.push_back(index);
+            }
+
+            messages.push_back(transactionReads(
+                key_ranges_type(),
+                TupleOf<int64_t>(fields),
+                TupleOf<int64_t>(indices),
+                transactionGuid
+            ));
+        }
+
+        chunk.flush();
+
+        messages.push_back(serializeMessage(mCompleteTransactionIndex, [&](instance_ptr fields) {
+            *(int64_t*)fields = asOfVersion;
+            *(int64_t*)(fields + sizeof(int64_t)) = transactionGuid;
+        }));
+
+        return messages;
+    }
+
+private:
+    // accumulates the contents of one TransactionData message, and emits it
+    // whenever any part of it reaches its limit.
+    class ChunkBuilder {
+    public:
+        ChunkBuilder(TransactionCommitSerializer& serializer, std::vector<std::string>& messages, int64_t transactionGuid) :
+            mSerializer(serializer),
+            mMessages(messages),
+            mTransactionGuid(transactionGuid),
+            setAddCount(0),
+            setRemoveCount(0)
+        {
+        }
+
+        void addWrite(const ObjectFieldId& key, const OneOf<None, Bytes>& value) {
+            writes.push_back(std::make_pair(key, value));
+
+            if (writes.size() > max_entries_per_message) {
+                flush();
+            }
+        }
+
+        // empty changes are dropped, as python does
+        void addIndexChange(
+                    std::vector<std::pair<IndexId, TupleOf<object_id> > >& changes,
+                    size_t& oidCount,
+                    const IndexKey& index,
+                    const std::set<object_id>& oids
+                    ) {
+            if (oids.empty()) {
+                return;
+            }
+
+            std::vector<object_id> sorted(oids.begin(), oids.end());
+
+            changes.push_back(std::make_pair(
+                IndexId(index.fieldId(), index.indexValue()),
+                TupleOf<object_id>::fromBuffer(&sorted[0], sorted.size())
+            ));
+
+            oidCount += sorted.size();
+
+            if (changes.size() > max_entries_per_message || oidCount > max_oids_per_message) {
+                flush();
+            }
+        }
+
+        void addKeyVersion(const ObjectFieldId& key) {
+            keyVersions.push_back(key);
+
+            if (keyVersions.size() > max_entries_per_message) {
+                flush();
+            }
+        }
+
+        void addIndexVersion(const IndexId& index) {
+            indexVersions.push_back(index);
+
+            if (indexVersions.size() > max_entries_per_message) {
+                flush();
+            }
+        }
+
+        // emit whatever we have as a TransactionData message, even if it's empty
+        void flush() {
+            mMessages.push_back(mSerializer.serializeMessage(mSerializer.mTransactionDataIndex, [&](instance_ptr fields) {
+                *(writes_type*)fields = writes_type(writes);
+                fields += sizeof(writes_type);
+
+                *(index_changes_type*)fields = index_changes_type(setAdds);
+                fields += sizeof(index_changes_type);
+
+                *(index_changes_type*)fields = index_changes_type(setRemoves);
+                fields += sizeof(index_changes_type);
+
+                *(TupleOf<ObjectFieldId>*)fields = TupleOf<ObjectFieldId>(keyVersions);
+                fields += sizeof(TupleOf<ObjectFieldId>);
+
+                *(TupleOf<IndexId>*)fields = TupleOf<IndexId>(indexVersions);
+                fields += sizeof(TupleOf<IndexId>);
+
+                *(int64_t*)fields = mTransactionGuid;
+            }));
+
+            writes.clear();
+            setAdds.clear();
+            setRemoves.clear();
+            keyVersions.clear();
+            indexVersions.clear();
+            setAddCount = 0;
+            setRemoveCount = 0;
+        }
+
+    private:
+        TransactionCommitSerializer& mSerializer;
+
+        std::vector<std::string>& mMessages;
+
+        int64_t mTransactionGuid;
+
+    public:
+        std::vector<std::pair<ObjectFieldId, OneOf<None, Bytes> > > writes;
+
+        std::vector<std::pair<IndexId, TupleOf<object_id> > > setAdds;
+
+        std::vector<std::pair<IndexId, TupleOf<object_id> > > setRemoves;
+
+        // how many oids are in 'setAdds' and 'setRemoves'
+        size_t setAddCount;
+
+        size_t setRemoveCount;
+
+        std::vector<ObjectFieldId> keyVersions;
+
+        std::vector<IndexId> indexVersions;
+    };
+
+    std::string transactionReads(
+            const key_ranges_type& keyRanges,
+            const TupleOf<int64_t>& fieldVersions,
+            const TupleOf<int64_t>& indexFieldVersions,
+            int64_t transactionGuid
+            ) {
+        return serializeMessage(mTransactionReadsIndex, [&](instance_ptr fields) {
+            *(key_ranges_type*)fields = keyRanges;
+            fields += sizeof(key_ranges_type);
+
+            *(TupleOf<int64_t>*)fields = fieldVersions;
+            fields += sizeof(TupleOf<int64_t>);
+
+            *(TupleOf<int64_t>*)fields = indexFieldVersions;
+            fields += sizeof(TupleOf<int64_t>);
+
+            *(int64_t*)fields = transactionGuid;
+        });
+    }
+
+    // build a default instance of subtype 'index' of our message type, let 'fill'
+    // assign the fields of its data, and serialize it.
+    template<class fill_type>
+    std::string serializeMessage(int64_t index, const fill_type& fill) {
+        ConcreteAlternative* concrete = ConcreteAlternative::Make(mMessageType, index);
+
+        Instance message(concrete, [&](instance_ptr data) {
+            concrete->constructor(data);
+        });
+
+        fill((*(Alternative::layout**)message.data())->data);
+
+        NullSerializationContext context;
+        SerializationBuffer buffer(context);
+
+        mMessageType->serialize(message.data(), buffer, 0);
+
+        buffer.finalize();
+
+        return std::string((const char*)buffer.buffer(), buffer.size());
+    }
+
+    static int64_t subtypeIndex(Alternative* messageType, const std::string& name, const std::vector<std::string>& names, const std::vector<Type*>& types) {
+        const auto& subtypes = messageType->subtypes();
+
+        for (size_t k = 0; k < subtypes.size(); k++) {
+            if (subtypes[k].first == name) {
+                NamedTuple* fields = subtypes[k].second;
+
+                if (fields->getNames() != names || fields->getTypes() != types) {
+                    throw std::runtime_error(
+                        messageType->name() + "." + name + " isn't laid out the way TransactionCommitSerializer expects."
+                    );
+                }
+
+                return k;
+            }
+        }
+
+        throw std::runtime_error(messageType->name() + " has no " + name + " message.");
+    }
+
+    Alternative* mMessageType;
+
+    int64_t mTransactionDataIndex;
+
+    int64_t mTransactionReadsIndex;
+
+    int64_t mCompleteTransactionIndex;
+};
@@ -0,0 +1,217 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <Python.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <typed_python/Type.hpp>
+#include <typed_python/Instance.hpp>
+#include <typed_python/PyInstance.hpp>
+#include <typed_python/DeserializationBuffer.hpp>
+#include <typed_python/SerializationContext.hpp>
+
+#include "DatabaseConnectionPumpLoop.hpp"
+#include "DatabaseConnectionState.hpp"
+#include "ObjectFieldId.hpp"
+#include "IndexId.hpp"
+#include "direct_types/all.hpp"
+
+/***********
+TransactionMessageHandler decodes the ServerToClient messages a pump loop
+receives in C++ and applies each 'Transaction' straight to a
+DatabaseConnectionState, so python never sees the message itself.
+
+Python only gets a summary: we call 'onTransaction(transaction_id, fieldIds)'
+while holding the connection's lock, which is also held while we apply the
+transaction. Every other message goes to python already decoded, so nothing
+gets deserialized twice.
+
+Once 'disable' has been called we hand transactions to python as well. We
+check this after taking the lock, so a transaction that arrives while python
+is turning us off still reaches python's handlers.
+***********/
+
+class TransactionMessageHandler : public NativeMessageHandler {
+public:
+    typedef ConstDict<ObjectFieldId, OneOf<None, Bytes> > writes_type;
+    typedef ConstDict<IndexId, TupleOf<object_id> > index_changes_type;
+
+    TransactionMessageHandler(
+            Alternative* messageType,
+            std::shared_ptr<DatabaseConnectionState> state,
+            PyObject* lock,
+            PyObject* onTransaction
+            ) :
+        mMessageType(messageType),
+        mTransactionIndex(transactionIndex(messageType)),
+        mState(state),
+        mLock(incref(lock)),
+        mOnTransaction(incref(onTransaction)),
+        mIsEnabled(true)
+    {
+    }
+
+    ~TransactionMessageHandler() {
+        PyEnsureGilAcquired getTheGil;
+
+        decref(mLock);
+        decref(mOnTransaction);
+    }
+
+    // the index of 'Transaction' in 'messageType', or -1 if it doesn't have one
+    // laid out the way we expect.
+    static int64_t transactionIndex(Alternative* messageType) {
+        const auto& subtypes = messageType->subtypes();
+
+        for (size_t k = 0; k < subtypes.size(); k++) {
+            if (subtypes[k].first == "Transaction") {
+                NamedTuple* fields = subtypes[k].second;
+
+                std::vector<std::string> names({"writes", "set_adds", "set_removes", "transaction_id"});
+                std::vector<Type*> types({
+                    writes_type::getType(),
+                    index_changes_type::getType(),
+                    index_changes_type::getType(),
+                    TypeDetails<int64_t>::getType()
+                });
+
+                if (fields->getNames() != names || fields->getTypes() != types) {
+                    return -1;
+                }
+
+                return k;
+            }
+        }
+
+        return -1;
+    }
+
+    // call with the GIL
+    void disable() {
+        mIsEnabled = false;
+    }
+
+    PyObject* handle(const char* data, size_t size) override {
+        Instance message(mMessageType, [&](instance_ptr dataPtr) {
+            NullSerializationContext context;
+            DeserializationBuffer buffer((uint8_t*)data, size, context);
+
+            auto fieldAndWireType = buffer.readFieldNumberAndWireType();
+            mMessageType->deserialize(dataPtr, buffer, fieldAndWireType.second);
+        });
+
+        Alternative::layout* layout = *(Alternative::layout**)message.data();
+
+        if (layout->which != mTransactionIndex || !mIsEnabled) {
+            return PyInstance::extractPythonObject(message.data(), mMessageType);
+        }
+
+        callLockMethod("acquire");
+
+        // python may have turned us off while we waited for the lock
+        bool applied = mIsEnabled;
+
+        if (applied) {
+            try {
+                applyTransaction(layout->data);
+            } catch(...) {
+                releaseLockPreservingError();
+                throw;
+            }
+        }
+
+        callLockMethod("release");
+
+        if (!applied) {
+            return PyInstance::extractPythonObject(message.data(), mMessageType);
+        }
+
+        return nullptr;
+    }
+
+private:
+    // 'fields' points at the data of a ServerToClient.Transaction. Requires the lock.
+    void applyTransaction(instance_ptr fields) {
+        const writes_type& writes = *(writes_type*)fields;
+        const index_changes_type& setAdds = *(index_changes_type*)(fields + sizeof(writes_type));
+        const index_changes_type& setRemoves = *(index_changes_type*)(
+            fields + sizeof(writes_type) + sizeof(index_changes_type)
+        );
+        transaction_id tid = *(int64_t*)(fields + sizeof(writes_type) + 2 * sizeof(index_changes_type));
+
+        mState->incomingTransaction(tid, writes, setAdds, setRemoves);
+
+        PyObjectStealer fieldIds(PySet_New(nullptr));
+        if (!fieldIds) {
+            throw PythonExceptionSet();
+        }
+
+        for (const auto& keyValuePair: writes) {
+            PyObjectStealer fieldId(PyLong_FromLong(keyValuePair.first.fieldId()));
+
+            if (!fieldId || PySet_Add(fieldIds, fieldId) == -1) {
+                throw PythonExceptionSet();
+            }
+        }
+
+        PyObjectStealer pyTid(PyLong_FromLong(tid));
+        PyObjectStealer res(PyObject_CallFunctionObjArgs(mOnTransaction, (PyObject*)pyTid, (PyObject*)fieldIds, NULL));
+
+        if (!res) {
+            throw PythonExceptionSet();
+        }
+    }
+
+    void callLockMethod(const char* method) {
+        PyObjectStealer res(PyObject_CallMethod(mLock, method, NULL));
+
+        if (!res) {
+            throw PythonExceptionSet();
+        }
+    }
+
+    // we're unwinding, possibly with a python exception set. Release the lock without losing it.
+    void releaseLockPreservingError() {
+        PyObject *type, *value, *traceback;
+        PyErr_Fetch(&type, &value, &traceback);
+
+        PyObject* res = PyObject_CallMethod(mLock, "release", NULL);
+        if (res) {
+            decref(res);
+        } else {
+            PyErr_Clear();
+        }
+
+        PyErr_Restore(type, value, traceback);
+    }
+
+    Alternative* mMessageType;
+
+    int64_t mTransactionIndex;
+
+    std::shared_ptr<DatabaseConnectionState> mState;
+
+    PyObject* mLock;
+
+    PyObject* mOnTransaction;
+
+    // protected by the GIL
+    bool mIsEnabled;
+};
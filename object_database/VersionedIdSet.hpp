@@ -16,10 +16,12 @@
 
 #pragma once
 
-#include <map>
+#include <deque>
+#include <limits>
 #include <vector>
-#include <set>
 #include "Common.hpp"
+#include "BlockedSortedVector.hpp"
+#include "ViewTrace.hpp"
 #include <iostream>
 
 /*************
@@ -33,17 +35,170 @@ we can add or remove some object ids for a particular value.
 For every transactionId, we want to be able to efficiently determine
 the number of objects in the set and walk over them.
 
+Everything lives in contiguous sorted arrays:
+
+* mPresentAtLowestId holds the objects that were present at the lowest
+  guaranteed id and that haven't been touched since. They're active at
+  every transaction we can be asked about.
+* mHistory holds, for each object touched above the lowest guaranteed id,
+  its adds and removes ordered by (object, transaction). An object that was
+  present at the lowest id when it was first touched gets a marker entry
+  ordered before any real transaction.
+* mLog holds (transaction, object) for each entry in mHistory, ordered by
+  transaction, so we can fold entries into mPresentAtLowestId as the lowest
+  guaranteed id moves forward.
+
 *************/
 
 class VersionedIdSet {
+    class HistoryEntry {
+    public:
+        HistoryEntry(object_id inObj, transaction_id inTrans, bool inAdded) :
+                objectId(inObj),
+                transactionId(inTrans),
+                added(inAdded)
+        {
+        }
+
+        bool operator<(const HistoryEntry& other) const {
+            if (objectId < other.objectId) {
+                return true;
+            }
+            if (objectId > other.objectId) {
+                return false;
+            }
+            return transactionId < other.transactionId;
+        }
+
+        object_id objectId;
+        transaction_id transactionId;
+        bool added;
+    };
+
+    class LogEntry {
+    public:
+        LogEntry(transaction_id inTrans, object_id inObj) :
+                transactionId(inTrans),
+                objectId(inObj)
+        {
+        }
+
+        transaction_id transactionId;
+        object_id objectId;
+    };
+
+    /******
+    For a block of mHistory, an index of the intervals of transactions during
+    which each of its objects is active, so lookupNext can find the entries
+    active at 't' without walking the ones that aren't.
+
+    An add entry keeps its object active until the object's next entry, which
+    is always the entry right after it in the history, so at worst we have to
+    look at the first entry of the following block. We group the block's
+    entries into leaves of 'entries_per_leaf' consecutive entries and keep a
+    binary tree over the leaves, each node holding the smallest interval that
+    covers every active interval beneath it. Finding what's active at 't'
+    descends only into nodes whose interval contains 't', and walks only the
+    leaves it reaches.
+
+    So a long-lived object costs its own leaf and the path down to it, not
+    the block, and each object active at 't' costs O(log(max_block_size)).
+    A node also gets descended into when it covers both an interval that
+    ended before 't' and one that started after it, which for the sets we
+    keep, where 't' is rarely far behind the latest transaction, is uncommon.
+    ******/
+    class HistoryBlockSummary {
+    public:
+        enum {
+            entries_per_leaf = 8,
+            leaf_count = BlockedSortedVector<HistoryEntry>::max_block_size / entries_per_leaf
+        };
+
+        HistoryBlockSummary() {
+            std::fill(firstActive, firstActive + 2 * leaf_count, std::numeric_limits<transaction_id>::max());
+            std::fill(lastActive, lastActive + 2 * leaf_count, std::numeric_limits<transaction_id>::min());
+        }
+
+        static HistoryBlockSummary compute(const HistoryEntry* begin, const HistoryEntry* end, const HistoryEntry* next) {
+            HistoryBlockSummary res;
+
+            for (const HistoryEntry* e = begin; e != end; ++e) {
+                if (!e->added) {
+                    continue;
+                }
+
+                const HistoryEntry* following = e + 1 != end ? e + 1 : next;
+
+                transaction_id activeUntil = (following && following->objectId == e->objectId) ?
+                    following->transactionId - 1 : std::numeric_limits<transaction_id>::max();
+
+                size_t node = leaf_count + leafFor(e - begin);
+
+                res.firstActive[node] = std::min(res.firstActive[node], e->transactionId);
+                res.lastActive[node] = std::max(res.lastActive[node], activeUntil);
+            }
+
+            for (size_t node = leaf_count - 1; node >= 1; node--) {
+                res.firstActive[node] = std::min(res.firstActive[2 * node], res.firstActive[2 * node + 1]);
+                res.lastActive[node] = std::max(res.lastActive[2 * node], res.lastActive[2 * node + 1]);
+            }
+
+            return res;
+        }
+
+        // the leaf holding the entry at 'offset' in the block. A block never holds more
+        // than history_block_size entries, but if it did, the last leaf would take the rest.
+        static size_t leafFor(size_t offset) {
+            return std::min<size_t>(offset / entries_per_leaf, leaf_count - 1);
+        }
+
+        /******
+        call 'visitor' with each leaf at or after 'firstLeaf' that might have an
+        entry active at 't', in order, until it returns false. Returns false if
+        the visitor did. Counts the nodes we look at in 'steps'.
+        ******/
+        template<class visitor_type>
+        bool visitLeavesActiveAt(transaction_id t, size_t firstLeaf, int64_t& steps, const visitor_type& visitor) const {
+            return visitNode(1, 0, leaf_count, t, firstLeaf, steps, visitor);
+        }
+
+    private:
+        // 'node' covers the leaves in [lo, hi)
+        template<class visitor_type>
+        bool visitNode(size_t node, size_t lo, size_t hi, transaction_id t, size_t firstLeaf, int64_t& steps, const visitor_type& visitor) const {
+            steps++;
+
+            if (hi <= firstLeaf || firstActive[node] > t || lastActive[node] < t) {
+                return true;
+            }
+
+            if (node >= leaf_count) {
+                return visitor(lo);
+            }
+
+            size_t mid = (lo + hi) / 2;
+
+            return visitNode(2 * node, lo, mid, t, firstLeaf, steps, visitor)
+                && visitNode(2 * node + 1, mid, hi, t, firstLeaf, steps, visitor);
+        }
+
+        // node 1 is the root, node n has children 2n and 2n+1, and the leaves are
+        // nodes [leaf_count, 2 * leaf_count).
+        transaction_id firstActive[2 * leaf_count];
+        transaction_id lastActive[2 * leaf_count];
+    };
+
+    typedef BlockedSortedVector<HistoryEntry, std::less<HistoryEntry>, HistoryBlockSummary> history_type;
+
 public:
     VersionedIdSet() :
-            mGuaranteedLowestId(NO_TRANSACTION)
+            mGuaranteedLowestId(NO_TRANSACTION),
+            mTransactionCount(0)
     {
     }
 
     bool empty() const {
-        return mObjToTrans.size() == 0 && mPresentAtLowestId.size() == 0;
+        return mHistory.size() == 0 && mPresentAtLowestId.size() == 0;
     }
 
     transaction_id getGuaranteedLowestId() const {
@@ -51,86 +206,67 @@ public:
     }
 
     transaction_id nextTransactionToMoveForwardOn() const {
-        if (!mTransToObj.size()) {
+        if (!mLog.size()) {
             return NO_TRANSACTION;
         }
 
-        return mTransToObj.begin()->first;
+        return mLog.front().transactionId;
     }
 
     transaction_id moveGuaranteedLowestIdForward(transaction_id t) {
+        size_t unlimited = std::numeric_limits<size_t>::max();
+        return moveGuaranteedLowestIdForward(t, unlimited);
+    }
+
+    // like moveGuaranteedLowestIdForward(t), but consume at most 'workRemaining' log
+    // entries, counting it down as we go. If we run out, the result will be <= t, and
+    // calling us again with the same 't' picks up where we left off.
+    transaction_id moveGuaranteedLowestIdForward(transaction_id t, size_t& workRemaining) {
         if (t < mGuaranteedLowestId) {
             throw std::runtime_error("Can't ask about a transaction id before the lowest guaranteed id");
         }
-        if (t == mGuaranteedLowestId) {
-            return nextTransactionToMoveForwardOn();
-        }
 
         mGuaranteedLowestId = t;
 
-        while (mTransToObj.size() && mTransToObj.begin()->first <= mGuaranteedLowestId) {
-            transaction_id transToDrop = mTransToObj.begin()->first;
-
-            auto& addsAndRemoves = mTransToObj.begin()->second;
+        while (workRemaining && mLog.size() && mLog.front().transactionId <= mGuaranteedLowestId) {
+            LogEntry entry = mLog.front();
+            mLog.pop_front();
+            workRemaining--;
 
-            for (auto objAndAdded: addsAndRemoves) {
-                if (objAndAdded.second) {
-                    mPresentAtLowestId.insert(objAndAdded.first);
-                } else {
-                    mPresentAtLowestId.erase(objAndAdded.first);
-                }
-
-                auto& transForThisObj = mObjToTrans[objAndAdded.first];
-
-                transForThisObj.erase(transToDrop);
-
-                if (transForThisObj.size() == 0) {
-                    mObjToTrans.erase(objAndAdded.first);
-                }
+            if (!mLog.size() || mLog.front().transactionId != entry.transactionId) {
+                mTransactionCount--;
             }
 
-            mTransToObj.erase(mTransToObj.begin());
+            foldObjectHistory(entry.objectId);
         }
 
         return nextTransactionToMoveForwardOn();
     }
 
-
     bool isActive(transaction_id t, object_id o) const {
         if (t < mGuaranteedLowestId) {
             throw std::runtime_error("Can't ask about a transaction id before the lowest guaranteed id");
         }
 
-        auto it = mObjToTrans.find(o);
-        if (it == mObjToTrans.end()) {
-            return mPresentAtLowestId.find(o) != mPresentAtLowestId.end();
-        }
-
-        if (it->second.size() == 0) {
-            throw std::runtime_error(
-                "Empty transaction lookup table should have been deleted."
-                );
-        }
-
-        auto t_it = it->second.lower_bound(t);
+        // the first entry strictly after (o, t)
+        auto it = mHistory.upper_bound(HistoryEntry(o, t, false));
 
-        //we're at the end. last transaction add/remove dictates
-        if (t_it == it->second.end()) {
-            t_it--;
-            return t_it->second;
-        }
+        if (it != mHistory.begin()) {
+            auto prior = it;
+            --prior;
 
-        if (t_it->first == t) {
-            return t_it->second;
+            if (prior->objectId == o) {
+                return prior->added;
+            }
         }
 
-        if (t_it == it->second.begin()) {
-            return mPresentAtLowestId.find(o) != mPresentAtLowestId.end();
+        // if we have history for 'o', it's not in mPresentAtLowestId, and
+        // none of its history is at or below 't'.
+        if (it != mHistory.end() && it->objectId == o) {
+            return false;
         }
 
-        t_it--;
-
-        return t_it->second;
+        return mPresentAtLowestId.contains(o);
     }
 
     object_id lookupOne(transaction_id t) const {
@@ -157,54 +293,41 @@ public:
     /******
     find the next object active at this transaction.
 
-    it this could get slow if you have had many objects in the index
-    over time but most of them are not active. it would be better to store
-    a 'next object' table (that's also versioned).
+    objects in mPresentAtLowestId are always active. Objects with history
+    might not be, so we use each block's summary of mHistory to find its
+    entries active at 't' without walking the rest. A walk over all of them
+    costs O(blocks + active * log(max_block_size)), give or take the nodes
+    described in HistoryBlockSummary, however long the dead objects around
+    the active ones have been dead.
     ******/
     object_id lookupNext(transaction_id t, object_id o) const {
-        auto g_it = mPresentAtLowestId.upper_bound(o);
-        auto o_it = mObjToTrans.upper_bound(o);
-
-        //step through both sets at the same time checking each value
-        while (g_it != mPresentAtLowestId.end() || o_it != mObjToTrans.end()) {
-            if (g_it == mPresentAtLowestId.end()) {
-                if (isActive(t, o_it->first)) {
-                    return o_it->first;
-                } else {
-                    o_it++;
-                }
-            } else if (o_it == mObjToTrans.end()) {
-                if (isActive(t, *g_it)) {
-                    return *g_it;
-                } else {
-                    g_it++;
-                }
-            } else {
-                //both are active
-                if (o_it->first < *g_it) {
-                    if (isActive(t, o_it->first)) {
-                        return o_it->first;
-                    } else {
-                        o_it++;
-                    }
-                } else if (*g_it < o_it->first) {
-                    if (isActive(t, *g_it)) {
-                        return *g_it;
-                    } else {
-                        g_it++;
-                    }
-                } else {
-                    if (isActive(t, *g_it)) {
-                        return *g_it;
-                    } else {
-                        o_it++;
-                        g_it++;
-                    }
-                }
-            }
-        }
+        object_id result = NO_OBJECT;
 
-        return NO_OBJECT;
+        visitActiveAfter(t, o, [&](object_id active) {
+            result = active;
+            return false;
+        });
+
+        return result;
+    }
+
+    /******
+    call 'visitor' with each object active at transaction 't', in order.
+    The visitor returns false to stop early.
+    ******/
+    template<class visitor_type>
+    void lookupAll(transaction_id t, const visitor_type& visitor) const {
+        visitActiveAfter(t, NO_OBJECT, visitor);
+    }
+
+    // the number of steps lookupAll(t) takes: nodes of the block summaries it looks
+    // at, and entries it walks. For tests and diagnostics.
+    int64_t lookupAllSteps(transaction_id t) const {
+        int64_t stepsTaken = 0;
+
+        visitActiveAfter(t, NO_OBJECT, [](object_id) { return true; }, &stepsTaken);
+
+        return stepsTaken;
     }
 
     void add(transaction_id t, object_id o) {
@@ -216,8 +339,7 @@ public:
             return;
         }
 
-        mTransToObj[t][o] = true;
-        mObjToTrans[o][t] = true;
+        setHistoryEntry(t, o, true);
     }
 
     void remove(transaction_id t, object_id o) {
@@ -229,12 +351,11 @@ public:
             return;
         }
 
-        mTransToObj[t][o] = false;
-        mObjToTrans[o][t] = false;
+        setHistoryEntry(t, o, false);
     }
 
     size_t transactionCount() const {
-        return mTransToObj.size();
+        return mTransactionCount;
     }
 
     void dumpState() const {
@@ -245,41 +366,230 @@ public:
             std::cout << "    " << i << "\n";
         }
 
-        for (auto t: mTransToObj) {
-            std::cout << "transaction_id: " << t.first << std::endl;
-            for (auto oAndA: t.second) {
-                std::cout << "   o=" << oAndA.first << " and " << (oAndA.second ? "add":"rem") << "\n";
-            }
+        for (auto& entry: mLog) {
+            std::cout << "transaction_id: " << entry.transactionId << " o=" << entry.objectId << std::endl;
         }
 
-        for (auto t: mObjToTrans) {
-            std::cout << "object_id: " << t.first << std::endl;
-            for (auto oAndA: t.second) {
-                std::cout << "   t=" << oAndA.first << " and " << (oAndA.second ? "add":"rem") << "\n";
+        for (auto& entry: mHistory) {
+            std::cout << "object_id: " << entry.objectId << " t=";
+            if (entry.transactionId == presentAtLowestIdMarker()) {
+                std::cout << "<lowest>";
+            } else {
+                std::cout << entry.transactionId;
             }
+            std::cout << " and " << (entry.added ? "add":"rem") << "\n";
         }
     }
 
     size_t totalEntryCount() const {
-        size_t res = mPresentAtLowestId.size();
+        return mPresentAtLowestId.size() + mLog.size();
+    }
+
+    // bytes of memory held by the set, for diagnostics.
+    size_t bytesAllocated() const {
+        return mPresentAtLowestId.bytesAllocated() + mHistory.bytesAllocated() + mLog.size() * sizeof(LogEntry);
+    }
+
+private:
+    // call 'visitor' on each object above 'o' active at 't' until it returns false.
+    // If 'stepsTaken', set it to the number of steps the walk took.
+    template<class visitor_type>
+    void visitActiveAfter(transaction_id t, object_id o, const visitor_type& visitor, int64_t* stepsTaken = nullptr) const {
+        StepCounter steps(stepsTaken);
+
+        auto g_it = mPresentAtLowestId.upper_bound(o);
+        auto h_it = mHistory.upper_bound(HistoryEntry(o, std::numeric_limits<transaction_id>::max(), false));
+
+        if ((g_it != mPresentAtLowestId.end() || h_it != mHistory.end()) && t < mGuaranteedLowestId) {
+            throw std::runtime_error("Can't ask about a transaction id before the lowest guaranteed id");
+        }
+
+        while (h_it != mHistory.end()) {
+            size_t block = h_it.block();
+            size_t firstOffset = h_it.offset();
+            size_t blockSize = mHistory.blockSize(block);
+            const HistoryEntry* entries = mHistory.blockData(block);
+            const HistoryEntry* next = block + 1 < mHistory.blockCount() ? mHistory.blockData(block + 1) : nullptr;
+
+            // an add entry is the one active for its object at 't' if it's at or below
+            // 't' and the object's next entry isn't. Each object has at most one such
+            // entry, and the leaves hand them to us in object order.
+            bool keepGoing = mHistory.blockSummary(block).visitLeavesActiveAt(
+                t,
+                HistoryBlockSummary::leafFor(firstOffset),
+                steps.count,
+                [&](size_t leaf) {
+                    size_t lo = std::max(leaf * HistoryBlockSummary::entries_per_leaf, firstOffset);
+                    size_t hi = leaf + 1 < HistoryBlockSummary::leaf_count ?
+                        std::min((leaf + 1) * HistoryBlockSummary::entries_per_leaf, blockSize) : blockSize;
+
+                    for (size_t i = lo; i < hi; i++) {
+                        steps.count++;
+
+                        const HistoryEntry& e = entries[i];
+
+                        if (!e.added || e.transactionId > t) {
+                            continue;
+                        }
+
+                        const HistoryEntry* following = i + 1 < blockSize ? &entries[i + 1] : next;
+
+                        if (following && following->objectId == e.objectId && following->transactionId <= t) {
+                            continue;
+                        }
+
+                        // objects in mPresentAtLowestId have no history, so they're active.
+                        while (g_it != mPresentAtLowestId.end() && *g_it < e.objectId) {
+                            steps.count++;
+                            if (!visitor(*g_it)) {
+                                return false;
+                            }
+                            ++g_it;
+                        }
+
+                        if (!visitor(e.objectId)) {
+                            return false;
+                        }
+                    }
+
+                    return true;
+                }
+            );
+
+            if (!keepGoing) {
+                return;
+            }
 
-        for (auto& tidAndObjects: mTransToObj) {
-            res += tidAndObjects.second.size();
+            h_it = mHistory.blockBegin(block + 1);
         }
 
-        return res;
+        while (g_it != mPresentAtLowestId.end()) {
+            steps.count++;
+            if (!visitor(*g_it)) {
+                return;
+            }
+            ++g_it;
+        }
+    }
+
+    // counts the steps one walk takes, and charges them to the active ViewTrace
+    // scope (and to 'report', if it's set) when it's done, so the walk itself only
+    // bumps a local
+    class StepCounter {
+    public:
+        StepCounter(int64_t* inReport) : count(0), report(inReport)
+        {
+        }
+
+        ~StepCounter() {
+            ViewTrace::Scope* trace = ViewTrace::active();
+
+            if (trace) {
+                trace->counters.indexLookupSteps += count;
+            }
+
+            if (report) {
+                *report = count;
+            }
+        }
+
+        int64_t count;
+
+        int64_t* report;
+    };
+
+    // the transaction id we use to mark an object as present at the lowest id
+    static transaction_id presentAtLowestIdMarker() {
+        return std::numeric_limits<transaction_id>::min();
+    }
+
+    bool hasHistory(object_id o) const {
+        auto it = mHistory.lower_bound(HistoryEntry(o, presentAtLowestIdMarker(), false));
+
+        return it != mHistory.end() && it->objectId == o;
+    }
+
+    void setHistoryEntry(transaction_id t, object_id o, bool added) {
+        // if this is the first time we've touched an object that was present
+        // at the lowest id, move it out of mPresentAtLowestId and into the history.
+        if (!hasHistory(o) && mPresentAtLowestId.erase(o)) {
+            mHistory.insert(HistoryEntry(o, presentAtLowestIdMarker(), true));
+        }
+
+        if (mHistory.replace(HistoryEntry(o, t, added))) {
+            return;
+        }
+
+        mHistory.insert(HistoryEntry(o, t, added));
+
+        // keep the log sorted by transaction. Most of the time we're appending.
+        auto it = mLog.end();
+        if (mLog.size() && mLog.back().transactionId > t) {
+            it = std::upper_bound(mLog.begin(), mLog.end(), t,
+                [](transaction_id tid, const LogEntry& e) { return tid < e.transactionId; }
+            );
+        }
+
+        if (it == mLog.begin() || (it - 1)->transactionId != t) {
+            mTransactionCount++;
+        }
+
+        mLog.insert(it, LogEntry(t, o));
+    }
+
+    // fold every history entry for 'o' at or below the lowest guaranteed id
+    // into mPresentAtLowestId.
+    void foldObjectHistory(object_id o) {
+        std::vector<HistoryEntry> toDrop;
+        bool activeAtLowest = false;
+        bool hasLaterEntries = false;
+
+        for (auto it = mHistory.lower_bound(HistoryEntry(o, presentAtLowestIdMarker(), false));
+                    it != mHistory.end() && it->objectId == o; ++it) {
+            if (it->transactionId <= mGuaranteedLowestId) {
+                toDrop.push_back(*it);
+                activeAtLowest = it->added;
+            } else {
+                hasLaterEntries = true;
+                break;
+            }
+        }
+
+        if (toDrop.size() == 0) {
+            return;
+        }
+
+        // the only thing below the lowest id is the marker, which is already folded
+        if (hasLaterEntries && toDrop.size() == 1 && toDrop[0].transactionId == presentAtLowestIdMarker()) {
+            return;
+        }
+
+        for (auto& entry: toDrop) {
+            mHistory.erase(entry);
+        }
+
+        if (activeAtLowest) {
+            if (hasLaterEntries) {
+                mHistory.insert(HistoryEntry(o, presentAtLowestIdMarker(), true));
+            } else {
+                mPresentAtLowestId.insert(o);
+            }
+        }
     }
 
-private:
     transaction_id mGuaranteedLowestId; //the lowest transaction anyone will ever ask us about
 
-    //a collection of objects present at the 'lowest id'
-    std::set<object_id> mPresentAtLowestId;
+    //objects present at the 'lowest id' that have no entries in mHistory
+    BlockedSortedVector<object_id> mPresentAtLowestId;
+
+    //for each object touched above the lowest guaranteed id, the transactions where it
+    //was added and removed, ordered by (object, transaction)
+    history_type mHistory;
 
-    //for each transaction, what did we add? only populated for transactions above the lowest
-    //guaranteed id
-    std::map<transaction_id, std::map<object_id, bool> > mTransToObj;
+    //for each entry in mHistory (other than markers), its transaction and object,
+    //ordered by transaction.
+    std::deque<LogEntry> mLog;
 
-    //for each object, the transactions where it was added (true) and removed (false)
-    std::map<object_id, std::map<transaction_id, bool> > mObjToTrans;
+    //the number of distinct transactions in mLog
+    size_t mTransactionCount;
 };
@@ -130,3 +130,99 @@ class VersionedIdSetTest(unittest.TestCase):
 
             self.assertTrue(s.isActive(100, 10))
             self.assertFalse(s.isActive(101, 10))
+
+    def test_iterating_churny_set(self):
+        # ids that were active once but aren't anymore shouldn't show up
+        # when we walk the set, even though we haven't collected them yet.
+        s = VersionedIdSet()
+
+        for oid in range(10000):
+            s.add(oid, oid)
+            s.remove(oid + 5, oid)
+
+        for tid in [0, 3, 2000, 5000, 9997, 10010]:
+            active = []
+            oid = s.lookupFirst(tid)
+            while oid != -1:
+                active.append(oid)
+                oid = s.lookupNext(tid, oid)
+
+            self.assertEqual(active, list(range(max(tid - 4, 0), min(tid + 1, 10000))))
+
+    def test_iterating_mixed_lifetimes(self):
+        # one long-lived id among many short-lived ones, before and after its
+        # history is folded into the ids present at the lowest id.
+        s = VersionedIdSet()
+
+        longLived = 500
+
+        for oid in range(2000):
+            s.add(oid + 1, oid)
+            if oid != longLived:
+                s.remove(oid + 3, oid)
+
+        def walk(tid):
+            active = []
+            oid = s.lookupFirst(tid)
+            while oid != -1:
+                active.append(oid)
+                oid = s.lookupNext(tid, oid)
+            return active
+
+        for tid in [1, 2, 250, 501, 502, 503, 1000, 1999, 2001, 2002, 5000]:
+            expected = sorted(
+                set(range(max(tid - 2, 0), min(tid, 2000)))
+                | ({longLived} if tid > longLived else set())
+            )
+
+            self.assertEqual(walk(tid), expected, tid)
+            self.assertEqual(s.lookupAll(tid), TupleOf(int)(expected), tid)
+
+        s.moveGuaranteedLowestIdForward(1000)
+
+        for tid in [1000, 1500, 5000]:
+            expected = sorted(set(range(tid - 2, min(tid, 2000))) | {longLived})
+
+            self.assertEqual(walk(tid), expected, tid)
+
+    def test_walks_skip_dead_objects_around_long_lived_ones(self):
+        # one long-lived id in every hundred means every block of history has one
+        # in it. The walk should still cost about what's active, not what's in the
+        # blocks around it.
+        s = VersionedIdSet()
+
+        for oid in range(2000):
+            s.add(oid + 1, oid)
+            if oid % 100 != 0:
+                s.remove(oid + 3, oid)
+
+        historySize = s.totalEntryCount()
+
+        for tid in [1500, 5000]:
+            expected = sorted(
+                set(range(tid - 2, min(tid, 2000))) | set(range(0, min(tid, 2000), 100))
+            )
+
+            self.assertEqual(s.lookupAll(tid), TupleOf(int)(expected), tid)
+            self.assertLess(s.lookupAllSteps(tid), historySize / 5, tid)
+
+    def test_lookup_all(self):
+        s = VersionedIdSet()
+
+        for oid in range(100):
+            s.add(oid, oid)
+            if oid % 3 == 0:
+                s.remove(oid + 10, oid)
+
+        s.moveGuaranteedLowestIdForward(50)
+
+        for tid in [50, 75, 200]:
+            walked = []
+            oid = s.lookupFirst(tid)
+            while oid != -1:
+                walked.append(oid)
+                oid = s.lookupNext(tid, oid)
+
+            self.assertEqual(s.lookupAll(tid), TupleOf(int)(walked))
+
+        self.assertEqual(len(s.lookupAll(200)), 66)
@@ -15,6 +15,9 @@
 ******************************************************************************/
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <limits>
 #include <memory>
 #include <map>
 
@@ -23,6 +26,8 @@
 #include "HashFunctions.hpp"
 #include "VersionedObjectsOfType.hpp"
 #include "VersionedObjectsOfMultiType.hpp"
+#include "DeserializedValueCache.hpp"
+#include "OrderedIndex.hpp"
 
 /*************
 
@@ -39,26 +44,52 @@ We provide functionality to
 
 class VersionedObjects {
 public:
+    VersionedObjects() : m_gc_target(NO_TRANSACTION), m_generation(0)
+    {
+    }
+
+    //readers don't create fields they find missing, so that only writers ever change
+    //m_field_to_versioned_objects. See SnapshotView.
     bool existsAtTransaction(Type* t, field_id fieldId, object_id objectId, transaction_id version) {
-        return versionedObjectsForFieldId(fieldId)->existsAtTransaction(t, objectId, version);
+        VersionedObjectsOfMultiType* objects = findVersionedObjectsForFieldId(fieldId);
+
+        return objects && objects->existsAtTransaction(t, objectId, version);
     }
 
     std::pair<instance_ptr, transaction_id> bestObjectVersion(Type* t, const std::shared_ptr<SerializationContext>& ctx, field_id fieldId, object_id objectId, transaction_id version) {
-        return versionedObjectsForFieldId(fieldId)->best(t, ctx, objectId, version);
-    }
+        VersionedObjectsOfMultiType* objects = findVersionedObjectsForFieldId(fieldId);
 
-    bool addObjectVersion(field_id fieldId, object_id oid, transaction_id tid, Bytes data) {
-        //mark this field on this transaction so we can garbage collect it
-        m_fields_needing_check.insert(std::make_pair(tid,fieldId));
+        if (!objects) {
+            return std::pair<instance_ptr, transaction_id>(nullptr, NO_TRANSACTION);
+        }
+
+        return objects->best(t, ctx, objectId, version);
+    }
 
-        return versionedObjectsForFieldId(fieldId)->add(oid, tid, data);
+    bool addObjectVersion(field_id fieldId, object_id oid, transaction_id tid, const Bytes& data) {
+        return fieldForWrite(fieldId, tid)->add(oid, tid, data);
     }
 
     bool markObjectVersionDeleted(field_id fieldId, object_id objectId, transaction_id version) {
+        return fieldForWrite(fieldId, version)->markDeleted(objectId, version);
+    }
+
+    //see VersionedObjectsOfMultiType::addShared
+    bool addSharedObjectVersion(field_id fieldId, object_id oid, transaction_id tid, std::shared_ptr<const void> owner, const uint8_t* data, size_t size) {
+        return fieldForWrite(fieldId, tid)->addShared(oid, tid, std::move(owner), data, size);
+    }
+
+    /*****
+    the objects for 'fieldId', ready to take writes at transaction 'tid'. Writing to
+    it touches nothing outside of the field itself, so writes to different fields
+    can happen on different threads once we've done this for each of them.
+    *****/
+    VersionedObjectsOfMultiType* fieldForWrite(field_id fieldId, transaction_id tid) {
         //mark this field on this transaction so we can garbage collect it
-        m_fields_needing_check.insert(std::make_pair(version, fieldId));
+        m_fields_needing_check.insert(std::make_pair(tid, fieldId));
+        m_generation++;
 
-        return versionedObjectsForFieldId(fieldId)->markDeleted(objectId, version);
+        return versionedObjectsForFieldId(fieldId);
     }
 
     object_id indexLookupOne(field_id fid, index_value i, transaction_id t) {
@@ -87,6 +118,54 @@ public:
         return it->second.lookupNext(t, o);
     }
 
+    //call 'visitor' with each object in the index at transaction 't', in order, until it returns false.
+    template<class visitor_type>
+    void indexLookupAll(field_id fid, index_value i, transaction_id t, const visitor_type& visitor) {
+        IndexKey key(fid,i);
+
+        auto it = m_index_to_versioned_id_sets.find(key);
+        if (it == m_index_to_versioned_id_sets.end()) {
+            return;
+        }
+
+        it->second.lookupAll(t, visitor);
+    }
+
+    //the VersionedIdSet holding index value 'i' of field 'fid', or nullptr if it's empty.
+    const VersionedIdSet* indexIdSet(field_id fid, index_value i) {
+        auto it = m_index_to_versioned_id_sets.find(IndexKey(fid, i));
+        if (it == m_index_to_versioned_id_sets.end()) {
+            return nullptr;
+        }
+
+        return &it->second;
+    }
+
+    //the ordered view of the values of index 'fid', which has values of type 'indexType'.
+    //we start tracking order the first time someone asks.
+    OrderedIndex& orderedIndex(field_id fid, Type* indexType) {
+        auto it = m_ordered_indices.find(fid);
+
+        if (it != m_ordered_indices.end()) {
+            if (it->second->getIndexType() != indexType) {
+                throw std::runtime_error("Index was already ordered using a different type.");
+            }
+            return *it->second;
+        }
+
+        std::shared_ptr<OrderedIndex> ordered(new OrderedIndex(indexType));
+
+        for (auto& keyAndSet: m_index_to_versioned_id_sets) {
+            if (keyAndSet.first.fieldId() == fid) {
+                ordered->valueAdded(keyAndSet.first.indexValue());
+            }
+        }
+
+        m_ordered_indices[fid] = ordered;
+
+        return *ordered;
+    }
+
     bool indexContains(field_id fid, index_value i, transaction_id t, object_id o) {
         IndexKey key(fid,i);
 
@@ -99,56 +178,207 @@ public:
     }
 
     void indexAdd(field_id fid, index_value i, transaction_id t, object_id o) {
-        m_indices_needing_check.insert(std::pair<transaction_id, IndexKey>(t, IndexKey(fid, i)));
-
-        return m_index_to_versioned_id_sets[IndexKey(fid, i)].add(t,o);
+        return indexIdSetForWrite(fid, i, t).add(t,o);
     }
 
     void indexRemove(field_id fid, index_value i, transaction_id t, object_id o) {
+        return indexIdSetForWrite(fid, i, t).remove(t,o);
+    }
+
+    //the set for index value 'i' of field 'fid', ready to take adds and removes at
+    //transaction 't'. As with 'fieldForWrite', different sets can be written from
+    //different threads once we've done this for each of them.
+    VersionedIdSet& indexIdSetForWrite(field_id fid, index_value i, transaction_id t) {
         m_indices_needing_check.insert(std::pair<transaction_id, IndexKey>(t, IndexKey(fid, i)));
 
-        return m_index_to_versioned_id_sets[IndexKey(fid, i)].remove(t,o);
+        noteIndexValueExists(fid, i);
+
+        return m_index_to_versioned_id_sets[IndexKey(fid, i)];
+    }
+
+    //call 'visitor' with the field id, index value and VersionedIdSet of every index
+    //value we're tracking
+    template<class visitor_type>
+    void visitIndexIdSets(const visitor_type& visitor) const {
+        for (auto& keyAndSet: m_index_to_versioned_id_sets) {
+            visitor(keyAndSet.first.fieldId(), keyAndSet.first.indexValue(), keyAndSet.second);
+        }
+    }
+
+    //drop every version of every object in 'fieldId', and every index value of it, as
+    //if we'd never seen them. Nobody can be looking at them.
+    void forgetField(field_id fieldId) {
+        VersionedObjectsOfMultiType* objects = findVersionedObjectsForFieldId(fieldId);
+
+        if (objects) {
+            objects->removeAllObjects();
+            m_generation++;
+        }
+
+        auto ordered_it = m_ordered_indices.find(fieldId);
+
+        for (auto it = m_index_to_versioned_id_sets.begin(); it != m_index_to_versioned_id_sets.end();) {
+            if (it->first.fieldId() == fieldId) {
+                if (ordered_it != m_ordered_indices.end()) {
+                    ordered_it->second->valueRemoved(it->first.indexValue());
+                }
+                it = m_index_to_versioned_id_sets.erase(it);
+            } else {
+                ++it;
+            }
+        }
     }
 
+    //forget everything below 't', right now.
     void moveGuaranteedLowestIdForward(transaction_id t) {
-        while (m_fields_needing_check.size() && m_fields_needing_check.begin()->first < t) {
+        setGarbageCollectionTarget(t);
+        collectGarbage(std::numeric_limits<size_t>::max());
+    }
+
+    //allow garbage collection of everything below 't'. Nothing happens until
+    //someone calls 'collectGarbage'.
+    void setGarbageCollectionTarget(transaction_id t) {
+        if (t > m_gc_target) {
+            m_gc_target = t;
+        }
+    }
+
+    transaction_id getGarbageCollectionTarget() const {
+        return m_gc_target;
+    }
+
+    /*****
+    Make progress collecting garbage below the target, doing at most 'maxWork'
+    units of work (checking a single object's versions or consuming a single
+    index log entry), and stopping early once more than 'maxMicroseconds' have
+    elapsed, if it's nonnegative. Returns the number of units of work we did.
+    *****/
+    size_t collectGarbage(size_t maxWork, int64_t maxMicroseconds = -1) {
+        //how many units of work between checks of the clock
+        const size_t workPerClockCheck = 64;
+
+        transaction_id t = m_gc_target;
+        size_t workRemaining = maxWork;
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(maxMicroseconds);
+
+        auto outOfTime = [&]() {
+            return maxMicroseconds >= 0 && std::chrono::steady_clock::now() >= deadline;
+        };
+
+        //stop at the next clock check, or when 'workRemaining' runs out
+        auto takeSlice = [&]() {
+            return std::min(workRemaining, workPerClockCheck);
+        };
+
+        while (workRemaining && m_fields_needing_check.size() && m_fields_needing_check.begin()->first < t) {
             //grab the field id and consume it from the queue
             field_id fieldId = m_fields_needing_check.begin()->second;
             m_fields_needing_check.erase(m_fields_needing_check.begin());
 
-            m_field_to_versioned_objects[fieldId]->moveGuaranteedLowestIdForward(t);
+            VersionedObjectsOfMultiType* objects = m_field_to_versioned_objects[fieldId].get();
+
+            bool done = false;
+
+            while (!done && workRemaining) {
+                size_t slice = takeSlice();
+                size_t sliceRemaining = slice;
+
+                done = objects->moveGuaranteedLowestIdForward(t, sliceRemaining);
+                workRemaining -= slice - sliceRemaining;
+
+                if (!done && outOfTime()) {
+                    break;
+                }
+            }
+
+            if (!done) {
+                //come back to it later. It's still below 't'.
+                m_fields_needing_check.insert(std::make_pair(objects->nextTransactionToCheck(), fieldId));
+                return maxWork - workRemaining;
+            }
+
+            if (outOfTime()) {
+                return maxWork - workRemaining;
+            }
         }
 
-        while (m_indices_needing_check.size() && m_indices_needing_check.begin()->first < t) {
+        while (workRemaining && m_indices_needing_check.size() && m_indices_needing_check.begin()->first < t) {
             //grab the field id and consume it from the queue
             IndexKey indexId = m_indices_needing_check.begin()->second;
             m_indices_needing_check.erase(m_indices_needing_check.begin());
 
             auto& versionedIdSet = m_index_to_versioned_id_sets[indexId];
 
-            transaction_id next = versionedIdSet.moveGuaranteedLowestIdForward(t);
+            size_t slice = takeSlice();
+            size_t sliceRemaining = slice;
+
+            transaction_id next = versionedIdSet.moveGuaranteedLowestIdForward(t, sliceRemaining);
+
+            //count the set itself as work, so that sets with nothing to do still use up our budget
+            workRemaining -= std::max<size_t>(1, slice - sliceRemaining);
 
             if (next != NO_TRANSACTION) {
-                m_indices_needing_check.insert(std::make_pair(next, indexId));
+                //if we didn't finish, 'next' is at or below 't'. It could be 't' itself,
+                //which we wouldn't look at again until the target moves, so make sure we
+                //come back to it.
+                m_indices_needing_check.insert(std::make_pair(next <= t ? t - 1 : next, indexId));
             } else {
                 if (versionedIdSet.empty()) {
+                    auto ordered_it = m_ordered_indices.find(indexId.fieldId());
+                    if (ordered_it != m_ordered_indices.end()) {
+                        ordered_it->second->valueRemoved(indexId.indexValue());
+                    }
+
                     m_index_to_versioned_id_sets.erase(indexId);
                 }
             }
+
+            if (outOfTime()) {
+                break;
+            }
         }
+
+        return maxWork - workRemaining;
+    }
+
+    //how many fields and indices are waiting to be garbage collected
+    size_t garbageCollectionBacklog() const {
+        size_t res = 0;
+
+        for (auto it = m_fields_needing_check.begin(); it != m_fields_needing_check.end() && it->first < m_gc_target; ++it) {
+            res++;
+        }
+
+        for (auto it = m_indices_needing_check.begin(); it != m_indices_needing_check.end() && it->first < m_gc_target; ++it) {
+            res++;
+        }
+
+        return res;
     }
 
     VersionedObjectsOfMultiType* versionedObjectsForFieldId(field_id field) {
         auto it = m_field_to_versioned_objects.find(field);
 
         if (it == m_field_to_versioned_objects.end()) {
-            m_field_to_versioned_objects[field].reset(new VersionedObjectsOfMultiType(field));
+            m_field_to_versioned_objects[field].reset(new VersionedObjectsOfMultiType(field, m_value_cache));
             return m_field_to_versioned_objects[field].get();
         }
 
         return it->second.get();
     }
 
+    //the objects for 'field', or nullptr if we've never seen it
+    VersionedObjectsOfMultiType* findVersionedObjectsForFieldId(field_id field) const {
+        auto it = m_field_to_versioned_objects.find(field);
+
+        if (it == m_field_to_versioned_objects.end()) {
+            return nullptr;
+        }
+
+        return it->second.get();
+    }
+
     size_t objectCount() const {
         size_t res = 0;
 
@@ -159,12 +389,62 @@ public:
         return res;
     }
 
+    //move cold payloads of at least 'minBytes' out to 'spill'. See
+    //VersionedObjectsOfMultiType::spillColdPayloads. Returns the bytes we moved.
+    size_t spillColdPayloads(SpillFile& spill, size_t minBytes) {
+        size_t res = 0;
+
+        for (auto& fieldAndObjects: m_field_to_versioned_objects) {
+            res += fieldAndObjects.second->spillColdPayloads(spill, minBytes);
+        }
+
+        return res;
+    }
+
+    DeserializedValueCache& getValueCache() {
+        return m_value_cache;
+    }
+
+    //changes whenever a value returned by 'bestObjectVersion' might have changed or
+    //been freed: a version was added or deleted, or a deserialized value was dropped.
+    uint64_t generation() const {
+        return m_generation + m_value_cache.drops();
+    }
+
 private:
-    std::unordered_map<field_id, std::shared_ptr<VersionedObjectsOfMultiType> > m_field_to_versioned_objects;
+    //if index 'fid' is ordered, make sure it knows about value 'i'
+    void noteIndexValueExists(field_id fid, const index_value& i) {
+        if (!m_ordered_indices.size()) {
+            return;
+        }
+
+        auto ordered_it = m_ordered_indices.find(fid);
+        if (ordered_it == m_ordered_indices.end()) {
+            return;
+        }
+
+        if (m_index_to_versioned_id_sets.find(IndexKey(fid, i)) == m_index_to_versioned_id_sets.end()) {
+            ordered_it->second->valueAdded(i);
+        }
+    }
+
+    //deserialized values for all of our fields. This has to outlive m_field_to_versioned_objects.
+    DeserializedValueCache m_value_cache;
+
+    FlatHashMap<field_id, std::shared_ptr<VersionedObjectsOfMultiType> > m_field_to_versioned_objects;
 
     std::unordered_map<IndexKey, VersionedIdSet> m_index_to_versioned_id_sets;
 
+    //for each index someone has done a range lookup on, its values in order
+    std::unordered_map<field_id, std::shared_ptr<OrderedIndex> > m_ordered_indices;
+
     std::set<std::pair<transaction_id, field_id> > m_fields_needing_check;
 
     std::set<std::pair<transaction_id, IndexKey> > m_indices_needing_check;
+
+    //we may garbage collect anything below this transaction id
+    transaction_id m_gc_target;
+
+    //bumped by every addObjectVersion and markObjectVersionDeleted
+    uint64_t m_generation;
 };
@@ -16,12 +16,20 @@
 
 #pragma once
 
-#include <unordered_map>
-#include <unordered_set>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
 
-#include "DictInstance.hpp"
 #include "Common.hpp"
+#include "DeserializedValueCache.hpp"
+#include "direct_types/FlatHashMap.hpp"
 #include "HashFunctions.hpp"
+#include "PayloadSlab.hpp"
+#include "SmallVector.hpp"
+#include "SpillFile.hpp"
+#include "ViewTrace.hpp"
 
 /*************
 
@@ -29,43 +37,85 @@ VersionedObjectsOfMultiType stores a collection of TypedPython objects that
 represent the same database field, but that can have different representations
 in different codebases.
 
+Each object has a single ObjectVersions record listing its live versions in
+increasing transaction order. Most objects have one or two live versions, so
+these normally sit inline in the record and finding the version visible at a
+given transaction is a binary search over a few adjacent entries. The
+serialized bytes of every version live in one PayloadSlab per field, which
+we compact once more than half of it is garbage. Bytes objects are
+immutable and refcounted, so large values are adopted by the slab rather
+than copied: we just hold on to the Bytes we were given.
+
+Deserialized values are cached in the DeserializedValueCache we're given,
+which is shared with the other fields and may evict them.
+
+If we're given a SpillFile, 'spillColdPayloads' moves large payloads nobody
+has read lately out to it. They're adopted by the slab like any other
+shared payload, so nothing else needs to know where they live, and reading
+one just pages it back in.
+
 *************/
 
 class VersionedObjectsOfMultiType {
     enum { NO_TRANSACTION = -1 };
 
-    class ObjectAndVersion {
+    //don't bother compacting the payload slab until it has this much garbage
+    enum { min_garbage_bytes_to_compact = 64 * 1024 };
+
+    //values at least this big are shared with the Bytes they arrived in rather than
+    //copied. Below this, the bookkeeping costs more than the copy.
+    enum { min_bytes_to_share = 1024 };
+
+    //one version of an object. Deleted versions have no payload.
+    class VersionEntry {
     public:
-        ObjectAndVersion(object_id objId, transaction_id verId) :
-                objectId(objId),
-                version(verId)
-        {
+        transaction_id tid;
+        uint64_t payloadOffset;
+        uint32_t payloadSize;
+        bool deleted;
+
+        //the payload lives in a SpillFile
+        bool spilled;
+
+        //'best' or 'bestPayload' has read it since the last call to 'spillColdPayloads'.
+        //Readers holding only the shared lock set it concurrently, so we only touch it
+        //through the relaxed atomics below. It stays a plain bool so the entry stays
+        //trivially copyable, which SmallVector needs.
+        bool recentlyRead;
+
+        bool wasRecentlyRead() const {
+            return __atomic_load_n(&recentlyRead, __ATOMIC_RELAXED);
         }
 
-        object_id objectId;
-        transaction_id version;
+        void setRecentlyRead(bool value) {
+            __atomic_store_n(&recentlyRead, value, __ATOMIC_RELAXED);
+        }
     };
 
-    class NextAndPrior {
-    public:
-        object_id nextId;
-        object_id priorId;
-    };
+    typedef SmallVector<VersionEntry, 2> ObjectVersions;
 
-    class ObjectData {
+    class VersionLess {
     public:
-        unsigned char object_data[8]; //can be any number, but need something since otherwise this is empty
+        bool operator()(const VersionEntry& entry, transaction_id tid) const {
+            return entry.tid < tid;
+        }
+
+        bool operator()(transaction_id tid, const VersionEntry& entry) const {
+            return tid < entry.tid;
+        }
     };
 
 public:
-    VersionedObjectsOfMultiType(field_id in_field_id) :
+    VersionedObjectsOfMultiType(field_id in_field_id, DeserializedValueCache& valueCache) :
             m_field_id(in_field_id),
-            m_guaranteed_lowest_id(NO_TRANSACTION)
+            m_guaranteed_lowest_id(NO_TRANSACTION),
+            m_value_cache(valueCache),
+            m_cached_values(valueCache.tablesForField(in_field_id))
     {
     }
 
     bool empty() const {
-        return m_serialized_values.size() == 0 && m_deleted_values.size() == 0;
+        return m_objects.size() == 0;
     }
 
     transaction_id getGuaranteedLowestId() const {
@@ -73,44 +123,60 @@ public:
     }
 
     transaction_id getBottomTid(object_id objectId) {
-        auto min_max_it = m_min_max_versions.find(objectId);
-        if (min_max_it == m_min_max_versions.end()) {
+        ObjectVersions* versions = versionsFor(objectId);
+        if (!versions) {
             return NO_TRANSACTION;
         }
-        return min_max_it->second.first;
+        return versions->front().tid;
     }
 
     transaction_id getTopTid(object_id objectId) {
-        auto min_max_it = m_min_max_versions.find(objectId);
-        if (min_max_it == m_min_max_versions.end()) {
+        ObjectVersions* versions = versionsFor(objectId);
+        if (!versions) {
             return NO_TRANSACTION;
         }
-        return min_max_it->second.second;
+        return versions->back().tid;
     }
 
     transaction_id nextTid(object_id objectId, transaction_id tid) {
-        auto it = m_prior_and_next.find(std::make_pair(objectId, tid));
+        ObjectVersions* versions = versionsFor(objectId);
+        if (!versions) {
+            return NO_TRANSACTION;
+        }
 
-        if (it == m_prior_and_next.end()) {
+        VersionEntry* entry = findVersion(*versions, tid);
+        if (!entry || entry + 1 == versions->end()) {
             return NO_TRANSACTION;
         }
 
-        return it->second.second;
+        return entry[1].tid;
     }
 
     transaction_id priorTid(object_id objectId, transaction_id tid) {
-        auto it = m_prior_and_next.find(std::make_pair(objectId, tid));
+        ObjectVersions* versions = versionsFor(objectId);
+        if (!versions) {
+            return NO_TRANSACTION;
+        }
 
-        if (it == m_prior_and_next.end()) {
+        VersionEntry* entry = findVersion(*versions, tid);
+        if (!entry || entry == versions->begin()) {
             return NO_TRANSACTION;
         }
 
-        return it->second.first;
+        return entry[-1].tid;
     }
 
     void moveGuaranteedLowestIdForward(transaction_id t) {
-        if (t <= m_guaranteed_lowest_id) {
-            return;
+        size_t unlimited = std::numeric_limits<size_t>::max();
+        moveGuaranteedLowestIdForward(t, unlimited);
+    }
+
+    // like moveGuaranteedLowestIdForward(t), but check at most 'workRemaining' objects,
+    // counting it down as we go. Returns false if we ran out before we were done, in
+    // which case calling us again picks up where we left off.
+    bool moveGuaranteedLowestIdForward(transaction_id t, size_t& workRemaining) {
+        if (t < m_guaranteed_lowest_id) {
+            return true;
         }
 
         m_guaranteed_lowest_id = t;
@@ -118,84 +184,80 @@ public:
         while (m_version_numbers_to_check.size() && m_version_numbers_to_check.begin()->first < t) {
             // this is the ID we're consuming, which is the lowest id mentioned in the
             // entire object.
-            transaction_id lowestId = m_version_numbers_to_check.begin()->first;
+            std::set<object_id>& toCheck = m_version_numbers_to_check.begin()->second;
 
-            std::set<object_id> toCheck;
-            std::swap(toCheck, m_version_numbers_to_check.begin()->second);
-            m_version_numbers_to_check.erase(lowestId);
+            while (toCheck.size()) {
+                if (!workRemaining) {
+                    return false;
+                }
+
+                object_id objectId = *toCheck.begin();
+                toCheck.erase(toCheck.begin());
+                workRemaining--;
 
-            for (auto objectId: toCheck) {
                 removeLowestIfPossible(objectId);
             }
-        }
-    }
 
-    transaction_id bestTransactionId(object_id objectId, transaction_id version) {
-        if (version < m_guaranteed_lowest_id) {
-            return NO_TRANSACTION;
+            m_version_numbers_to_check.erase(m_version_numbers_to_check.begin());
         }
 
-        auto range_it = m_min_max_versions.find(objectId);
-        if (range_it == m_min_max_versions.end()) {
-            return NO_TRANSACTION;
-        }
+        compactPayloadsIfWorthwhile();
 
-        if (version < range_it->second.first) {
+        return true;
+    }
+
+    //the lowest transaction id at which we have objects to check, or NO_TRANSACTION
+    transaction_id nextTransactionToCheck() const {
+        if (!m_version_numbers_to_check.size()) {
             return NO_TRANSACTION;
         }
 
-        if (version >= range_it->second.second) {
-            return range_it->second.second;
-        }
+        return m_version_numbers_to_check.begin()->first;
+    }
 
-        transaction_id id = range_it->second.second;
-        while (id > version) {
-            id = priorTid(objectId, id);
-        }
+    transaction_id bestTransactionId(object_id objectId, transaction_id version) {
+        const VersionEntry* entry = bestVersion(objectId, version);
 
-        return id;
+        return entry ? entry->tid : (transaction_id)NO_TRANSACTION;
     }
 
     bool existsAtTransaction(Type* valueType, object_id objectId, transaction_id version) {
-        transaction_id bestTid = bestTransactionId(objectId, version);
+        const VersionEntry* entry = bestVersion(objectId, version);
 
-        if (bestTid == NO_TRANSACTION) {
-            return false;
-        }
-
-        if (isDeleted(objectId, bestTid)) {
-            return false;
-        }
-
-        return true;
+        return entry && !entry->deleted;
     }
 
     std::pair<instance_ptr, transaction_id> best(Type* valueType, const std::shared_ptr<SerializationContext>& ctx, object_id objectId, transaction_id version) {
-        transaction_id bestTid = bestTransactionId(objectId, version);
+        VersionEntry* entry = bestVersion(objectId, version);
 
-        if (bestTid == NO_TRANSACTION) {
+        if (!entry || entry->deleted) {
             return std::pair<instance_ptr, transaction_id>(nullptr, NO_TRANSACTION);
         }
 
-        if (isDeleted(objectId, bestTid)) {
-            return std::pair<instance_ptr, transaction_id>(nullptr, NO_TRANSACTION);
-        }
+        entry->setRecentlyRead(true);
 
-        auto& dataForType = dataCacheForType(valueType, ctx);
+        transaction_id bestTid = entry->tid;
 
-        ObjectData* od = dataForType.lookupKey(ObjectAndVersion(objectId, bestTid));
-        if (od) {
-            return std::pair<instance_ptr, transaction_id>(od->object_data, bestTid);
-        }
+        ViewTrace::Scope* trace = ViewTrace::active();
 
-        //the data is not already in the cache, so we have to produce it
-        auto serialized_it = m_serialized_values.find(std::make_pair(objectId, bestTid));
+        instance_ptr cached = m_value_cache.lookup(m_cached_values, valueType, ctx, objectId, bestTid);
+        if (cached) {
+            if (trace) {
+                trace->counters.valueCacheHits++;
+            }
+            return std::pair<instance_ptr, transaction_id>(cached, bestTid);
+        }
 
-        if (serialized_it == m_serialized_values.end()) {
-            throw std::runtime_error("Somehow, we don't have serialized data for this object.");
+        if (trace) {
+            trace->counters.deserializations++;
         }
 
-        Bytes serializedVal(serialized_it->second);
+        //the data is not already in the cache, so we have to produce it. We copy the
+        //bytes out of the slab first, since it can move once we release the lock below.
+        std::string serializedVal;
+        if (entry->payloadSize) {
+            serializedVal.assign((const char*)m_payloads.data(entry->payloadOffset), entry->payloadSize);
+        }
 
         DeserializationBuffer buffer((uint8_t*)&serializedVal[0], serializedVal.size(), *ctx);
 
@@ -207,67 +269,85 @@ public:
             valueType->deserialize(dataPtr, buffer, fieldAndWireType.second);
         });
 
-        //re-grab 'dataCacheForType' because it could have moved.
-        od = dataCacheForType(valueType, ctx).insertKey(ObjectAndVersion(objectId, bestTid));
+        return std::pair<instance_ptr, transaction_id>(
+            m_value_cache.insert(m_cached_values, valueType, ctx, objectId, bestTid, instance, serializedVal.size()),
+            bestTid
+        );
+    }
+
+    /****
+    point 'outData' and 'outSize' at the serialized value of 'objectId' visible at
+    'version', and return true, or return false if there isn't one. Unlike 'best',
+    this doesn't touch the value cache, and the only thing it changes is the entry's
+    'recentlyRead' flag, which is a relaxed atomic, so any number of threads can call
+    it at once as long as nobody is writing to us.
+    ****/
+    bool bestPayload(object_id objectId, transaction_id version, const uint8_t*& outData, size_t& outSize) {
+        VersionEntry* entry = bestVersion(objectId, version);
+
+        if (!entry || entry->deleted) {
+            return false;
+        }
+
+        entry->setRecentlyRead(true);
 
-        valueType->copy_constructor(od->object_data, instance.data());
+        outData = entry->payloadSize ? m_payloads.data(entry->payloadOffset) : nullptr;
+        outSize = entry->payloadSize;
 
-        return std::pair<instance_ptr, transaction_id>(od->object_data, bestTid);
+        return true;
     }
 
     bool isDeleted(object_id objectId, transaction_id tid) {
-        return m_deleted_values.find(std::make_pair(objectId, tid)) != m_deleted_values.end();
+        ObjectVersions* versions = versionsFor(objectId);
+        if (!versions) {
+            return false;
+        }
+
+        VersionEntry* entry = findVersion(*versions, tid);
+
+        return entry && entry->deleted;
     }
 
     //consume any values in the object that are _lower_ than 'version'
     void removeLowestIfPossible(object_id objectId) {
-        transaction_id topTid = getTopTid(objectId);
+        ObjectVersions* versions = versionsFor(objectId);
 
-        if (topTid == NO_TRANSACTION) {
+        if (!versions) {
             return;
         }
 
         //check whether our top transaction has rolled off
-        if (topTid <= m_guaranteed_lowest_id) {
+        if (versions->back().tid <= m_guaranteed_lowest_id) {
             //if the object was deleted, we can remove it
-            if (isDeleted(objectId, topTid)) {
+            if (versions->back().deleted) {
                 removeObject(objectId);
                 return;
             }
         }
 
-        transaction_id bottomTid = getBottomTid(objectId);
-
-        while (bottomTid != topTid && bottomTid < m_guaranteed_lowest_id) {
-            transaction_id nextBottomTid = nextTid(objectId, bottomTid);
-
-            if (nextBottomTid == NO_TRANSACTION) {
-                throw std::runtime_error("Expected next TID to be populated");
-            }
-
-            if (nextBottomTid > m_guaranteed_lowest_id) {
+        //drop the bottom version as long as the one above it is also visible at
+        //m_guaranteed_lowest_id. We always keep the top version.
+        while (versions->size() > 1 && (*versions)[0].tid < m_guaranteed_lowest_id) {
+            if ((*versions)[1].tid > m_guaranteed_lowest_id) {
                 return;
             }
 
-            dropObjectVersion(objectId, bottomTid);
-            bottomTid = nextBottomTid;
+            dropVersionAt(objectId, *versions, 0);
         }
     }
 
     //remove all traces of an object from the transaction stream
     void removeObject(object_id objectId) {
-        transaction_id bottomTid = getBottomTid(objectId);
-        if (bottomTid == NO_TRANSACTION) {
+        auto it = m_objects.find(objectId);
+        if (it == m_objects.end()) {
             return;
         }
 
-        while (bottomTid != NO_TRANSACTION) {
-            transaction_id next = nextTid(objectId, bottomTid);
-            dropObjectVersion(objectId, bottomTid);
-            bottomTid = next;
+        while (it->second.size()) {
+            dropVersionAt(objectId, it->second, it->second.size() - 1);
         }
 
-        m_min_max_versions.erase(objectId);
+        m_objects.erase(it);
     }
 
     // mark an object 'deleted' as of a particular version number. once deleted,
@@ -277,34 +357,41 @@ public:
             return false;
         }
 
-        transaction_id topTid = getTopTid(objectId);
+        ObjectVersions* versions = versionsFor(objectId);
 
-        if (topTid == NO_TRANSACTION) {
+        if (!versions) {
             //can't delete something that doesn't exist
             return false;
         }
 
-        if (topTid > version) {
+        const VersionEntry& top = versions->back();
+
+        if (top.tid > version) {
             // makes no sense to delete before the current version
             return false;
         }
 
-        if (isDeleted(objectId, topTid)) {
+        if (top.deleted) {
             //no reason to re-delete
             return false;
         }
 
-        if (topTid == version) {
+        if (top.tid == version) {
             //can't delete a value that's known to be non-deleted
             return false;
         }
 
-        m_deleted_values.insert(std::make_pair(objectId, version));
+        transaction_id topTid = top.tid;
+
+        VersionEntry entry;
+        entry.tid = version;
+        entry.payloadOffset = 0;
+        entry.payloadSize = 0;
+        entry.deleted = true;
+        entry.spilled = false;
+        entry.recentlyRead = false;
 
-        m_min_max_versions[objectId].second = version;
-        m_prior_and_next[std::make_pair(objectId, topTid)].second = version;
-        m_prior_and_next[std::make_pair(objectId, version)].first = topTid;
-        m_prior_and_next[std::make_pair(objectId, version)].second = NO_TRANSACTION;
+        versions->push_back(entry);
 
         registerObjectAndVersion(objectId, topTid);
 
@@ -317,117 +404,113 @@ public:
 
     The version number and object ids must be nonnegative.
     *****/
-    bool add(object_id objectId, transaction_id version, Bytes data) {
+    bool add(object_id objectId, transaction_id version, const Bytes& data) {
         if (version < m_guaranteed_lowest_id) {
             return false;
         }
 
-        transaction_id tid = getTopTid(objectId);
+        auto it = m_objects.find(objectId);
 
-        m_serialized_values[std::make_pair(objectId, version)] = data;
-
-        if (tid == NO_TRANSACTION) {
+        if (it == m_objects.end()) {
             //this is new
-            m_min_max_versions[objectId] = std::make_pair(version, version);
-            m_prior_and_next[std::make_pair(objectId, version)] = std::make_pair(NO_TRANSACTION, NO_TRANSACTION);
+            m_objects[objectId].push_back(newPayload(version, data));
             return true;
         }
 
-        if (version > tid) {
+        ObjectVersions& versions = it->second;
+
+        if (version > versions.back().tid) {
             //we're inserting on the front
-            m_min_max_versions[objectId].second = version;
-            m_prior_and_next[std::make_pair(objectId, version)].second = NO_TRANSACTION;
-            m_prior_and_next[std::make_pair(objectId, version)].first = tid;
-            m_prior_and_next[std::make_pair(objectId, tid)].second = version;
+            transaction_id priorTop = versions.back().tid;
+
+            versions.push_back(newPayload(version, data));
 
             //make sure we check this version later
-            registerObjectAndVersion(objectId, tid);
+            registerObjectAndVersion(objectId, priorTop);
 
             return true;
         }
 
-        transaction_id prior = priorTid(objectId, tid);
-
-        while (prior != NO_TRANSACTION && prior > version) {
-            tid = prior;
-            prior = priorTid(objectId, tid);
-        }
+        VersionEntry* pos = std::lower_bound(versions.begin(), versions.end(), version, VersionLess());
 
-        if (prior == version || tid == version) {
+        if (pos->tid == version) {
             return false;
         }
 
-        //inserting on the back
-        if (prior == NO_TRANSACTION) {
-            m_min_max_versions[objectId].first = version;
-            m_prior_and_next[std::make_pair(objectId, tid)].first = version;
-            m_prior_and_next[std::make_pair(objectId, version)].second = tid;
-            m_prior_and_next[std::make_pair(objectId, version)].first = NO_TRANSACTION;
+        //inserting on the back or in the middle
+        versions.insert(pos - versions.begin(), newPayload(version, data));
 
-            registerObjectAndVersion(objectId, version);
+        registerObjectAndVersion(objectId, version);
 
-            return true;
+        return true;
+    }
+
+    /****
+    add the first version of an object, whose payload is the 'size' bytes at 'data'.
+    'owner' keeps them alive, so large payloads are used where they are rather than
+    copied. Returns 'false' and does nothing if we already have the object.
+    *****/
+    bool addShared(object_id objectId, transaction_id version, std::shared_ptr<const void> owner, const uint8_t* data, size_t size) {
+        if (version < m_guaranteed_lowest_id || m_objects.find(objectId) != m_objects.end()) {
+            return false;
         }
 
-        if (!(prior < version && version < tid)) {
-            throw std::runtime_error("Expected to be in between two transactions: " +
-                    format(version) + " not in between " + format(prior) + " and " + format(tid));
+        VersionEntry entry;
+        entry.tid = version;
+
+        if (size >= min_bytes_to_share) {
+            entry.payloadOffset = m_payloads.adopt(std::move(owner), data, size);
+        } else {
+            entry.payloadOffset = size ? m_payloads.append(data, size) : 0;
         }
 
-        //inserting in the middle
-        m_prior_and_next[std::make_pair(objectId, tid)].first = version;
-        m_prior_and_next[std::make_pair(objectId, prior)].second = version;
-        m_prior_and_next[std::make_pair(objectId, version)].first = prior;
-        m_prior_and_next[std::make_pair(objectId, version)].second = tid;
+        entry.payloadSize = size;
+        entry.deleted = false;
+        entry.spilled = false;
+        entry.recentlyRead = true;
 
-        registerObjectAndVersion(objectId, version);
+        m_objects[objectId].push_back(entry);
 
         return true;
     }
 
-    void dropObjectVersion(object_id oid, transaction_id tid) {
-        auto range_it = m_min_max_versions.find(oid);
-
-        if (range_it == m_min_max_versions.end()) {
-            return;
-        }
-
-        m_deleted_values.erase(std::make_pair(oid, tid));
-        m_serialized_values.erase(std::make_pair(oid, tid));
-
-        for (auto& typeAndData: m_simple_data) {
-            typeAndData.second.deleteKey(ObjectAndVersion(oid, tid));
+    //call 'visitor' with the id of every object we have any versions of
+    template<class visitor_type>
+    void visitObjectIds(const visitor_type& visitor) const {
+        for (auto& objectAndVersions: m_objects) {
+            visitor(objectAndVersions.first);
         }
+    }
 
-        for (auto& typeAndData: m_nonsimple_data) {
-            for (auto& contextAndData: typeAndData.second) {
-                contextAndData.second.deleteKey(ObjectAndVersion(oid, tid));
+    void removeAllObjects() {
+        for (auto& objectAndVersions: m_objects) {
+            while (objectAndVersions.second.size()) {
+                dropVersionAt(objectAndVersions.first, objectAndVersions.second, objectAndVersions.second.size() - 1);
             }
         }
 
-        std::pair<transaction_id, transaction_id> priorAndNext = m_prior_and_next[std::make_pair(oid, tid)];
-        m_prior_and_next.erase(std::make_pair(oid, tid));
+        m_objects.clear();
+
+        m_version_numbers_to_check.clear();
+    }
+
+    void dropObjectVersion(object_id oid, transaction_id tid) {
+        auto it = m_objects.find(oid);
 
-        if (priorAndNext.first == NO_TRANSACTION && priorAndNext.second == NO_TRANSACTION) {
-            m_min_max_versions.erase(oid);
+        if (it == m_objects.end()) {
             return;
         }
 
-        //update the bounds if we're removing the bottom value
-        if (tid == range_it->second.first) {
-            range_it->second.first = priorAndNext.second;
-        }
+        VersionEntry* entry = findVersion(it->second, tid);
 
-        //update the bounds if we're removing the top value
-        if (tid == range_it->second.second) {
-            range_it->second.second = priorAndNext.first;
+        if (!entry) {
+            return;
         }
 
-        if (priorAndNext.first != NO_TRANSACTION) {
-            m_prior_and_next[std::make_pair(oid, priorAndNext.first)].second = priorAndNext.second;
-        }
-        if (priorAndNext.second != NO_TRANSACTION) {
-            m_prior_and_next[std::make_pair(oid, priorAndNext.second)].first = priorAndNext.first;
+        dropVersionAt(oid, it->second, entry - it->second.begin());
+
+        if (it->second.empty()) {
+            m_objects.erase(it);
         }
     }
 
@@ -436,97 +519,191 @@ public:
     }
 
     size_t objectCount() const {
-        return m_min_max_versions.size();
+        return m_objects.size();
     }
 
-    DictInstance<ObjectAndVersion, ObjectData>& dataCacheForType(Type* t, const std::shared_ptr<SerializationContext>& ctx) {
-        if (t->isSimple()) {
-            auto it = m_simple_data.find(t);
-            if (it != m_simple_data.end()) {
-                return it->second;
-            }
+    //bytes of serialized data we're holding, including garbage we haven't compacted yet
+    size_t payloadBytes() const {
+        return m_payloads.liveBytes() + m_payloads.garbageBytes() + m_payloads.adoptedBytes();
+    }
 
-            m_simple_data[t] = DictInstance<ObjectAndVersion, ObjectData>(
-                Tuple::Make(std::vector<Type*>({Int64::Make(),Int64::Make()})),
-                t
-            );
+    /****
+    move the payloads of at least 'minBytes' that nobody has read since our last
+    call out to 'spill', as one batch, and clear everyone else's 'recentlyRead'. So a
+    value gets spilled once it's gone unread for between one and two calls.
+
+    Returns the number of bytes we spilled.
+    ****/
+    size_t spillColdPayloads(SpillFile& spill, size_t minBytes) {
+        std::vector<VersionEntry*> cold;
+        std::vector<std::pair<const uint8_t*, size_t> > payloads;
+
+        for (auto& objectAndVersions: m_objects) {
+            for (VersionEntry& entry: objectAndVersions.second) {
+                if (entry.spilled || !entry.payloadSize || entry.payloadSize < minBytes) {
+                    continue;
+                }
 
-            return m_simple_data[t];
-        } else {
-            auto& byContext = m_nonsimple_data[t];
+                if (entry.wasRecentlyRead()) {
+                    entry.setRecentlyRead(false);
+                    continue;
+                }
 
-            auto it = byContext.find(ctx);
-            if (it != byContext.end()) {
-                return it->second;
+                cold.push_back(&entry);
+                payloads.push_back(std::make_pair(m_payloads.data(entry.payloadOffset), (size_t)entry.payloadSize));
             }
+        }
+
+        if (cold.empty()) {
+            return 0;
+        }
+
+        SpillFile::Batch batch = spill.write(payloads);
 
-            byContext[ctx] = DictInstance<ObjectAndVersion, ObjectData>(
-                Tuple::Make(std::vector<Type*>({Int64::Make(),Int64::Make()})),
-                t
-            );
+        size_t offset = 0;
 
-            return byContext[ctx];
+        for (VersionEntry* entry: cold) {
+            uint64_t spilledOffset = m_payloads.adopt(batch.owner, batch.data + offset, entry->payloadSize);
+
+            m_payloads.release(entry->payloadOffset, entry->payloadSize);
+
+            entry->payloadOffset = spilledOffset;
+            entry->spilled = true;
+
+            offset += entry->payloadSize;
         }
+
+        compactPayloadsIfWorthwhile();
+
+        return offset;
     }
 
     void check(object_id oid) {
-        auto bottom = getBottomTid(oid);
-        auto top = getTopTid(oid);
+        ObjectVersions* versions = versionsFor(oid);
 
-        if (bottom == NO_TRANSACTION) {
+        if (!versions) {
             return;
         }
 
-        while (bottom != NO_TRANSACTION) {
-            if (m_serialized_values.find(std::make_pair(oid, bottom)) == m_serialized_values.end()) {
-                throw std::runtime_error("missing");
+        for (size_t k = 0; k < versions->size(); k++) {
+            const VersionEntry& entry = (*versions)[k];
+
+            if (k && (*versions)[k - 1].tid >= entry.tid) {
+                throw std::runtime_error("versions are out of order");
             }
 
-            auto next = nextTid(oid, bottom);
+        }
+    }
 
-            if (next == NO_TRANSACTION) {
-                if (bottom != top) {
-                    throw std::runtime_error("next is empty when it shouldn't be");
+private:
+    ObjectVersions* versionsFor(object_id objectId) {
+        auto it = m_objects.find(objectId);
+        if (it == m_objects.end()) {
+            return nullptr;
+        }
+        return &it->second;
+    }
+
+    static VersionEntry* findVersion(ObjectVersions& versions, transaction_id tid) {
+        VersionEntry* pos = std::lower_bound(versions.begin(), versions.end(), tid, VersionLess());
+
+        if (pos == versions.end() || pos->tid != tid) {
+            return nullptr;
+        }
+
+        return pos;
+    }
+
+    //the version of 'objectId' visible at 'version', if any
+    VersionEntry* bestVersion(object_id objectId, transaction_id version) {
+        if (version < m_guaranteed_lowest_id) {
+            return nullptr;
+        }
+
+        ObjectVersions* versions = versionsFor(objectId);
+        if (!versions) {
+            return nullptr;
+        }
+
+        VersionEntry* pos = std::upper_bound(versions->begin(), versions->end(), version, VersionLess());
+
+        if (pos == versions->begin()) {
+            return nullptr;
+        }
+
+        return pos - 1;
+    }
+
+    //put 'data' in the payload slab and return an entry describing it
+    VersionEntry newPayload(transaction_id version, const Bytes& data) {
+        VersionEntry entry;
+        entry.tid = version;
+
+        if (data.size() >= min_bytes_to_share) {
+            std::shared_ptr<Bytes> owner(new Bytes(data));
+            entry.payloadOffset = m_payloads.adopt(owner, (const uint8_t*)&(*owner)[0], owner->size());
+        } else {
+            entry.payloadOffset = data.size() ? m_payloads.append((const uint8_t*)&data[0], data.size()) : 0;
+        }
+
+        entry.payloadSize = data.size();
+        entry.deleted = false;
+        entry.spilled = false;
+        entry.recentlyRead = true;
+
+        return entry;
+    }
+
+    //remove one version of an object, without removing the object's record
+    void dropVersionAt(object_id oid, ObjectVersions& versions, size_t index) {
+        transaction_id tid = versions[index].tid;
+
+        m_payloads.release(versions[index].payloadOffset, versions[index].payloadSize);
+
+        m_value_cache.dropVersion(m_cached_values, oid, tid);
+
+        versions.erase(index);
+    }
+
+    //rewrite the payload slab without its garbage, if more than half of it is garbage
+    void compactPayloadsIfWorthwhile() {
+        size_t garbage = m_payloads.garbageBytes();
+
+        if (garbage < min_garbage_bytes_to_compact || garbage < m_payloads.liveBytes()) {
+            return;
+        }
+
+        PayloadSlab compacted;
+
+        for (auto& objectAndVersions: m_objects) {
+            for (VersionEntry& entry: objectAndVersions.second) {
+                if (entry.payloadSize) {
+                    entry.payloadOffset = compacted.appendFrom(m_payloads, entry.payloadOffset, entry.payloadSize);
                 }
-            } else if (priorTid(oid, next) != bottom) {
-                throw std::runtime_error("prev(next) != next");
             }
-
-            bottom = next;
         }
+
+        m_payloads.swap(compacted);
     }
 
-private:
     //the field we represent
     field_id m_field_id;
 
     //the lowest transaction anyone will ever ask us about
     transaction_id m_guaranteed_lowest_id;
 
-    //the first and last transaction id for each object id
-    std::unordered_map<object_id, std::pair<transaction_id, transaction_id> > m_min_max_versions;
-
-    //the next and prior transaction ids for a given object/transaction id pair
-    std::unordered_map<std::pair<object_id, transaction_id>, std::pair<transaction_id, transaction_id> > m_prior_and_next;
-
-    //the serialized representation of each value
-    std::unordered_map<std::pair<object_id, transaction_id>, Bytes> m_serialized_values;
+    //the live versions of each object, in increasing transaction order. Every
+    //object in here has at least one version.
+    FlatHashMap<object_id, ObjectVersions> m_objects;
 
-    //any deleted values
-    std::unordered_set<std::pair<object_id, transaction_id> > m_deleted_values;
+    //the serialized representation of each value. VersionEntry::payloadOffset is the handle.
+    PayloadSlab m_payloads;
 
-    //a cache of the deserialized versions of each value for simple types (e.g. int)
-    std::unordered_map<Type*, DictInstance<ObjectAndVersion, ObjectData> > m_simple_data;
+    //where we cache deserialized values. This is shared with the other fields.
+    DeserializedValueCache& m_value_cache;
 
-    //a cache of the deserialized values for nonsimple types (e.g. ConstDict(int, object))
-    //where the deserialization result could depend on the SerializationContext.
-    std::unordered_map<
-        Type*,
-        std::map<
-            std::shared_ptr<SerializationContext>,
-            DictInstance<ObjectAndVersion, ObjectData>
-        >
-    > m_nonsimple_data;
+    //our own tables within m_value_cache
+    DeserializedValueCache::FieldTables& m_cached_values;
 
     //for each transaction, a list of objects we want to check when that version number
     //gets consumed by the m_guaranteed_lowest_id, in case we want to delete things.
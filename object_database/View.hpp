@@ -18,6 +18,9 @@
 
 #include "DatabaseConnectionState.hpp"
 #include "HashFunctions.hpp"
+#include "IndexQuery.hpp"
+#include "ArenaHashTable.hpp"
+#include "ViewTrace.hpp"
 #include <unordered_set>
 #include <unordered_map>
 
@@ -28,19 +31,59 @@ that have different representation at different transaction_ids, along with a si
 transaction_id. We show a coherent view of all the objects whose versions are <= the
 given transaction_id.
 
-We also track all objects and indices we read or write during execution.
+We also track all objects and indices we read or write during execution. That
+bookkeeping lives in open-addressing tables allocated out of a per-view Arena,
+so a transaction that touches many fields does a handful of large allocations
+instead of one per entry, and tears them all down at once.
+
+Reads that reach the VersionedObjects also land in a small direct-mapped
+cache keyed on (field, oid). A repeated read of the same field is then one
+array probe, and we only record it in 'm_read_values' the first time. Each
+entry remembers the VersionedObjects generation it was filled at, so it stops
+matching as soon as a version is added or a deserialized value is dropped.
+
+Transactions that read many objects can record their reads more compactly (see
+ReadTracking): as the oids read of each field, which we send as ranges, or as
+just the fields read, which the server treats as a lock on the whole field.
+
+If ViewTrace is on when we're entered, we count what we do in a ViewTrace::Scope
+that outlives our exit, so python can look at it afterwards.
 ***********/
 
 class View {
 public:
+   // how we record what we read, for the server to check for conflicts when we commit
+   enum ReadTracking {
+      // every (field, oid) pair, in 'm_read_values'. The default.
+      track_keys,
+      // the oids we read of each field, which we send as ranges of oids
+      track_key_ranges,
+      // only the fields we read. Any write to them since our snapshot is a conflict.
+      track_fields
+   };
+
    View(std::shared_ptr<DatabaseConnectionState> connection, transaction_id tid, bool allowWrites) :
       m_tid(tid),
       m_allow_writes(allowWrites),
+      m_read_tracking(track_keys),
       m_enclosing_view(nullptr),
+      m_enclosing_trace(nullptr),
       m_is_entered(false),
       m_ever_entered(false),
+      m_read_values(m_arena),
+      m_read_oids(m_arena),
+      m_read_fields(m_arena),
+      m_write_cache(m_arena),
+      m_new_writes(m_arena),
+      m_delete_cache(m_arena),
+      m_set_adds(m_arena),
+      m_set_removes(m_arena),
+      m_set_reads(m_arena),
+      m_index_range_reads(m_arena),
       m_versioned_objects(*connection->getVersionedObjects()),
-      m_connection_state(connection)
+      m_connection_state(connection),
+      m_visible_type_generation(-1),
+      m_read_cache()
    {
       m_connection_state->increfVersion(m_tid);
       m_serialization_context = m_connection_state->getContext();
@@ -54,6 +97,9 @@ public:
 
    void setSerializationContext(std::shared_ptr<SerializationContext> context) {
       m_serialization_context = context;
+
+      //cached values were deserialized with the old context
+      clearReadCache();
    }
 
    std::shared_ptr<SerializationContext> getSerializationContext() {
@@ -68,6 +114,10 @@ public:
       m_is_entered = true;
       m_enclosing_view = s_current_view;
       s_current_view = this;
+
+      m_trace.reset(ViewTrace::scopeForNewView());
+      m_enclosing_trace = ViewTrace::active();
+      ViewTrace::active() = m_trace.get();
    }
 
    static View* currentView() {
@@ -83,9 +133,35 @@ public:
       s_current_view = m_enclosing_view;
       m_enclosing_view = nullptr;
       m_connection_state->decrefVersion(m_tid);
+
+      // after decrefVersion, so we're charged for any garbage collection it does
+      if (m_trace) {
+         ViewTrace::viewExited(*m_trace, m_allow_writes ? "transaction" : "view", m_tid);
+      }
+
+      ViewTrace::active() = m_enclosing_trace;
+      m_enclosing_trace = nullptr;
+   }
+
+   // what we counted while we were entered, or nullptr if ViewTrace was off
+   ViewTrace::Scope* getTrace() const {
+      return m_trace.get();
    }
 
    bool objectIsVisible(SchemaAndTypeName objType, object_id oid) {
+      // most reads are of types we're subscribed to in full, and once that covers
+      // our snapshot there's nothing to look up about the object itself.
+      if (objType == m_visible_type
+            && m_visible_type_generation == m_connection_state->typeSubscriptionGeneration()) {
+         return true;
+      }
+
+      if (m_connection_state->typeIsVisible(objType, m_tid)) {
+         m_visible_type = objType;
+         m_visible_type_generation = m_connection_state->typeSubscriptionGeneration();
+         return true;
+      }
+
       return m_connection_state->objectIsVisible(objType, oid, m_tid);
    }
 
@@ -93,6 +169,10 @@ public:
       m_connection_state->loadLazyObjectIfNeeded(oid);
    }
 
+   void prefetchLazyObjects(const TupleOf<object_id>& oids) {
+      m_connection_state->prefetchLazyObjects(oids);
+   }
+
    void newObject(SchemaAndTypeName obType, object_id oid) {
       m_connection_state->markObjectSubscribed(obType, oid, m_tid);
    }
@@ -101,6 +181,21 @@ public:
    // otherwise use the value in the view. If the value does not exist, returns a null pointer.
    // we also record what values were read
    instance_ptr getField(field_id field, object_id oid, Type* t, bool recordAccess=true) {
+      if (m_trace) {
+         m_trace->counters.fieldReads++;
+      }
+
+      ReadCacheEntry* cached = readCacheHit(field, oid, t);
+      if (cached) {
+         if (m_trace) {
+            m_trace->counters.readCacheHits++;
+         }
+         if (recordAccess) {
+            recordCachedRead(*cached);
+         }
+         return cached->data;
+      }
+
       auto delete_it = m_delete_cache.find(std::make_pair(field, oid));
       if (delete_it != m_delete_cache.end()) {
          return nullptr;
@@ -111,16 +206,37 @@ public:
          return write_it->second.data();
       }
 
+      // deserializing can release the lock, so take the generation before we look.
+      // if anything changes in the meantime, the entry just won't match.
+      uint64_t generation = m_versioned_objects.generation();
+
       instance_ptr i = m_versioned_objects.bestObjectVersion(t, m_serialization_context, field, oid, m_tid).first;
 
       if (recordAccess) {
-         m_read_values.insert(std::make_pair(field, oid));
+         recordRead(field, oid);
       }
 
+      ReadCacheEntry& entry = readCacheSlot(field, oid);
+      entry.valid = true;
+      entry.field = field;
+      entry.oid = oid;
+      entry.type = t;
+      entry.data = i;
+      entry.generation = generation;
+      entry.recorded = recordAccess;
+
       return i;
    }
 
    bool fieldExists(field_id field, object_id oid, Type* t, bool recordAccess=true) {
+      ReadCacheEntry* cached = readCacheHit(field, oid, t);
+      if (cached) {
+         if (recordAccess) {
+            recordCachedRead(*cached);
+         }
+         return cached->data != nullptr;
+      }
+
       auto delete_it = m_delete_cache.find(std::make_pair(field, oid));
       if (delete_it != m_delete_cache.end()) {
          return false;
@@ -134,7 +250,7 @@ public:
       bool res = m_versioned_objects.existsAtTransaction(t, field, oid, m_tid);
 
       if (recordAccess) {
-         m_read_values.insert(std::make_pair(field, oid));
+         recordRead(field, oid);
       }
 
       return res;
@@ -145,12 +261,19 @@ public:
          throw std::runtime_error("Please use a transaction if you wish to write to object_database fields.");
       }
 
+      if (m_trace) {
+         m_trace->counters.fieldWrites++;
+      }
+
       auto delete_it = m_delete_cache.find(std::make_pair(field, oid));
 
       if (delete_it != m_delete_cache.end()) {
          throw std::runtime_error("Value is deleted.");
       }
 
+      //from here on, reads of this field come from the write or delete caches
+      readCacheSlot(field, oid).valid = false;
+
       if (data) {
          //if we're writing a new value, record whether this is a new object
          //that we're populating into 'm_new_writes'
@@ -172,6 +295,30 @@ public:
       }
    }
 
+   // write 'field' for the 'count' objects starting at 'firstOid', which we just
+   // allocated, so none of them can exist or have been deleted yet. 'values(k)' is
+   // the value for 'firstOid + k'.
+   template<class values_type>
+   void setNewObjectsField(field_id field, object_id firstOid, int64_t count, Type* t, const values_type& values) {
+      if (!m_allow_writes) {
+         throw std::runtime_error("Please use a transaction if you wish to write to object_database fields.");
+      }
+
+      if (m_trace) {
+         m_trace->counters.fieldWrites += count;
+      }
+
+      for (int64_t k = 0; k < count; k++) {
+         std::pair<field_id, object_id> key(field, firstOid + k);
+
+         //we might have read the object before it existed
+         readCacheSlot(field, firstOid + k).valid = false;
+
+         m_new_writes.insert(key);
+         m_write_cache[key] = Instance(values(k), t);
+      }
+   }
+
    void indexAdd(field_id fid, index_value i, object_id o) {
       IndexKey key(fid, i);
 
@@ -307,6 +454,215 @@ public:
       }
    }
 
+   /******
+   call 'visitor' with each object in the index as seen by this view, in order,
+   until it returns false. This resolves the index once, rather than once per
+   object like indexLookupFirst/indexLookupNext.
+   ******/
+   template<class visitor_type>
+   void indexLookupAll(field_id fid, index_value i, const visitor_type& visitor) {
+      IndexKey key(fid, i);
+
+      m_set_reads.insert(key);
+
+      auto add_it = m_set_adds.find(key);
+      auto remove_it = m_set_removes.find(key);
+
+      const std::set<object_id>* adds = add_it != m_set_adds.end() ? &add_it->second : nullptr;
+      const std::set<object_id>* removes = remove_it != m_set_removes.end() && remove_it->second.size() ?
+         &remove_it->second : nullptr;
+
+      std::set<object_id>::const_iterator next_added;
+      if (adds) {
+         next_added = adds->begin();
+      }
+
+      bool stopped = false;
+
+      //we need to suppress anything in 'm_set_removes' and add anything in 'm_set_adds'
+      m_versioned_objects.indexLookupAll(fid, i, m_tid, [&](object_id o) {
+         while (adds && next_added != adds->end() && *next_added < o) {
+            if (!visitor(*next_added)) {
+               stopped = true;
+               return false;
+            }
+            ++next_added;
+         }
+
+         if (removes && removes->find(o) != removes->end()) {
+            return true;
+         }
+
+         if (!visitor(o)) {
+            stopped = true;
+            return false;
+         }
+
+         return true;
+      });
+
+      while (!stopped && adds && next_added != adds->end()) {
+         if (!visitor(*next_added)) {
+            return;
+         }
+         ++next_added;
+      }
+   }
+
+   /******
+   a cursor over the objects in the index as seen by this view.
+   ******/
+   IndexCursor indexCursor(field_id fid, index_value i) {
+      IndexKey key(fid, i);
+
+      m_set_reads.insert(key);
+
+      auto add_it = m_set_adds.find(key);
+      auto remove_it = m_set_removes.find(key);
+
+      return IndexCursor(
+         m_tid,
+         m_versioned_objects.indexIdSet(fid, i),
+         add_it != m_set_adds.end() ? &add_it->second : nullptr,
+         remove_it != m_set_removes.end() ? &remove_it->second : nullptr
+      );
+   }
+
+   /******
+   an upper bound on how many objects 'indexLookup(terms)' can find, or -1 if we
+   can't cheaply say (every term is a range). A match has to match every exact
+   term, and an exact term can't match more ids than its committed set has entries
+   plus the ids this view added to it.
+   ******/
+   int64_t indexLookupBound(const std::vector<IndexLookupTerm>& terms) {
+      int64_t bound = -1;
+
+      for (auto& term: terms) {
+         if (term.isRange) {
+            continue;
+         }
+
+         IndexKey key(term.fieldId, term.value);
+
+         const VersionedIdSet* committed = m_versioned_objects.indexIdSet(term.fieldId, term.value);
+         auto add_it = m_set_adds.find(key);
+
+         int64_t termBound = (committed ? committed->totalEntryCount() : 0) +
+            (add_it != m_set_adds.end() ? add_it->second.size() : 0);
+
+         if (bound == -1 || termBound < bound) {
+            bound = termBound;
+         }
+      }
+
+      return bound;
+   }
+
+   /******
+   find every object whose value in the (ordered) index 'term.fieldId' is in 'term.range',
+   in increasing order. We record a read of each index value we visit, and a read
+   of the index as a whole, so that a concurrent write that moves an object into
+   the range under a value we never visited still conflicts with us.
+   ******/
+   std::vector<object_id> indexLookupRange(const IndexLookupTerm& term) {
+      m_index_range_reads.insert(term.fieldId);
+
+      std::set<index_value> values;
+
+      m_versioned_objects.orderedIndex(term.fieldId, term.indexType).visitRange(
+         *m_serialization_context,
+         term.range,
+         [&](const index_value& value) {
+            values.insert(value);
+            return true;
+         }
+      );
+
+      //values we've added to the index in this view may not be known to the ordered index yet.
+      for (auto& keyAndAdds: m_set_adds) {
+         if (keyAndAdds.first.fieldId() == term.fieldId && keyAndAdds.second.size() &&
+               values.find(keyAndAdds.first.indexValue()) == values.end()) {
+            Instance decoded = OrderedIndex::decode(term.indexType, *m_serialization_context, keyAndAdds.first.indexValue());
+
+            if (term.range.contains(term.indexType, decoded.data())) {
+               values.insert(keyAndAdds.first.indexValue());
+            }
+         }
+      }
+
+      std::vector<object_id> result;
+
+      for (auto& value: values) {
+         indexLookupAll(term.fieldId, value, [&](object_id o) {
+            result.push_back(o);
+            return true;
+         });
+      }
+
+      std::sort(result.begin(), result.end());
+
+      return result;
+   }
+
+   /******
+   call 'visitor' with each object matching all of 'terms', in order, until it returns false.
+
+   With several terms we leapfrog across one cursor per term: each cursor seeks to
+   the current candidate, and any cursor that lands past it proposes a new
+   candidate. So the work is bounded by the most selective term, and we never
+   build the full set of matches for any individual term unless it's a range.
+   ******/
+   template<class visitor_type>
+   void indexLookup(const std::vector<IndexLookupTerm>& terms, const visitor_type& visitor) {
+      if (m_trace) {
+         m_trace->counters.indexLookups++;
+      }
+
+      if (terms.size() == 1 && !terms[0].isRange) {
+         indexLookupAll(terms[0].fieldId, terms[0].value, visitor);
+         return;
+      }
+
+      std::vector<IndexCursor> cursors;
+
+      for (auto& term: terms) {
+         if (term.isRange) {
+            cursors.push_back(IndexCursor(indexLookupRange(term)));
+         } else {
+            cursors.push_back(indexCursor(term.fieldId, term.value));
+         }
+      }
+
+      object_id candidate = 0;
+      size_t agreeing = 0;
+      size_t which = 0;
+
+      while (true) {
+         object_id found = cursors[which].seek(candidate);
+
+         if (found == NO_OBJECT) {
+            return;
+         }
+
+         if (found == candidate) {
+            agreeing++;
+         } else {
+            candidate = found;
+            agreeing = 1;
+         }
+
+         if (agreeing == cursors.size()) {
+            if (!visitor(candidate)) {
+               return;
+            }
+            candidate++;
+            agreeing = 0;
+         }
+
+         which = (which + 1) % cursors.size();
+      }
+   }
+
    DatabaseConnectionState& getConnectionState() {
       return *m_connection_state;
    }
@@ -315,36 +671,151 @@ public:
       return m_allow_writes;
    }
 
-   const std::unordered_set<std::pair<field_id, object_id> >& getReadValues() const {
+   void setReadTracking(ReadTracking tracking) {
+      if (m_read_values.size() || m_read_oids.size() || m_read_fields.size()) {
+         throw std::runtime_error("Can't change how a view tracks reads after it has read something.");
+      }
+
+      m_read_tracking = tracking;
+
+      //entries recorded under the old mode would never get recorded under the new one
+      clearReadCache();
+   }
+
+   ReadTracking getReadTracking() const {
+      return m_read_tracking;
+   }
+
+   const ArenaHashSet<std::pair<field_id, object_id> >& getReadValues() const {
       return m_read_values;
    }
 
-   const std::unordered_map<std::pair<field_id, object_id>, Instance>& getWriteCache() const {
+   const ArenaHashSet<field_id>& getReadFields() const {
+      return m_read_fields;
+   }
+
+   /******
+   call 'visitor' with each field we read under 'track_key_ranges' and the oids we
+   read of it, as a sorted, flattened list of half-open [start, stop) ranges.
+   ******/
+   template<class visitor_type>
+   void visitReadKeyRanges(const visitor_type& visitor) {
+      std::vector<object_id> ranges;
+
+      for (auto& fieldAndOids: m_read_oids) {
+         std::vector<object_id>& oids = fieldAndOids.second;
+
+         std::sort(oids.begin(), oids.end());
+         oids.erase(std::unique(oids.begin(), oids.end()), oids.end());
+
+         ranges.clear();
+
+         for (object_id oid: oids) {
+            if (ranges.size() && ranges.back() == oid) {
+               ranges.back() = oid + 1;
+            } else {
+               ranges.push_back(oid);
+               ranges.push_back(oid + 1);
+            }
+         }
+
+         visitor(fieldAndOids.first, ranges);
+      }
+   }
+
+   const ArenaHashMap<std::pair<field_id, object_id>, Instance>& getWriteCache() const {
       return m_write_cache;
    }
 
-   const std::unordered_set<std::pair<field_id, object_id> >& getDeleteCache() const {
+   const ArenaHashSet<std::pair<field_id, object_id> >& getDeleteCache() const {
       return m_delete_cache;
    }
 
-   const std::unordered_map<IndexKey, std::set<object_id> >& getSetAdds() const {
+   const ArenaHashMap<IndexKey, std::set<object_id> >& getSetAdds() const {
       return m_set_adds;
    }
 
-   const std::unordered_map<IndexKey, std::set<object_id> >& getSetRemoves() const {
+   const ArenaHashMap<IndexKey, std::set<object_id> >& getSetRemoves() const {
       return m_set_removes;
    }
 
-   const std::unordered_set<IndexKey >& getSetReads() const {
+   const ArenaHashSet<IndexKey>& getSetReads() const {
       return m_set_reads;
    }
 
+   const ArenaHashSet<field_id>& getIndexRangeReads() const {
+      return m_index_range_reads;
+   }
+
+   //bytes of bookkeeping this view has allocated
+   size_t arenaBytesAllocated() const {
+      return m_arena.bytesAllocated();
+   }
+
    transaction_id getTransactionId() const {
       return m_tid;
    }
 
 
 private:
+   enum { read_cache_size = 64 };
+
+   class ReadCacheEntry {
+   public:
+      bool valid;
+      bool recorded;
+      field_id field;
+      object_id oid;
+      Type* type;
+      instance_ptr data;
+      uint64_t generation;
+   };
+
+   ReadCacheEntry& readCacheSlot(field_id field, object_id oid) {
+      uint64_t h = (uint64_t)oid * 0x9E3779B97F4A7C15ULL + (uint64_t)field;
+      return m_read_cache[(h >> 32) % read_cache_size];
+   }
+
+   // the cached read of (field, oid) as type 't', or nullptr if it's missing or stale
+   ReadCacheEntry* readCacheHit(field_id field, object_id oid, Type* t) {
+      ReadCacheEntry& entry = readCacheSlot(field, oid);
+
+      if (!entry.valid || entry.field != field || entry.oid != oid || entry.type != t ||
+            entry.generation != m_versioned_objects.generation()) {
+         return nullptr;
+      }
+
+      return &entry;
+   }
+
+   void recordCachedRead(ReadCacheEntry& entry) {
+      if (!entry.recorded) {
+         recordRead(entry.field, entry.oid);
+         entry.recorded = true;
+      }
+   }
+
+   void recordRead(field_id field, object_id oid) {
+      if (m_read_tracking == track_keys) {
+         m_read_values.insert(std::make_pair(field, oid));
+      } else if (m_read_tracking == track_key_ranges) {
+         std::vector<object_id>& oids = m_read_oids[field];
+
+         //scans tend to read the same object several times in a row
+         if (oids.empty() || oids.back() != oid) {
+            oids.push_back(oid);
+         }
+      } else {
+         m_read_fields.insert(field);
+      }
+   }
+
+   void clearReadCache() {
+      for (auto& entry: m_read_cache) {
+         entry.valid = false;
+      }
+   }
+
    static thread_local View* s_current_view;
 
    //the transaction id that snapshots this view
@@ -353,29 +824,58 @@ private:
    //is this a view or a transaction?
    bool m_allow_writes;
 
+   ReadTracking m_read_tracking;
+
    View* m_enclosing_view;
 
+   // if ViewTrace was on when we were entered, our counters
+   std::unique_ptr<ViewTrace::Scope> m_trace;
+
+   // the scope that was active on this thread before we were entered
+   ViewTrace::Scope* m_enclosing_trace;
+
    bool m_is_entered;
 
    bool m_ever_entered;
 
-   std::unordered_set<std::pair<field_id, object_id> > m_read_values;
+   //holds the storage for all the tables below, so it has to be declared first
+   Arena m_arena;
+
+   ArenaHashSet<std::pair<field_id, object_id> > m_read_values;
+
+   //under 'track_key_ranges', the oids we read of each field, unsorted
+   ArenaHashMap<field_id, std::vector<object_id> > m_read_oids;
 
-   std::unordered_map<std::pair<field_id, object_id>, Instance> m_write_cache;
+   //under 'track_fields', the fields we read
+   ArenaHashSet<field_id> m_read_fields;
 
-   std::unordered_set<std::pair<field_id, object_id> > m_new_writes;
+   ArenaHashMap<std::pair<field_id, object_id>, Instance> m_write_cache;
 
-   std::unordered_set<std::pair<field_id, object_id> > m_delete_cache;
+   ArenaHashSet<std::pair<field_id, object_id> > m_new_writes;
 
-   std::unordered_map<IndexKey, std::set<object_id> > m_set_adds;
+   ArenaHashSet<std::pair<field_id, object_id> > m_delete_cache;
 
-   std::unordered_map<IndexKey, std::set<object_id> > m_set_removes;
+   ArenaHashMap<IndexKey, std::set<object_id> > m_set_adds;
 
-   std::unordered_set<IndexKey > m_set_reads;
+   ArenaHashMap<IndexKey, std::set<object_id> > m_set_removes;
+
+   ArenaHashSet<IndexKey> m_set_reads;
+
+   //the indices we looked up a range of values of. Any change to one of them is a conflict.
+   ArenaHashSet<field_id> m_index_range_reads;
 
    VersionedObjects& m_versioned_objects;
 
    std::shared_ptr<DatabaseConnectionState> m_connection_state;
 
    std::shared_ptr<SerializationContext> m_serialization_context;
+
+   //the last type we found fully visible at m_tid, and the connection's
+   //typeSubscriptionGeneration when we did. See objectIsVisible.
+   SchemaAndTypeName m_visible_type;
+
+   size_t m_visible_type_generation;
+
+   //resolved reads from m_versioned_objects. See readCacheSlot.
+   ReadCacheEntry m_read_cache[read_cache_size];
 };
@@ -0,0 +1,384 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <time.h>
+#include <unistd.h>
+
+/*************
+
+ViewTrace counts what a View spends its time on: field reads and writes,
+how many reads its own read cache answered, how many went on to find a
+value VersionedObjects had already deserialized and how many had to
+deserialize one, index lookups and the steps they took walking
+VersionedIdSets, lazy loads, and garbage collection.
+
+It's off until somebody calls 'configure'. A View entered while it's on
+gets a Scope, and points this thread at it until the View exits. The hot
+paths bump the counters of whatever Scope this thread points at, so with
+tracing off all they pay is a null check on a thread local.
+
+One View in every 'sampleEvery' also records timed spans for itself and for
+the lazy loads and garbage collection it causes, into a bounded buffer
+shared by the whole process. 'chromeTraceJson' writes that buffer in the
+Chrome trace event format, which chrome://tracing, Perfetto and speedscope
+can all load.
+
+*************/
+
+class ViewTrace {
+public:
+    class Counters {
+    public:
+        Counters() :
+            attributeReads(0),
+            fieldReads(0),
+            readCacheHits(0),
+            valueCacheHits(0),
+            deserializations(0),
+            fieldWrites(0),
+            indexLookups(0),
+            indexLookupSteps(0),
+            lazyLoads(0),
+            lazyLoadNanos(0),
+            gcPasses(0),
+            gcNanos(0)
+        {
+        }
+
+        // fields python read off an object, each of which is one or two fieldReads
+        int64_t attributeReads;
+
+        // calls to View::getField
+        int64_t fieldReads;
+
+        // of those, the ones the View's read cache answered
+        int64_t readCacheHits;
+
+        // reads that reached VersionedObjectsOfMultiType::best and found the value
+        // already deserialized, and the ones that had to deserialize it
+        int64_t valueCacheHits;
+        int64_t deserializations;
+
+        int64_t fieldWrites;
+
+        // index lookups, and the entries and blocks of VersionedIdSet they walked
+        int64_t indexLookups;
+        int64_t indexLookupSteps;
+
+        int64_t lazyLoads;
+        int64_t lazyLoadNanos;
+
+        // passes of DatabaseConnectionState::checkMinId, and the time they took
+        int64_t gcPasses;
+        int64_t gcNanos;
+    };
+
+    // the counters of one entered View
+    class Scope {
+    public:
+        Scope(bool inSampled) :
+            sampled(inSampled),
+            enteredAt(nanos()),
+            exitedAt(0)
+        {
+        }
+
+        Counters counters;
+
+        // whether we record spans for this view
+        bool sampled;
+
+        // in 'nanos'. 'exitedAt' is zero until the view exits.
+        int64_t enteredAt;
+        int64_t exitedAt;
+    };
+
+    // what 'finishSpan' is timing
+    enum SpanKind {
+        span_lazy_load,
+        span_garbage_collection
+    };
+
+    static bool enabled() {
+        return enabledFlag().load(std::memory_order_relaxed);
+    }
+
+    /*****
+    turn tracing on or off. While it's on, one View in 'sampleEvery' records spans,
+    and we keep at most 'maxEvents' of them, dropping any more until 'clear'.
+    Views that are already entered keep doing whatever they were doing.
+    *****/
+    static void configure(bool enable, int64_t sampleEvery, size_t maxEvents) {
+        if (sampleEvery < 1) {
+            throw std::runtime_error("sampleEvery must be at least 1.");
+        }
+
+        State& s = state();
+
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        s.sampleEvery = sampleEvery;
+        s.maxEvents = maxEvents;
+
+        enabledFlag().store(enable);
+    }
+
+    // the Scope counting for this thread, or nullptr if nothing is
+    static Scope*& active() {
+        static thread_local Scope* scope = nullptr;
+        return scope;
+    }
+
+    // a new Scope for a View being entered, or nullptr if we're off
+    static Scope* scopeForNewView() {
+        if (!enabled()) {
+            return nullptr;
+        }
+
+        return new Scope(shouldSample());
+    }
+
+    // 'scope's View is exiting. Requires that it's still the active scope.
+    static void viewExited(Scope& scope, const char* name, int64_t transactionId) {
+        scope.exitedAt = nanos();
+
+        if (scope.sampled) {
+            record(name, scope.enteredAt, scope.exitedAt - scope.enteredAt, transactionId, &scope.counters);
+        }
+    }
+
+    // the start of a span we might want to time, or 0 if we're off
+    static int64_t startSpan() {
+        return enabled() ? nanos() : 0;
+    }
+
+    // count a span that began at 'startedAt' (from 'startSpan') against the active scope,
+    // and record it if the scope's sampled. Outside any view we sample on our own.
+    static void finishSpan(SpanKind kind, int64_t startedAt) {
+        if (!startedAt) {
+            return;
+        }
+
+        int64_t duration = nanos() - startedAt;
+        const char* name = kind == span_lazy_load ? "lazyLoad" : "collectGarbage";
+
+        Scope* scope = active();
+
+        if (scope) {
+            if (kind == span_lazy_load) {
+                scope->counters.lazyLoads++;
+                scope->counters.lazyLoadNanos += duration;
+            } else {
+                scope->counters.gcPasses++;
+                scope->counters.gcNanos += duration;
+            }
+
+            if (scope->sampled) {
+                record(name, startedAt, duration, -1, nullptr);
+            }
+        } else if (enabled() && shouldSample()) {
+            record(name, startedAt, duration, -1, nullptr);
+        }
+    }
+
+    // the spans we've recorded, as a Chrome trace JSON document. If 'andClear', we
+    // forget them, so a span lands in exactly one of a series of these.
+    static std::string chromeTraceJson(bool andClear=false) {
+        State& s = state();
+
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        std::string res = "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+
+        char buffer[1024];
+        int pid = getpid();
+
+        for (size_t k = 0; k < s.events.size(); k++) {
+            const Event& e = s.events[k];
+
+            snprintf(
+                buffer,
+                sizeof(buffer),
+                "%s\n{\"name\": \"%s\", \"cat\": \"object_database\", \"ph\": \"X\", "
+                "\"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %lld",
+                k ? "," : "",
+                e.name,
+                e.start / 1000.0,
+                e.duration / 1000.0,
+                pid,
+                (long long)e.thread
+            );
+            res += buffer;
+
+            if (e.hasCounters) {
+                const Counters& c = e.counters;
+
+                snprintf(
+                    buffer,
+                    sizeof(buffer),
+                    ", \"args\": {\"transactionId\": %lld, \"attributeReads\": %lld, \"fieldReads\": %lld, \"readCacheHits\": %lld, "
+                    "\"valueCacheHits\": %lld, \"deserializations\": %lld, \"fieldWrites\": %lld, "
+                    "\"indexLookups\": %lld, \"indexLookupSteps\": %lld, \"lazyLoads\": %lld, "
+                    "\"lazyLoadNanos\": %lld, \"gcPasses\": %lld, \"gcNanos\": %lld}",
+                    (long long)e.transactionId,
+                    (long long)c.attributeReads,
+                    (long long)c.fieldReads,
+                    (long long)c.readCacheHits,
+                    (long long)c.valueCacheHits,
+                    (long long)c.deserializations,
+                    (long long)c.fieldWrites,
+                    (long long)c.indexLookups,
+                    (long long)c.indexLookupSteps,
+                    (long long)c.lazyLoads,
+                    (long long)c.lazyLoadNanos,
+                    (long long)c.gcPasses,
+                    (long long)c.gcNanos
+                );
+                res += buffer;
+            }
+
+            res += "}";
+        }
+
+        snprintf(buffer, sizeof(buffer), "\n], \"otherData\": {\"droppedEvents\": %lld}}\n", (long long)s.droppedEvents);
+        res += buffer;
+
+        if (andClear) {
+            s.events.clear();
+            s.droppedEvents = 0;
+        }
+
+        return res;
+    }
+
+    // forget the spans we've recorded
+    static void clear() {
+        State& s = state();
+
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        s.events.clear();
+        s.droppedEvents = 0;
+    }
+
+    // spans we've recorded and haven't cleared
+    static size_t eventCount() {
+        State& s = state();
+
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        return s.events.size();
+    }
+
+    // a clock for measuring intervals, which never goes backwards
+    static int64_t nanos() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+private:
+    class Event {
+    public:
+        const char* name;
+        int64_t start;
+        int64_t duration;
+        int64_t thread;
+        int64_t transactionId;
+        bool hasCounters;
+        Counters counters;
+    };
+
+    class State {
+    public:
+        State() : sampleEvery(1), sampleCounter(0), maxEvents(0), droppedEvents(0)
+        {
+        }
+
+        std::mutex mutex;
+
+        std::atomic<int64_t> sampleEvery;
+
+        std::atomic<int64_t> sampleCounter;
+
+        size_t maxEvents;
+
+        std::vector<Event> events;
+
+        // events we didn't keep because we already had 'maxEvents'
+        int64_t droppedEvents;
+    };
+
+    static std::atomic<bool>& enabledFlag() {
+        static std::atomic<bool> flag(false);
+        return flag;
+    }
+
+    static State& state() {
+        static State s;
+        return s;
+    }
+
+    static bool shouldSample() {
+        State& s = state();
+
+        return s.sampleCounter++ % s.sampleEvery == 0;
+    }
+
+    // a small number naming this thread, so traces are readable
+    static int64_t threadNumber() {
+        static std::atomic<int64_t> threadCount(0);
+        static thread_local int64_t number = ++threadCount;
+        return number;
+    }
+
+    static void record(const char* name, int64_t start, int64_t duration, int64_t transactionId, const Counters* counters) {
+        int64_t thread = threadNumber();
+
+        State& s = state();
+
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        if (s.events.size() >= s.maxEvents) {
+            s.droppedEvents++;
+            return;
+        }
+
+        s.events.push_back(Event());
+
+        Event& e = s.events.back();
+        e.name = name;
+        e.start = start;
+        e.duration = duration;
+        e.thread = thread;
+        e.transactionId = transactionId;
+        e.hasCounters = counters != nullptr;
+
+        if (counters) {
+            e.counters = *counters;
+        }
+    }
+};
@@ -3,10 +3,14 @@
 #include <typed_python/AllTypes.hpp>
 #include <typed_python/PyInstance.hpp>
 #include "PyVersionedIdSet.hpp"
+#include "PyServerTransactionRouter.hpp"
+#include "PyLogStructuredStore.hpp"
 #include "PyDatabaseObjectType.hpp"
+#include "PyDatabaseFieldAccessor.hpp"
 #include "PyDatabaseConnectionState.hpp"
 #include "PyDatabaseConnectionPumpLoop.hpp"
 #include "PyView.hpp"
+#include "PySnapshotView.hpp"
 
 PyObject* createDatabaseObjectType(PyObject *none, PyObject* args, PyObject* kwargs)
 {
@@ -23,8 +27,50 @@ PyObject* createDatabaseObjectType(PyObject *none, PyObject* args, PyObject* kwa
     });
 }
 
+// turn ViewTrace on or off. See ViewTrace::configure.
+PyObject* configureViewTrace(PyObject *none, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {"enabled", "sampleEvery", "maxEvents", NULL};
+    int enabled;
+    long long sampleEvery = 1;
+    Py_ssize_t maxEvents = 100000;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "p|Ln", (char**)kwlist, &enabled, &sampleEvery, &maxEvents)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&] {
+        if (maxEvents < 0) {
+            throw std::runtime_error("maxEvents can't be negative.");
+        }
+
+        ViewTrace::configure(enabled, sampleEvery, maxEvents);
+
+        return incref(Py_None);
+    });
+}
+
+// the spans ViewTrace has sampled, as a Chrome trace JSON string. If 'clear', forget them.
+PyObject* viewTraceChromeJson(PyObject *none, PyObject* args, PyObject* kwargs)
+{
+    static const char *kwlist[] = {"clear", NULL};
+    int clear = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|p", (char**)kwlist, &clear)) {
+        return nullptr;
+    }
+
+    return translateExceptionToPyObject([&] {
+        std::string json = ViewTrace::chromeTraceJson(clear);
+
+        return PyUnicode_FromStringAndSize(json.data(), json.size());
+    });
+}
+
 static PyMethodDef module_methods[] = {
     {"createDatabaseObjectType", (PyCFunction)createDatabaseObjectType, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"configureViewTrace", (PyCFunction)configureViewTrace, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"viewTraceChromeJson", (PyCFunction)viewTraceChromeJson, METH_VARARGS | METH_KEYWORDS, NULL},
     {NULL, NULL}
 };
 
@@ -51,6 +97,12 @@ PyInit__types(void)
     if (PyType_Ready(&PyType_VersionedIdSet) < 0)
         return NULL;
 
+    if (PyType_Ready(&PyType_ServerTransactionRouter) < 0)
+        return NULL;
+
+    if (PyType_Ready(&PyType_LogStructuredStore) < 0)
+        return NULL;
+
     if (PyType_Ready(&PyType_DatabaseConnectionState) < 0)
         return NULL;
 
@@ -60,15 +112,25 @@ PyInit__types(void)
     if (PyType_Ready(&PyType_View) < 0)
         return NULL;
 
+    if (PyType_Ready(&PyType_SnapshotView) < 0)
+        return NULL;
+
+    if (PyType_Ready(&PyType_DatabaseFieldAccessor) < 0)
+        return NULL;
+
     PyObject *module = PyModule_Create(&moduledef);
 
     if (module == NULL)
         return NULL;
 
     PyModule_AddObject(module, "VersionedIdSet", (PyObject *)&PyType_VersionedIdSet);
+    PyModule_AddObject(module, "ServerTransactionRouter", (PyObject *)&PyType_ServerTransactionRouter);
+    PyModule_AddObject(module, "LogStructuredStore", (PyObject *)&PyType_LogStructuredStore);
     PyModule_AddObject(module, "DatabaseConnectionState", (PyObject *)&PyType_DatabaseConnectionState);
     PyModule_AddObject(module, "DatabaseConnectionPumpLoop", (PyObject *)&PyType_DatabaseConnectionPumpLoop);
     PyModule_AddObject(module, "View", (PyObject *)&PyType_View);
+    PyModule_AddObject(module, "SnapshotView", (PyObject *)&PyType_SnapshotView);
+    PyModule_AddObject(module, "DatabaseFieldAccessor", (PyObject *)&PyType_DatabaseFieldAccessor);
 
     return module;
 }
@@ -6,7 +6,11 @@ with the object_database implementation.
 #include "_types.cpp"
 #include "View.cpp"
 #include "PyView.cpp"
+#include "PySnapshotView.cpp"
 #include "PyDatabaseConnectionState.cpp"
 #include "PyDatabaseConnectionPumpLoop.cpp"
 #include "PyVersionedIdSet.cpp"
+#include "PyServerTransactionRouter.cpp"
+#include "PyLogStructuredStore.cpp"
+#include "PyDatabaseFieldAccessor.cpp"
 #include "PyDatabaseObjectType.cpp"
@@ -0,0 +1,206 @@
+/******************************************************************************
+   Copyright 2017-2019 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+/*************
+
+Compares hashes for the (int64, int64) keys we use in our unordered maps
+(e.g. (object id, transaction id)) over id distributions that look like the
+ones the database produces. For each hash and distribution we report the
+fraction of distinct hash values, the mean number of keys examined per
+successful lookup in a std::unordered_map, and insert / find throughput.
+We also time the same inserts and finds in a FlatHashMap using hashCombine,
+for comparison.
+
+This doesn't need typed_python. Build and run it from the repo root with
+
+    g++ -O2 -std=c++14 object_database/benchmarks/hash_benchmark.cpp -o hash_benchmark
+    ./hash_benchmark [key count]
+
+Each result is printed as one line of JSON.
+
+*************/
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../direct_types/Hashing.hpp"
+#include "../direct_types/FlatHashMap.hpp"
+
+typedef std::pair<int64_t, int64_t> key_type;
+
+//what HashFunctions.hpp used to do
+class XorPairHash {
+public:
+    size_t operator()(const key_type& k) const {
+        return k.first ^ k.second;
+    }
+};
+
+class CombinedPairHash {
+public:
+    size_t operator()(const key_type& k) const {
+        return hashCombine(k.first, k.second);
+    }
+};
+
+//objects and transactions drawing ids from one shared counter: each transaction
+//allocates its own id and then creates a handful of objects.
+std::vector<key_type> sharedCounterKeys(size_t count, std::mt19937_64& rng) {
+    std::vector<key_type> res;
+    int64_t counter = 0;
+
+    while (res.size() < count) {
+        int64_t tid = counter++;
+        size_t objects = 1 + rng() % 8;
+        for (size_t k = 0; k < objects && res.size() < count; k++) {
+            res.push_back(key_type(counter++, tid));
+        }
+    }
+
+    return res;
+}
+
+//a fixed population of objects, each written by a few recent transactions,
+//where object ids and transaction ids come from similar, independent ranges.
+std::vector<key_type> objectHistoryKeys(size_t count, std::mt19937_64& rng) {
+    std::vector<key_type> res;
+    std::unordered_set<key_type, CombinedPairHash> seen;
+
+    int64_t objects = count / 4;
+
+    for (int64_t tid = 0; res.size() < count; tid++) {
+        key_type k(rng() % objects, tid / 2);
+        if (seen.insert(k).second) {
+            res.push_back(k);
+        }
+    }
+
+    return res;
+}
+
+//(field id, object id) pairs, like a view's read set: a few dozen fields over
+//a dense range of objects.
+std::vector<key_type> fieldAndObjectKeys(size_t count, std::mt19937_64& rng) {
+    std::vector<key_type> res;
+
+    int64_t fields = 40;
+    for (int64_t o = 0; res.size() < count; o++) {
+        for (int64_t f = 0; f < fields && res.size() < count; f++) {
+            res.push_back(key_type(f, o));
+        }
+    }
+
+    return res;
+}
+
+template<class hash_type>
+void measure(const char* hashName, const char* distributionName, const std::vector<key_type>& keys) {
+    std::unordered_set<size_t> hashes;
+    for (auto& k: keys) {
+        hashes.insert(hash_type()(k));
+    }
+
+    std::unordered_map<key_type, int64_t, hash_type> table;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    for (auto& k: keys) {
+        table[k] = k.first;
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+
+    int64_t checksum = 0;
+    for (auto& k: keys) {
+        checksum += table.find(k)->second;
+    }
+
+    auto t2 = std::chrono::steady_clock::now();
+
+    //a key at position 'p' in its bucket takes p+1 comparisons to find
+    double comparisons = 0;
+    for (size_t b = 0; b < table.bucket_count(); b++) {
+        double n = table.bucket_size(b);
+        comparisons += n * (n + 1) / 2;
+    }
+
+    printf(
+        "{\"hash\": \"%s\", \"distribution\": \"%s\", \"keys\": %zu, \"distinct_hash_fraction\": %.4f, "
+        "\"mean_probe_length\": %.2f, \"insert_ns\": %.1f, \"find_ns\": %.1f, \"checksum\": %lld}\n",
+        hashName,
+        distributionName,
+        keys.size(),
+        hashes.size() / double(keys.size()),
+        comparisons / keys.size(),
+        std::chrono::duration<double, std::nano>(t1 - t0).count() / keys.size(),
+        std::chrono::duration<double, std::nano>(t2 - t1).count() / keys.size(),
+        (long long)checksum
+    );
+}
+
+void measureFlatHashMap(const char* distributionName, const std::vector<key_type>& keys) {
+    FlatHashMap<key_type, int64_t, CombinedPairHash> table;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    for (auto& k: keys) {
+        table[k] = k.first;
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+
+    int64_t checksum = 0;
+    for (auto& k: keys) {
+        checksum += table.find(k)->second;
+    }
+
+    auto t2 = std::chrono::steady_clock::now();
+
+    printf(
+        "{\"table\": \"FlatHashMap\", \"distribution\": \"%s\", \"keys\": %zu, "
+        "\"insert_ns\": %.1f, \"find_ns\": %.1f, \"checksum\": %lld}\n",
+        distributionName,
+        keys.size(),
+        std::chrono::duration<double, std::nano>(t1 - t0).count() / keys.size(),
+        std::chrono::duration<double, std::nano>(t2 - t1).count() / keys.size(),
+        (long long)checksum
+    );
+}
+
+int main(int argc, char** argv) {
+    //the xor hash is quadratic on some of these, so keep the default modest
+    size_t count = argc > 1 ? std::stoull(argv[1]) : 100000;
+
+    std::mt19937_64 rng(42);
+
+    std::vector<std::pair<std::string, std::vector<key_type> > > distributions;
+    distributions.push_back(std::make_pair("shared_counter", sharedCounterKeys(count, rng)));
+    distributions.push_back(std::make_pair("object_history", objectHistoryKeys(count, rng)));
+    distributions.push_back(std::make_pair("field_and_object", fieldAndObjectKeys(count, rng)));
+
+    for (auto& nameAndKeys: distributions) {
+        measure<XorPairHash>("xor", nameAndKeys.first.c_str(), nameAndKeys.second);
+        measure<CombinedPairHash>("hashCombine", nameAndKeys.first.c_str(), nameAndKeys.second);
+        measureFlatHashMap(nameAndKeys.first.c_str(), nameAndKeys.second);
+    }
+
+    return 0;
+}
@@ -0,0 +1,343 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+
+/*************
+
+Times the native structures a client spends its time in, on their own, with
+no server and no python code in the loop:
+
+    * VersionedIdSet add / remove, lookupNext scans at the newest and oldest
+      transaction, and garbage collection, as the fraction of the set that
+      churns over its history grows.
+    * VersionedObjectsOfMultiType::best (missing and hitting the deserialized
+      value cache) and bestPayload, as each object's history gets deeper, and
+      the rate at which moveGuaranteedLowestIdForward drops that history.
+    * View::getField (first read and cached re-read) and View::setField over
+      a populated DatabaseConnectionState.
+
+Values are serialized int64s. We start an embedded interpreter only because
+typed_python expects one to exist; nothing we time calls into it.
+
+This needs typed_python's compiled objects, so build it with
+
+    make benchmarks
+
+and run
+
+    build/temp.linux-x86_64-3.6/object_database/structures_benchmark [object count]
+
+Each result is printed as one line of JSON, with its timings in nanoseconds
+per operation, so runs can be diffed or loaded into a dataframe.
+
+*************/
+
+#include <Python.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <typed_python/SerializationBuffer.hpp>
+#include <typed_python/SerializationContext.hpp>
+
+#include "../View.cpp"
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+//nanoseconds per operation for 'count' operations that started at 't0'
+double nsPerOp(benchmark_clock::time_point t0, size_t count) {
+    return std::chrono::duration<double, std::nano>(benchmark_clock::now() - t0).count() / std::max<size_t>(1, count);
+}
+
+Bytes serializedInt(int64_t value) {
+    NullSerializationContext context;
+    SerializationBuffer buffer(context);
+
+    TypeDetails<int64_t>::getType()->serialize((instance_ptr)&value, buffer, 0);
+
+    buffer.finalize();
+
+    return Bytes((const char*)buffer.buffer(), buffer.size());
+}
+
+/*****
+populate a VersionedIdSet with 'count' objects at transaction 1, then replace 'churn'
+of them, one at a time, by removing a random member and adding a new id, sixteen
+such changes per transaction.
+*****/
+void benchmarkVersionedIdSet(size_t count, double churn, std::mt19937_64& rng) {
+    VersionedIdSet set;
+
+    std::vector<object_id> members;
+
+    auto t0 = benchmark_clock::now();
+
+    for (size_t k = 0; k < count; k++) {
+        set.add(1, k);
+        members.push_back(k);
+    }
+
+    double addNs = nsPerOp(t0, count);
+
+    size_t changes = count * churn;
+    transaction_id tid = 1;
+    object_id nextId = count;
+
+    t0 = benchmark_clock::now();
+
+    for (size_t k = 0; k < changes; k++) {
+        if (k % 16 == 0) {
+            tid++;
+        }
+
+        size_t which = rng() % members.size();
+
+        set.remove(tid, members[which]);
+        set.add(tid, nextId);
+
+        members[which] = nextId++;
+    }
+
+    double churnNs = nsPerOp(t0, changes * 2);
+
+    //a full scan at the newest and oldest transactions
+    int64_t checksum = 0;
+    size_t visitedAtNewest = 0;
+    size_t visitedAtOldest = 0;
+
+    t0 = benchmark_clock::now();
+
+    for (object_id o = set.lookupFirst(tid); o != NO_OBJECT; o = set.lookupNext(tid, o)) {
+        checksum += o;
+        visitedAtNewest++;
+    }
+
+    double scanNewestNs = nsPerOp(t0, visitedAtNewest);
+
+    t0 = benchmark_clock::now();
+
+    for (object_id o = set.lookupFirst(1); o != NO_OBJECT; o = set.lookupNext(1, o)) {
+        checksum += o;
+        visitedAtOldest++;
+    }
+
+    double scanOldestNs = nsPerOp(t0, visitedAtOldest);
+
+    size_t entries = set.totalEntryCount();
+
+    t0 = benchmark_clock::now();
+
+    set.moveGuaranteedLowestIdForward(tid);
+
+    double gcNs = nsPerOp(t0, entries);
+
+    printf(
+        "{\"benchmark\": \"VersionedIdSet\", \"objects\": %zu, \"churn\": %.2f, \"transactions\": %lld, "
+        "\"add_ns\": %.1f, \"churn_op_ns\": %.1f, \"scan_newest_ns\": %.1f, \"scan_oldest_ns\": %.1f, "
+        "\"gc_ns_per_entry\": %.1f, \"entries_before_gc\": %zu, \"entries_after_gc\": %zu, \"checksum\": %lld}\n",
+        count,
+        churn,
+        (long long)tid,
+        addNs,
+        churnNs,
+        scanNewestNs,
+        scanOldestNs,
+        gcNs,
+        entries,
+        set.totalEntryCount(),
+        (long long)checksum
+    );
+}
+
+/*****
+give each of 'count' objects 'depth' versions, at transactions 1 through 'depth', and
+read them at random transactions. Then collect everything but the newest version.
+*****/
+void benchmarkVersionedObjects(size_t count, size_t depth, std::mt19937_64& rng) {
+    DeserializedValueCache valueCache;
+    VersionedObjectsOfMultiType objects(0, valueCache);
+
+    Type* valueType = TypeDetails<int64_t>::getType();
+    std::shared_ptr<SerializationContext> context(new NullSerializationContext());
+
+    auto t0 = benchmark_clock::now();
+
+    for (transaction_id tid = 1; tid <= (transaction_id)depth; tid++) {
+        for (size_t k = 0; k < count; k++) {
+            objects.add(k, tid, serializedInt(k * depth + tid));
+        }
+    }
+
+    double addNs = nsPerOp(t0, count * depth);
+
+    std::vector<std::pair<object_id, transaction_id> > reads;
+    for (size_t k = 0; k < count; k++) {
+        reads.push_back(std::make_pair(rng() % count, 1 + rng() % depth));
+    }
+
+    int64_t checksum = 0;
+
+    t0 = benchmark_clock::now();
+
+    for (const auto& read: reads) {
+        checksum += *(int64_t*)objects.best(valueType, context, read.first, read.second).first;
+    }
+
+    double bestMissNs = nsPerOp(t0, reads.size());
+
+    t0 = benchmark_clock::now();
+
+    for (const auto& read: reads) {
+        checksum += *(int64_t*)objects.best(valueType, context, read.first, read.second).first;
+    }
+
+    double bestHitNs = nsPerOp(t0, reads.size());
+
+    t0 = benchmark_clock::now();
+
+    for (const auto& read: reads) {
+        const uint8_t* data;
+        size_t size;
+
+        if (objects.bestPayload(read.first, read.second, data, size)) {
+            checksum += size;
+        }
+    }
+
+    double bestPayloadNs = nsPerOp(t0, reads.size());
+
+    t0 = benchmark_clock::now();
+
+    objects.moveGuaranteedLowestIdForward(depth);
+
+    double gcNs = nsPerOp(t0, count * (depth - 1));
+
+    printf(
+        "{\"benchmark\": \"VersionedObjectsOfMultiType\", \"objects\": %zu, \"depth\": %zu, "
+        "\"add_ns\": %.1f, \"best_miss_ns\": %.1f, \"best_hit_ns\": %.1f, \"best_payload_ns\": %.1f, "
+        "\"gc_ns_per_version\": %.1f, \"checksum\": %lld}\n",
+        count,
+        depth,
+        addNs,
+        bestMissNs,
+        bestHitNs,
+        bestPayloadNs,
+        depth > 1 ? gcNs : 0.0,
+        (long long)checksum
+    );
+}
+
+/*****
+load 'count' objects with 'fields' fields each into a DatabaseConnectionState in one
+transaction, then read each field twice and overwrite it once in a View.
+*****/
+void benchmarkView(size_t count, size_t fields, std::mt19937_64& rng) {
+    std::shared_ptr<DatabaseConnectionState> state(new DatabaseConnectionState());
+    std::shared_ptr<SerializationContext> context(new NullSerializationContext());
+
+    state->setContext(context);
+
+    std::vector<std::pair<ObjectFieldId, OneOf<None, Bytes> > > writes;
+
+    for (size_t k = 0; k < count; k++) {
+        for (size_t f = 0; f < fields; f++) {
+            writes.push_back(std::make_pair(ObjectFieldId(k, f, false), OneOf<None, Bytes>(serializedInt(k + f))));
+        }
+    }
+
+    state->incomingTransaction(
+        1,
+        ConstDict<ObjectFieldId, OneOf<None, Bytes> >(writes),
+        ConstDict<IndexId, TupleOf<object_id> >(),
+        ConstDict<IndexId, TupleOf<object_id> >()
+    );
+
+    Type* valueType = TypeDetails<int64_t>::getType();
+
+    std::vector<std::pair<field_id, object_id> > keys;
+    for (size_t k = 0; k < count; k++) {
+        for (size_t f = 0; f < fields; f++) {
+            keys.push_back(std::make_pair(f, k));
+        }
+    }
+
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    int64_t checksum = 0;
+    double firstReadNs, cachedReadNs, writeNs;
+
+    {
+        View view(state, 1, true);
+
+        auto t0 = benchmark_clock::now();
+
+        for (const auto& key: keys) {
+            checksum += *(int64_t*)view.getField(key.first, key.second, valueType);
+        }
+
+        firstReadNs = nsPerOp(t0, keys.size());
+
+        t0 = benchmark_clock::now();
+
+        for (const auto& key: keys) {
+            checksum += *(int64_t*)view.getField(key.first, key.second, valueType);
+        }
+
+        cachedReadNs = nsPerOp(t0, keys.size());
+
+        t0 = benchmark_clock::now();
+
+        for (const auto& key: keys) {
+            int64_t value = key.second * 2;
+            view.setField(key.first, key.second, valueType, (instance_ptr)&value);
+        }
+
+        writeNs = nsPerOp(t0, keys.size());
+    }
+
+    printf(
+        "{\"benchmark\": \"View\", \"objects\": %zu, \"fields\": %zu, "
+        "\"get_field_first_ns\": %.1f, \"get_field_cached_ns\": %.1f, \"set_field_ns\": %.1f, \"checksum\": %lld}\n",
+        count,
+        fields,
+        firstReadNs,
+        cachedReadNs,
+        writeNs,
+        (long long)checksum
+    );
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::stoull(argv[1]) : 100000;
+
+    Py_Initialize();
+
+    std::mt19937_64 rng(42);
+
+    for (double churn: {0.0, 0.1, 0.5, 2.0}) {
+        benchmarkVersionedIdSet(count, churn, rng);
+    }
+
+    for (size_t depth: {1, 2, 4, 16}) {
+        benchmarkVersionedObjects(count, depth, rng);
+    }
+
+    benchmarkView(count, 4, rng);
+
+    return 0;
+}
@@ -19,7 +19,7 @@ from object_database.core_schema import core_schema
 from object_database.view import View, Transaction, _cur_view
 from object_database.reactor import Reactor
 from object_database.identity import IDENTITY_BLOCK_SIZE
-from object_database._types import DatabaseConnectionState
+from object_database._types import DatabaseConnectionState, SnapshotView
 
 from typed_python.SerializationContext import SerializationContext
 from typed_python import Alternative, Dict, OneOf
@@ -64,6 +64,7 @@ class DatabaseConnection:
         self._connection_state = DatabaseConnectionState()
         self._connection_state.setSerializationContext(self.serializationContext)
         self._connection_state.setTriggerLazyLoad(self.loadLazyObject)
+        self._connection_state.setTriggerLazyPrefetch(self.prefetchLazyObjects)
 
         self._lazy_object_read_blocks = {}
 
@@ -108,6 +109,25 @@ class DatabaseConnection:
         self._max_tid_by_schema = {}
         self._max_tid_by_schema_and_type = {}
 
+        # (schema, typename) for each type we subscribed to in its entirety, lazily.
+        # 'saveState' leaves these out.
+        self._lazily_subscribed_types = set()
+
+        # the transaction and server epoch of the state we restored, if any. See
+        # 'restoreState'.
+        self._restored_tid = None
+        self._restored_epoch = None
+
+        # (schema, typename, None) for each restored type we're resubscribing to
+        self._resuming = set()
+
+        # flush guid -> the epoch the server sent in response to it
+        self._epochResponses = {}
+
+        # whether our channel applies Transaction messages to _connection_state itself
+        self._transactionsAreNative = False
+        self._updateNativeTransactionHandler()
+
     @property
     def auth_token(self):
         return self._auth_token
@@ -129,10 +149,45 @@ class DatabaseConnection:
     def registerOnTransactionHandler(self, handler):
         with self._lock:
             self._onTransactionHandlers.add(handler)
+            self._updateNativeTransactionHandler()
 
     def dropTransactionHandler(self, handler):
         with self._lock:
             self._onTransactionHandlers.discard(handler)
+            self._updateNativeTransactionHandler()
+
+    def _updateNativeTransactionHandler(self):
+        """Let the channel apply transactions natively iff nobody needs to see them.
+
+        Transaction handlers want the full message, so while we have any, transactions
+        come through _onMessage like everything else.
+        """
+        setHandler = getattr(self._channel, "setNativeTransactionHandler", None)
+        if setHandler is None:
+            return
+
+        wantNative = not self._onTransactionHandlers
+
+        with self._lock:
+            if wantNative == self._transactionsAreNative:
+                return
+
+            if wantNative:
+                self._transactionsAreNative = bool(
+                    setHandler(self._connection_state, self._lock, self._onNativeTransaction)
+                )
+            else:
+                self._channel.clearNativeTransactionHandler()
+                self._transactionsAreNative = False
+
+    def _onNativeTransaction(self, transaction_id, fieldIds):
+        """Our channel applied a Transaction to _connection_state. We hold self._lock."""
+        try:
+            self._messages_received += 1
+            self._markSchemaAndTypeMaxTids(fieldIds, transaction_id)
+            self._cur_transaction_num = transaction_id
+        except Exception:
+            self._logger.exception("Failed to process a natively applied transaction:")
 
     def currentTransactionId(self):
         return self._cur_transaction_num
@@ -176,6 +231,7 @@ class DatabaseConnection:
         with self._lock:
             self.connectionObject = None
             self._connection_state.setTriggerLazyLoad(None)
+            self._connection_state.setTriggerLazyPrefetch(None)
             self.disconnected.set()
 
             for e in self._lazy_object_read_blocks.values():
@@ -203,6 +259,143 @@ class DatabaseConnection:
         with self._lock:
             return self._connection_state.outstandingViewCount() == 0
 
+    def collectGarbage(self, maxWork=None, maxMicroseconds=None):
+        """Discard object versions that no view can see any more.
+
+        We do a bounded amount of this every time a transaction arrives or a
+        view closes, so after a long-lived view closes there can be a backlog.
+        Idle callers can use this to drain it. Returns the amount of work done.
+        """
+        with self._lock:
+            return self._connection_state.collectGarbage(maxWork, maxMicroseconds)
+
+    def serverEpoch(self, timeout=None):
+        """Ask the server for the name of its process.
+
+        Transaction ids are only comparable between connections with the same
+        epoch. It's empty if the server can't resume subscriptions.
+        """
+        with self._lock:
+            if self.disconnected.is_set():
+                raise DisconnectedException()
+
+            self._flushIx += 1
+            ix = self._flushIx
+            e = self._flushEvents[ix] = threading.Event()
+            self._channel.write(ClientToServer.RequestEpoch(guid=ix))
+
+        if not e.wait(timeout):
+            raise Exception(f"Failed to get the server's epoch in {timeout} seconds")
+
+        with self._lock:
+            if self.disconnected.is_set():
+                raise DisconnectedException()
+
+            return self._epochResponses.pop(ix)
+
+    def saveState(self, path, timeout=None):
+        """Save what we can see of every type we're subscribed to in its entirety.
+
+        A later connection to the same server process can 'restoreState' from
+        'path' and download only what's changed since, rather than everything.
+        Types we subscribed to lazily, and subscriptions to individual objects or
+        index values, aren't saved.
+        """
+        epoch = self.serverEpoch(timeout=timeout)
+
+        with self._lock:
+            self._connection_state.saveState(path, epoch, list(self._lazily_subscribed_types))
+
+    def restoreState(self, path, timeout=None):
+        """Load a file written by 'saveState', before subscribing to anything.
+
+        Objects in it can't be read until we subscribe to their type, which only
+        downloads the objects written since the file was saved. Returns False, and
+        loads nothing, if the file came from another server process, in which case
+        subscribing works as though we'd never restored anything.
+        """
+        epoch = self.serverEpoch(timeout=timeout)
+
+        with self._lock:
+            tid, savedEpoch = self._connection_state.restoreState(path)
+
+            if not epoch or savedEpoch != epoch:
+                for schemaName, typeName in self._connection_state.restoredTypes():
+                    self._connection_state.forgetRestoredType(schemaName, typeName)
+                return False
+
+            self._restored_tid = tid
+            self._restored_epoch = epoch
+
+            return True
+
+    def setParallelApply(self, threads, minOperations):
+        """Apply incoming transactions with at least 'minOperations' writes and
+        index changes on 'threads' threads. Initial subscriptions can be large
+        enough for this to matter. One thread turns it off.
+        """
+        with self._lock:
+            self._connection_state.setParallelApply(threads, minOperations)
+
+    def setValueSpill(self, directory, minBytes=64 * 1024, coldSeconds=600):
+        """Move serialized values of at least 'minBytes' that nobody has read for
+        'coldSeconds' (give or take) out of RAM, into a file in 'directory' that we
+        map back in when they're read. None turns it off for new values.
+        """
+        with self._lock:
+            self._connection_state.setSpillPolicy(directory, minBytes, coldSeconds)
+
+    def setChangeLogCapacity(self, capacity):
+        """Remember the last 'capacity' writes and index changes we receive, so that
+        'changesSince' can answer for recent transactions. Zero turns it off.
+        """
+        with self._lock:
+            self._connection_state.setChangeLogCapacity(capacity)
+
+    def changesSince(self, tid, types=None, indices=None):
+        """Describe what changed in the transactions we received after 'tid'.
+
+        Requires 'setChangeLogCapacity'. Without filters we report everything.
+        Otherwise we report writes to the fields of each of 'types', and changes
+        to the indices of those types and to each (type, indexName) in 'indices'.
+
+        Returns a dict with:
+            complete: False if we've forgotten some of what happened after 'tid',
+                in which case the rest is partial and the caller should rescan.
+            latestTid: the transaction to pass to the next call.
+            oids: the sorted ids of the objects with matching writes, including
+                objects that were created or deleted.
+            indexChanges: a dict from IndexId to (joined, left), the sorted ids of
+                the objects that joined or left that index value.
+
+        Objects that arrive with a new subscription aren't reported.
+        """
+        fieldIds = None
+
+        if types is not None or indices is not None:
+            fieldIds = set()
+
+            with self._lock:
+                for t in types or ():
+                    for fieldDef, fieldId in self._fields_to_field_ids.items():
+                        if (
+                            fieldDef.schema == t.__schema__.name
+                            and fieldDef.typename == t.__qualname__
+                        ):
+                            fieldIds.add(fieldId)
+
+                for t, indexName in indices or ():
+                    fieldDef = FieldDefinition(
+                        schema=t.__schema__.name, typename=t.__qualname__, fieldname=indexName
+                    )
+
+                    if fieldDef not in self._fields_to_field_ids:
+                        raise Exception(f"{t.__qualname__} has no known index {indexName}.")
+
+                    fieldIds.add(self._fields_to_field_ids[fieldDef])
+
+        return self._connection_state.changesSince(tid, fieldIds)
+
     def authenticate(self, token):
         assert self._auth_token is None, "We already authenticated."
         self._auth_token = token
@@ -380,14 +573,26 @@ class DatabaseConnection:
 
                 assert tup[0] and tup[1]
 
-                self._channel.write(
-                    ClientToServer.Subscribe(
-                        schema=tup[0],
-                        typename=tup[1],
-                        fieldname_and_value=tup[2],
-                        isLazy=tup[3],
+                if self._isRestoredType(tup):
+                    self._resuming.add((tup[0], tup[1], None))
+
+                    self._channel.write(
+                        ClientToServer.ResumeSubscription(
+                            schema=tup[0],
+                            typename=tup[1],
+                            since_tid=self._restored_tid,
+                            epoch=self._restored_epoch,
+                        )
+                    )
+                else:
+                    self._channel.write(
+                        ClientToServer.Subscribe(
+                            schema=tup[0],
+                            typename=tup[1],
+                            fieldname_and_value=tup[2],
+                            isLazy=tup[3],
+                        )
                     )
-                )
 
                 events.append(e)
 
@@ -404,6 +609,16 @@ class DatabaseConnection:
 
         return ()
 
+    def _isRestoredType(self, subscriptionTuple):
+        schemaName, typeName, fieldnameAndValue, isLazy = subscriptionTuple
+
+        return (
+            self._restored_tid is not None
+            and fieldnameAndValue is None
+            and not isLazy
+            and (schemaName, typeName) in self._connection_state.restoredTypes()
+        )
+
     def waitForCondition(self, cond, timeout, maxSleepTime=None):
         """Wait for 'cond' to return True.
 
@@ -447,6 +662,25 @@ class DatabaseConnection:
 
             return View(self, transaction_id)
 
+    def snapshot(self, transaction_id=None):
+        """A read-only snapshot that many threads can read from at once.
+
+        Unlike a view, reads from a snapshot take field ids and types explicitly and
+        release the GIL while they look at the data, so native code can scan it in
+        parallel. Only fields of simple types can be read. Lazy objects that
+        haven't been loaded yet look like they don't exist.
+        """
+        with self._lock:
+            if self.disconnected.is_set():
+                raise DisconnectedException()
+
+            if transaction_id is None:
+                transaction_id = self._cur_transaction_num
+
+            assert transaction_id <= self._cur_transaction_num
+
+            return SnapshotView(self._connection_state, transaction_id)
+
     def transaction(self):
         """Only one transaction may be committed on the current transaction number."""
         with self._lock:
@@ -461,6 +695,19 @@ class DatabaseConnection:
         if msg.matches.Disconnected:
             with self._lock:
                 self._onDisconnected()
+        elif msg.matches.EpochResponse:
+            with self._lock:
+                e = self._flushEvents.pop(msg.guid, None)
+                if not e:
+                    self._logger.error("Got an unrequested epoch response: %s", msg.guid)
+                else:
+                    self._epochResponses[msg.guid] = msg.epoch
+                    e.set()
+        elif msg.matches.ResumeRefused:
+            with self._lock:
+                # the server is sending all of it instead
+                self._resuming.discard((msg.schema, msg.typename, None))
+                self._connection_state.forgetRestoredType(msg.schema, msg.typename)
         elif msg.matches.FlushResponse:
             with self._lock:
                 e = self._flushEvents.pop(msg.guid, None)
@@ -574,6 +821,20 @@ class DatabaseConnection:
                 if e:
                     e.set()
 
+        elif msg.matches.LazyLoadManyResponse:
+            with self._lock:
+                self._connection_state.incomingTransaction(
+                    self._connection_state.getMinTid(), msg.values, {}, {}
+                )
+
+                for identity in msg.identities:
+                    self._connection_state.markObjectNotLazy(identity)
+
+                    e = self._lazy_object_read_blocks.pop(identity, None)
+
+                    if e:
+                        e.set()
+
         elif msg.matches.LazySubscriptionData:
             with self._lock:
                 lookupTuple = (msg.schema, msg.typename, msg.fieldname_and_value)
@@ -619,7 +880,14 @@ class DatabaseConnection:
 
                 self._markSchemaAndTypeMaxTids(set(v.fieldId for v in values), msg.tid)
 
-                sets = self._indexValuesToSetAdds(index_values)
+                if lookupTuple in self._resuming:
+                    self._resuming.discard(lookupTuple)
+                    sets, setRemoves = self._resumedIndexValuesToSetChanges(index_values)
+                    resumed = True
+                else:
+                    sets = self._indexValuesToSetAdds(index_values)
+                    setRemoves = {}
+                    resumed = False
 
                 if msg.fieldname_and_value is None:
                     if msg.typename is None:
@@ -650,7 +918,17 @@ class DatabaseConnection:
                     for i in identities:
                         self._connection_state.markObjectLazy(schema, typename, i)
 
-                self._connection_state.incomingTransaction(msg.tid, values, sets, {})
+                    if msg.fieldname_and_value is None:
+                        if msg.typename is None:
+                            for typename in self._schemaToType[msg.schema]:
+                                self._lazily_subscribed_types.add((msg.schema, typename))
+                        else:
+                            self._lazily_subscribed_types.add((msg.schema, msg.typename))
+
+                self._connection_state.incomingTransaction(msg.tid, values, sets, setRemoves)
+
+                if resumed:
+                    self._connection_state.finishRestoredType(msg.schema, msg.typename)
 
                 # this should be inline with the stream of messages coming from the server
                 assert self._cur_transaction_num <= msg.tid
@@ -705,12 +983,51 @@ class DatabaseConnection:
 
         return {k: tuple(v) for k, v in setAdds.items()}
 
+    def _resumedIndexValuesToSetChanges(self, indexValues):
+        # like _indexValuesToSetAdds, but for objects we may have restored, which
+        # have to leave whichever index values they were in when they were saved.
+        setAdds = {}
+        setRemoves = {}
+
+        for iv in indexValues:
+            val = indexValues[iv]
+            prior = self._connection_state.restoredIndexValue(iv.fieldId, iv.objId)
+
+            if prior == val:
+                continue
+
+            if prior is not None:
+                index_key = IndexId(fieldId=iv.fieldId, indexValue=prior)
+                setRemoves.setdefault(index_key, set()).add(iv.objId)
+
+            if val is not None:
+                index_key = IndexId(fieldId=iv.fieldId, indexValue=val)
+                setAdds.setdefault(index_key, set()).add(iv.objId)
+
+        return (
+            {k: tuple(v) for k, v in setAdds.items()},
+            {k: tuple(v) for k, v in setRemoves.items()},
+        )
+
     def requestLazyObjects(self, objects):
+        identitiesByType = {}
+
+        for o in objects:
+            identitiesByType.setdefault(
+                (type(o).__schema__.name, type(o).__qualname__), []
+            ).append(o._identity)
+
         with self._lock:
-            for o in objects:
-                self._loadLazyObject(
-                    o._identity, type(o).__schema__.name, type(o).__qualname__
-                )
+            for (schemaName, typeName), identities in identitiesByType.items():
+                self._loadLazyObjects(identities, schemaName, typeName)
+
+    def prefetchLazyObjects(self, schemaName, typeName, identities):
+        """Start loading the lazy objects 'identities' of one type, without waiting.
+
+        Anybody who reads one of them before it arrives waits for this request.
+        """
+        with self._lock:
+            self._loadLazyObjects(identities, schemaName, typeName)
 
     def loadLazyObject(self, identity, schemaName, typeName):
         with self._lock:
@@ -734,6 +1051,52 @@ class DatabaseConnection:
 
         return e
 
+    def _loadLazyObjects(self, identities, schemaName, typeName):
+        # objects already on their way don't need asking for again
+        toLoad = []
+
+        for identity in identities:
+            if identity not in self._lazy_object_read_blocks:
+                self._lazy_object_read_blocks[identity] = threading.Event()
+                toLoad.append(identity)
+
+        if not toLoad:
+            return
+
+        self._channel.write(
+            ClientToServer.LoadLazyObjects(
+                identities=toLoad, schema=schemaName, typename=typeName
+            )
+        )
+
+    def _commitNatively(self, view, as_of_version, confirmCallback):
+        """Commit the native View 'view', letting our channel build the messages in C++.
+
+        This sends the same messages as _createTransaction would.
+
+        Returns:
+            False if our channel can't do this, in which case the caller should
+            use _createTransaction instead.
+        """
+        writeCommit = getattr(self._channel, "writeCommit", None)
+        if writeCommit is None:
+            return False
+
+        transaction_guid = self._connection_state.allocateIdentity()
+
+        with self._lock:
+            if self.disconnected.is_set():
+                confirmCallback(TransactionResult.Disconnected())
+                return True
+
+            self._transaction_callbacks[transaction_guid] = confirmCallback
+
+        # if the channel is closing this sends nothing, and our disconnect handler
+        # fails the callback, just as it would for _createTransaction.
+        writeCommit(view, transaction_guid, as_of_version)
+
+        return True
+
     def _createTransaction(
         self,
         key_value,
@@ -743,6 +1106,9 @@ class DatabaseConnection:
         indices_to_check_versions,
         as_of_version,
         confirmCallback,
+        key_ranges_to_check_versions=None,
+        fields_to_check_versions=None,
+        index_fields_to_check_versions=None,
     ):
         assert confirmCallback is not None
 
@@ -844,6 +1210,30 @@ class DatabaseConnection:
             )
             indices_to_check_versions = indices_to_check_versions[10000:]
 
+        # reads recorded as ranges or fields (see Transaction.withReadTracking) go in
+        # their own messages. A range is two ints, so this is 10000 ranges at a time.
+        for fieldId, ranges in (key_ranges_to_check_versions or {}).items():
+            for start in range(0, len(ranges), 20000):
+                self._channel.write(
+                    ClientToServer.TransactionReads(
+                        key_ranges={fieldId: ranges[start : start + 20000]},
+                        field_versions=(),
+                        index_field_versions=(),
+                        transaction_guid=transaction_guid,
+                    )
+                )
+                self._channel.write(ClientToServer.Heartbeat())
+
+        if fields_to_check_versions or index_fields_to_check_versions:
+            self._channel.write(
+                ClientToServer.TransactionReads(
+                    key_ranges={},
+                    field_versions=fields_to_check_versions or (),
+                    index_field_versions=index_fields_to_check_versions or (),
+                    transaction_guid=transaction_guid,
+                )
+            )
+
         self._channel.write(
             ClientToServer.TransactionData(
                 writes=out_writes,
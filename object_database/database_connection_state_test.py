@@ -49,3 +49,85 @@ class DatabaseConnectionStateTests(unittest.TestCase):
             )
 
         self.assertLess(currentMemUsageMb() - m0, 1)
+
+    def test_garbage_collection_in_bounded_steps(self):
+        connectionState = DatabaseConnectionState()
+
+        # only collect a single unit of garbage per transaction
+        connectionState.setGarbageCollectionStep(1, None)
+
+        for i in range(100):
+            connectionState.incomingTransaction(
+                i,
+                {
+                    ObjectFieldId(objId=objId, fieldId=0, isIndexValue=False): b" " * 100
+                    for objId in range(10)
+                },
+                {IndexId(fieldId=0, indexValue=b"a"): (i,)},
+                {IndexId(fieldId=0, indexValue=b"a"): (i - 1,)} if i > 0 else {},
+            )
+
+        backlog = connectionState.garbageCollectionBacklog()
+        self.assertGreater(backlog, 0)
+
+        self.assertEqual(connectionState.collectGarbage(maxWork=5), 5)
+        self.assertLessEqual(connectionState.garbageCollectionBacklog(), backlog)
+
+        self.assertGreater(connectionState.collectGarbage(), 0)
+        self.assertEqual(connectionState.garbageCollectionBacklog(), 0)
+        self.assertEqual(connectionState.collectGarbage(), 0)
+
+        with self.assertRaises(Exception):
+            connectionState.collectGarbage(maxWork=-1)
+
+    def test_parallel_apply_matches_serial_apply(self):
+        serial = DatabaseConnectionState()
+        serial.setParallelApply(1, 0)
+
+        parallel = DatabaseConnectionState()
+        parallel.setParallelApply(4, 1)
+
+        for i in range(10):
+            writes = {
+                ObjectFieldId(objId=objId, fieldId=fieldId, isIndexValue=False): (
+                    b" " * (objId + i) if (objId + i) % 7 else None
+                )
+                for objId in range(100)
+                for fieldId in range(5)
+            }
+            adds = {IndexId(fieldId=0, indexValue=b"%s" % k): (i,) for k in range(20)}
+            removes = (
+                {IndexId(fieldId=0, indexValue=b"%s" % k): (i - 1,) for k in range(20)}
+                if i > 0
+                else {}
+            )
+
+            for connectionState in (serial, parallel):
+                connectionState.incomingTransaction(i, writes, adds, removes)
+
+        self.assertEqual(serial.objectCount(), parallel.objectCount())
+
+        with self.assertRaises(Exception):
+            parallel.setParallelApply(0, 1)
+
+    def test_object_subscriptions_keep_the_latest_transaction(self):
+        connectionState = DatabaseConnectionState()
+
+        for oid in range(1000, 2000):
+            connectionState.markObjectSubscribed(oid, 10)
+
+        for oid in range(1200, 1300, 3):
+            connectionState.markObjectSubscribed(oid, 20)
+
+        # an earlier subscription never lowers the transaction we already have
+        for oid in range(1000, 2000, 7):
+            connectionState.markObjectSubscribed(oid, 5)
+
+        self.assertIsNone(connectionState.objectSubscriptionLowestTransaction(999))
+        self.assertIsNone(connectionState.objectSubscriptionLowestTransaction(2000))
+
+        for oid in range(1000, 2000):
+            expected = 20 if 1200 <= oid < 1300 and (oid - 1200) % 3 == 0 else 10
+            self.assertEqual(
+                connectionState.objectSubscriptionLowestTransaction(oid), expected
+            )
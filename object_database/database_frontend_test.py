@@ -12,10 +12,12 @@
 #   See the License for the specific language governing permissions and
 #   limitations under the License.
 
+import json
 import unittest
 import subprocess
 import sys
 import os
+import tempfile
 import time
 from object_database.util import genToken
 
@@ -45,11 +47,18 @@ class ObjectDatabaseFrontEnd(unittest.TestCase):
                 [
                     sys.executable,
                     os.path.join(own_dir, "frontends", "database_throughput_test.py"),
-                    "localhost",
-                    "8889",
+                    "--server",
+                    "localhost:8889",
                     "--service-token",
                     token,
+                    "--seconds",
                     "1",
+                    "--items",
+                    "1000",
+                    "--buckets",
+                    "10",
+                    "--mix",
+                    "small_transactions=1",
                 ]
             )
 
@@ -57,3 +66,50 @@ class ObjectDatabaseFrontEnd(unittest.TestCase):
         finally:
             server.terminate()
             server.wait()
+
+    def test_throughput_test_reports_percentiles(self):
+        with tempfile.TemporaryDirectory() as tempDir:
+            outputPath = os.path.join(tempDir, "results.json")
+
+            client = subprocess.run(
+                [
+                    sys.executable,
+                    os.path.join(own_dir, "frontends", "database_throughput_test.py"),
+                    "--seconds",
+                    "2",
+                    "--items",
+                    "1000",
+                    "--buckets",
+                    "10",
+                    "--mix",
+                    ",".join(
+                        [
+                            "small_transactions=1",
+                            "index_reads=1",
+                            "large_subscription=1",
+                            "lazy_loads=1",
+                        ]
+                    ),
+                    "--output",
+                    outputPath,
+                ]
+            )
+
+            self.assertEqual(client.returncode, 0)
+
+            with open(outputPath) as f:
+                results = json.load(f)
+
+        self.assertGreater(results["transactions"], 0)
+        self.assertIsNotNone(results["server_cpu_us_per_transaction"])
+
+        for metric in (
+            "commit_latency",
+            "index_read_latency",
+            "subscription_ready",
+            "lazy_load_latency",
+        ):
+            self.assertGreater(results["metrics"][metric]["count"], 0, metric)
+            self.assertLessEqual(
+                results["metrics"][metric]["p50_ms"], results["metrics"][metric]["p999_ms"]
+            )
@@ -47,6 +47,19 @@ public:
         new (&isIndexValue()) isIndexValue_type(other.isIndexValue());
     }
 
+    ObjectFieldId& operator = (ObjectFieldId&& other) {
+        objId() = std::move(other.objId());
+        fieldId() = std::move(other.fieldId());
+        isIndexValue() = std::move(other.isIndexValue());
+        return *this;
+    }
+
+    ObjectFieldId(ObjectFieldId&& other) {
+        new (&objId()) objId_type(std::move(other.objId()));
+        new (&fieldId()) fieldId_type(std::move(other.fieldId()));
+        new (&isIndexValue()) isIndexValue_type(std::move(other.isIndexValue()));
+    }
+
     ~ObjectFieldId() {
         isIndexValue().~isIndexValue_type();
         fieldId().~fieldId_type();
@@ -162,6 +175,17 @@ public:
         new (&indexValue()) indexValue_type(other.indexValue());
     }
 
+    IndexId& operator = (IndexId&& other) {
+        fieldId() = std::move(other.fieldId());
+        indexValue() = std::move(other.indexValue());
+        return *this;
+    }
+
+    IndexId(IndexId&& other) {
+        new (&fieldId()) fieldId_type(std::move(other.fieldId()));
+        new (&indexValue()) indexValue_type(std::move(other.indexValue()));
+    }
+
     ~IndexId() {
         indexValue().~indexValue_type();
         fieldId().~fieldId_type();
@@ -266,6 +290,17 @@ public:
         new (&indices()) indices_type(other.indices());
     }
 
+    ValueType& operator = (ValueType&& other) {
+        fields() = std::move(other.fields());
+        indices() = std::move(other.indices());
+        return *this;
+    }
+
+    ValueType(ValueType&& other) {
+        new (&fields()) fields_type(std::move(other.fields()));
+        new (&indices()) indices_type(std::move(other.indices()));
+    }
+
     ~ValueType() {
         indices().~indices_type();
         fields().~fields_type();
@@ -367,6 +402,17 @@ public:
         new (&a1()) a1_type(other.a1());
     }
 
+    Anon30231616& operator = (Anon30231616&& other) {
+        a0() = std::move(other.a0());
+        a1() = std::move(other.a1());
+        return *this;
+    }
+
+    Anon30231616(Anon30231616&& other) {
+        new (&a0()) a0_type(std::move(other.a0()));
+        new (&a1()) a1_type(std::move(other.a1()));
+    }
+
     ~Anon30231616() {
         a1().~a1_type();
         a0().~a0_type();
@@ -472,11 +518,20 @@ public:
         return PyInstance::extractPythonObject((instance_ptr)&mLayout, getType());
     }
 
-    ~ClientToServer() { getType()->destroy((instance_ptr)&mLayout); }
+    ~ClientToServer() { if (mLayout) getType()->destroy((instance_ptr)&mLayout); }
     ClientToServer():mLayout(0) { getType()->constructor((instance_ptr)&mLayout); }
     ClientToServer(kind k):mLayout(0) { ConcreteAlternative::Make(getType(), (int64_t)k)->constructor((instance_ptr)&mLayout); }
     ClientToServer(const ClientToServer& in) { getType()->copy_constructor((instance_ptr)&mLayout, (instance_ptr)&in.mLayout); }
-    ClientToServer& operator=(const ClientToServer& other) { getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout); return *this; }
+    ClientToServer(ClientToServer&& in): mLayout(in.mLayout) { in.mLayout = nullptr; }
+    ClientToServer& operator=(const ClientToServer& other) {
+        if (!mLayout) {
+            getType()->copy_constructor((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
+        } else {
+            getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
+        }
+        return *this;
+    }
+    ClientToServer& operator=(ClientToServer&& other) { std::swap(mLayout, other.mLayout); return *this; }
 
     static ClientToServer TransactionData(const ConstDict<ObjectFieldId, OneOf<None, Bytes>>& writes, const ConstDict<IndexId, TupleOf<int64_t>>& set_adds, const ConstDict<IndexId, TupleOf<int64_t>>& set_removes, const TupleOf<ObjectFieldId>& key_versions, const TupleOf<IndexId>& index_versions, const int64_t& transaction_guid);
     static ClientToServer CompleteTransaction(const int64_t& as_of_version, const int64_t& transaction_guid);
@@ -571,6 +626,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    ClientToServer_TransactionData(ClientToServer_TransactionData&& other):ClientToServer(std::move(other)) {}
+    ClientToServer_TransactionData& operator=(ClientToServer_TransactionData&& other) {
+         ClientToServer::operator=(std::move(other));
+         return *this;
+    }
     ~ClientToServer_TransactionData() {}
 
     ConstDict<ObjectFieldId, OneOf<None, Bytes>>& writes() const { return *(ConstDict<ObjectFieldId, OneOf<None, Bytes>>*)(mLayout->data); }
@@ -611,6 +671,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    ClientToServer_CompleteTransaction(ClientToServer_CompleteTransaction&& other):ClientToServer(std::move(other)) {}
+    ClientToServer_CompleteTransaction& operator=(ClientToServer_CompleteTransaction&& other) {
+         ClientToServer::operator=(std::move(other));
+         return *this;
+    }
     ~ClientToServer_CompleteTransaction() {}
 
     int64_t& as_of_version() const { return *(int64_t*)(mLayout->data); }
@@ -639,6 +704,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    ClientToServer_Heartbeat(ClientToServer_Heartbeat&& other):ClientToServer(std::move(other)) {}
+    ClientToServer_Heartbeat& operator=(ClientToServer_Heartbeat&& other) {
+         ClientToServer::operator=(std::move(other));
+         return *this;
+    }
     ~ClientToServer_Heartbeat() {}
 
 private:
@@ -668,6 +738,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    ClientToServer_DefineSchema(ClientToServer_DefineSchema&& other):ClientToServer(std::move(other)) {}
+    ClientToServer_DefineSchema& operator=(ClientToServer_DefineSchema&& other) {
+         ClientToServer::operator=(std::move(other));
+         return *this;
+    }
     ~ClientToServer_DefineSchema() {}
 
     String& name() const { return *(String*)(mLayout->data); }
@@ -701,6 +776,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    ClientToServer_LoadLazyObject(ClientToServer_LoadLazyObject&& other):ClientToServer(std::move(other)) {}
+    ClientToServer_LoadLazyObject& operator=(ClientToServer_LoadLazyObject&& other) {
+         ClientToServer::operator=(std::move(other));
+         return *this;
+    }
     ~ClientToServer_LoadLazyObject() {}
 
     String& schema() const { return *(String*)(mLayout->data); }
@@ -737,6 +817,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    ClientToServer_Subscribe(ClientToServer_Subscribe&& other):ClientToServer(std::move(other)) {}
+    ClientToServer_Subscribe& operator=(ClientToServer_Subscribe&& other) {
+         ClientToServer::operator=(std::move(other));
+         return *this;
+    }
     ~ClientToServer_Subscribe() {}
 
     String& schema() const { return *(String*)(mLayout->data); }
@@ -772,6 +857,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    ClientToServer_Flush(ClientToServer_Flush&& other):ClientToServer(std::move(other)) {}
+    ClientToServer_Flush& operator=(ClientToServer_Flush&& other) {
+         ClientToServer::operator=(std::move(other));
+         return *this;
+    }
     ~ClientToServer_Flush() {}
 
     int64_t& guid() const { return *(int64_t*)(mLayout->data); }
@@ -801,6 +891,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    ClientToServer_Authenticate(ClientToServer_Authenticate&& other):ClientToServer(std::move(other)) {}
+    ClientToServer_Authenticate& operator=(ClientToServer_Authenticate&& other) {
+         ClientToServer::operator=(std::move(other));
+         return *this;
+    }
     ~ClientToServer_Authenticate() {}
 
     String& token() const { return *(String*)(mLayout->data); }
@@ -80,6 +80,10 @@ public:
         return !mLayout ? 0 : getType()->count((instance_ptr)&mLayout);
     }
 
+    PyObject* toPython() {
+        return PyInstance::extractPythonObject((instance_ptr)&mLayout, getType());
+    }
+
     template<class buf_t>
     void serialize(buf_t& buffer) {
         getType()->serialize<buf_t>((instance_ptr)&mLayout, buffer);
@@ -145,6 +149,16 @@ public:
         return *this;
     }
 
+    // a null layout is an empty ConstDict, so moving just takes the other's layout
+    ConstDict(ConstDict&& other): mLayout(other.mLayout) {
+        other.mLayout = nullptr;
+    }
+
+    ConstDict& operator=(ConstDict&& other) {
+        std::swap(mLayout, other.mLayout);
+        return *this;
+    }
+
     const value_type* lookupValueByKey(const key_type&  k) const {
         return (value_type*)(getType()->lookupValueByKey((instance_ptr)&mLayout, (instance_ptr)&k));
     }
@@ -0,0 +1,523 @@
+/******************************************************************************
+   Copyright 2017-2020 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Hashing.hpp"
+
+/*************
+
+FlatHashMap is an open-addressing hash table for plain-data keys (trivially
+copied and destroyed) that compare with ==, like our object, field and
+transaction ids and pairs of them. It supports the subset of
+std::unordered_map we use.
+
+It's laid out like SwissTable. Next to the slot array is an array with one
+control byte per slot. It holds 'empty', 'deleted', or the low 7 bits of the
+hash of the slot's key. Lookups take the rest of the hash to pick a group
+of 16 slots, and compare all 16 control bytes against the key's 7 bits at
+once (with SSE2 where we have it), so we only compare the keys of slots
+whose tag matches. A group with an empty slot ends the probe. Equality and
+hashing are inlined, so nothing goes through a function pointer.
+
+Keys have to be well mixed across all 64 bits of the hash, which is why
+the default hash is MixedHash.
+
+Iterators and pointers to values are invalidated by inserts. Erasing
+doesn't move anything, so the iterators to other entries stay valid.
+
+*************/
+
+template<class K, class V, class Hash = MixedHash<K> >
+class FlatHashMap {
+    static_assert(
+        std::is_trivially_copy_constructible<K>::value && std::is_trivially_destructible<K>::value,
+        "FlatHashMap keys must be plain data"
+    );
+
+    enum { group_width = 16 };
+
+    //control bytes for slots without a value. Full slots hold a tag in [0, 128).
+    enum : int8_t { ctrl_empty = -128, ctrl_deleted = -2 };
+
+    //the control bytes of one group, which we can match all at once. Each match
+    //is a bitmask with bit k set if control byte k matched.
+    class Group {
+    public:
+        explicit Group(const int8_t* ctrl) {
+#ifdef __SSE2__
+            m_ctrl = _mm_loadu_si128((const __m128i*)ctrl);
+#else
+            memcpy(m_ctrl, ctrl, group_width);
+#endif
+        }
+
+        uint32_t match(int8_t tag) const {
+#ifdef __SSE2__
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), m_ctrl));
+#else
+            uint32_t res = 0;
+            for (int k = 0; k < group_width; k++) {
+                if (m_ctrl[k] == tag) {
+                    res |= 1u << k;
+                }
+            }
+            return res;
+#endif
+        }
+
+        uint32_t matchEmpty() const {
+            return match(ctrl_empty);
+        }
+
+        //empty and deleted are the control bytes with the high bit set
+        uint32_t matchEmptyOrDeleted() const {
+#ifdef __SSE2__
+            return _mm_movemask_epi8(m_ctrl);
+#else
+            uint32_t res = 0;
+            for (int k = 0; k < group_width; k++) {
+                if (m_ctrl[k] < 0) {
+                    res |= 1u << k;
+                }
+            }
+            return res;
+#endif
+        }
+
+    private:
+#ifdef __SSE2__
+        __m128i m_ctrl;
+#else
+        int8_t m_ctrl[group_width];
+#endif
+    };
+
+public:
+    typedef std::pair<K, V> value_type;
+
+    template<bool is_const>
+    class iterator_base {
+        typedef typename std::conditional<is_const, const FlatHashMap*, FlatHashMap*>::type table_ptr;
+        typedef typename std::conditional<is_const, const value_type, value_type>::type ref_type;
+
+    public:
+        iterator_base(table_ptr table, size_t slot) :
+                m_table(table),
+                m_slot(slot)
+        {
+            skipToFull();
+        }
+
+        //allow conversion from iterator to const_iterator
+        iterator_base(const iterator_base<false>& other) :
+                m_table(other.table()),
+                m_slot(other.slot())
+        {
+        }
+
+        ref_type& operator*() const {
+            return m_table->m_slots[m_slot];
+        }
+
+        ref_type* operator->() const {
+            return &m_table->m_slots[m_slot];
+        }
+
+        iterator_base& operator++() {
+            m_slot++;
+            skipToFull();
+            return *this;
+        }
+
+        bool operator==(const iterator_base& other) const {
+            return m_slot == other.m_slot;
+        }
+
+        bool operator!=(const iterator_base& other) const {
+            return m_slot != other.m_slot;
+        }
+
+        table_ptr table() const {
+            return m_table;
+        }
+
+        size_t slot() const {
+            return m_slot;
+        }
+
+    private:
+        void skipToFull() {
+            while (m_slot < m_table->m_capacity && m_table->m_ctrl[m_slot] < 0) {
+                m_slot++;
+            }
+        }
+
+        table_ptr m_table;
+        size_t m_slot;
+    };
+
+    typedef iterator_base<false> iterator;
+    typedef iterator_base<true> const_iterator;
+
+    FlatHashMap() :
+            m_ctrl(nullptr),
+            m_slots(nullptr),
+            m_capacity(0),
+            m_size(0),
+            m_deleted(0)
+    {
+    }
+
+    FlatHashMap(const FlatHashMap& other) : FlatHashMap() {
+        if (!other.m_size) {
+            return;
+        }
+
+        allocate(other.m_capacity);
+
+        for (size_t k = 0; k < other.m_capacity; k++) {
+            if (other.m_ctrl[k] >= 0) {
+                new (&m_slots[k]) value_type(other.m_slots[k]);
+                m_ctrl[k] = other.m_ctrl[k];
+                m_size++;
+            } else if (other.m_ctrl[k] == ctrl_deleted) {
+                m_ctrl[k] = ctrl_deleted;
+                m_deleted++;
+            }
+        }
+    }
+
+    FlatHashMap(FlatHashMap&& other) :
+            m_ctrl(other.m_ctrl),
+            m_slots(other.m_slots),
+            m_capacity(other.m_capacity),
+            m_size(other.m_size),
+            m_deleted(other.m_deleted)
+    {
+        other.m_ctrl = nullptr;
+        other.m_slots = nullptr;
+        other.m_capacity = 0;
+        other.m_size = 0;
+        other.m_deleted = 0;
+    }
+
+    FlatHashMap& operator=(FlatHashMap other) {
+        swap(other);
+        return *this;
+    }
+
+    ~FlatHashMap() {
+        destroyAll();
+        free(m_ctrl);
+        free(m_slots);
+    }
+
+    void swap(FlatHashMap& other) {
+        std::swap(m_ctrl, other.m_ctrl);
+        std::swap(m_slots, other.m_slots);
+        std::swap(m_capacity, other.m_capacity);
+        std::swap(m_size, other.m_size);
+        std::swap(m_deleted, other.m_deleted);
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    iterator begin() {
+        return iterator(this, 0);
+    }
+
+    iterator end() {
+        return iterator(this, m_capacity);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, m_capacity);
+    }
+
+    iterator find(const K& key) {
+        return iterator(this, findSlot(key));
+    }
+
+    const_iterator find(const K& key) const {
+        return const_iterator(this, findSlot(key));
+    }
+
+    size_t count(const K& key) const {
+        return findSlot(key) == m_capacity ? 0 : 1;
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) {
+        size_t slot = findSlot(value.first);
+
+        if (slot != m_capacity) {
+            return std::make_pair(iterator(this, slot), false);
+        }
+
+        slot = insertNew(value.first, value.second);
+
+        return std::make_pair(iterator(this, slot), true);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& value) {
+        size_t slot = findSlot(value.first);
+
+        if (slot != m_capacity) {
+            return std::make_pair(iterator(this, slot), false);
+        }
+
+        slot = insertNew(value.first, std::move(value.second));
+
+        return std::make_pair(iterator(this, slot), true);
+    }
+
+    V& operator[](const K& key) {
+        size_t slot = findSlot(key);
+
+        if (slot == m_capacity) {
+            slot = insertNew(key, V());
+        }
+
+        return m_slots[slot].second;
+    }
+
+    size_t erase(const K& key) {
+        size_t slot = findSlot(key);
+
+        if (slot == m_capacity) {
+            return 0;
+        }
+
+        eraseSlot(slot);
+
+        return 1;
+    }
+
+    //returns the iterator following 'it'
+    iterator erase(iterator it) {
+        eraseSlot(it.slot());
+        return ++it;
+    }
+
+    //remove everything, but keep our slots
+    void clear() {
+        destroyAll();
+
+        if (m_capacity) {
+            memset(m_ctrl, (uint8_t)ctrl_empty, m_capacity);
+        }
+
+        m_size = 0;
+        m_deleted = 0;
+    }
+
+    //make room for 'count' values without further rehashing
+    void reserve(size_t count) {
+        if (count * 8 > m_capacity * 7) {
+            rehash(count);
+        }
+    }
+
+private:
+    //the slot holding 'key', or m_capacity if it's not present
+    size_t findSlot(const K& key) const {
+        if (!m_size) {
+            return m_capacity;
+        }
+
+        size_t hash = Hash()(key);
+        int8_t tag = hash & 0x7F;
+        size_t groupMask = m_capacity / group_width - 1;
+        size_t group = (hash >> 7) & groupMask;
+
+        //the probe visits group, group + 1, group + 3, group + 6, ..., which covers
+        //every group because the group count is a power of two. There's always an
+        //empty slot somewhere, so it ends.
+        for (size_t step = 1; ; step++) {
+            size_t base = group * group_width;
+            Group g(m_ctrl + base);
+
+            for (uint32_t matches = g.match(tag); matches; matches &= matches - 1) {
+                size_t slot = base + __builtin_ctz(matches);
+
+                if (m_slots[slot].first == key) {
+                    return slot;
+                }
+            }
+
+            if (g.matchEmpty()) {
+                return m_capacity;
+            }
+
+            group = (group + step) & groupMask;
+        }
+    }
+
+    //insert a key we know isn't present and return its slot
+    template<class value_arg>
+    size_t insertNew(const K& key, value_arg&& value) {
+        if ((m_size + m_deleted + 1) * 8 > m_capacity * 7) {
+            rehash(m_size + 1);
+        }
+
+        size_t hash = Hash()(key);
+        size_t slot = freeSlotFor(hash);
+
+        new (&m_slots[slot]) value_type(key, std::forward<value_arg>(value));
+
+        if (m_ctrl[slot] == ctrl_deleted) {
+            m_deleted--;
+        }
+
+        m_ctrl[slot] = hash & 0x7F;
+        m_size++;
+
+        return slot;
+    }
+
+    //the first empty or deleted slot on the probe sequence for 'hash'
+    size_t freeSlotFor(size_t hash) const {
+        size_t groupMask = m_capacity / group_width - 1;
+        size_t group = (hash >> 7) & groupMask;
+
+        for (size_t step = 1; ; step++) {
+            size_t base = group * group_width;
+            uint32_t available = Group(m_ctrl + base).matchEmptyOrDeleted();
+
+            if (available) {
+                return base + __builtin_ctz(available);
+            }
+
+            group = (group + step) & groupMask;
+        }
+    }
+
+    //a probe only continues past a group with no empty slots. If this group
+    //still has one, it has never been full, so no probe has ever gone past it
+    //and we can mark the slot empty rather than leaving a tombstone.
+    void eraseSlot(size_t slot) {
+        m_slots[slot].~value_type();
+
+        if (Group(m_ctrl + (slot & ~(size_t)(group_width - 1))).matchEmpty()) {
+            m_ctrl[slot] = ctrl_empty;
+        } else {
+            m_ctrl[slot] = ctrl_deleted;
+            m_deleted++;
+        }
+
+        m_size--;
+    }
+
+    void destroyAll() {
+        for (size_t k = 0; k < m_capacity; k++) {
+            if (m_ctrl[k] >= 0) {
+                m_slots[k].~value_type();
+            }
+        }
+    }
+
+    //allocate empty arrays for 'capacity' slots, which must be a power of two
+    //no smaller than group_width. We must not be holding any arrays.
+    void allocate(size_t capacity) {
+        m_ctrl = (int8_t*)malloc(capacity);
+        m_slots = (value_type*)malloc(sizeof(value_type) * capacity);
+
+        if (!m_ctrl || !m_slots) {
+            free(m_ctrl);
+            free(m_slots);
+            m_ctrl = nullptr;
+            m_slots = nullptr;
+            throw std::bad_alloc();
+        }
+
+        memset(m_ctrl, (uint8_t)ctrl_empty, capacity);
+        m_capacity = capacity;
+    }
+
+    //move everything into fresh arrays with room for at least 'count' values.
+    //We size them to be at most half full, so a rehash that's only clearing out
+    //tombstones may keep the same capacity.
+    void rehash(size_t count) {
+        size_t newCapacity = group_width;
+        while (count * 2 > newCapacity) {
+            newCapacity *= 2;
+        }
+
+        int8_t* oldCtrl = m_ctrl;
+        value_type* oldSlots = m_slots;
+        size_t oldCapacity = m_capacity;
+
+        m_ctrl = nullptr;
+        m_slots = nullptr;
+        m_capacity = 0;
+
+        try {
+            allocate(newCapacity);
+        } catch(...) {
+            m_ctrl = oldCtrl;
+            m_slots = oldSlots;
+            m_capacity = oldCapacity;
+            throw;
+        }
+
+        m_deleted = 0;
+
+        for (size_t k = 0; k < oldCapacity; k++) {
+            if (oldCtrl[k] >= 0) {
+                size_t slot = freeSlotFor(Hash()(oldSlots[k].first));
+
+                new (&m_slots[slot]) value_type(std::move(oldSlots[k]));
+                m_ctrl[slot] = oldCtrl[k];
+
+                oldSlots[k].~value_type();
+            }
+        }
+
+        free(oldCtrl);
+        free(oldSlots);
+    }
+
+    int8_t* m_ctrl;
+
+    value_type* m_slots;
+
+    //always zero or a power of two no smaller than group_width
+    size_t m_capacity;
+
+    size_t m_size;
+
+    size_t m_deleted;
+};
@@ -29,11 +29,20 @@ public:
         return PyInstance::extractPythonObject((instance_ptr)&mLayout, getType());
     }
 
-    ~A() { getType()->destroy((instance_ptr)&mLayout); }
+    ~A() { if (mLayout) getType()->destroy((instance_ptr)&mLayout); }
     A():mLayout(0) { getType()->constructor((instance_ptr)&mLayout); }
     A(kind k):mLayout(0) { ConcreteAlternative::Make(getType(), (int64_t)k)->constructor((instance_ptr)&mLayout); }
     A(const A& in) { getType()->copy_constructor((instance_ptr)&mLayout, (instance_ptr)&in.mLayout); }
-    A& operator=(const A& other) { getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout); return *this; }
+    A(A&& in): mLayout(in.mLayout) { in.mLayout = nullptr; }
+    A& operator=(const A& other) {
+        if (!mLayout) {
+            getType()->copy_constructor((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
+        } else {
+            getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
+        }
+        return *this;
+    }
+    A& operator=(A&& other) { std::swap(mLayout, other.mLayout); return *this; }
 
     static A Sub1(const int64_t& b, const int64_t& c);
     static A Sub2(const String& d, const String& e);
@@ -94,6 +103,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    A_Sub1(A_Sub1&& other):A(std::move(other)) {}
+    A_Sub1& operator=(A_Sub1&& other) {
+         A::operator=(std::move(other));
+         return *this;
+    }
     ~A_Sub1() {}
 
     int64_t& b() const { return *(int64_t*)(mLayout->data); }
@@ -126,6 +140,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    A_Sub2(A_Sub2&& other):A(std::move(other)) {}
+    A_Sub2& operator=(A_Sub2&& other) {
+         A::operator=(std::move(other));
+         return *this;
+    }
     ~A_Sub2() {}
 
     String& d() const { return *(String*)(mLayout->data); }
@@ -196,11 +215,20 @@ public:
         return PyInstance::extractPythonObject((instance_ptr)&mLayout, getType());
     }
 
-    ~Overlap() { getType()->destroy((instance_ptr)&mLayout); }
+    ~Overlap() { if (mLayout) getType()->destroy((instance_ptr)&mLayout); }
     Overlap():mLayout(0) { getType()->constructor((instance_ptr)&mLayout); }
     Overlap(kind k):mLayout(0) { ConcreteAlternative::Make(getType(), (int64_t)k)->constructor((instance_ptr)&mLayout); }
     Overlap(const Overlap& in) { getType()->copy_constructor((instance_ptr)&mLayout, (instance_ptr)&in.mLayout); }
-    Overlap& operator=(const Overlap& other) { getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout); return *this; }
+    Overlap(Overlap&& in): mLayout(in.mLayout) { in.mLayout = nullptr; }
+    Overlap& operator=(const Overlap& other) {
+        if (!mLayout) {
+            getType()->copy_constructor((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
+        } else {
+            getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
+        }
+        return *this;
+    }
+    Overlap& operator=(Overlap&& other) { std::swap(mLayout, other.mLayout); return *this; }
 
     static Overlap Sub1(const bool& b, const int64_t& c);
     static Overlap Sub2(const String& b, const TupleOf<String>& c);
@@ -262,6 +290,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    Overlap_Sub1(Overlap_Sub1&& other):Overlap(std::move(other)) {}
+    Overlap_Sub1& operator=(Overlap_Sub1&& other) {
+         Overlap::operator=(std::move(other));
+         return *this;
+    }
     ~Overlap_Sub1() {}
 
     bool& b() const { return *(bool*)(mLayout->data); }
@@ -294,6 +327,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    Overlap_Sub2(Overlap_Sub2&& other):Overlap(std::move(other)) {}
+    Overlap_Sub2& operator=(Overlap_Sub2&& other) {
+         Overlap::operator=(std::move(other));
+         return *this;
+    }
     ~Overlap_Sub2() {}
 
     String& b() const { return *(String*)(mLayout->data); }
@@ -325,6 +363,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    Overlap_Sub3(Overlap_Sub3&& other):Overlap(std::move(other)) {}
+    Overlap_Sub3& operator=(Overlap_Sub3&& other) {
+         Overlap::operator=(std::move(other));
+         return *this;
+    }
     ~Overlap_Sub3() {}
 
     int64_t& b() const { return *(int64_t*)(mLayout->data); }
@@ -396,6 +439,17 @@ public:
         new (&Y()) Y_type(other.Y());
     }
 
+    NamedTupleTwoStrings& operator = (NamedTupleTwoStrings&& other) {
+        X() = std::move(other.X());
+        Y() = std::move(other.Y());
+        return *this;
+    }
+
+    NamedTupleTwoStrings(NamedTupleTwoStrings&& other) {
+        new (&X()) X_type(std::move(other.X()));
+        new (&Y()) Y_type(std::move(other.Y()));
+    }
+
     ~NamedTupleTwoStrings() {
         Y().~Y_type();
         X().~X_type();
@@ -507,6 +561,19 @@ public:
         new (&s()) s_type(other.s());
     }
 
+    NamedTupleBoolIntStr& operator = (NamedTupleBoolIntStr&& other) {
+        b() = std::move(other.b());
+        i() = std::move(other.i());
+        s() = std::move(other.s());
+        return *this;
+    }
+
+    NamedTupleBoolIntStr(NamedTupleBoolIntStr&& other) {
+        new (&b()) b_type(std::move(other.b()));
+        new (&i()) i_type(std::move(other.i()));
+        new (&s()) s_type(std::move(other.s()));
+    }
+
     ~NamedTupleBoolIntStr() {
         s().~s_type();
         i().~i_type();
@@ -629,6 +696,19 @@ public:
         new (&desc()) desc_type(other.desc());
     }
 
+    NamedTupleIntFloatDesc& operator = (NamedTupleIntFloatDesc&& other) {
+        a() = std::move(other.a());
+        b() = std::move(other.b());
+        desc() = std::move(other.desc());
+        return *this;
+    }
+
+    NamedTupleIntFloatDesc(NamedTupleIntFloatDesc&& other) {
+        new (&a()) a_type(std::move(other.a()));
+        new (&b()) b_type(std::move(other.b()));
+        new (&desc()) desc_type(std::move(other.desc()));
+    }
+
     ~NamedTupleIntFloatDesc() {
         desc().~desc_type();
         b().~b_type();
@@ -744,6 +824,17 @@ public:
         new (&Y()) Y_type(other.Y());
     }
 
+    NamedTupleBoolListOfInt& operator = (NamedTupleBoolListOfInt&& other) {
+        X() = std::move(other.X());
+        Y() = std::move(other.Y());
+        return *this;
+    }
+
+    NamedTupleBoolListOfInt(NamedTupleBoolListOfInt&& other) {
+        new (&X()) X_type(std::move(other.X()));
+        new (&Y()) Y_type(std::move(other.Y()));
+    }
+
     ~NamedTupleBoolListOfInt() {
         Y().~Y_type();
         X().~X_type();
@@ -848,6 +939,17 @@ public:
         new (&values()) values_type(other.values());
     }
 
+    NamedTupleAttrAndValues& operator = (NamedTupleAttrAndValues&& other) {
+        attributes() = std::move(other.attributes());
+        values() = std::move(other.values());
+        return *this;
+    }
+
+    NamedTupleAttrAndValues(NamedTupleAttrAndValues&& other) {
+        new (&attributes()) attributes_type(std::move(other.attributes()));
+        new (&values()) values_type(std::move(other.values()));
+    }
+
     ~NamedTupleAttrAndValues() {
         values().~values_type();
         attributes().~attributes_type();
@@ -949,6 +1051,17 @@ public:
         new (&a1()) a1_type(other.a1());
     }
 
+    Anon27165584& operator = (Anon27165584&& other) {
+        a0() = std::move(other.a0());
+        a1() = std::move(other.a1());
+        return *this;
+    }
+
+    Anon27165584(Anon27165584&& other) {
+        new (&a0()) a0_type(std::move(other.a0()));
+        new (&a1()) a1_type(std::move(other.a1()));
+    }
+
     ~Anon27165584() {
         a1().~a1_type();
         a0().~a0_type();
@@ -1050,6 +1163,17 @@ public:
         new (&a1()) a1_type(other.a1());
     }
 
+    Anon27173904& operator = (Anon27173904&& other) {
+        a0() = std::move(other.a0());
+        a1() = std::move(other.a1());
+        return *this;
+    }
+
+    Anon27173904(Anon27173904&& other) {
+        new (&a0()) a0_type(std::move(other.a0()));
+        new (&a1()) a1_type(std::move(other.a1()));
+    }
+
     ~Anon27173904() {
         a1().~a1_type();
         a0().~a0_type();
@@ -1154,6 +1278,17 @@ public:
         new (&y()) y_type(other.y());
     }
 
+    Anon27201024& operator = (Anon27201024&& other) {
+        x() = std::move(other.x());
+        y() = std::move(other.y());
+        return *this;
+    }
+
+    Anon27201024(Anon27201024&& other) {
+        new (&x()) x_type(std::move(other.x()));
+        new (&y()) y_type(std::move(other.y()));
+    }
+
     ~Anon27201024() {
         y().~y_type();
         x().~x_type();
@@ -1267,6 +1402,21 @@ public:
         new (&a3()) a3_type(other.a3());
     }
 
+    AnonTest& operator = (AnonTest&& other) {
+        a0() = std::move(other.a0());
+        a1() = std::move(other.a1());
+        a2() = std::move(other.a2());
+        a3() = std::move(other.a3());
+        return *this;
+    }
+
+    AnonTest(AnonTest&& other) {
+        new (&a0()) a0_type(std::move(other.a0()));
+        new (&a1()) a1_type(std::move(other.a1()));
+        new (&a2()) a2_type(std::move(other.a2()));
+        new (&a3()) a3_type(std::move(other.a3()));
+    }
+
     ~AnonTest() {
         a3().~a3_type();
         a2().~a2_type();
@@ -1384,11 +1534,20 @@ public:
         return PyInstance::extractPythonObject((instance_ptr)&mLayout, getType());
     }
 
-    ~Bexpress() { getType()->destroy((instance_ptr)&mLayout); }
+    ~Bexpress() { if (mLayout) getType()->destroy((instance_ptr)&mLayout); }
     Bexpress():mLayout(0) { getType()->constructor((instance_ptr)&mLayout); }
     Bexpress(kind k):mLayout(0) { ConcreteAlternative::Make(getType(), (int64_t)k)->constructor((instance_ptr)&mLayout); }
     Bexpress(const Bexpress& in) { getType()->copy_constructor((instance_ptr)&mLayout, (instance_ptr)&in.mLayout); }
-    Bexpress& operator=(const Bexpress& other) { getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout); return *this; }
+    Bexpress(Bexpress&& in): mLayout(in.mLayout) { in.mLayout = nullptr; }
+    Bexpress& operator=(const Bexpress& other) {
+        if (!mLayout) {
+            getType()->copy_constructor((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
+        } else {
+            getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
+        }
+        return *this;
+    }
+    Bexpress& operator=(Bexpress&& other) { std::swap(mLayout, other.mLayout); return *this; }
 
     static Bexpress Leaf(const bool& value);
     static Bexpress BinOp(const Bexpress& left, const String& op, const Bexpress& right);
@@ -1451,6 +1610,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    Bexpress_Leaf(Bexpress_Leaf&& other):Bexpress(std::move(other)) {}
+    Bexpress_Leaf& operator=(Bexpress_Leaf&& other) {
+         Bexpress::operator=(std::move(other));
+         return *this;
+    }
     ~Bexpress_Leaf() {}
 
     bool& value() const { return *(bool*)(mLayout->data); }
@@ -1482,6 +1646,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    Bexpress_BinOp(Bexpress_BinOp&& other):Bexpress(std::move(other)) {}
+    Bexpress_BinOp& operator=(Bexpress_BinOp&& other) {
+         Bexpress::operator=(std::move(other));
+         return *this;
+    }
     ~Bexpress_BinOp() {}
 
     Bexpress& left() const { return *(Bexpress*)(mLayout->data); }
@@ -1516,6 +1685,11 @@ public:
          getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);
          return *this;
     }
+    Bexpress_UnaryOp(Bexpress_UnaryOp&& other):Bexpress(std::move(other)) {}
+    Bexpress_UnaryOp& operator=(Bexpress_UnaryOp&& other) {
+         Bexpress::operator=(std::move(other));
+         return *this;
+    }
     ~Bexpress_UnaryOp() {}
 
     String& op() const { return *(String*)(mLayout->data); }
@@ -16,9 +16,9 @@
 #pragma once
 
 #include <cstring>
-#include <functional>
 
 #include <typed_python/hash_table_layout.hpp>
+#include "Hashing.hpp"
 
 template <typename T>
 class HashTableLayout {
@@ -44,26 +44,22 @@ class HashTableLayout {
     std::pair<instance_ptr, size_t> add(instance_ptr el, int32_t slot = -1) {
         if (slot == -1)
             slot = table->allocateNewSlot(byte_count_per_el);
-        size_t keyhash = std::hash<T>{}(*reinterpret_cast<T*>(el));
+        size_t keyhash = MixedHash<T>{}(*reinterpret_cast<T*>(el));
         table->add(keyhash, slot);
         instance_ptr dst = table->items + slot * byte_count_per_el;
         std::memcpy((void*)dst, (void*)el, sizeof(T));
         return std::pair<instance_ptr, size_t>(dst, keyhash);
     }
 
-    bool cmp(instance_ptr key_to_find, instance_ptr key_in_table) {
-        if (key_to_find == key_in_table) {
-            return cmpResultToBoolForPyOrdering(Py_EQ, 0);
-        }
-        if (*reinterpret_cast<T*>(key_to_find) == *reinterpret_cast<T*>(key_in_table)) {
-            return cmpResultToBoolForPyOrdering(Py_EQ, 0);
-        }
-        return cmpResultToBoolForPyOrdering(Py_EQ, 1);
+    // hash_table_layout takes the comparison as a template argument, so handing
+    // it a lambda gets the == inlined into the probe loop.
+    static bool cmp(instance_ptr key_to_find, instance_ptr key_in_table) {
+        return key_to_find == key_in_table
+            || *reinterpret_cast<T*>(key_to_find) == *reinterpret_cast<T*>(key_in_table);
     }
 
     instance_ptr lookupKey(instance_ptr key_to_find, size_t keyhash) {
-        using namespace std::placeholders;
-        auto cmp_func = std::bind(&HashTableLayout::cmp, this, key_to_find, _1);
+        auto cmp_func = [key_to_find](instance_ptr key_in_table) { return cmp(key_to_find, key_in_table); };
         int32_t index = table->find(byte_count_per_el, keyhash, cmp_func);
         if (index >= 0) {
             return table->items + index * byte_count_per_el;
@@ -72,9 +68,8 @@ class HashTableLayout {
     }
 
     bool remove(instance_ptr el) {
-        using namespace std::placeholders;
-        size_t keyhash = std::hash<T>{}(*reinterpret_cast<T*>(el));
-        auto cmp_func = std::bind(&HashTableLayout::cmp, this, el, _1);
+        size_t keyhash = MixedHash<T>{}(*reinterpret_cast<T*>(el));
+        auto cmp_func = [el](instance_ptr key_in_table) { return cmp(el, key_in_table); };
         int32_t index = table->remove(byte_count_per_el, keyhash, cmp_func);
         if (index >= 0) {
             return true;
@@ -0,0 +1,61 @@
+/******************************************************************************
+   Copyright 2017-2019 object_database Authors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+/*************
+
+Hash building blocks for our containers.
+
+std::hash of an integer is the integer itself, and our object and
+transaction ids are handed out sequentially from overlapping ranges. Hashes
+built by xor'ing such values (or taking their low bits) collide constantly:
+(oid, tid) and (tid, oid) are identical, as is every (x, x). Anything that
+hashes several ids should combine them with 'hashCombine', and tables that
+pick buckets using the low bits of a hash should run it through 'hashMix'
+(or use 'MixedHash') first.
+
+*************/
+
+//the 64 bit finalizer from MurmurHash3. It's a bijection, so it never adds
+//collisions, and every input bit affects every output bit.
+inline uint64_t hashMix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+//fold 'value' into 'seed'. Order matters, so hashCombine(a, b) != hashCombine(b, a),
+//and equal inputs don't cancel out like they do with xor.
+inline uint64_t hashCombine(uint64_t seed, uint64_t value) {
+    return hashMix(seed * 0x9E3779B97F4A7C15ULL + value);
+}
+
+//std::hash<T>, followed by hashMix. Use this for integer-like keys in tables
+//that take the low bits of the hash.
+template<class T>
+class MixedHash {
+public:
+    size_t operator()(const T& value) const noexcept {
+        return (size_t)hashMix((uint64_t)std::hash<T>()(value));
+    }
+};
@@ -15,6 +15,7 @@
 ******************************************************************************/
 #pragma once
 
+#include <utility>
 #include <typed_python/Type.hpp>
 #include <typed_python/PyInstance.hpp>
 
@@ -117,6 +118,17 @@ public:
         return *this;
     }
 
+    // typed_python instances can be relocated bitwise, so moving takes the other's
+    // layout as-is and leaves it holding a default-constructed value
+    OneOf(OneOf<T1, Ts...>&& other): mLayout(other.mLayout) {
+        getType()->constructor((instance_ptr)&other.mLayout);
+    }
+
+    OneOf<T1, Ts...>& operator=(OneOf<T1, Ts...>&& other) {
+        std::swap(mLayout, other.mLayout);
+        return *this;
+    }
+
     const layout* getLayout() const { return &mLayout; }
 private:
     explicit OneOf(layout l): mLayout(l) {
@@ -15,6 +15,7 @@
 ******************************************************************************/
 #pragma once
 
+#include <utility>
 #include <vector>
 #include <typed_python/Type.hpp>
 #include <typed_python/PyInstance.hpp>
@@ -85,6 +86,46 @@ public:
         return TupleOf<element_type>(layoutPtr);
     }
 
+    //build a tuple holding a copy of 'count' elements starting at 'data'. Only valid for
+    //element types that can be copied bitwise, like object_id.
+    static TupleOf<element_type> fromBuffer(const element_type* data, int64_t count) {
+        TupleOfType::layout* layoutPtr = nullptr;
+
+        getType()->constructor((instance_ptr)&layoutPtr, count, [&](instance_ptr tgt, int64_t k) {
+            *(element_type*)tgt = data[k];
+        });
+
+        return TupleOf<element_type>(layoutPtr);
+    }
+
+    //build a tuple by letting 'fill' write elements straight into its buffer, which
+    //has room for 'capacity' of them. 'fill' gets a pointer to the buffer, must write
+    //no more than 'capacity' elements, and returns how many it wrote, so the tuple python sees is the buffer we filled. If 'fill'
+    //used less than half the room, we copy into an exactly sized tuple rather than
+    //hold onto the rest. Only valid for element types that can be copied bitwise.
+    template<class F>
+    static TupleOf<element_type> fromFill(int64_t capacity, const F& fill) {
+        if (capacity == 0) {
+            return TupleOf<element_type>();
+        }
+
+        TupleOfType::layout* layoutPtr = nullptr;
+
+        getType()->constructor((instance_ptr)&layoutPtr, capacity, [&](instance_ptr tgt, int64_t k) {});
+
+        TupleOf<element_type> res(layoutPtr);
+
+        int64_t count = fill((element_type*)layoutPtr->data);
+
+        if (count * 2 < capacity) {
+            return fromBuffer((element_type*)layoutPtr->data, count);
+        }
+
+        layoutPtr->count = count;
+
+        return res;
+    }
+
     PyObject* toPython() {
         return PyInstance::extractPythonObject((instance_ptr)&mLayout, getType());
     }
@@ -152,6 +193,16 @@ public:
         return *this;
     }
 
+    // a null layout is an empty TupleOf, so moving just takes the other's layout
+    TupleOf(TupleOf&& other): mLayout(other.mLayout) {
+        other.mLayout = nullptr;
+    }
+
+    TupleOf& operator=(TupleOf&& other) {
+        std::swap(mLayout, other.mLayout);
+        return *this;
+    }
+
     TupleOfType::layout* getLayout() const {
         return mLayout;
     }
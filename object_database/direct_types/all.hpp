@@ -25,5 +25,7 @@
 #include "OneOf.hpp"
 #include "String.hpp"
 #include "TupleOf.hpp"
+#include "Hashing.hpp"
 #include <typed_python/hash_table_layout.hpp>
 #include "HashTableLayout.hpp"
+#include "FlatHashMap.hpp"
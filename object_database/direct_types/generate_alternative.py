@@ -91,7 +91,8 @@ def gen_alternative_type(full_name, d):
     ret.append("    }")
     ret.append("")
 
-    ret.append(f"    ~{name}() {{ getType()->destroy((instance_ptr)&mLayout); }}")
+    # a moved-from instance has no layout, and can only be destroyed or assigned to
+    ret.append(f"    ~{name}() {{ if (mLayout) getType()->destroy((instance_ptr)&mLayout); }}")
     ret.append(
         f"    {name}():mLayout(0) {{ getType()->constructor((instance_ptr)&mLayout); }}"
     )
@@ -104,10 +105,23 @@ def gen_alternative_type(full_name, d):
         f"    {name}(const {name}& in) "
         "{ getType()->copy_constructor((instance_ptr)&mLayout, (instance_ptr)&in.mLayout); }"
     )
+    ret.append(f"    {name}({name}&& in): mLayout(in.mLayout) {{ in.mLayout = nullptr; }}")
+    ret.append(f"    {name}& operator=(const {name}& other) {{")
+    ret.append("        if (!mLayout) {")
     ret.append(
-        f"    {name}& operator=(const {name}& other) "
-        "{ getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);"
-        " return *this; }"
+        "            getType()->copy_constructor"
+        "((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);"
+    )
+    ret.append("        } else {")
+    ret.append(
+        "            getType()->assign((instance_ptr)&mLayout, (instance_ptr)&other.mLayout);"
+    )
+    ret.append("        }")
+    ret.append("        return *this;")
+    ret.append("    }")
+    ret.append(
+        f"    {name}& operator=({name}&& other) "
+        "{ std::swap(mLayout, other.mLayout); return *this; }"
     )
     ret.append("")
     for nt in nts:
@@ -190,6 +204,11 @@ def gen_alternative_type(full_name, d):
         )
         ret.append("         return *this;")
         ret.append("    }")
+        ret.append(f"    {name}_{nt}({name}_{nt}&& other):{name}(std::move(other)) {{}}")
+        ret.append(f"    {name}_{nt}& operator=({name}_{nt}&& other) {{")
+        ret.append(f"         {name}::operator=(std::move(other));")
+        ret.append("         return *this;")
+        ret.append("    }")
         ret.append(f"    ~{name}_{nt}() {{}}")
         ret.append("")
         for i, (a, t) in enumerate(d[nt]):
@@ -84,6 +84,21 @@ def gen_tuple_type(full_name, *args):
     ret.append("    }")
     ret.append("")
 
+    # moving moves each member, so a temporary's refcounted payloads change hands
+    # instead of getting incref'd here and decref'd when it dies
+    ret.append(f"    {name}& operator = ({name}&& other) {{")
+    for key in keys:
+        ret.append(f"        {key}() = std::move(other.{key}());")
+    ret.append("        return *this;")
+    ret.append("    }")
+    ret.append("")
+
+    ret.append(f"    {name}({name}&& other) {{")
+    for key in keys:
+        ret.append(f"        new (&{key}()) {key}_type(std::move(other.{key}()));")
+    ret.append("    }")
+    ret.append("")
+
     ret.append(f"    ~{name}() {{")
     for key in revkeys:
         ret.append(f"        {key}().~{key}_type();")
@@ -18,7 +18,11 @@ import argparse
 import sys
 import time
 
-from object_database.persistence import InMemoryPersistence, RedisPersistence
+from object_database.persistence import (
+    InMemoryPersistence,
+    LogStructuredPersistence,
+    RedisPersistence,
+)
 from object_database.tcp_server import TcpServer
 from object_database.util import sslContextFromCertPathOrNone
 
@@ -42,11 +46,18 @@ def main(argv):
     )
     parser.add_argument("--redis_port", type=int, default=None)
     parser.add_argument("--inmem", default=False, action="store_true")
+    parser.add_argument(
+        "--persistence-path",
+        default=None,
+        help="keep the database in a log-structured file here, rather than in redis",
+    )
 
     parsedArgs = parser.parse_args(argv[1:])
 
     if parsedArgs.inmem:
         mem_store = InMemoryPersistence()
+    elif parsedArgs.persistence_path is not None:
+        mem_store = LogStructuredPersistence(parsedArgs.persistence_path)
     else:
         mem_store = RedisPersistence(port=parsedArgs.redis_port)
 
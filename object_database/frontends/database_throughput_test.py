@@ -14,61 +14,393 @@
 #   See the License for the specific language governing permissions and
 #   limitations under the License.
 
-import threading
+"""Drive a standard workload against an object_database server and report latencies.
+
+By default we start a TcpServer in this process, load it with a fixed, seeded
+population of Items, and then start client processes, each of which connects
+over TCP (and so through the native pump loop) and runs one workload for the
+given number of seconds:
+
+    small_transactions: increment a counter of our own, one transaction at a time
+    index_reads: look up a random bucket of Items by index and read them
+    large_subscription: connect, subscribe to every Item, and disconnect
+    lazy_loads: connect, subscribe to Items lazily, and read a few of them
+
+'--mix' says how many client processes run each workload. When we host the
+server, this process does nothing else while the clients run, so its CPU time
+is the server's. We print one JSON object with p50/p99/p999 latencies for each
+metric, transaction throughput, and server CPU per transaction.
+"""
+
 import argparse
+import json
+import multiprocessing
+import random
 import sys
+import threading
 import time
-from object_database import connect, Schema
 
+from object_database import connect, Indexed, Schema
+from object_database.persistence import InMemoryPersistence
+from object_database.tcp_server import TcpServer
+from object_database.util import genToken, sslContextFromCertPathOrNone
 
-def main(argv):
-    parser = argparse.ArgumentParser("Run a database throughput test")
+schema = Schema("database_throughput_test")
 
-    parser.add_argument("host")
-    parser.add_argument("port")
-    parser.add_argument(
-        "--service-token",
-        type=str,
-        required=True,
-        help="the auth token to be used with this service",
-    )
-    parser.add_argument("seconds", type=float)
-    parser.add_argument("--threads", dest="threads", type=int, default=1)
 
-    parsedArgs = parser.parse_args(argv[1:])
+@schema.define
+class Counter:
+    k = int
+
+
+@schema.define
+class Item:
+    bucket = Indexed(int)
+    value = int
+    payload = str
+
+
+WORKLOADS = ("small_transactions", "index_reads", "large_subscription", "lazy_loads")
+
+DEFAULT_MIX = "small_transactions=2,index_reads=1,large_subscription=1,lazy_loads=1"
+
+# how many Items a lazy_loads client reads on each connection
+LAZY_READS_PER_CONNECTION = 50
+
+# how many Items we create per transaction while loading
+LOAD_BATCH_SIZE = 10000
+
+
+def parseMix(mix):
+    res = {}
+
+    for term in mix.split(","):
+        name, _, count = term.partition("=")
+
+        if name not in WORKLOADS:
+            raise Exception(f"Unknown workload {name}. Choose from {', '.join(WORKLOADS)}.")
+
+        res[name] = int(count or 1)
+
+    return res
+
+
+def percentiles(samples):
+    """Summarize a list of durations in seconds, in milliseconds."""
+    if not samples:
+        return {"count": 0}
 
-    db = connect(parsedArgs.host, parsedArgs.port, parsedArgs.service_token)
+    samples = sorted(samples)
 
-    schema = Schema("database_throughput_test")
+    def at(fraction):
+        return samples[min(len(samples) - 1, int(fraction * len(samples)))] * 1000.0
 
-    @schema.define
-    class Counter:
-        k = int
+    return {
+        "count": len(samples),
+        "mean_ms": sum(samples) / len(samples) * 1000.0,
+        "p50_ms": at(0.5),
+        "p99_ms": at(0.99),
+        "p999_ms": at(0.999),
+        "max_ms": samples[-1] * 1000.0,
+    }
 
-    db.subscribeToSchema(schema)
 
-    t0 = time.time()
+def loadItems(db, itemCount, buckets, payloadBytes, seed):
+    rng = random.Random(seed)
 
-    transactionCount = []
+    db.subscribeToType(Item)
+
+    with db.view():
+        if Item.lookupAny():
+            return
+
+    for start in range(0, itemCount, LOAD_BATCH_SIZE):
+        with db.transaction():
+            for i in range(start, min(itemCount, start + LOAD_BATCH_SIZE)):
+                Item(
+                    bucket=rng.randrange(buckets),
+                    value=i,
+                    payload="".join(rng.choice("abcdef") for _ in range(payloadBytes)),
+                )
+
+
+def runSmallTransactions(db, config, rng, deadline, metrics):
+    db.subscribeToType(Counter)
 
     def doWork():
         with db.transaction():
             c = Counter()
 
-        while time.time() - t0 < parsedArgs.seconds:
+        latencies = []
+
+        while time.time() < deadline:
+            t0 = time.perf_counter()
+
             with db.transaction():
                 c.k = c.k + 1
 
-        with db.view():
-            transactionCount.append(c.k)
+            latencies.append(time.perf_counter() - t0)
+
+        metrics["commit_latency"].extend(latencies)
 
-    threads = [threading.Thread(target=doWork) for _ in range(parsedArgs.threads)]
+    threads = [threading.Thread(target=doWork) for _ in range(config["threads"])]
     for t in threads:
         t.start()
     for t in threads:
         t.join()
 
-    print(sum(transactionCount) / parsedArgs.seconds, " transactions per second")
+    return len(metrics["commit_latency"])
+
+
+def runIndexReads(db, config, rng, deadline, metrics):
+    t0 = time.perf_counter()
+    db.subscribeToType(Item)
+    metrics["subscription_ready"].append(time.perf_counter() - t0)
+
+    total = 0
+
+    while time.time() < deadline:
+        t0 = time.perf_counter()
+
+        with db.view():
+            for item in Item.lookupAll(bucket=rng.randrange(config["buckets"])):
+                total += item.value
+
+        metrics["index_read_latency"].append(time.perf_counter() - t0)
+
+    return 0
+
+
+def runLargeSubscriptions(host, port, token, config, rng, deadline, metrics):
+    while time.time() < deadline:
+        db = connect(host, port, token)
+
+        try:
+            t0 = time.perf_counter()
+            db.subscribeToType(Item)
+            metrics["subscription_ready"].append(time.perf_counter() - t0)
+        finally:
+            db.disconnect(block=True)
+
+    return 0
+
+
+def runLazyLoads(host, port, token, config, rng, deadline, metrics):
+    while time.time() < deadline:
+        db = connect(host, port, token)
+
+        try:
+            t0 = time.perf_counter()
+            db.subscribeToType(Item, lazySubscription=True)
+            metrics["lazy_subscription_ready"].append(time.perf_counter() - t0)
+
+            with db.view():
+                items = list(Item.lookupAll(bucket=rng.randrange(config["buckets"])))
+
+            rng.shuffle(items)
+
+            for item in items[:LAZY_READS_PER_CONNECTION]:
+                if time.time() >= deadline:
+                    break
+
+                t0 = time.perf_counter()
+
+                with db.view():
+                    item.value
+
+                metrics["lazy_load_latency"].append(time.perf_counter() - t0)
+        finally:
+            db.disconnect(block=True)
+
+    return 0
+
+
+def clientMain(host, port, token, workload, clientIx, config, ready, go, results):
+    """Run 'workload' in a client process, and put its samples on 'results'."""
+    rng = random.Random(config["seed"] * 1000 + clientIx)
+    metrics = {
+        name: []
+        for name in (
+            "commit_latency",
+            "index_read_latency",
+            "subscription_ready",
+            "lazy_subscription_ready",
+            "lazy_load_latency",
+        )
+    }
+
+    db = connect(host, port, token)
+
+    ready.put(clientIx)
+    go.wait()
+
+    deadline = time.time() + config["seconds"]
+
+    if workload == "small_transactions":
+        transactions = runSmallTransactions(db, config, rng, deadline, metrics)
+    elif workload == "index_reads":
+        transactions = runIndexReads(db, config, rng, deadline, metrics)
+    elif workload == "large_subscription":
+        transactions = runLargeSubscriptions(host, port, token, config, rng, deadline, metrics)
+    else:
+        transactions = runLazyLoads(host, port, token, config, rng, deadline, metrics)
+
+    db.disconnect(block=True)
+
+    results.put((workload, transactions, metrics))
+
+
+def main(argv):
+    parser = argparse.ArgumentParser("Run a database load test")
+
+    parser.add_argument(
+        "--server",
+        default=None,
+        help="host:port of a running server. By default we start one in this process.",
+    )
+    parser.add_argument(
+        "--service-token",
+        type=str,
+        default=None,
+        help="the auth token to be used with --server",
+    )
+    parser.add_argument("--seconds", type=float, default=10.0)
+    parser.add_argument("--mix", default=DEFAULT_MIX, help="workload=processes,...")
+    parser.add_argument(
+        "--threads",
+        type=int,
+        default=1,
+        help="threads in each small_transactions process",
+    )
+    parser.add_argument("--items", type=int, default=100000)
+    parser.add_argument("--buckets", type=int, default=1000)
+    parser.add_argument("--payload-bytes", type=int, default=100)
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--output", default=None, help="also write the results here")
+
+    parsedArgs = parser.parse_args(argv[1:])
+
+    mix = parseMix(parsedArgs.mix)
+
+    config = dict(
+        seconds=parsedArgs.seconds,
+        threads=parsedArgs.threads,
+        items=parsedArgs.items,
+        buckets=parsedArgs.buckets,
+        payloadBytes=parsedArgs.payload_bytes,
+        seed=parsedArgs.seed,
+        mix=mix,
+    )
+
+    server = None
+
+    if parsedArgs.server is None:
+        host, port = "localhost", 0
+        token = genToken()
+
+        server = TcpServer(
+            host,
+            port,
+            InMemoryPersistence(),
+            ssl_context=sslContextFromCertPathOrNone(None),
+            auth_token=token,
+        )
+        server.start()
+
+        port = server.bus.listeningEndpoint.port
+    else:
+        host, port = parsedArgs.server.rsplit(":", 1)
+        port = int(port)
+        token = parsedArgs.service_token
+
+    try:
+        db = connect(host, port, token)
+
+        t0 = time.time()
+        loadItems(
+            db, config["items"], config["buckets"], config["payloadBytes"], config["seed"]
+        )
+        loadSeconds = time.time() - t0
+
+        db.disconnect(block=True)
+
+        # spawn rather than fork, since we have a server's threads running
+        context = multiprocessing.get_context("spawn")
+        ready = context.Queue()
+        results = context.Queue()
+        go = context.Event()
+
+        clients = []
+        for workload in WORKLOADS:
+            for _ in range(mix.get(workload, 0)):
+                clients.append(
+                    context.Process(
+                        target=clientMain,
+                        args=(
+                            host,
+                            port,
+                            token,
+                            workload,
+                            len(clients),
+                            config,
+                            ready,
+                            go,
+                            results,
+                        ),
+                        daemon=True,
+                    )
+                )
+
+        for c in clients:
+            c.start()
+
+        for _ in clients:
+            ready.get()
+
+        cpu0 = time.process_time()
+        wall0 = time.time()
+        go.set()
+
+        transactions = 0
+        metrics = {}
+        for _ in clients:
+            workload, clientTransactions, clientMetrics = results.get()
+            transactions += clientTransactions
+
+            for name, samples in clientMetrics.items():
+                metrics.setdefault(name, []).extend(samples)
+
+        wallSeconds = time.time() - wall0
+        cpuSeconds = time.process_time() - cpu0
+
+        for c in clients:
+            c.join()
+    finally:
+        if server is not None:
+            server.stop()
+
+    output = dict(
+        config=config,
+        load_seconds=loadSeconds,
+        wall_seconds=wallSeconds,
+        transactions=transactions,
+        transactions_per_second=transactions / wallSeconds,
+        metrics={name: percentiles(samples) for name, samples in sorted(metrics.items())},
+    )
+
+    if server is not None:
+        output["server_cpu_seconds"] = cpuSeconds
+        output["server_cpu_us_per_transaction"] = (
+            cpuSeconds / transactions * 1e6 if transactions else None
+        )
+
+    text = json.dumps(output, indent=4)
+
+    print(text)
+
+    if parsedArgs.output:
+        with open(parsedArgs.output, "w") as f:
+            f.write(text)
 
     return 0
 
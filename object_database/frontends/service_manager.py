@@ -40,6 +40,7 @@ from object_database import (
     connect,
     RedisPersistence,
     InMemoryPersistence,
+    LogStructuredPersistence,
     DisconnectedException,
 )
 from object_database.service_manager.SubprocessServiceManager import SubprocessServiceManager
@@ -219,6 +220,16 @@ def processHostnameArg(hostname):
     return hostname
 
 
+def makePersistence(parsedArgs):
+    if parsedArgs.persistence_path is not None:
+        return LogStructuredPersistence(parsedArgs.persistence_path)
+
+    if parsedArgs.redis_port is not None:
+        return RedisPersistence(port=parsedArgs.redis_port)
+
+    return InMemoryPersistence()
+
+
 def main(argv=None):
     if argv is None:
         # this is a needed pathway for the 'console_scripts' in setup.py
@@ -267,6 +278,12 @@ def main(argv=None):
         help="path to (self-signed) SSL certificate",
     )
     parser.add_argument("--redis_port", type=int, default=None, required=False)
+    parser.add_argument(
+        "--persistence-path",
+        default=None,
+        required=False,
+        help="keep the database in a log-structured file here, rather than in redis",
+    )
     parser.add_argument("--fd-limit", type=int, default=4096, required=False)
 
     parser.add_argument("--max_gb_ram", type=float, default=None, required=False)
@@ -326,7 +343,9 @@ def main(argv=None):
 
     parsedArgs = parser.parse_args(argv[1:])
 
-    if parsedArgs.redis_port is not None and not parsedArgs.run_db:
+    if (
+        parsedArgs.redis_port is not None or parsedArgs.persistence_path is not None
+    ) and not parsedArgs.run_db:
         sys.stderr.write("error: please add --run_db if you want to run a database\n")
         parser.print_help()
         return 2
@@ -370,9 +389,7 @@ def main(argv=None):
             databaseServer = TcpServer(
                 ownHostname,
                 parsedArgs.port,
-                RedisPersistence(port=parsedArgs.redis_port)
-                if parsedArgs.redis_port is not None
-                else InMemoryPersistence(),
+                makePersistence(parsedArgs),
                 ssl_context=ssl_ctx,
                 auth_token=parsedArgs.service_token,
             )
@@ -1,4 +1,4 @@
-from object_database.server import Server
+from object_database.server import Server, DEFAULT_FIELD_WRITE_LOG_CAPACITY
 from object_database.database_connection import DatabaseConnection
 from object_database.messages import ClientToServer, ServerToClient, getHeartbeatInterval
 from object_database.persistence import InMemoryPersistence
@@ -128,8 +128,18 @@ class InMemoryChannel(ClientToServerChannel, ServerToClientChannel):
 
 
 class InMemServer(Server):
-    def __init__(self, kvstore=None, auth_token=""):
-        Server.__init__(self, kvstore or InMemoryPersistence(), auth_token)
+    def __init__(
+        self,
+        kvstore=None,
+        auth_token="",
+        fieldWriteLogCapacity=DEFAULT_FIELD_WRITE_LOG_CAPACITY,
+    ):
+        Server.__init__(
+            self,
+            kvstore or InMemoryPersistence(),
+            auth_token,
+            fieldWriteLogCapacity=fieldWriteLogCapacity,
+        )
         self.channels = []
         self.stopped = threading.Event()
         self.checkForDeadConnectionsLoopThread = threading.Thread(
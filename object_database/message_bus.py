@@ -26,6 +26,7 @@ import struct
 import logging
 import os
 import socket
+import zlib
 import sortedcontainers
 
 from typed_python import Alternative, NamedTuple, TypeFunction, serialize, deserialize
@@ -35,6 +36,12 @@ from object_database.bytecount_limited_queue import BytecountLimitedQueue
 from object_database.socket_watcher import SocketWatcher
 
 MESSAGE_LEN_BYTES = 4  # sizeof an int32 used to pack messages
+
+# set in a message-length prefix if the message is compressed. A compressed message is
+# the length of the original message followed by a zlib stream of it. A compressed
+# message with no body says the sender can read compressed messages. This matches
+# FrameCompression.hpp.
+COMPRESSED_FLAG = 0x80000000
 EPOLL_TIMEOUT = 5.0
 MSG_BUF_SIZE = 128 * 1024
 
@@ -47,6 +54,10 @@ class CorruptMessageStream(Exception):
     pass
 
 
+class CompressionHello:
+    """Schedule this for write to tell the other side we can read compressed messages."""
+
+
 class MessageBuffer:
     def __init__(self, extraMessageSizeCheck: bool):
         """ The buffer we're reading
@@ -64,20 +75,80 @@ class MessageBuffer:
         # the current message length, if any.
         self.curMessageLen = None
 
+        # the current message's length prefix, including COMPRESSED_FLAG
+        self.curMessageHeader = None
+
+        # whether the other side has told us it can read compressed messages
+        self.peerAcceptsCompression = False
+
+        # whether we've told the other side that we can
+        self.sentCompressionHello = False
+
+        # how much compression saved the other side, in bytes
+        self.bytesBeforeDecompression = 0
+        self.bytesAfterDecompression = 0
+
     def pendingBytecount(self):
         return len(self.buffer)
 
     @staticmethod
-    def encode(bytes, extraMessageSizeCheck: bool):
-        """Prepend a message-length prefix"""
-        res = bytearray(struct.pack("i", len(bytes)))
+    def encode(bytes, extraMessageSizeCheck: bool, isCompressed=False):
+        """Prepend a message-length prefix
+
+        Args:
+            isCompressed (bool): if True, 'bytes' is the output of 'compress'.
+        """
+        header = struct.pack("I", len(bytes) | (COMPRESSED_FLAG if isCompressed else 0))
+
+        res = bytearray(header)
         res.extend(bytes)
 
         if extraMessageSizeCheck:
-            res.extend(struct.pack("i", len(bytes)))
+            res.extend(header)
 
         return res
 
+    @staticmethod
+    def compress(bytes):
+        """Return the body of a compressed message holding 'bytes'.
+
+        Returns:
+            None if compressing doesn't make it any smaller.
+        """
+        res = struct.pack("I", len(bytes)) + zlib.compress(bytes)
+
+        if len(res) >= len(bytes):
+            return None
+
+        return res
+
+    def _completeMessage(self, body, messages):
+        if self.curMessageHeader & COMPRESSED_FLAG:
+            if not body:
+                self.peerAcceptsCompression = True
+                return
+
+            if len(body) < MESSAGE_LEN_BYTES:
+                raise CorruptMessageStream("Compressed message is too short")
+
+            originalLen = struct.unpack("I", body[:MESSAGE_LEN_BYTES])[0]
+
+            try:
+                decompressed = zlib.decompress(body[MESSAGE_LEN_BYTES:])
+            except zlib.error as e:
+                raise CorruptMessageStream(f"Failed to decompress a message: {e}")
+
+            if len(decompressed) != originalLen:
+                raise CorruptMessageStream(f"{len(decompressed)} != {originalLen}")
+
+            self.bytesBeforeDecompression += len(body)
+            self.bytesAfterDecompression += len(decompressed)
+
+            body = decompressed
+
+        messages.append(body)
+        self.messagesEver += 1
+
     def write(self, bytesToWrite):
         """Push bytes into the buffer and read any completed messages.
 
@@ -94,7 +165,8 @@ class MessageBuffer:
         while True:
             if self.curMessageLen is None:
                 if len(self.buffer) >= MESSAGE_LEN_BYTES:
-                    self.curMessageLen = struct.unpack("i", self.buffer[:MESSAGE_LEN_BYTES])[0]
+                    self.curMessageHeader = struct.unpack("I", self.buffer[:MESSAGE_LEN_BYTES])[0]
+                    self.curMessageLen = self.curMessageHeader & ~COMPRESSED_FLAG
                     self.buffer[:MESSAGE_LEN_BYTES] = b""
 
             if self.curMessageLen is None:
@@ -102,24 +174,23 @@ class MessageBuffer:
 
             if self.extraMessageSizeCheck:
                 if len(self.buffer) >= self.curMessageLen + MESSAGE_LEN_BYTES:
-                    messages.append(bytes(self.buffer[: self.curMessageLen]))
-                    self.messagesEver += 1
                     msgLen = self.curMessageLen
                     sizeCheckBytes = self.buffer[msgLen : msgLen + MESSAGE_LEN_BYTES]
-                    sizeCheck = struct.unpack("i", sizeCheckBytes)[0]
+                    sizeCheck = struct.unpack("I", sizeCheckBytes)[0]
+
+                    if sizeCheck != self.curMessageHeader:
+                        raise CorruptMessageStream(f"{sizeCheck} != {self.curMessageHeader}")
+
+                    self._completeMessage(bytes(self.buffer[:msgLen]), messages)
 
                     self.buffer[: msgLen + MESSAGE_LEN_BYTES] = b""
                     self.curMessageLen = None
 
-                    if sizeCheck != msgLen:
-                        raise CorruptMessageStream(f"{sizeCheck} != {msgLen}")
-
                 else:
                     return messages
             else:
                 if len(self.buffer) >= self.curMessageLen:
-                    messages.append(bytes(self.buffer[: self.curMessageLen]))
-                    self.messagesEver += 1
+                    self._completeMessage(bytes(self.buffer[: self.curMessageLen]), messages)
                     self.buffer[: self.curMessageLen] = b""
                     self.curMessageLen = None
                 else:
@@ -185,6 +256,7 @@ class MessageBus(object):
         wantsSSL=True,
         sslContext=None,
         extraMessageSizeCheck=True,
+        compressionThreshold=None,
     ):
         """Initialize a MessageBus
 
@@ -210,6 +282,9 @@ class MessageBus(object):
             certPath(str or None): if we use SSL, an optional path to a cert file.
             wantsSSL(bool): should we encrypt our channel with SSL
             sslContext - an SSL context if we've already got one
+            compressionThreshold (int or None): if not None, offer to exchange compressed
+                messages with the other side of each connection, and compress messages
+                at least this many bytes long to any connection that accepts.
 
         The MessageBus listens for connection on the endpoint and calls
         onEvent from the read thread whenever a new event occurs.
@@ -256,6 +331,11 @@ class MessageBus(object):
         self.started = False
         self._acceptSocket = None
         self.extraMessageSizeCheck = extraMessageSizeCheck
+        self.compressionThreshold = compressionThreshold
+
+        # how much compressing the messages we send has saved us, in bytes
+        self.totalBytesBeforeCompression = 0
+        self.totalBytesAfterCompression = 0
 
         self._connIdToIncomingSocket = {}  # connectionId -> socket
         self._connIdToOutgoingSocket = {}  # connectionId -> socket
@@ -628,7 +708,10 @@ class MessageBus(object):
 
             return
 
-        msgBytes = MessageBuffer.encode(msg, self.extraMessageSizeCheck)
+        if msg is CompressionHello:
+            msgBytes = MessageBuffer.encode(b"", self.extraMessageSizeCheck, isCompressed=True)
+        else:
+            msgBytes = self._encodeMaybeCompressed(sslSock, msg)
 
         with self._lock:
             self.totalBytesPendingInOutputLoop += len(msgBytes)
@@ -638,6 +721,32 @@ class MessageBus(object):
             else:
                 self._socketToBytesNeedingWrite[sslSock].extend(msgBytes)
 
+    def _encodeMaybeCompressed(self, sslSock, msg):
+        """Encode 'msg' for 'sslSock', compressing it if it's big and the other side allows.
+
+        Accessed by: socketThread and eventThread
+        """
+        messageBuffer = self._incomingSocketBuffers.get(sslSock)
+
+        if (
+            self.compressionThreshold is not None
+            and len(msg) >= self.compressionThreshold
+            and messageBuffer is not None
+            and messageBuffer.peerAcceptsCompression
+        ):
+            compressed = MessageBuffer.compress(msg)
+
+            if compressed is not None:
+                with self._lock:
+                    self.totalBytesBeforeCompression += len(msg)
+                    self.totalBytesAfterCompression += len(compressed)
+
+                return MessageBuffer.encode(
+                    compressed, self.extraMessageSizeCheck, isCompressed=True
+                )
+
+        return MessageBuffer.encode(msg, self.extraMessageSizeCheck)
+
     def _handleReadReadySocket(self, socketWithData):
         """ Our select loop indicated 'socketWithData' has data pending.
 
@@ -723,6 +832,17 @@ class MessageBus(object):
                     self.totalBytesPendingInInputLoopHighWatermark,
                 )
 
+                if (
+                    messageBuffer.peerAcceptsCompression
+                    and not messageBuffer.sentCompressionHello
+                    and self.compressionThreshold is not None
+                ):
+                    # tell the other side we can read what it sends us too
+                    messageBuffer.sentCompressionHello = True
+                    connId = self._getConnectionIdFromSocket(socketWithData)
+                    if connId is not None:
+                        self._scheduleBytesForWrite(connId, CompressionHello)
+
                 for m in newMessages:
                     if not self._handleIncomingMessage(m, socketWithData):
                         self._markSocketClosed(socketWithData)
@@ -877,6 +997,9 @@ class MessageBus(object):
             if self._authToken is not None:
                 self._scheduleBytesForWrite(connId, self._authToken.encode("utf8"))
 
+            if self.compressionThreshold is not None:
+                self._scheduleBytesForWrite(connId, CompressionHello)
+
             # we're supposed to connect to this worker. We have to do
             # this in a background.
             self.scheduleCallback(lambda: self._connectTo(connId))
@@ -1112,6 +1235,11 @@ class MessageBus(object):
                 self._connIdToOutgoingSocket[connId] = sock
                 self._incomingSocketBuffers[sock] = MessageBuffer(self.extraMessageSizeCheck)
 
+                # we prescheduled a CompressionHello when we got TriggerConnect
+                self._incomingSocketBuffers[sock].sentCompressionHello = (
+                    self.compressionThreshold is not None
+                )
+
                 if connId in self._messagesForUnconnectedOutgoingConnection:
                     messages = self._messagesForUnconnectedOutgoingConnection.pop(connId)
 
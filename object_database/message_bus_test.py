@@ -24,7 +24,7 @@ import time
 import unittest
 
 from flaky import flaky
-from object_database.message_bus import MessageBus
+from object_database.message_bus import MessageBus, MessageBuffer, CorruptMessageStream
 from object_database.bytecount_limited_queue import BytecountLimitedQueue
 
 
@@ -582,3 +582,91 @@ class TestMessageBus(unittest.TestCase):
         msg = self.messageQueue2.get()
         assert msg.matches.IncomingMessage
         assert msg.message == "asdf"
+
+
+class TestMessageBufferCompression(unittest.TestCase):
+    def test_compressed_messages_roundtrip(self):
+        for extraMessageSizeCheck in [False, True]:
+            msg = b"0123456789" * 10000
+            compressed = MessageBuffer.compress(msg)
+
+            self.assertTrue(compressed is not None and len(compressed) < len(msg))
+
+            stream = bytearray()
+            stream.extend(
+                MessageBuffer.encode(compressed, extraMessageSizeCheck, isCompressed=True)
+            )
+            stream.extend(MessageBuffer.encode(b"plain", extraMessageSizeCheck))
+
+            buffer = MessageBuffer(extraMessageSizeCheck)
+
+            # feed it in small pieces so that we see every partial state
+            received = []
+            for i in range(0, len(stream), 7):
+                received.extend(buffer.write(bytes(stream[i : i + 7])))
+
+            self.assertEqual(received, [msg, b"plain"])
+            self.assertEqual(buffer.bytesAfterDecompression, len(msg))
+
+    def test_incompressible_messages_are_left_alone(self):
+        self.assertIsNone(MessageBuffer.compress(os.urandom(1000)))
+
+    def test_hello_is_not_a_message(self):
+        buffer = MessageBuffer(False)
+
+        self.assertFalse(buffer.peerAcceptsCompression)
+        self.assertEqual(buffer.write(MessageBuffer.encode(b"", False, isCompressed=True)), [])
+        self.assertTrue(buffer.peerAcceptsCompression)
+
+    def test_corrupt_compressed_message(self):
+        buffer = MessageBuffer(False)
+
+        with self.assertRaises(CorruptMessageStream):
+            buffer.write(MessageBuffer.encode(b"\x10\0\0\0garbage", False, isCompressed=True))
+
+    def test_buses_compress_large_messages(self):
+        def makeBus(name, port, messageQueue):
+            return MessageBus(
+                name,
+                ("localhost", port),
+                str,
+                str,
+                messageQueue.put,
+                "auth_token",
+                None,
+                "testcert.cert",
+                compressionThreshold=1024,
+            )
+
+        queue1 = queue.Queue()
+        queue2 = queue.Queue()
+        bus1 = makeBus("bus1", 8000, queue1)
+        bus2 = makeBus("bus2", 8001, queue2)
+
+        bus1.start()
+        bus2.start()
+
+        try:
+            connId = bus1.connect(bus2.listeningEndpoint)
+
+            assert queue2.get(timeout=TIMEOUT).matches.NewIncomingConnection
+
+            bigMessage = "hi there " * 100000
+            bus1.sendMessage(connId, bigMessage)
+
+            msg = queue2.get(timeout=TIMEOUT)
+            assert msg.matches.IncomingMessage
+            assert msg.message == bigMessage
+
+            # bus2 said hello back, so its replies get compressed too
+            bus2.sendMessage(msg.connectionId, bigMessage)
+
+            assert queue1.get(timeout=TIMEOUT).matches.OutgoingConnectionEstablished
+            reply = queue1.get(timeout=TIMEOUT)
+            assert reply.matches.IncomingMessage
+            assert reply.message == bigMessage
+
+            assert bus2.totalBytesAfterCompression < bus2.totalBytesBeforeCompression / 10
+        finally:
+            bus1.stop(timeout=TIMEOUT)
+            bus2.stop(timeout=TIMEOUT)
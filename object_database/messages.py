@@ -146,6 +146,29 @@ ClientToServer = Alternative(
     # indicate that we may be getting new objects for this type
     # even if we have not subscribed to any indices.
     SubscribeNone={"schema": str, "typename": str},
+    # more of what a transaction read, for transactions that would rather not list
+    # every key in 'key_versions'. 'key_ranges' maps a field id to a flat list of
+    # [start, stop) ranges of the object ids we read it from. 'field_versions' lists
+    # fields we read as a whole: any write to them since 'as_of_version' is a conflict.
+    # 'index_field_versions' lists indices we looked up a range of values of: any
+    # change to which objects have which values of them is a conflict.
+    # like TransactionData, this can come in chunks.
+    TransactionReads={
+        "key_ranges": ConstDict(int, TupleOf(ObjectId)),
+        "field_versions": TupleOf(int),
+        "index_field_versions": TupleOf(int),
+        "transaction_guid": int,
+    },
+    # like LoadLazyObject, but for several objects of the same type at once. The
+    # server responds with a single LazyLoadManyResponse.
+    LoadLazyObjects={"schema": str, "typename": str, "identities": TupleOf(ObjectId)},
+    # like subscribing to an entire type, for a client that restored a copy of it saved
+    # at 'since_tid' by a connection to the server process named 'epoch'. The server
+    # sends only the objects written since then, or a ResumeRefused followed by the
+    # entire type if it can't tell which those are.
+    ResumeSubscription={"schema": str, "typename": str, "since_tid": int, "epoch": str},
+    # ask the server for its epoch. The server responds with an EpochResponse.
+    RequestEpoch={"guid": int},
     __str__=MessageToStr,
 )
 
@@ -222,5 +245,16 @@ ServerToClient = Alternative(
     },
     # respond with a dependent connection id.
     DependentConnectionId={"guid": str, "connIdentity": ObjectId, "identity_root": int},
+    # sent in response to LoadLazyObjects, with the values of all of the objects.
+    LazyLoadManyResponse={
+        "identities": TupleOf(ObjectId),
+        "values": ConstDict(ObjectFieldId, OneOf(None, bytes)),
+    },
+    # respond to a RequestEpoch. 'epoch' names this server process: transaction ids
+    # are only comparable between connections to the same one. It's empty if
+    # the server can't resume subscriptions.
+    EpochResponse={"guid": int, "epoch": str},
+    # the server can't bring a restored type up to date, and is sending all of it.
+    ResumeRefused={"schema": str, "typename": str},
     __str__=MessageToStr,
 )
@@ -14,14 +14,39 @@
 
 
 class Indexed:
-    def __init__(self, obj):
+    def __init__(self, obj, ordered=False):
         assert isinstance(obj, type)
         self.obj = obj
+        self.ordered = ordered
 
 
 class Index:
-    def __init__(self, *names):
+    def __init__(self, *names, ordered=False):
         self.names = names
+        self.ordered = ordered
 
     def __call__(self, instance):
         return tuple(getattr(instance, x) for x in self.names)
+
+
+class IndexRange:
+    """A range of values to look up in an ordered index.
+
+    Pass one in place of a value, as in `T.lookupAll(timestamp=IndexRange(lo=t0))`.
+    Either bound may be None, meaning unbounded. By default the range is
+    half-open, like python's `range`.
+    """
+
+    def __init__(self, lo=None, hi=None, includeLo=True, includeHi=False):
+        self.lo = lo
+        self.hi = hi
+        self.includeLo = includeLo
+        self.includeHi = includeHi
+
+    def __repr__(self):
+        return "IndexRange(lo=%r, hi=%r, includeLo=%r, includeHi=%r)" % (
+            self.lo,
+            self.hi,
+            self.includeLo,
+            self.includeHi,
+        )
@@ -17,6 +17,7 @@ import time
 import threading
 import logging
 
+import object_database._types as _types
 from object_database.schema import ObjectFieldId, IndexId, FieldId, IndexValue
 from typed_python import serialize, deserialize, OneOf
 
@@ -308,3 +309,74 @@ class RedisPersistence(object):
             if key in self.cache:
                 del self.cache[key]
             self.redis.delete(serialize(KeyType, key))
+
+
+class LogStructuredPersistence(object):
+    """Keeps the database in a log-structured file at 'path', using a native store.
+
+    This has the same interface as RedisPersistence, but needs no other process.
+    Commits are appended to the file and, if 'sync', synced to disk before
+    'setSeveral' returns. Threads committing at the same time share a sync.
+    Values read when we open the file stay in the file (which we map), which
+    makes opening a large database cheap. The file is compacted, on a background
+    thread, once it's at least 'compactionMinBytes' and more than twice the size
+    of its live data. A 'setSeveral' that fails to write raises, and changes nothing.
+    """
+
+    def __init__(self, path, sync=True, compactionMinBytes=64 * 1024 * 1024):
+        self.path = path
+        self.store = _types.LogStructuredStore(
+            path, sync=sync, compactionMinBytes=compactionMinBytes
+        )
+
+    def get(self, key):
+        """Get the value stored in a value-style key, or None if no key exists."""
+        return self.store.get(serialize(KeyType, key))
+
+    def getSeveralAsDictionary(self, keys):
+        keys = list(keys)
+        return {keys[i]: value for i, value in enumerate(self.getSeveral(keys))}
+
+    def getSeveral(self, keys):
+        """Get the values (or None) stored in several value-style keys."""
+        return self.store.getSeveral([serialize(KeyType, k) for k in keys])
+
+    def getSetMembers(self, key):
+        return set(
+            deserialize(SetValue, k) for k in self.store.getSetMembers(serialize(KeyType, key))
+        )
+
+    def setSeveral(self, kvs, setAdds=None, setRemoves=None):
+        def serializeSets(sets):
+            return {
+                serialize(KeyType, key): [serialize(SetValue, v) for v in values]
+                for key, values in (sets or {}).items()
+            }
+
+        new_sets, dropped_sets = self.store.setSeveral(
+            {serialize(KeyType, key): value for key, value in kvs.items()},
+            serializeSets(setAdds),
+            serializeSets(setRemoves),
+        )
+
+        return (
+            set(deserialize(KeyType, k) for k in new_sets),
+            set(deserialize(KeyType, k) for k in dropped_sets),
+        )
+
+    def set(self, key, value):
+        self.setSeveral({key: value})
+
+    def exists(self, key):
+        return self.store.exists(serialize(KeyType, key))
+
+    def delete(self, key):
+        self.setSeveral({key: None})
+
+    def compact(self):
+        """Rewrite the file with only what's live in it."""
+        self.store.compact()
+
+    def stats(self):
+        """Return a dict of logBytes, liveBytes, valueKeys, and setKeys."""
+        return self.store.stats()
@@ -682,6 +682,14 @@ class SubscriptionState:
             )
         )
 
+    def lazyLoadObjects(self, channel, schema, typename, identities):
+        channel.write(
+            ServerToClient.LazyLoadManyResponse(
+                identities=identities,
+                values=self.objectValuesForOids(schema, typename, list(identities)),
+            )
+        )
+
 
 class ProxyServer:
     def __init__(self, upstreamChannel: ClientToServerChannel, authToken):
@@ -943,6 +951,27 @@ class ProxyServer:
             self._subscriptionState.addSubscription(channel, subscription)
             return
 
+        if msg.matches.RequestEpoch:
+            # our clients' subscriptions come out of our own state, which we can't
+            # diff against an old transaction, so we never resume them.
+            channel.sendMessage(ServerToClient.EpochResponse(guid=msg.guid, epoch=""))
+            return
+
+        if msg.matches.ResumeSubscription:
+            channel.sendMessage(
+                ServerToClient.ResumeRefused(schema=msg.schema, typename=msg.typename)
+            )
+            self.handleClientToServerMessage(
+                channel,
+                ClientToServer.Subscribe(
+                    schema=msg.schema,
+                    typename=msg.typename,
+                    fieldname_and_value=None,
+                    isLazy=False,
+                ),
+            )
+            return
+
         if msg.matches.Flush:
             self._flushGuidIx += 1
             guid = self._flushGuidIx
@@ -966,6 +995,20 @@ class ProxyServer:
             )
             return
 
+        if msg.matches.LoadLazyObjects:
+            if (
+                makeNamedTuple(schema=msg.schema, typename=msg.typename)
+                not in self._subscriptionState.completedTypes
+            ):
+                logging.error("Client tried to lazy load for a type we're not subscribed to")
+                self.dropConnection(channel)
+                return
+
+            self._subscriptionState.lazyLoadObjects(
+                channel, msg.schema, msg.typename, msg.identities
+            )
+            return
+
         if msg.matches.TransactionData:
             if channel in self._subscriptionState.channelToPendingSubscriptions:
                 assert self._subscriptionState.channelToPendingSubscriptions[channel]
@@ -974,24 +1017,7 @@ class ProxyServer:
                 ).append(msg)
                 return
 
-            if (
-                channel,
-                msg.transaction_guid,
-            ) in self._channelAndTransactionGuidToOutgoingTransactionGuid:
-                guid = self._channelAndTransactionGuidToOutgoingTransactionGuid[
-                    channel, msg.transaction_guid
-                ]
-            else:
-                self._transactionGuidIx += 1
-                guid = self._transactionGuidIx
-
-                self._outgoingTransactionGuidToChannelAndTransactionGuid[guid] = (
-                    channel,
-                    msg.transaction_guid,
-                )
-                self._channelAndTransactionGuidToOutgoingTransactionGuid[
-                    channel, msg.transaction_guid
-                ] = guid
+            guid = self._outgoingTransactionGuid(channel, msg.transaction_guid)
 
             self._subscriptionState.increaseSubscriptionIfNecessary(
                 channel, msg.set_adds, self._transactionNum
@@ -1009,6 +1035,26 @@ class ProxyServer:
             )
             return
 
+        if msg.matches.TransactionReads:
+            if channel in self._subscriptionState.channelToPendingSubscriptions:
+                assert self._subscriptionState.channelToPendingSubscriptions[channel]
+                self._subscriptionState.channelToPendingTransactions.setdefault(
+                    channel
+                ).append(msg)
+                return
+
+            self._channelToMainServer.sendMessage(
+                ClientToServer.TransactionReads(
+                    key_ranges=msg.key_ranges,
+                    field_versions=msg.field_versions,
+                    index_field_versions=msg.index_field_versions,
+                    transaction_guid=self._outgoingTransactionGuid(
+                        channel, msg.transaction_guid
+                    ),
+                )
+            )
+            return
+
         if msg.matches.CompleteTransaction:
             if channel in self._subscriptionState.channelToPendingSubscriptions:
                 assert self._subscriptionState.channelToPendingSubscriptions[channel]
@@ -1044,6 +1090,21 @@ class ProxyServer:
 
         raise Exception("Don't know how to handle ", msg)
 
+    def _outgoingTransactionGuid(self, channel, transaction_guid):
+        """The guid we use on the main server for 'channel's transaction 'transaction_guid'."""
+        key = (channel, transaction_guid)
+
+        if key in self._channelAndTransactionGuidToOutgoingTransactionGuid:
+            return self._channelAndTransactionGuidToOutgoingTransactionGuid[key]
+
+        self._transactionGuidIx += 1
+        guid = self._transactionGuidIx
+
+        self._outgoingTransactionGuidToChannelAndTransactionGuid[guid] = key
+        self._channelAndTransactionGuidToOutgoingTransactionGuid[key] = guid
+
+        return guid
+
     def handleServerToClientMessage(self, msg: ServerToClient):
         with self._lock:
             if msg.matches.Initialize:
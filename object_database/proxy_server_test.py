@@ -15,13 +15,14 @@
 import pytest
 import unittest
 import os
+import tempfile
 
 from object_database.util import configureLogging, genToken
 from object_database.messages import setHeartbeatInterval, getHeartbeatInterval
 from object_database.persistence import InMemoryPersistence
 from object_database.inmem_proxy_server import InMemProxyServer
 from object_database.inmem_server import InMemServer
-from object_database.database_test import Counter, ObjectDatabaseTests
+from object_database.database_test import Counter, ObjectDatabaseTests, schema
 
 
 class ExecuteOdbTestsOnProxyServer(unittest.TestCase, ObjectDatabaseTests):
@@ -99,6 +100,25 @@ class ExecuteOdbTestsOnProxyServer(unittest.TestCase, ObjectDatabaseTests):
     def test_max_tid(self):
         pass
 
+    def test_restore_state_through_proxy(self):
+        db = self.createNewDb()
+        db.subscribeToSchema(schema)
+
+        with db.transaction():
+            c = Counter(k=1, x=2)
+
+        with tempfile.TemporaryDirectory() as tempDir:
+            path = os.path.join(tempDir, "state")
+            db.saveState(path)
+
+            # proxies can't resume subscriptions, so we download everything again
+            db2 = self.createNewDb()
+            self.assertFalse(db2.restoreState(path))
+            db2.subscribeToSchema(schema)
+
+            with db2.view():
+                self.assertEqual(c.x, 2)
+
 
 class ExecuteOdbTestsOnSingleProxyServer(ExecuteOdbTestsOnProxyServer):
     USE_SINGLE_PROXY = True
@@ -207,7 +207,7 @@ class Schema:
                 self._field_types[typename][name] = val
             elif isinstance(val, Indexed):
                 t.addField(name, val.obj)
-                t.addIndex(name, (name,))
+                t.addIndex(name, (name,), ordered=val.ordered)
                 self._field_types[typename][name] = val.obj
                 self._indices[typename][name] = (name,)
                 self._index_types[typename][name] = val.obj
@@ -223,7 +223,7 @@ class Schema:
 
         for name, val in classMembers.items():
             if isinstance(val, Index):
-                t.addIndex(name, tuple(val.names))
+                t.addIndex(name, tuple(val.names), ordered=val.ordered)
                 assert len(val.names)
 
                 self._indices[typename][name] = tuple(val.names)
@@ -18,6 +18,7 @@ from object_database.schema import FieldDefinition, ObjectFieldId, IndexId, inde
 from object_database.core_schema import core_schema
 from object_database.messages import SchemaDefinition
 from object_database.util import Timer
+from object_database._types import ServerTransactionRouter
 from typed_python import (
     serialize,
     deserialize,
@@ -29,13 +30,25 @@ from typed_python import (
     NamedTuple,
 )
 from typed_python.SerializationContext import SerializationContext
+import array
+import bisect
 import queue
 import time
+import uuid
 import logging
 import threading
 
 DEFAULT_GC_INTERVAL = 900.0
 
+# the most writes, across all fields, FieldWriteLog remembers by default
+DEFAULT_FIELD_WRITE_LOG_CAPACITY = 100000
+
+# the most range ends, and the widest range, in one field's TransactionReads key
+# ranges that we'll check object by object. A transaction that read more than that
+# conflicts with any write to the field after its snapshot.
+MAX_KEY_RANGE_INTS = 100000
+MAX_KEY_RANGE_LENGTH = 2 ** 32
+
 
 defaultSerializationContext = SerializationContext().withoutCompression()
 
@@ -43,6 +56,109 @@ defaultSerializationContext = SerializationContext().withoutCompression()
 ObjectBase = NamedTuple(_identity=int)
 
 
+class FieldWriteLog:
+    """For each field we log, which objects each recent transaction wrote it on, in order.
+
+    This lets us find the writes to a field after some transaction by bisecting,
+    rather than by looking up every key we might care about. We only log the fields
+    somebody has subscribed to (see 'logField'), and hold at most 'capacity' writes
+    across all of them, in arrays of int64. Past that we drop the oldest half, and
+    can't answer for transactions before the ones we dropped.
+    """
+
+    def __init__(self, capacity=DEFAULT_FIELD_WRITE_LOG_CAPACITY):
+        self._capacity = capacity
+
+        # fieldId -> (tids, objIds), parallel arrays in increasing tid order
+        self._writes = {}
+
+        # the tid of every write we hold, in the order we got them
+        self._tids = array.array("q")
+
+        # we know of every write to a logged field after this transaction
+        self._completeSince = -1
+
+        # fieldId -> the transaction we started logging the field after
+        self._loggedSince = {}
+
+    def logField(self, fieldId, tid):
+        """Start logging 'fieldId', if we aren't already. 'tid' is the last transaction."""
+        if fieldId not in self._writes:
+            self._writes[fieldId] = (array.array("q"), array.array("q"))
+            self._loggedSince[fieldId] = tid
+
+    def record(self, fieldId, objId, tid):
+        log = self._writes.get(fieldId)
+
+        if log is None:
+            return
+
+        log[0].append(tid)
+        log[1].append(objId)
+        self._tids.append(tid)
+
+        if len(self._tids) > self._capacity:
+            self._dropOldest()
+
+    def _dropOldest(self):
+        # drop whole transactions, at least half of what we hold
+        cutoff = self._tids[len(self._tids) - self._capacity // 2 - 1]
+
+        del self._tids[: bisect.bisect_right(self._tids, cutoff)]
+
+        for tids, objIds in self._writes.values():
+            toDrop = bisect.bisect_right(tids, cutoff)
+            del tids[:toDrop]
+            del objIds[:toDrop]
+
+        self._completeSince = cutoff
+
+    def writesSince(self, fieldId, tid):
+        """The objects whose 'fieldId' was written after transaction 'tid'.
+
+        Objects written more than once appear more than once. Returns None if we
+        don't log the field, or dropped some of those writes.
+        """
+        if fieldId not in self._writes:
+            return None
+
+        if tid < self._completeSince or tid < self._loggedSince[fieldId]:
+            return None
+
+        tids, objIds = self._writes[fieldId]
+
+        return objIds[bisect.bisect_right(tids, tid) :]
+
+
+def keyRangesProblem(ranges):
+    """Why we can't check the flat list of [start, stop) pairs 'ranges' object by object.
+
+    Returns "invalid" if they aren't sorted, non-empty, non-overlapping pairs, "too big"
+    if there are more of them, or they're wider, than we're willing to check, and None
+    if they're fine. Clients only send ranges they actually read, but we can't rely on it.
+    """
+    if len(ranges) % 2:
+        return "invalid"
+
+    if len(ranges) > MAX_KEY_RANGE_INTS:
+        return "too big"
+
+    lastStop = None
+
+    for i in range(0, len(ranges), 2):
+        start, stop = ranges[i], ranges[i + 1]
+
+        if start >= stop or (lastStop is not None and start < lastStop):
+            return "invalid"
+
+        if stop - start > MAX_KEY_RANGE_LENGTH:
+            return "too big"
+
+        lastStop = stop
+
+    return None
+
+
 class TypeMap(Class, Final):
     fieldDefToId = Member(Dict(FieldDefinition, int))
     fieldIdToDef = Member(Dict(int, FieldDefinition))
@@ -67,18 +183,16 @@ class TypeMap(Class, Final):
 
 
 class ConnectedChannel:
-    def __init__(self, initial_tid, channel, connectionObject, identityRoot):
+    def __init__(self, initial_tid, channel, connectionObject, identityRoot, routerId):
         super(ConnectedChannel, self).__init__()
         self.channel = channel
+        # names us to the Server's ServerTransactionRouter, which tracks what we're
+        # subscribed to
+        self.routerId = routerId
         self.initial_tid = initial_tid
         self.connectionObject = connectionObject
         self.missedHeartbeats = 0
         self.definedSchemas = {}
-        self.subscribedFields = (
-            {}
-        )  # schema, type to the lazy transaction id (or -1 if not lazy)
-        self.subscribedIds = set()  # identities
-        self.subscribedIndexKeys = {}  # full index keys to lazy transaction id
         self.identityRoot = identityRoot
         self.pendingTransactions = {}
         self.dependentConnections = set([connectionObject])
@@ -95,7 +209,6 @@ class ConnectedChannel:
         self.missedHeartbeats = 0
 
     def sendTransaction(self, msg):
-        # we need to cut the transaction down
         self.channel.write(msg)
 
     def sendInitializationMessage(self):
@@ -114,8 +227,7 @@ class ConnectedChannel:
             )
         )
 
-    def handleTransactionData(self, msg):
-        guid = msg.transaction_guid
+    def _pendingTransaction(self, guid):
         if guid not in self.pendingTransactions:
             self.pendingTransactions[guid] = {
                 "writes": {},
@@ -123,24 +235,41 @@ class ConnectedChannel:
                 "set_removes": {},
                 "key_versions": set(),
                 "index_versions": set(),
+                "key_ranges": [],
+                "field_versions": set(),
+                "index_field_versions": set(),
             }
 
-        self.pendingTransactions[guid]["writes"].update({k: msg.writes[k] for k in msg.writes})
-        self.pendingTransactions[guid]["set_adds"].update(
+        return self.pendingTransactions[guid]
+
+    def handleTransactionData(self, msg):
+        pending = self._pendingTransaction(msg.transaction_guid)
+
+        pending["writes"].update({k: msg.writes[k] for k in msg.writes})
+        pending["set_adds"].update(
             {k: set(msg.set_adds[k]) for k in msg.set_adds if msg.set_adds[k]}
         )
-        self.pendingTransactions[guid]["set_removes"].update(
+        pending["set_removes"].update(
             {k: set(msg.set_removes[k]) for k in msg.set_removes if msg.set_removes[k]}
         )
-        self.pendingTransactions[guid]["key_versions"].update(msg.key_versions)
-        self.pendingTransactions[guid]["index_versions"].update(msg.index_versions)
+        pending["key_versions"].update(msg.key_versions)
+        pending["index_versions"].update(msg.index_versions)
+
+    def handleTransactionReads(self, msg):
+        pending = self._pendingTransaction(msg.transaction_guid)
+
+        pending["key_ranges"].extend(msg.key_ranges.items())
+        pending["field_versions"].update(msg.field_versions)
+        pending["index_field_versions"].update(msg.index_field_versions)
 
     def extractTransactionData(self, guid):
         return self.pendingTransactions.pop(guid)
 
 
 class Server:
-    def __init__(self, kvstore, auth_token):
+    def __init__(
+        self, kvstore, auth_token, fieldWriteLogCapacity=DEFAULT_FIELD_WRITE_LOG_CAPACITY
+    ):
         self._kvstore = kvstore
         self._auth_token = auth_token
         self.serializationContext = defaultSerializationContext
@@ -163,14 +292,34 @@ class Server:
         self._version_numbers = {}
         self._version_numbers_timestamps = {}
 
-        # _field_id to set(subscribed channel)
-        self._field_id_to_channel = {}
+        # for each field, the last transaction that wrote to any object's value of it
+        self._field_version_numbers = {}
+
+        # for each field somebody subscribed to, the objects recent transactions
+        # wrote it on, in order
+        self._field_write_log = FieldWriteLog(fieldWriteLogCapacity)
+
+        # for each field, the objects we have a key of it for in '_version_numbers'
+        self._field_object_ids = {}
+
+        # for each index, the last transaction that changed which objects have any value of it
+        self._index_field_version_numbers = {}
+
+        # names this process, so clients can tell whether transaction ids they saved
+        # came from us. See ResumeSubscription.
+        self._epoch = uuid.uuid4().hex
+
+        # the highest transaction whose version numbers we've discarded. We can't
+        # tell what changed since a transaction below this.
+        self._resume_horizon = 0
 
-        # index-stringname to set(subscribed channel)
-        self._index_to_channel = Dict(IndexId, object)()
+        # which channels are subscribed to which fields, index values and objects,
+        # and so which of them each transaction goes to
+        self._router = ServerTransactionRouter()
 
-        # for each individually subscribed ID, a set of channels
-        self._id_to_channel = {}
+        # ConnectedChannel.routerId -> ConnectedChannel
+        self._routerIdToChannel = {}
+        self._nextRouterId = 0
 
         self.longTransactionThreshold = 1.0
 
@@ -295,19 +444,8 @@ class Server:
 
             connectedChannel = self._clientChannels[channel]
 
-            for fieldId in connectedChannel.subscribedFields:
-                self._field_id_to_channel[fieldId].discard(connectedChannel)
-
-            for index_key in connectedChannel.subscribedIndexKeys:
-                self._index_to_channel[index_key].discard(connectedChannel)
-                if not self._index_to_channel[index_key]:
-                    del self._index_to_channel[index_key]
-
-            for identity in connectedChannel.subscribedIds:
-                if identity in self._id_to_channel:
-                    self._id_to_channel[identity].discard(connectedChannel)
-                    if not self._id_to_channel[identity]:
-                        del self._id_to_channel[identity]
+            self._router.dropChannel(connectedChannel.routerId)
+            del self._routerIdToChannel[connectedChannel.routerId]
 
             connectionsToDrop = connectedChannel.dependentConnections
 
@@ -359,11 +497,18 @@ class Server:
             with self._lock:
                 connectionObject, identityRoot = self._createConnectionEntry()
 
+                self._nextRouterId += 1
+
                 connectedChannel = ConnectedChannel(
-                    self._cur_transaction_num, channel, connectionObject, identityRoot
+                    self._cur_transaction_num,
+                    channel,
+                    connectionObject,
+                    identityRoot,
+                    self._nextRouterId,
                 )
 
                 self._clientChannels[channel] = connectedChannel
+                self._routerIdToChannel[connectedChannel.routerId] = connectedChannel
 
                 channel.setClientToServerHandler(
                     lambda msg: self.onClientToServerMessage(connectedChannel, msg)
@@ -435,6 +580,94 @@ class Server:
                 )
             )
 
+    def _handleResumeSubscription(self, channel, msg):
+        """Bring a client's saved copy of an entire type up to date.
+
+        We send the objects with a field written since 'msg.since_tid', including
+        the ones deleted since then, as a single SubscriptionData. If we can't tell
+        which those are, because the client's copy came from another server process,
+        we've forgotten keys deleted since then, or our FieldWriteLog doesn't have
+        all the writes since then, we refuse and send the entire type.
+        """
+
+        def refuse():
+            channel.channel.write(
+                ServerToClient.ResumeRefused(schema=msg.schema, typename=msg.typename)
+            )
+            self._handleSubscriptionInForeground(
+                channel,
+                ClientToServer.Subscribe(
+                    schema=msg.schema,
+                    typename=msg.typename,
+                    fieldname_and_value=None,
+                    isLazy=False,
+                ),
+            )
+
+        if (
+            msg.epoch != self._epoch
+            or msg.since_tid < self._resume_horizon
+            or msg.since_tid > self._cur_transaction_num
+        ):
+            refuse()
+            return
+
+        definition = channel.definedSchemas.get(msg.schema)
+
+        assert definition is not None, "can't subscribe to a schema we don't know about!"
+        assert msg.typename in definition, (
+            "Can't subscribe to a type we didn't define in the schema: %s not in %s"
+            % (msg.typename, list(definition))
+        )
+
+        typedef = definition[msg.typename]
+
+        fieldIds = set(
+            self._currentTypeMap().fieldIdFor(msg.schema, msg.typename, fieldname)
+            for fieldname in typedef.fields
+        )
+
+        identities = set()
+
+        # most of the time nothing in the type has changed, and we needn't look.
+        # Otherwise we walk just the writes after 'since_tid'.
+        for fieldId in fieldIds:
+            if self._field_version_numbers.get(fieldId, -1) <= msg.since_tid:
+                continue
+
+            written = self._field_write_log.writesSince(fieldId, msg.since_tid)
+
+            if written is None:
+                refuse()
+                return
+
+            identities.update(written)
+
+        self._sendPartialSubscription(
+            channel,
+            msg.schema,
+            msg.typename,
+            None,
+            typedef,
+            identities,
+            set(identities),
+            BATCH_SIZE=None,
+            checkPending=False,
+        )
+
+        self._markSubscriptionComplete(
+            msg.schema, msg.typename, None, identities, channel, isLazy=False
+        )
+
+        channel.channel.write(
+            ServerToClient.SubscriptionComplete(
+                schema=msg.schema,
+                typename=msg.typename,
+                fieldname_and_value=None,
+                tid=self._cur_transaction_num,
+            )
+        )
+
     def _parseSubscriptionMsg(self, channel, msg):
         schema_name = msg.schema
 
@@ -633,10 +866,7 @@ class Server:
     ):
         if fieldname_and_value is not None:
             # this is an index subscription
-            for ident in identities:
-                self._id_to_channel.setdefault(ident, set()).add(connectedChannel)
-
-                connectedChannel.subscribedIds.add(ident)
+            self._router.subscribeToIds(connectedChannel.routerId, identities)
 
             if fieldname_and_value[0] != "_identity":
                 fieldId = self._currentTypeMap().fieldIdFor(
@@ -644,30 +874,21 @@ class Server:
                 )
                 index_key = IndexId(fieldId=fieldId, indexValue=fieldname_and_value[1])
 
-                if index_key not in self._index_to_channel:
-                    self._index_to_channel[index_key] = set()
-
-                self._index_to_channel[index_key].add(connectedChannel)
-
-                connectedChannel.subscribedIndexKeys[index_key] = (
-                    -1 if not isLazy else self._cur_transaction_num
-                )
+                self._router.subscribeToIndex(connectedChannel.routerId, index_key, isLazy)
             else:
                 # an object's identity cannot change,
                 # so we don't need to track our subscription to it
                 assert not isLazy
         else:
-            # this is a type-subscription
-            for fieldname in connectedChannel.definedSchemas[schema][typename].fields:
-                fieldId = self._currentTypeMap().fieldIdFor(schema, typename, fieldname)
-                if fieldId not in self._field_id_to_channel:
-                    self._field_id_to_channel[fieldId] = set()
+            # this is a type-subscription. We subscribe to the type's indices as well
+            # as its fields, so the router lets through changes to either.
+            typedef = connectedChannel.definedSchemas[schema][typename]
 
-                self._field_id_to_channel[fieldId].add(connectedChannel)
+            for fieldname in set(typedef.fields) | set(typedef.indices):
+                fieldId = self._currentTypeMap().fieldIdFor(schema, typename, fieldname)
 
-                connectedChannel.subscribedFields[fieldId] = (
-                    -1 if not isLazy else self._cur_transaction_num
-                )
+                self._router.subscribeToField(connectedChannel.routerId, fieldId, isLazy)
+                self._field_write_log.logField(fieldId, self._cur_transaction_num)
 
     def _currentTypeMap(self):
         if self._typeMap is None:
@@ -843,6 +1064,13 @@ class Server:
 
             if self._lazyLoadCallback:
                 self._lazyLoadCallback(msg.identity)
+        elif msg.matches.LoadLazyObjects:
+            with self._lock:
+                self._loadLazyObjects(connectedChannel, msg)
+
+            if self._lazyLoadCallback:
+                for identity in msg.identities:
+                    self._lazyLoadCallback(identity)
 
         elif msg.matches.Flush:
             with self._lock:
@@ -857,8 +1085,17 @@ class Server:
         elif msg.matches.Subscribe:
             with self._lock:
                 self._handleSubscriptionInForeground(connectedChannel, msg)
+        elif msg.matches.ResumeSubscription:
+            with self._lock:
+                self._handleResumeSubscription(connectedChannel, msg)
+        elif msg.matches.RequestEpoch:
+            connectedChannel.channel.write(
+                ServerToClient.EpochResponse(guid=msg.guid, epoch=self._epoch)
+            )
         elif msg.matches.TransactionData:
             connectedChannel.handleTransactionData(msg)
+        elif msg.matches.TransactionReads:
+            connectedChannel.handleTransactionReads(msg)
         elif msg.matches.CompleteTransaction:
             try:
                 transStartTime = time.time()
@@ -875,6 +1112,9 @@ class Server:
                         data["index_versions"],
                         msg.as_of_version,
                         transStartTime=transStartTime,
+                        key_ranges_to_check_versions=data["key_ranges"],
+                        fields_to_check_versions=data["field_versions"],
+                        index_fields_to_check_versions=data["index_field_versions"],
                     )
             except Exception:
                 self._logger.exception("Unknown error committing transaction:")
@@ -883,24 +1123,6 @@ class Server:
 
             connectedChannel.sendTransactionSuccess(msg.transaction_guid, isOK, badKey)
 
-    def indexReverseLookupKvs(self, adds, removes):
-        res = {}
-
-        for indexKey, identities in removes.items():
-            for ident in identities:
-                res[
-                    ObjectFieldId(fieldId=indexKey.fieldId, objId=ident, isIndexValue=True)
-                ] = None
-
-        for indexKey, identities in adds.items():
-            fieldId = indexKey.fieldId
-            valueHash = indexKey.indexValue
-
-            for ident in identities:
-                res[ObjectFieldId(fieldId=fieldId, objId=ident, isIndexValue=True)] = valueHash
-
-        return res
-
     def _broadcastSubscriptionIncrease(self, channel, indexKey, tid, newIds):
         newIds = list(newIds)
 
@@ -981,6 +1203,16 @@ class Server:
             )
         )
 
+    def _loadLazyObjects(self, channel, msg):
+        channel.channel.write(
+            ServerToClient.LazyLoadManyResponse(
+                identities=msg.identities,
+                values=self._loadValuesForObject(
+                    channel, msg.schema, msg.typename, list(msg.identities)
+                ),
+            )
+        )
+
     def _garbage_collect(self, intervalOverride=None):
         """Cleanup anything in '_version_numbers' where we have deleted the entry
         and it's inactive for a long time."""
@@ -997,10 +1229,15 @@ class Server:
                 if ts < threshold:
                     if isinstance(key, IndexId):
                         if not self._kvstore.getSetMembers(key):
-                            del self._version_numbers[key]
+                            self._resume_horizon = max(
+                                self._resume_horizon, self._version_numbers.pop(key)
+                            )
                     else:
                         if self._kvstore.get(key) is None:
-                            del self._version_numbers[key]
+                            self._resume_horizon = max(
+                                self._resume_horizon, self._version_numbers.pop(key)
+                            )
+                            self._field_object_ids[key.fieldId].discard(key.objId)
                 else:
                     new_ts[key] = ts
 
@@ -1018,6 +1255,9 @@ class Server:
         indices_to_check_versions,
         as_of_version,
         transStartTime=None,
+        key_ranges_to_check_versions=(),
+        fields_to_check_versions=(),
+        index_fields_to_check_versions=(),
     ):
         self._cur_transaction_num += 1
         transaction_id = self._cur_transaction_num
@@ -1042,11 +1282,8 @@ class Server:
                 fieldDef = self._currentTypeMap().fieldIdToDef.get(fieldId)
 
                 if fieldDef.fieldname == " exists":
-                    if fieldId not in sourceChannel.subscribedFields:
-                        sourceChannel.subscribedIds.update(added_identities)
-
-                        for new_id in added_identities:
-                            self._id_to_channel.setdefault(new_id, set()).add(sourceChannel)
+                    if not self._router.isSubscribedToField(sourceChannel.routerId, fieldId):
+                        self._router.subscribeToIds(sourceChannel.routerId, added_identities)
 
                         self._broadcastSubscriptionIncrease(
                             sourceChannel, add_index, transaction_id, added_identities
@@ -1073,21 +1310,68 @@ class Server:
                 if as_of_version < last_tid:
                     return (False, key)
 
+        for fieldId in fields_to_check_versions:
+            if as_of_version < self._field_version_numbers.get(fieldId, -1):
+                return (False, "field %s" % fieldId)
+
+        for fieldId in index_fields_to_check_versions:
+            if as_of_version < self._index_field_version_numbers.get(fieldId, -1):
+                return (False, "index %s" % fieldId)
+
+        # 'ranges' is a flat, sorted list of [start, stop) pairs. We only need to look
+        # at the writes to the field since our snapshot, and an object is in one of
+        # the ranges if an odd number of range ends are at or below it.
+        for fieldId, ranges in key_ranges_to_check_versions:
+            if as_of_version >= self._field_version_numbers.get(fieldId, -1):
+                continue
+
+            problem = keyRangesProblem(ranges)
+
+            if problem == "invalid":
+                return (False, "invalid key ranges for field %s" % fieldId)
+
+            if problem is not None:
+                return (False, "field %s" % fieldId)
+
+            written = self._field_write_log.writesSince(fieldId, as_of_version)
+
+            if written is not None:
+                for objId in written:
+                    if bisect.bisect_right(ranges, objId) % 2:
+                        return (
+                            False,
+                            ObjectFieldId(fieldId=fieldId, objId=objId, isIndexValue=False),
+                        )
+                continue
+
+            # we dropped some of the writes since our snapshot, so check each key of
+            # the field we know about. We never walk the ranges themselves, which
+            # are only bounded by what the client sent.
+            for objId in self._field_object_ids.get(fieldId, ()):
+                if bisect.bisect_right(ranges, objId) % 2:
+                    key = ObjectFieldId(fieldId=fieldId, objId=objId, isIndexValue=False)
+                    if as_of_version < self._version_numbers.get(key, -1):
+                        return (False, key)
+
         t1 = time.time()
 
         for key in keysWritingTo:
             self._version_numbers[key] = transaction_id
             self._version_numbers_timestamps[key] = t1
+            self._field_version_numbers[key.fieldId] = transaction_id
+            self._field_write_log.record(key.fieldId, key.objId, transaction_id)
+            self._field_object_ids.setdefault(key.fieldId, set()).add(key.objId)
 
         for key in setsWritingTo:
             self._version_numbers[key] = transaction_id
             self._version_numbers_timestamps[key] = t1
+            self._index_field_version_numbers[key.fieldId] = transaction_id
 
         priorValues = self._kvstore.getSeveralAsDictionary(key_value)
 
         # set the json representation in the database
         target_kvs = {k: v for k, v in key_value.items()}
-        target_kvs.update(self.indexReverseLookupKvs(set_adds, set_removes))
+        target_kvs.update(self._router.indexReverseLookupKvs(set_adds, set_removes))
 
         new_sets, dropped_sets = self._kvstore.setSeveral(target_kvs, set_adds, set_removes)
 
@@ -1111,53 +1395,39 @@ class Server:
 
         t2 = time.time()
 
-        channelsTriggeredForPriors = set()
+        # work out which channels get this transaction. Channels subscribed to an
+        # index value get subscribed to the objects this adds to it, and we add the
+        # backing data for those objects to the transaction.
+        increases, channelIdsTriggered, channelIdsTriggeredForPriors = self._router.route(
+            fieldIdsWriting, identities_mentioned, set_adds
+        )
 
-        # check any index-level subscriptions that are going to increase as a
-        # result of this transaction and add the backing data to the relevant
-        # transaction.
-        for index_key, adds in list(set_adds.items()):
-            if index_key in self._index_to_channel:
-                idsToAddToTransaction = set()
+        idsToAddToTransaction = {}
+        channelForIndexKey = {}
 
-                for channel in self._index_to_channel.get(index_key):
-                    if (
-                        index_key in channel.subscribedIndexKeys
-                        and channel.subscribedIndexKeys[index_key] >= 0
-                    ):
-                        # this is a lazy subscription. We're not using the
-                        # transaction ID yet because we don't store it on a
-                        # per-object basis here. Instead, we're always sending
-                        # everything twice to lazy subscribers.
-                        channelsTriggeredForPriors.add(channel)
-
-                    newIds = adds.difference(channel.subscribedIds)
-                    for new_id in newIds:
-                        self._id_to_channel.setdefault(new_id, set()).add(channel)
-                        channel.subscribedIds.add(new_id)
-
-                    self._broadcastSubscriptionIncrease(
-                        channel, index_key, transaction_id, newIds
-                    )
+        for index_key, channelId, newIds in increases:
+            channel = self._routerIdToChannel[channelId]
 
-                    idsToAddToTransaction.update(newIds)
-
-                if idsToAddToTransaction:
-                    self._increaseBroadcastTransactionToInclude(
-                        channel,  # deliberately just using whatever random channel, under
-                        # the assumption they're all the same. it would be better
-                        # to explictly compute the union of the relevant set of
-                        # defined fields, as its possible one channel has more fields
-                        # for a type than another and we'd like to broadcast them all
-                        index_key,
-                        idsToAddToTransaction,
-                        key_value,
-                        set_adds,
-                        set_removes,
-                    )
+            self._broadcastSubscriptionIncrease(channel, index_key, transaction_id, newIds)
 
-        transaction_message = None
-        channelsTriggered = set()
+            idsToAddToTransaction.setdefault(index_key, set()).update(newIds)
+
+            # deliberately just using whatever random channel, under the assumption
+            # they're all the same. it would be better to explictly compute the union
+            # of the relevant set of defined fields, as its possible one channel has
+            # more fields for a type than another and we'd like to broadcast them all
+            channelForIndexKey[index_key] = channel
+
+        for index_key, newIds in idsToAddToTransaction.items():
+            if newIds:
+                self._increaseBroadcastTransactionToInclude(
+                    channelForIndexKey[index_key],
+                    index_key,
+                    newIds,
+                    key_value,
+                    set_adds,
+                    set_removes,
+                )
 
         for fieldId in fieldIdsWriting:
             if fieldId not in self.fieldTransactionsSinceLastLog:
@@ -1165,18 +1435,12 @@ class Server:
             else:
                 self.fieldTransactionsSinceLastLog[fieldId] += 1
 
-            for channel in self._field_id_to_channel.get(fieldId, ()):
-                if channel.subscribedFields[fieldId] >= 0:
-                    # this is a lazy subscription. We're not using the
-                    # transaction ID yet because we don't store it on a
-                    # per-object basis here. Instead, we're always sending
-                    # everything twice to lazy subscribers.
-                    channelsTriggeredForPriors.add(channel)
-                channelsTriggered.add(channel)
-
-        for i in identities_mentioned:
-            if i in self._id_to_channel:
-                channelsTriggered.update(self._id_to_channel[i])
+        # lazy subscribers get everything twice. We're not using the transaction ID
+        # yet because we don't store it on a per-object basis here.
+        channelsTriggeredForPriors = [
+            self._routerIdToChannel[c] for c in channelIdsTriggeredForPriors
+        ]
+        channelsTriggered = [self._routerIdToChannel[c] for c in channelIdsTriggered]
 
         # keep track of the broadcast multiple each field is getting sent to
         for fieldId in fieldIdsWriting:
@@ -1201,8 +1465,28 @@ class Server:
         if self._pendingSubscriptionRecheck is not None:
             self._pendingSubscriptionRecheck.append(transaction_message)
 
-        for channel in channelsTriggered:
-            channel.sendTransaction(transaction_message)
+        # each channel only gets the writes and index changes it's subscribed to. The
+        # many that are subscribed to all of it share one message.
+        filtered = self._router.filterTransaction(
+            [channel.routerId for channel in channelsTriggered],
+            key_value,
+            set_adds,
+            set_removes,
+        )
+
+        for channel, parts in zip(channelsTriggered, filtered):
+            if parts is None:
+                channel.sendTransaction(transaction_message)
+            else:
+                writes, adds, removes = parts
+                channel.sendTransaction(
+                    ServerToClient.Transaction(
+                        writes=writes,
+                        set_adds=adds,
+                        set_removes=removes,
+                        transaction_id=transaction_id,
+                    )
+                )
 
         if self.verbose or time.time() - t0 > self.longTransactionThreshold:
             self._logger.info(
@@ -14,7 +14,7 @@
 
 from object_database.database_connection import DatabaseConnection
 from object_database._types import DatabaseConnectionPumpLoop
-from object_database.server import Server
+from object_database.server import Server, DEFAULT_FIELD_WRITE_LOG_CAPACITY
 from object_database.proxy_server import ProxyServer
 from object_database.message_bus import MessageBus
 from object_database.messages import ClientToServer, ServerToClient, getHeartbeatInterval
@@ -30,9 +30,12 @@ import threading
 import socket
 import atexit
 
+# messages at least this big get compressed, if the other side of the connection can read them
+DEFAULT_COMPRESSION_THRESHOLD = 64 * 1024
+
 
 class PumpLoopChannel(ClientToServerChannel):
-    def __init__(self, SendT, RecvT, nativePumpLoop, socket, ssl, ssl_ctx):
+    def __init__(self, SendT, RecvT, nativePumpLoop, socket, ssl, ssl_ctx, eventLoop=None):
         self._nativePumpLoop = nativePumpLoop
         self.SendT = SendT
         self.RecvT = RecvT
@@ -40,15 +43,25 @@ class PumpLoopChannel(ClientToServerChannel):
         self._ssl = ssl
         self._ssl_context = ssl_ctx
 
-        self._threads = [
-            threading.Thread(target=self.writeLoop, daemon=True),
-            threading.Thread(target=self.readLoop, daemon=True),
-        ]
+        # if we have an asyncio loop, it processes our messages on its own thread,
+        # waking up on the pump loop's ready fd, instead of a readLoop thread of ours.
+        self._eventLoop = eventLoop
+        self._readyPumpLoop = None
+
+        if eventLoop is None:
+            self._threads = [threading.Thread(target=self.readLoop, daemon=True)]
+        else:
+            self._threads = []
 
         self._nativePumpLoop.setHeartbeatMessage(
             serialize(ClientToServer, ClientToServer.Heartbeat()), getHeartbeatInterval()
         )
 
+        # where we can, the socket gets pumped by a pool shared with every other
+        # connection in the process. Otherwise it needs a thread of its own.
+        if not self._nativePumpLoop.attachToEngine():
+            self._threads.append(threading.Thread(target=self.writeLoop, daemon=True))
+
         self._lock = threading.Lock()
         self._messageHandler = None
         self._pendingMessages = []
@@ -58,6 +71,15 @@ class PumpLoopChannel(ClientToServerChannel):
 
         atexit.register(self._atExit)
 
+        if eventLoop is not None:
+            # the fd stays open as long as the pump loop does, so hold on to it
+            # until we've unregistered
+            self._readyPumpLoop = nativePumpLoop
+            readyFD = nativePumpLoop.readyFD()
+            eventLoop.call_soon_threadsafe(
+                eventLoop.add_reader, readyFD, self._onReady, readyFD
+            )
+
         for t in self._threads:
             t.start()
 
@@ -97,22 +119,84 @@ class PumpLoopChannel(ClientToServerChannel):
             serialize(ClientToServer, ClientToServer.Heartbeat()), 0.0
         )
 
+    def setNativeTransactionHandler(self, connectionState, lock, onTransaction):
+        """Apply incoming Transaction messages to 'connectionState' in C++.
+
+        Instead of seeing them as messages, we call 'onTransaction(transaction_id, fieldIds)'
+        under 'lock' for each one.
+
+        Returns:
+            False if we can't do this for our message type.
+        """
+        with self._lock:
+            pumpLoop = self._nativePumpLoop
+
+        if pumpLoop is None:
+            return False
+
+        return pumpLoop.setTransactionHandler(self.RecvT, connectionState, lock, onTransaction)
+
+    def writeCommit(self, view, transaction_guid, as_of_version):
+        """Send the messages that commit the native View 'view', built in C++.
+
+        Returns:
+            False if we have no pump loop, in which case nothing was sent.
+        """
+        with self._lock:
+            pumpLoop = self._nativePumpLoop
+
+        if pumpLoop is None:
+            return False
+
+        pumpLoop.writeCommit(self.SendT, view, transaction_guid, as_of_version)
+
+        return True
+
+    def compressionStats(self):
+        """Return a dict describing how much compression has saved us on the wire, or None."""
+        with self._lock:
+            pumpLoop = self._nativePumpLoop
+
+        if pumpLoop is None:
+            return None
+
+        return pumpLoop.compressionStats()
+
+    def pumpStats(self):
+        """Return a dict describing our outgoing queue and socket thread, or None."""
+        with self._lock:
+            pumpLoop = self._nativePumpLoop
+
+        if pumpLoop is None:
+            return None
+
+        return pumpLoop.pumpStats()
+
+    def setHighWaterMark(self, bytes):
+        """Make 'write' block while at least 'bytes' of messages are waiting to go out.
+
+        Zero means never block.
+        """
+        with self._lock:
+            pumpLoop = self._nativePumpLoop
+
+        if pumpLoop is not None:
+            pumpLoop.setHighWaterMark(bytes)
+
+    def clearNativeTransactionHandler(self):
+        with self._lock:
+            pumpLoop = self._nativePumpLoop
+
+        if pumpLoop is not None:
+            pumpLoop.clearTransactionHandler()
+
     def readLoop(self):
         try:
             self._nativePumpLoop.readLoop(self.onMessage)
         except Exception:
             logging.exception("PumpLoopChannel.readLoop had unexpected exception")
 
-        with self._lock:
-            self._hasClosed = True
-            callback = self._onClosed
-
-        pumpLoop = self._nativePumpLoop
-        if pumpLoop is not None:
-            pumpLoop.close()
-
-        if callback is not None:
-            callback()
+        self._pumpLoopFinished()
 
     def writeLoop(self):
         try:
@@ -120,6 +204,27 @@ class PumpLoopChannel(ClientToServerChannel):
         except Exception:
             logging.exception("PumpLoopChannel.writeLoop had unexpected exception")
 
+        self._pumpLoopFinished()
+
+    def _onReady(self, readyFD):
+        # called on our event loop whenever the pump loop has messages for us
+        try:
+            messages = self._readyPumpLoop.drain()
+        except Exception:
+            logging.exception("PumpLoopChannel.drain had unexpected exception")
+            messages = None
+
+        if messages is not None:
+            for msg in messages:
+                self.onMessage(msg)
+            return
+
+        self._eventLoop.remove_reader(readyFD)
+        self._readyPumpLoop = None
+
+        self._pumpLoopFinished()
+
+    def _pumpLoopFinished(self):
         with self._lock:
             self._hasClosed = True
             callback = self._onClosed
@@ -133,7 +238,11 @@ class PumpLoopChannel(ClientToServerChannel):
 
     def onMessage(self, msgBytes):
         try:
-            msg = deserialize(self.RecvT, msgBytes)
+            # if we have a native transaction handler, it already decoded the message
+            if isinstance(msgBytes, bytes):
+                msg = deserialize(self.RecvT, msgBytes)
+            else:
+                msg = msgBytes
 
             with self._lock:
                 if self._messageHandler is not None:
@@ -185,7 +294,16 @@ class PumpLoopChannel(ClientToServerChannel):
         pumpLoop.write(serialize(self.SendT, msg))
 
 
-def _connectedChannel(host, port, auth_token, timeout=10.0, retry=False):
+def _connectedChannel(
+    host,
+    port,
+    auth_token,
+    timeout=10.0,
+    retry=False,
+    compressionThreshold=None,
+    highWaterMark=None,
+    eventLoop=None,
+):
     t0 = time.time()
 
     # With CLIENT_AUTH we are setting up the SSL to use encryption only, which is what we want.
@@ -219,18 +337,63 @@ def _connectedChannel(host, port, auth_token, timeout=10.0, retry=False):
     if nativePumpLoop is None:
         raise ConnectionRefusedError()
 
+    if compressionThreshold is not None:
+        nativePumpLoop.enableCompression(compressionThreshold)
+
+    if highWaterMark is not None:
+        nativePumpLoop.setHighWaterMark(highWaterMark)
+
     connectionDict = dict(peername=peername, socket=sock, sockname=sockname)
 
     return (
-        PumpLoopChannel(ClientToServer, ServerToClient, nativePumpLoop, sock, ssock, ssl_ctx),
+        PumpLoopChannel(
+            ClientToServer,
+            ServerToClient,
+            nativePumpLoop,
+            sock,
+            ssock,
+            ssl_ctx,
+            eventLoop=eventLoop,
+        ),
         connectionDict,
     )
 
 
-def connect(host, port, auth_token, timeout=10.0, retry=False):
+def connect(
+    host,
+    port,
+    auth_token,
+    timeout=10.0,
+    retry=False,
+    compressionThreshold=None,
+    highWaterMark=None,
+    eventLoop=None,
+):
+    """Connect to the TcpServer at host:port.
+
+    Args:
+        compressionThreshold (int or None): if not None, compress messages at least this
+            many bytes long, and ask the server to do the same. Requires a server that
+            understands compressed messages.
+        highWaterMark (int or None): if not None, sending a message blocks while at
+            least this many bytes are waiting to go out to the server.
+        eventLoop (asyncio event loop or None): if not None, process incoming messages
+            on this loop's thread, which must already be running, instead of a thread
+            of our own. We wait for the connection to initialize, so don't call this on
+            that thread. Use 'loop.run_in_executor' from a coroutine instead.
+    """
     t0 = time.time()
 
-    channel, connectionDict = _connectedChannel(host, port, auth_token, timeout, retry)
+    channel, connectionDict = _connectedChannel(
+        host,
+        port,
+        auth_token,
+        timeout,
+        retry,
+        compressionThreshold=compressionThreshold,
+        highWaterMark=highWaterMark,
+        eventLoop=eventLoop,
+    )
 
     conn = DatabaseConnection(channel, connectionDict)
 
@@ -270,8 +433,22 @@ class ServerChannel(ServerToClientChannel):
 
 
 class TcpServer(Server):
-    def __init__(self, host, port, mem_store, ssl_context, auth_token):
-        Server.__init__(self, mem_store or InMemoryPersistence(), auth_token)
+    def __init__(
+        self,
+        host,
+        port,
+        mem_store,
+        ssl_context,
+        auth_token,
+        compressionThreshold=DEFAULT_COMPRESSION_THRESHOLD,
+        fieldWriteLogCapacity=DEFAULT_FIELD_WRITE_LOG_CAPACITY,
+    ):
+        Server.__init__(
+            self,
+            mem_store or InMemoryPersistence(),
+            auth_token,
+            fieldWriteLogCapacity=fieldWriteLogCapacity,
+        )
         self.host = host
         self.port = port
         self.mem_store = mem_store
@@ -284,6 +461,7 @@ class TcpServer(Server):
             self.onEvent,
             sslContext=ssl_context,
             extraMessageSizeCheck=False,
+            compressionThreshold=compressionThreshold,
         )
         self._messageBusChannels = {}
 
@@ -328,8 +506,17 @@ class TcpServer(Server):
             if id in self._messageBusChannels:
                 self._messageBusChannels[id].receive(event.message)
 
-    def connect(self, auth_token):
-        return connect(self.host, self.port, auth_token)
+    def connect(
+        self, auth_token, compressionThreshold=None, highWaterMark=None, eventLoop=None
+    ):
+        return connect(
+            self.host,
+            self.port,
+            auth_token,
+            compressionThreshold=compressionThreshold,
+            highWaterMark=highWaterMark,
+            eventLoop=eventLoop,
+        )
 
     def __enter__(self):
         self.start()
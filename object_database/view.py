@@ -102,6 +102,21 @@ class View(object):
     def transaction_id(self):
         return self._transaction_num
 
+    def prefetchLazyObjects(self, objects):
+        """Start loading any lazy objects in 'objects' with one request per type.
+
+        Reading one of them afterwards waits for that request instead of making
+        one round trip to the server per object.
+        """
+        self._view.prefetchLazyObjects([o._identity for o in objects])
+
+    def traceSummary(self):
+        """A dict of what we did while we were entered, or None if tracing was off.
+
+        See object_database.view_trace.
+        """
+        return self._view.traceSummary()
+
     def getFieldReads(self):
         return self._view.extractReads()
 
@@ -115,13 +130,9 @@ class View(object):
         if not self._writeable:
             raise Exception("Views are static. Please open a transaction.")
 
-        reads = self._view.extractReads()
-        writes = self._view.extractWrites()
-        indexReads = self._view.extractIndexReads()
-        setAdds = self._view.extractSetAdds()
-        setRemoves = self._view.extractSetRemoves()
+        writeCount, setChangeCount = self._view.pendingWriteCounts()
 
-        if writes:
+        if writeCount:
             tid = self._transaction_num
 
             if self._confirmCommitCallback is None:
@@ -131,15 +142,22 @@ class View(object):
             else:
                 confirmCallback = self._confirmCommitCallback
 
-            self._db._createTransaction(
-                writes,
-                {k: v for k, v in setAdds.items() if v},
-                {k: v for k, v in setRemoves.items() if v},
-                reads,
-                indexReads,
-                tid,
-                confirmCallback,
-            )
+            if not self._db._commitNatively(self._view, tid, confirmCallback):
+                setAdds = self._view.extractSetAdds()
+                setRemoves = self._view.extractSetRemoves()
+
+                self._db._createTransaction(
+                    self._view.extractWrites(),
+                    {k: v for k, v in setAdds.items() if v},
+                    {k: v for k, v in setRemoves.items() if v},
+                    self._view.extractReads(),
+                    self._view.extractIndexReads(),
+                    tid,
+                    confirmCallback,
+                    key_ranges_to_check_versions=self._view.extractReadRanges(),
+                    fields_to_check_versions=self._view.extractReadFields(),
+                    index_fields_to_check_versions=self._view.extractIndexRangeReads(),
+                )
 
             if not self._confirmCommitCallback:
                 # this is the synchronous case - we want to wait for the confirm
@@ -153,8 +171,8 @@ class View(object):
                 if time.time() - t0 > LOG_SLOW_COMMIT_THRESHOLD:
                     self._logger.info(
                         "Committing %s writes and %s set changes took %.1f seconds",
-                        len(writes),
-                        len(setAdds) + len(setRemoves),
+                        writeCount,
+                        setChangeCount,
                         time.time() - t0,
                     )
 
@@ -246,12 +264,41 @@ class Transaction(View):
 
         return self
 
+    def withReadTracking(self, tracking):
+        """Return ourselves, but record what we read as 'tracking', which must be one of
+
+            'keys': every field of every object we read. This is the default.
+            'ranges': the same keys, but sent to the server as ranges of object ids,
+                which is far smaller for transactions that scan many objects.
+            'fields': only the fields we read. Any write to one of them since our
+                snapshot conflicts with us, even if it's to an object we didn't read.
+
+        This has to be called before the transaction reads anything.
+        """
+        self._view.setReadTracking(tracking)
+
+        return self
+
     def withCommitTimeout(self, commitTimeout):
         """Return ourselves, but set the commit timeout."""
         self._commitTimeout = commitTimeout
 
         return self
 
+    def setMany(self, objects, **columns):
+        """Write a column of values to each of 'objects', which must all be of one type.
+
+        Each keyword names a field and gives a ListOf, TupleOf, or list with one value
+        per object. The writes happen in one native pass, updating indices as they go.
+        Call this inside the transaction's 'with' block.
+        """
+        objects = list(objects)
+
+        if not objects:
+            return
+
+        type(objects[0]).setMany(objects, **columns)
+
 
 def current_transaction():
     if not hasattr(_cur_view, "view"):
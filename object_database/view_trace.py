@@ -0,0 +1,57 @@
+#   Copyright 2017-2020 object_database Authors
+#
+#   Licensed under the Apache License, Version 2.0 (the "License");
+#   you may not use this file except in compliance with the License.
+#   You may obtain a copy of the License at
+#
+#       http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+
+"""Count what views and transactions spend their time on, and sample traces of them.
+
+Tracing is compiled in but off by default. While it's on, every view or transaction
+entered counts its field reads, read-cache and value-cache hits, deserializations, index
+lookup steps, lazy loads, and garbage collection, and 'View.traceSummary' returns those
+counts once it has exited. One view in every 'sampleEvery' also records timed spans,
+which 'exportChromeTrace' writes as Chrome trace JSON for chrome://tracing or Perfetto.
+"""
+
+import json
+
+import object_database._types as _types
+
+
+def enable(sampleEvery=1, maxEvents=100000):
+    """Start tracing views entered from now on.
+
+    Args:
+        sampleEvery (int): record spans for one view in this many.
+        maxEvents (int): keep at most this many spans until they're exported.
+    """
+    _types.configureViewTrace(True, sampleEvery, maxEvents)
+
+
+def disable():
+    """Stop tracing views entered from now on. Spans already recorded are kept."""
+    _types.configureViewTrace(False)
+
+
+def chromeTrace(clear=True):
+    """Return the spans recorded so far as a Chrome trace, in a dict.
+
+    If 'clear', forget them, so the next call only sees newer spans.
+    """
+    return json.loads(_types.viewTraceChromeJson(clear))
+
+
+def exportChromeTrace(path, clear=True):
+    """Write the spans recorded so far to 'path' as Chrome trace JSON."""
+    text = _types.viewTraceChromeJson(clear)
+
+    with open(path, "w") as f:
+        f.write(text)